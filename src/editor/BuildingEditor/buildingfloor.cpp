@@ -45,19 +45,22 @@ using namespace BuildingEditor;
 FloorTileGrid::FloorTileGrid(int width, int height) :
     mWidth(width),
     mHeight(height),
-    mCount(0),
-    mUseVector(false)
+    mBlocksWide((width + BlockSize - 1) >> BlockShift),
+    mCount(0)
 {
+    int blocksHigh = (height + BlockSize - 1) >> BlockShift;
+    mBlocks.resize(mBlocksWide * blocksHigh);
+    mBlockCounts.fill(0, mBlocks.size());
 }
 
 const QString &FloorTileGrid::at(int index) const
 {
-    if (mUseVector)
-        return mCellsVector[index];
-    QHash<int,QString>::const_iterator it = mCells.find(index);
-    if (it != mCells.end())
-        return *it;
-    return mEmptyCell;
+    return BuildingTilesMgr::tileNameForId(idAt(index));
+}
+
+const QString &FloorTileGrid::at(int x, int y) const
+{
+    return BuildingTilesMgr::tileNameForId(idAt(x, y));
 }
 
 // Return true if the area of this object matches that of the other object placed at x,y.
@@ -71,7 +74,7 @@ bool FloorTileGrid::matches(int x, int y, const FloorTileGrid &other) const
     }
     for (int y1 = 0; y1 < other.height(); y1++) {
         for (int x1 = 0; x1 < other.width(); x1++) {
-            if (at(x + x1, y + y1) != other.at(x1, y1)) {
+            if (idAt(x + x1, y + y1) != other.idAt(x1, y1)) {
                 return false;
             }
         }
@@ -81,60 +84,29 @@ bool FloorTileGrid::matches(int x, int y, const FloorTileGrid &other) const
 
 void FloorTileGrid::replace(int index, const QString &tile)
 {
-    if (mUseVector) {
-        if (!mCellsVector[index].isEmpty() && tile.isEmpty()) mCount--;
-        if (mCellsVector[index].isEmpty() && !tile.isEmpty()) mCount++;
-        mCellsVector[index] = tile;
-        return;
-    }
-    QHash<int,QString>::iterator it = mCells.find(index);
-    if (it == mCells.end()) {
-        if (tile.isEmpty())
-            return;
-        mCells.insert(index, tile);
-        mCount++;
-    } else if (!tile.isEmpty()) {
-        (*it) = tile;
-        mCount++;
-    } else {
-        mCells.erase(it);
-        mCount--;
-    }
-    if (mCells.size() > 300 * 300 / 3)
-        swapToVector();
+    replaceId(index % mWidth, index / mWidth, BuildingTilesMgr::tileNameId(tile));
 }
 
 void FloorTileGrid::replace(int x, int y, const QString &tile)
 {
-    Q_ASSERT(contains(x, y));
-    replace(y * mWidth + x, tile);
+    replaceId(x, y, BuildingTilesMgr::tileNameId(tile));
 }
 
 bool FloorTileGrid::replace(const QString &tile)
 {
-    bool changed = false;
-    for (int x = 0; x < mWidth; x++) {
-        for (int y = 0; y < mHeight; y++) {
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
-                changed = true;
-            }
-        }
-    }
-    return changed;
+    return replace(bounds(), tile);
 }
 
 bool FloorTileGrid::replace(const QRegion &rgn, const QString &tile)
 {
+    quint32 id = BuildingTilesMgr::tileNameId(tile);
     bool changed = false;
     for (QRect r2 : rgn) {
         r2 &= bounds();
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                if (at(x, y) != tile) {
-                    replace(x, y, tile);
+                if (replaceId(x, y, id))
                     changed = true;
-                }
             }
         }
     }
@@ -150,11 +122,8 @@ bool FloorTileGrid::replace(const QRegion &rgn, const QPoint &p,
         r2 &= bounds();
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                QString tile = other->at(x - p.x(), y - p.y());
-                if (at(x, y) != tile) {
-                    replace(x, y, tile);
+                if (replaceId(x, y, other->idAt(x - p.x(), y - p.y())))
                     changed = true;
-                }
             }
         }
     }
@@ -163,16 +132,7 @@ bool FloorTileGrid::replace(const QRegion &rgn, const QPoint &p,
 
 bool FloorTileGrid::replace(const QRect &r, const QString &tile)
 {
-    bool changed = false;
-    for (int x = r.left(); x <= r.right(); x++) {
-        for (int y = r.top(); y <= r.bottom(); y++) {
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
-                changed = true;
-            }
-        }
-    }
-    return changed;
+    return replace(QRegion(r), tile);
 }
 
 bool FloorTileGrid::replace(const QPoint &p, const FloorTileGrid *other)
@@ -181,22 +141,43 @@ bool FloorTileGrid::replace(const QPoint &p, const FloorTileGrid *other)
     bool changed = false;
     for (int x = r.left(); x <= r.right(); x++) {
         for (int y = r.top(); y <= r.bottom(); y++) {
-            QString tile = other->at(x - p.x(), y - p.y());
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
+            if (replaceId(x, y, other->idAt(x - p.x(), y - p.y())))
                 changed = true;
-            }
         }
     }
     return changed;
 }
 
+bool FloorTileGrid::replaceId(int x, int y, quint32 id)
+{
+    Q_ASSERT(contains(x, y));
+    int b = blockIndex(x, y);
+    if (mBlocks[b].isEmpty()) {
+        if (!id)
+            return false;
+        mBlocks[b].fill(0, BlockSize * BlockSize);
+    }
+    quint32 &cell = mBlocks[b][cellIndex(x, y)];
+    if (cell == id)
+        return false;
+    if (!cell) {
+        mCount++;
+        mBlockCounts[b]++;
+    } else if (!id) {
+        mCount--;
+        if (--mBlockCounts[b] == 0) {
+            mBlocks[b].clear();
+            return true;
+        }
+    }
+    cell = id;
+    return true;
+}
+
 void FloorTileGrid::clear()
 {
-    if (mUseVector)
-        mCellsVector.fill(mEmptyCell);
-    else
-        mCells.clear();
+    mBlocks.fill(QVector<quint32>());
+    mBlockCounts.fill(0);
     mCount = 0;
 }
 
@@ -211,7 +192,7 @@ FloorTileGrid *FloorTileGrid::clone(const QRect &r)
     const QRect r2 = r & bounds();
     for (int x = r2.left(); x <= r2.right(); x++) {
         for (int y = r2.top(); y <= r2.bottom(); y++) {
-            klone->replace(x - r.x(), y - r.y(), at(x, y));
+            klone->replaceId(x - r.x(), y - r.y(), idAt(x, y));
         }
     }
     return klone;
@@ -224,26 +205,13 @@ FloorTileGrid *FloorTileGrid::clone(const QRect &r, const QRegion &rgn)
         r2 &= bounds() & r;
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                klone->replace(x - r.x(), y - r.y(), at(x, y));
+                klone->replaceId(x - r.x(), y - r.y(), idAt(x, y));
             }
         }
     }
     return klone;
 }
 
-void FloorTileGrid::swapToVector()
-{
-    Q_ASSERT(!mUseVector);
-    mCellsVector.resize(size());
-    QHash<int,QString>::const_iterator it = mCells.begin();
-    while (it != mCells.end()) {
-        mCellsVector[it.key()] = (*it);
-        ++it;
-    }
-    mCells.clear();
-    mUseVector = true;
-}
-
 /////
 
 BuildingFloor::BuildingFloor(Building *building, int level) :
@@ -499,12 +467,107 @@ static void ReplaceWindow(Window *window, QVector<QVector<BuildingFloor::Square>
     }
 }
 
+// Returns the squares that LayoutToSquares() might change because of an object.
+// Doors, windows, stairs, furniture and roof caps touch the squares next to
+// them, and roof tiles may be placed at an offset from their actual position.
+QRect BuildingFloor::layoutBounds(BuildingObject *object)
+{
+    int margin = 1;
+    if (RoofObject *ro = object->asRoof()) {
+        BuildingTileEntry *entries[3] = { ro->slopeTiles(), ro->capTiles(), ro->topTiles() };
+        for (BuildingTileEntry *entry : entries) {
+            if (!entry)
+                continue;
+            foreach (const QPoint &offset, entry->mOffsets)
+                margin = qMax(margin, 1 + qMax(qAbs(offset.x()), qAbs(offset.y())));
+        }
+    }
+    return object->bounds().adjusted(-margin, -margin, margin, margin);
+}
+
+QHash<BuildingObject*,QRect> BuildingFloor::layoutObjectBounds() const
+{
+    QHash<BuildingObject*,QRect> ret;
+    foreach (BuildingObject *object, mObjects)
+        ret[object] = layoutBounds(object);
+    if (BuildingFloor *floorBelow = this->floorBelow()) {
+        foreach (BuildingObject *object, floorBelow->objects()) {
+            if (object->affectsFloorAbove())
+                ret[object] = layoutBounds(object);
+        }
+    }
+    return ret;
+}
+
+// Compares the room grid and objects with those the squares were last laid
+// out from.
+QRect BuildingFloor::layoutChanges(const QHash<BuildingObject*,QRect> &objects) const
+{
+    QRect changed;
+
+    for (int x = 0; x < width(); x++) {
+        // Columns that were never modified are still shared.
+        if (mRoomAtPos[x].constData() == mLayoutRoomAtPos[x].constData())
+            continue;
+        for (int y = 0; y < height(); y++) {
+            if (mRoomAtPos[x][y] != mLayoutRoomAtPos[x][y])
+                changed |= QRect(x, y, 1, 1);
+        }
+    }
+
+    QHash<BuildingObject*,QRect>::const_iterator it;
+    for (it = objects.constBegin(); it != objects.constEnd(); it++) {
+        QRect old = mLayoutObjectBounds.value(it.key());
+        if (old != it.value())
+            changed |= old | it.value();
+    }
+    for (it = mLayoutObjectBounds.constBegin(); it != mLayoutObjectBounds.constEnd(); it++) {
+        if (!objects.contains(it.key()))
+            changed |= it.value();
+    }
+
+    return changed;
+}
+
 void BuildingFloor::LayoutToSquares()
+{
+    LayoutToSquares(bounds(1, 1));
+}
+
+QRect BuildingFloor::LayoutToSquares(const QRect &changed)
 {
     int w = width() + 1;
     int h = height() + 1;
     // +1 for the outside walls;
     static const Square empty;
+
+    QHash<BuildingObject*,QRect> objectBounds = layoutObjectBounds();
+
+    // Only the squares near a change are laid out again.  The squares
+    // around those are laid out too, since walls, wall trim and the SE wall
+    // pieces depend on the squares to the north and west of them.  That is
+    // done in a scratch grid and only the squares in 'area' are kept.
+    QRect area = bounds(1, 1);
+    QRect work = area;
+    bool full = (this->squares.size() != w) || (this->squares[0].size() != h)
+            || (mLayoutRoomAtPos.size() != width()) || ((changed & area) == area);
+    if (!full) {
+        QRect dirty = changed | layoutChanges(objectBounds);
+        if (dirty.isEmpty())
+            return QRect();
+        area = dirty.adjusted(-2, -2, 2, 2) & bounds(1, 1);
+        work = area.adjusted(-2, -2, 2, 2) & bounds(1, 1);
+        if (work == bounds(1, 1)) {
+            area = work;
+            full = true;
+        }
+    }
+    auto skipObject = [&](BuildingObject *object) {
+        return !full && !work.intersects(objectBounds.value(object));
+    };
+
+    QVector<QVector<Square> > scratch;
+    QVector<QVector<Square> > &squares = full ? this->squares : scratch;
     squares.resize(w);
     for (int x = 0; x < w; x++)
         squares[x].fill(empty, h);
@@ -533,8 +596,8 @@ void BuildingFloor::LayoutToSquares()
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    for (int x = work.left(); x <= work.right(); x++) {
+        for (int y = work.top(); y <= work.bottom(); y++) {
             // Place N walls...
             if (x < width()) {
                 if (y == height() && mIndexAtPos[x][y - 1] >= 0) {
@@ -570,6 +633,8 @@ void BuildingFloor::LayoutToSquares()
 
     // Handle WallObjects.
     foreach (BuildingObject *object, mObjects) {
+        if (skipObject(object))
+            continue;
         if (WallObject *wall = object->asWall()) {
             int x = wall->x(), y = wall->y();
             if (wall->isN()) {
@@ -599,6 +664,8 @@ void BuildingFloor::LayoutToSquares()
     // Furniture in the Walls layer replaces wall entries with tiles.
     QList<FurnitureObject*> wallReplacement;
     foreach (BuildingObject *object, mObjects) {
+        if (skipObject(object))
+            continue;
         if (FurnitureObject *fo = object->asFurniture()) {
             FurnitureTile *ftile = fo->furnitureTile()->resolved();
             if (ftile->owner()->layer() == FurnitureTiles::LayerWalls) {
@@ -641,8 +708,8 @@ void BuildingFloor::LayoutToSquares()
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    for (int x = work.left(); x <= work.right(); x++) {
+        for (int y = work.top(); y <= work.bottom(); y++) {
             Square &s = squares[x][y];
             BuildingTileEntry *wallN = s.mWallN.entry;
             BuildingTileEntry *wallW = s.mWallW.entry;
@@ -671,8 +738,8 @@ void BuildingFloor::LayoutToSquares()
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    for (int x = work.left(); x <= work.right(); x++) {
+        for (int y = work.top(); y <= work.bottom(); y++) {
             Square &sq = squares[x][y];
             if ((sq.mEntries[Square::SectionWall] &&
                     !sq.mEntries[Square::SectionWall]->isNone()) ||
@@ -716,6 +783,16 @@ void BuildingFloor::LayoutToSquares()
     mStairs.clear();
 
     foreach (BuildingObject *object, mObjects) {
+        if (skipObject(object)) {
+            // The floor above still needs these.
+            if (Stairs *stairs = object->asStairs())
+                mStairs += stairs;
+            if (RoofObject *ro = object->asRoof()) {
+                if (ro->depth() == RoofObject::Three && !ro->flatTop().isEmpty())
+                    mFlatRoofsWithDepthThree += ro;
+            }
+            continue;
+        }
         int x = object->x();
         int y = object->y();
         if (Door *door = object->asDoor()) {
@@ -1604,8 +1681,8 @@ void BuildingFloor::LayoutToSquares()
     }
 
     // Place floors
-    for (int x = 0; x < width(); x++) {
-        for (int y = 0; y < height(); y++) {
+    for (int x = work.left(); x <= qMin(work.right(), width() - 1); x++) {
+        for (int y = work.top(); y <= qMin(work.bottom(), height() - 1); y++) {
             if (mIndexAtPos[x][y] >= 0)
                 squares[x][y].ReplaceFloor(floors[mIndexAtPos[x][y]], 0);
         }
@@ -1614,6 +1691,8 @@ void BuildingFloor::LayoutToSquares()
     if (BuildingFloor *floorBelow = this->floorBelow()) {
         // Place flat roof tops above roofs on the floor below
         foreach (RoofObject *ro, floorBelow->mFlatRoofsWithDepthThree) {
+            if (skipObject(ro))
+                continue;
             ReplaceRoofTop(ro, ro->flatTop(), squares);
         }
 
@@ -1640,8 +1719,8 @@ void BuildingFloor::LayoutToSquares()
     FloorTileGrid *userTilesWalls = mGrimeGrid.contains(QLatin1String("Walls")) ? mGrimeGrid[QLatin1String("Walls")] : 0;
     FloorTileGrid *userTilesWalls2 = mGrimeGrid.contains(QLatin1String("Walls2")) ? mGrimeGrid[QLatin1String("Walls2")] : 0;
 
-    for (int x = 0; x < w; x++) {
-        for (int y = 0; y < h; y++) {
+    for (int x = work.left(); x <= work.right(); x++) {
+        for (int y = work.top(); y <= work.bottom(); y++) {
             Square &sq = squares[x][y];
 
             sq.ReplaceWallTrim();
@@ -1678,8 +1757,50 @@ void BuildingFloor::LayoutToSquares()
             }
         }
     }
+
+    if (!full) {
+        for (int x = area.left(); x <= area.right(); x++) {
+            for (int y = area.top(); y <= area.bottom(); y++)
+                this->squares[x][y] = scratch[x][y];
+        }
+    }
+
+    mLayoutRoomAtPos = mRoomAtPos;
+    mLayoutObjectBounds = objectBounds;
+
+#ifndef QT_NO_DEBUG
+    if (!full && !checkLayout(area))
+        return bounds(1, 1);
+#endif
+
+    return area;
 }
 
+#ifndef QT_NO_DEBUG
+int BuildingFloor::sLayoutMismatches = 0;
+
+// Debug builds check every partial layout against a full one.  The full
+// layout is kept, and on a mismatch the caller updates the whole floor, so
+// the mismatch is only reported, never drawn.
+bool BuildingFloor::checkLayout(const QRect &area)
+{
+    QVector<QVector<Square> > partial = squares;
+    LayoutToSquares(bounds(1, 1));
+    for (int x = 0; x < squares.size(); x++) {
+        for (int y = 0; y < squares[x].size(); y++) {
+            if (squares[x][y] != partial[x][y]) {
+                qWarning("BuildingFloor::LayoutToSquares: square %d,%d on level %d differs from a full layout"
+                         " (laid out %d,%d %dx%d)", x, y, level(),
+                         area.x(), area.y(), area.width(), area.height());
+                ++sLayoutMismatches;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+#endif
+
 Door *BuildingFloor::GetDoorAt(int x, int y)
 {
     foreach (BuildingObject *o, mObjects) {
@@ -1819,7 +1940,7 @@ QMap<QString,FloorTileGrid*> BuildingFloor::resizeGrime(const QSize &newSize) co
         grid[key] = new FloorTileGrid(newSize.width(), newSize.height());
         for (int x = 0; x < qMin(mGrimeGrid[key]->width(), newSize.width()); x++)
             for (int y = 0; y < qMin(mGrimeGrid[key]->height(), newSize.height()); y++)
-                grid[key]->replace(x, y, mGrimeGrid[key]->at(x, y));
+                grid[key]->replaceId(x, y, mGrimeGrid[key]->idAt(x, y));
 
     }
 
@@ -1897,6 +2018,13 @@ QString BuildingFloor::grimeAt(const QString &layerName, int x, int y) const
     return QString();
 }
 
+quint32 BuildingFloor::grimeIdAt(const QString &layerName, int x, int y) const
+{
+    if (mGrimeGrid.contains(layerName))
+        return mGrimeGrid[layerName]->idAt(x, y);
+    return 0;
+}
+
 FloorTileGrid *BuildingFloor::grimeAt(const QString &layerName, const QRect &r)
 {
     if (mGrimeGrid.contains(layerName))
@@ -1937,6 +2065,13 @@ void BuildingFloor::setGrime(const QString &layerName, int x, int y,
     mGrimeGrid[layerName]->replace(x, y, tileName);
 }
 
+void BuildingFloor::setGrimeId(const QString &layerName, int x, int y, quint32 id)
+{
+    if (!mGrimeGrid.contains(layerName))
+        mGrimeGrid[layerName] = new FloorTileGrid(width() + 1, height() + 1);
+    mGrimeGrid[layerName]->replaceId(x, y, id);
+}
+
 
 void BuildingFloor::setGrime(const QString &layerName, const QPoint &p,
                              const FloorTileGrid *other)
@@ -1991,6 +2126,21 @@ BuildingFloor::Square::Square() :
 }
 
 
+bool BuildingFloor::Square::operator==(const Square &other) const
+{
+    auto sameWall = [](const WallInfo &a, const WallInfo &b) {
+        return a.entry == b.entry && a.trim == b.trim && a.furniture == b.furniture
+                && a.furnitureBldgTile == b.furnitureBldgTile;
+    };
+    return mEntries == other.mEntries &&
+            mEntryEnum == other.mEntryEnum &&
+            mWallOrientation == other.mWallOrientation &&
+            mExterior == other.mExterior &&
+            mTiles == other.mTiles &&
+            sameWall(mWallN, other.mWallN) &&
+            sameWall(mWallW, other.mWallW);
+}
+
 BuildingFloor::Square::~Square()
 {
     // mTiles are owned by BuildingTiles
@@ -2324,6 +2474,7 @@ void BuildingFloor::Square::ReplaceFloorGrime(BuildingTileEntry *grimeTile)
 #include "tilemetainfomgr.h"
 #include <QDebug>
 #include <QFileInfo>
+#include <QThread>
 
 #if defined(Q_OS_WIN) && (_MSC_VER >= 1600)
 // Hmmmm.  libtiled.dll defines the Properties class as so:
@@ -2339,9 +2490,9 @@ namespace Internal {
 
 TileDefWatcher::TileDefWatcher() :
     mWatcher(new FileSystemWatcher(this)),
-    mTileDefFile(new TileDefFile()),
     tileDefFileChecked(false),
-    watching(false)
+    watching(false),
+    mTileDefFile(new TileDefFile())
 {
     connect(mWatcher, &FileSystemWatcher::fileChanged, this, &TileDefWatcher::fileChanged);
 }
@@ -2349,6 +2500,7 @@ TileDefWatcher::TileDefWatcher() :
 
 void TileDefWatcher::check()
 {
+    Q_ASSERT(QThread::currentThread() == thread());
     if (!tileDefFileChecked) {
         QFileInfo fileInfo(TileMetaInfoMgr::instance()->tilesDirectory() + QString::fromLatin1("/newtiledefinitions.tiles"));
 #if 1
@@ -2358,7 +2510,12 @@ void TileDefWatcher::check()
 #endif
         if (fileInfo.exists()) {
             qDebug() << "TileDefWatcher read " << fileInfo.absoluteFilePath();
-            mTileDefFile->read(fileInfo.absoluteFilePath());
+            QSharedPointer<TileDefFile> tileDefFile(new TileDefFile());
+            tileDefFile->read(fileInfo.absoluteFilePath());
+            QMutexLocker locker(&mMutex);
+            mTileDefFile = tileDefFile;
+            mFileName = fileInfo.absoluteFilePath();
+            locker.unlock();
             if (!watching) {
                 mWatcher->addPath(fileInfo.canonicalFilePath());
                 watching = true;
@@ -2368,6 +2525,20 @@ void TileDefWatcher::check()
     }
 }
 
+QSharedPointer<TileDefFile> TileDefWatcher::tileDefFile()
+{
+    if (QThread::currentThread() == thread())
+        check();
+    QMutexLocker locker(&mMutex);
+    return mTileDefFile;
+}
+
+QString TileDefWatcher::fileName()
+{
+    QMutexLocker locker(&mMutex);
+    return mFileName;
+}
+
 void TileDefWatcher::fileChanged(const QString &path)
 {
     qDebug() << "TileDefWatcher.fileChanged() " << path;
@@ -2410,8 +2581,7 @@ static bool tileHasGrimeProperties(BuildingTile *btile, GrimeProperties *props)
     if (btile == nullptr)
         return false;
 
-    Tiled::Internal::TileDefWatcher *tileDefWatcher = getTileDefWatcher();
-    tileDefWatcher->check();
+    QSharedPointer<TileDefFile> tileDefFile = getTileDefWatcher()->tileDefFile();
 
     if (props) {
         props->West = props->North = props->SouthEast = false;
@@ -2419,7 +2589,7 @@ static bool tileHasGrimeProperties(BuildingTile *btile, GrimeProperties *props)
         props->DoubleLeft = props->DoubleRight = false;
     }
 
-    if (TileDefTileset *tdts = tileDefWatcher->mTileDefFile->tileset(btile->mTilesetName)) {
+    if (TileDefTileset *tdts = tileDefFile->tileset(btile->mTilesetName)) {
         if (TileDefTile *tdt = tdts->tileAt(btile->mIndex)) {
             if (tdt->mProperties.contains(QString::fromLatin1("GrimeType"))) {
                 if (props) {
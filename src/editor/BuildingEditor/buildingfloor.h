@@ -21,8 +21,10 @@
 #include <QHash>
 #include <QList>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QRegion>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QVector>
@@ -42,6 +44,12 @@ class Room;
 class Stairs;
 class Window;
 
+/**
+  * The user-drawn tiles in one layer of a floor.  Tile names are stored as
+  * ids from BuildingTilesMgr::tileNameId() in blocks of 16x16 squares.
+  * Blocks without any tiles aren't allocated, and blocks are implicitly
+  * shared between clones until one of them is changed.
+  */
 class FloorTileGrid
 {
 public:
@@ -57,11 +65,18 @@ public:
     { return QRect(0, 0, mWidth, mHeight); }
 
     const QString &at(int index) const;
+    const QString &at(int x, int y) const;
 
-    const QString &at(int x, int y) const
+    quint32 idAt(int index) const
+    { return idAt(index % mWidth, index / mWidth); }
+
+    quint32 idAt(int x, int y) const
     {
         Q_ASSERT(contains(x, y));
-        return at(x + y * mWidth);
+        const QVector<quint32> &block = mBlocks[blockIndex(x, y)];
+        if (block.isEmpty())
+            return 0;
+        return block[cellIndex(x, y)];
     }
 
     bool matches(int x, int y, const FloorTileGrid &other) const;
@@ -74,6 +89,8 @@ public:
     bool replace(const QRect &r, const QString &tile);
     bool replace(const QPoint &p, const FloorTileGrid *other);
 
+    bool replaceId(int x, int y, quint32 id);
+
     bool isEmpty() const
     { return !mCount; }
 
@@ -87,14 +104,23 @@ public:
     FloorTileGrid *clone(const QRect &r, const QRegion &rgn);
 
 private:
-    void swapToVector();
+    enum {
+        BlockShift = 4,
+        BlockSize = 1 << BlockShift,
+        BlockMask = BlockSize - 1
+    };
+
+    int blockIndex(int x, int y) const
+    { return (x >> BlockShift) + (y >> BlockShift) * mBlocksWide; }
+
+    static int cellIndex(int x, int y)
+    { return (x & BlockMask) + ((y & BlockMask) << BlockShift); }
 
     int mWidth, mHeight;
+    int mBlocksWide;
     int mCount;
-    QHash<int,QString> mCells;
-    QVector<QString> mCellsVector;
-    bool mUseVector;
-    QString mEmptyCell;
+    QVector<QVector<quint32> > mBlocks;
+    QVector<int> mBlockCounts;
 };
 
 class BuildingFloor
@@ -198,6 +224,10 @@ public:
         void ReplaceWallTrim();
 
         int getWallOffset();
+
+        bool operator==(const Square &other) const;
+        bool operator!=(const Square &other) const
+        { return !(*this == other); }
     };
 
     QVector<QVector<Square> > squares;
@@ -258,6 +288,27 @@ public:
 
     void LayoutToSquares();
 
+    /**
+      * Lays out only the squares that might have changed since the last
+      * layout.  Changes to the room grid and to the position or size of
+      * objects on this floor or the floor below are found by comparing them
+      * with the last layout.  Other changes, such as an object's tiles or the
+      * user tiles in the Walls layers, must be passed in \a changed.
+      * Returns the squares that were laid out again.  Debug builds check the
+      * result against a full layout and warn if they differ.
+      */
+    QRect LayoutToSquares(const QRect &changed);
+
+#ifndef QT_NO_DEBUG
+    /**
+      * How many partial layouts have differed from a full layout.
+      */
+    static int layoutMismatches()
+    { return sLayoutMismatches; }
+#endif
+
+    static QRect layoutBounds(BuildingObject *object);
+
     int width() const;
     int height() const;
 
@@ -286,6 +337,7 @@ public:
     { return mGrimeGrid.keys(); }
 
     QString grimeAt(const QString &layerName, int x, int y) const;
+    quint32 grimeIdAt(const QString &layerName, int x, int y) const;
     FloorTileGrid *grimeAt(const QString &layerName, const QRect &r);
     FloorTileGrid *grimeAt(const QString &layerName, const QRect &r, const QRegion &rgn);
 
@@ -293,6 +345,7 @@ public:
 
     QMap<QString,FloorTileGrid*> setGrime(const QMap<QString,FloorTileGrid*> &grime);
     void setGrime(const QString &layerName, int x, int y, const QString &tileName);
+    void setGrimeId(const QString &layerName, int x, int y, quint32 id);
     void setGrime(const QString &layerName, const QPoint &p, const FloorTileGrid *other);
     void setGrime(const QString &layerName, const QRegion &rgn, const QString &tileName);
     void setGrime(const QString &layerName, const QRegion &rgn, const QPoint &pos, const FloorTileGrid *other);
@@ -331,6 +384,17 @@ private:
     QMap<QString,bool> mLayerVisibility;
     QList<RoofObject*> mFlatRoofsWithDepthThree;
     QList<Stairs*> mStairs;
+
+    QHash<BuildingObject*,QRect> layoutObjectBounds() const;
+    QRect layoutChanges(const QHash<BuildingObject*,QRect> &objects) const;
+#ifndef QT_NO_DEBUG
+    bool checkLayout(const QRect &area);
+    static int sLayoutMismatches;
+#endif
+
+    // What the squares were last laid out from.
+    QVector<QVector<Room*> > mLayoutRoomAtPos;
+    QHash<BuildingObject*,QRect> mLayoutObjectBounds;
 };
 
 } // namespace BuildingEditor
@@ -347,16 +411,35 @@ class TileDefWatcher : public QObject
 public:
     TileDefWatcher();
 
+    /**
+      * Reads the tile definitions again if the file changed.  Only the
+      * thread this object lives in may call this.
+      */
     void check();
 
+    /**
+      * Returns the tile definitions.  A file that is read again replaces
+      * the old TileDefFile instead of changing it, so MapReaderWorker threads
+      * can keep using what this returned.  In the GUI thread this calls
+      * check() first; MapManager::loadMap() calls it before queueing a
+      * building.
+      */
+    QSharedPointer<TileDefFile> tileDefFile();
+
+    QString fileName();
+
 public slots:
     void fileChanged(const QString &path);
 
 public:
     Tiled::Internal::FileSystemWatcher *mWatcher;
-    TileDefFile *mTileDefFile;
     bool tileDefFileChecked;
     bool watching;
+
+private:
+    QSharedPointer<TileDefFile> mTileDefFile;
+    QString mFileName;
+    QMutex mMutex; // Guards mTileDefFile and mFileName
 };
 
 }
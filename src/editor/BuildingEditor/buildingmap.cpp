@@ -94,7 +94,7 @@ QString BuildingMap::buildingTileAt(int x, int y, int level, const QString &laye
     foreach (TileLayer *tl, layerGroup->layers()) {
         if (layerName == MapComposite::layerNameWithoutPrefix(tl)) {
             if (tl->contains(x, y)) {
-                Tile *tile = tl->cellAt(x, y).tile;
+                Tile *tile = tl->cellAt(x, y).tile();
                 if (tile)
                     tileName = BuildingTilesMgr::nameForTile(tile);
             }
@@ -128,9 +128,9 @@ QString BuildingMap::buildingTileAt(int x, int y, const QList<bool> visibleLevel
                     if (!mBuilding->floor(level)->layerVisibility(layerName))
                         continue;
                     if (!tl->contains(tx, ty)) continue;
-                    Tile *test = tl->cellAt(tx, ty).tile; // user tile
+                    Tile *test = tl->cellAt(tx, ty).tile(); // user tile
                     if (!test)
-                        test = tlBlend->cellAt(tx, ty).tile; // building tile
+                        test = tlBlend->cellAt(tx, ty).tile(); // building tile
                     if (test) {
                         Tile *realTile = test;
                         if (test->image().isNull()) {
@@ -221,17 +221,20 @@ QStringList BuildingMap::requiredLayerNames()
 void BuildingMap::setCursorObject(BuildingFloor *floor, BuildingObject *object)
 {
     if (mCursorObjectFloor && (mCursorObjectFloor != floor)) {
-        pendingLayoutToSquares.insert(mCursorObjectFloor);
+        layoutLater(mCursorObjectFloor);
         if (mCursorObjectFloor->floorAbove())
-            pendingLayoutToSquares.insert(mCursorObjectFloor->floorAbove());
+            layoutLater(mCursorObjectFloor->floorAbove());
         schedulePending();
         mCursorObjectFloor = nullptr;
     }
 
     if (mShadowBuilding->setCursorObject(floor, object)) {
-        pendingLayoutToSquares.insert(floor);
+        // The cursor object is recreated, its tiles may have changed.
+        QRect changed = object ? BuildingFloor::layoutBounds(object) : QRect();
+        if (floor)
+            layoutLater(floor, changed);
         if (floor && floor->floorAbove())
-            pendingLayoutToSquares.insert(floor->floorAbove());
+            layoutLater(floor->floorAbove(), changed);
         schedulePending();
         mCursorObjectFloor = object ? floor : nullptr;
     }
@@ -240,32 +243,32 @@ void BuildingMap::setCursorObject(BuildingFloor *floor, BuildingObject *object)
 void BuildingMap::dragObject(BuildingFloor *floor, BuildingObject *object, const QPoint &offset)
 {
     mShadowBuilding->dragObject(floor, object, offset);
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
     if (floor->floorAbove())
-        pendingLayoutToSquares.insert(floor->floorAbove());
+        layoutLater(floor->floorAbove());
     schedulePending();
 }
 
 void BuildingMap::resetDrag(BuildingFloor *floor, BuildingObject *object)
 {
     mShadowBuilding->resetDrag(object);
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
     if (floor->floorAbove())
-        pendingLayoutToSquares.insert(floor->floorAbove());
+        layoutLater(floor->floorAbove());
     schedulePending();
 }
 
 void BuildingMap::changeFloorGrid(BuildingFloor *floor, const QVector<QVector<Room*> > &grid)
 {
     mShadowBuilding->changeFloorGrid(floor, grid);
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
     schedulePending();
 }
 
 void BuildingMap::resetFloorGrid(BuildingFloor *floor)
 {
     mShadowBuilding->resetFloorGrid(floor);
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
     schedulePending();
 }
 
@@ -323,10 +326,15 @@ Map *BuildingMap::mergedMap() const
 }
 
 void BuildingMap::loadNeededTilesets(Building *building)
+{
+    loadNeededTilesets(building->tilesetNames());
+}
+
+void BuildingMap::loadNeededTilesets(const QStringList &tilesetNames)
 {
     // If the building uses any tilesets that aren't in Tilesets.txt, then
     // try to load them in now.
-    foreach (QString tilesetName, building->tilesetNames()) {
+    foreach (QString tilesetName, tilesetNames) {
         if (!TileMetaInfoMgr::instance()->tileset(tilesetName)) {
             QString source = TileMetaInfoMgr::instance()->tilesDirectory() +
                     QLatin1Char('/') + tilesetName + QLatin1String(".png");
@@ -579,7 +587,7 @@ void BuildingMap::BuildingSquaresToTileLayers(BuildingFloor *floor,
         if (area == floor->bounds(1, 1))
             tl->erase();
         else
-            tl->erase(area/*.adjusted(0,0,1,1)*/);
+            tl->erase(area.translated(offset, offset));
         for (int x = area.x(); x <= area.right(); x++) {
             for (int y = area.y(); y <= area.bottom(); y++) {
                 if (section != BuildingFloor::Square::SectionFloor
@@ -627,35 +635,21 @@ void BuildingMap::userTilesToLayer(BuildingFloor *floor,
         return;
     }
 
-    QMap<QString,Tileset*> tilesetByName;
-    foreach (Tileset *ts, mMap->tilesets())
-        tilesetByName[ts->name()] = ts;
-
     QRegion suppress;
     if (mSuppressTiles.contains(floor))
         suppress = mSuppressTiles[floor];
 
     BuildingFloor *shadowFloor = mShadowBuilding->floor(floor->level());
+    FloorTileGrid *grid = shadowFloor->grime().value(layerName);
+    BuildingTilesMgr *btiles = BuildingTilesMgr::instance();
 
     for (int x = bounds.left(); x <= bounds.right(); x++) {
         for (int y = bounds.top(); y <= bounds.bottom(); y++) {
-            if (suppress.contains(QPoint(x, y))) {
+            if (!grid || suppress.contains(QPoint(x, y))) {
                 layer->setCell(x, y, Cell());
                 continue;
             }
-            QString tileName = shadowFloor->grimeAt(layerName, x, y);
-            Tile *tile = nullptr;
-            if (!tileName.isEmpty()) {
-                tile = TilesetManager::instance()->missingTile();
-                QString tilesetName;
-                int index;
-                if (BuildingTilesMgr::parseTileName(tileName, tilesetName, index)) {
-                    if (tilesetByName.contains(tilesetName)) {
-                        tile = tilesetByName[tilesetName]->tileAt(index);
-                    }
-                }
-            }
-            layer->setCell(x, y, Cell(tile));
+            layer->setCell(x, y, Cell(btiles->tileForId(grid->idAt(x, y))));
         }
     }
 
@@ -678,7 +672,7 @@ void BuildingMap::floorEdited(BuildingFloor *floor)
 {
     mShadowBuilding->floorEdited(floor);
 
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor, floor->bounds(1, 1));
     schedulePending();
 }
 
@@ -690,7 +684,7 @@ void BuildingMap::floorTilesChanged(BuildingFloor *floor)
 
     // Painting tiles in the Walls/Walls2 layer affects which grime tiles are chosen.
 //    if (tiles.contains(QLatin1String("Walls")) || tiles.contains(QLatin1String("Walls2")))
-        pendingLayoutToSquares.insert(floor);
+        layoutLater(floor, floor->bounds(1, 1));
 
     schedulePending();
 }
@@ -704,41 +698,21 @@ void BuildingMap::floorTilesChanged(BuildingFloor *floor, const QString &layerNa
 
     // Painting tiles in the Walls/Walls2 layer affects which grime tiles are chosen.
     if (layerName == QLatin1String("Walls") || layerName == QLatin1String("Walls2"))
-        pendingLayoutToSquares.insert(floor);
+        layoutLater(floor, bounds);
 
     schedulePending();
 }
 
 void BuildingMap::objectAdded(BuildingObject *object)
 {
-    BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
-
-    // Stairs affect the floor tiles on the floor above.
-    // Roofs sometimes affect the floor tiles on the floor above.
-    if (BuildingFloor *floorAbove = floor->floorAbove()) {
-        if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
-    }
-
-    schedulePending();
+    layoutObjectLater(object);
 
     mShadowBuilding->objectAdded(object);
 }
 
 void BuildingMap::objectAboutToBeRemoved(BuildingObject *object)
 {
-    BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
-
-    // Stairs affect the floor tiles on the floor above.
-    // Roofs sometimes affect the floor tiles on the floor above.
-    if (BuildingFloor *floorAbove = floor->floorAbove()) {
-        if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
-    }
-
-    schedulePending();
+    layoutObjectLater(object);
 
     mShadowBuilding->objectAboutToBeRemoved(object);
 }
@@ -750,34 +724,14 @@ void BuildingMap::objectRemoved(BuildingObject *object)
 
 void BuildingMap::objectMoved(BuildingObject *object)
 {
-    BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
-
-    // Stairs affect the floor tiles on the floor above.
-    // Roofs sometimes affect the floor tiles on the floor above.
-    if (BuildingFloor *floorAbove = floor->floorAbove()) {
-        if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
-    }
-
-    schedulePending();
+    layoutObjectLater(object);
 
     mShadowBuilding->objectMoved(object);
 }
 
 void BuildingMap::objectTileChanged(BuildingObject *object)
 {
-    BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
-
-    // Stairs affect the floor tiles on the floor above.
-    // Roofs sometimes affect the floor tiles on the floor above.
-    if (BuildingFloor *floorAbove = floor->floorAbove()) {
-        if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
-    }
-
-    schedulePending();
+    layoutObjectLater(object);
 
     mShadowBuilding->objectTileChanged(object);
 }
@@ -863,9 +817,9 @@ void BuildingMap::handlePending()
     }
 
     if (pendingRecreateAll || pendingBuildingResized) {
-        QList<BuildingFloor*> floors = mBuilding->floors();
-        //pendingLayoutToSquares = QSet<BuildingFloor*>(floors.begin(), floors.end());
-        pendingLayoutToSquares = QSet<BuildingFloor*>(floors.toSet());
+        pendingLayoutToSquares.clear();
+        foreach (BuildingFloor *floor, mBuilding->floors())
+            pendingLayoutToSquares[floor] = floor->bounds(1, 1);
         pendingUserTilesToLayer.clear();
         foreach (BuildingFloor *floor, mBuilding->floors()) {
             foreach (QString layerName, floor->grimeLayers()) {
@@ -902,26 +856,33 @@ void BuildingMap::handlePending()
     }
 
     if (!pendingLayoutToSquares.isEmpty()) {
-        foreach (BuildingFloor *floor, pendingLayoutToSquares) {
-            floor->LayoutToSquares(); // not sure this belongs in this class
-            pendingSquaresToTileLayers[floor] = floor->bounds(1, 1);
+        // Lowest floor first, the floor above looks at the stairs and roofs
+        // found on the floor below.
+        foreach (BuildingFloor *floor, mBuilding->floors()) {
+            if (!pendingLayoutToSquares.contains(floor))
+                continue;
+            QRect changed = pendingLayoutToSquares[floor].boundingRect();
+            floor->LayoutToSquares(changed); // not sure this belongs in this class
 
-            mShadowBuilding->floor(floor->level())->LayoutToSquares();
+            QRect area = mShadowBuilding->floor(floor->level())->LayoutToSquares(changed);
+            if (!area.isEmpty())
+                pendingSquaresToTileLayers[floor] |= area;
         }
     }
 
     if (!pendingSquaresToTileLayers.isEmpty()) {
         foreach (BuildingFloor *floor, pendingSquaresToTileLayers.keys()) {
             CompositeLayerGroup *layerGroup = mBlendMapComposite->layerGroupForLevel(floor->level());
-            QRect area = pendingSquaresToTileLayers[floor].boundingRect(); // TODO: only affected region
-            BuildingSquaresToTileLayers(floor, area, layerGroup);
+            QRegion rgn = pendingSquaresToTileLayers[floor];
+            for (const QRect &area : rgn)
+                BuildingSquaresToTileLayers(floor, area, layerGroup);
             if (layerGroup->needsSynch()) {
                 mMapComposite->layerGroupForLevel(floor->level())->setNeedsSynch(true);
                 layerGroup->synch(); // Don't really need to synch the blend-over-map, but do need
                                      // to update its draw margins so MapComposite::regionAltered
                                      // doesn't set mNeedsSynch repeatedly.
             }
-            updatedLevels[floor->level()] |= area;
+            updatedLevels[floor->level()] |= rgn;
         }
     }
 
@@ -964,6 +925,27 @@ void BuildingMap::handlePending()
     pendingUserTilesToLayer.clear();
 }
 
+void BuildingMap::layoutLater(BuildingFloor *floor, const QRect &changed)
+{
+    pendingLayoutToSquares[floor] |= changed;
+}
+
+void BuildingMap::layoutObjectLater(BuildingObject *object)
+{
+    BuildingFloor *floor = object->floor();
+    QRect changed = BuildingFloor::layoutBounds(object);
+    layoutLater(floor, changed);
+
+    // Stairs affect the floor tiles on the floor above.
+    // Roofs sometimes affect the floor tiles on the floor above.
+    if (BuildingFloor *floorAbove = floor->floorAbove()) {
+        if (object->affectsFloorAbove())
+            layoutLater(floorAbove, changed);
+    }
+
+    schedulePending();
+}
+
 void BuildingMap::recreateAllLater()
 {
     pendingRecreateAll = true;
@@ -153,9 +153,10 @@ public:
     Tiled::Map *mergedMap() const;
 
     static void loadNeededTilesets(Building *building);
+    static void loadNeededTilesets(const QStringList &tilesetNames);
 
     void addRoomDefObjects(Tiled::Map *map);
-    void addRoomDefObjects(Tiled::Map *map, BuildingFloor *floor);
+    static void addRoomDefObjects(Tiled::Map *map, BuildingFloor *floor);
 
     static int defaultOrientation();
 
@@ -205,6 +206,9 @@ private:
     void userTilesToLayer(BuildingFloor *floor, const QString &layerName,
                           const QRect &bounds);
 
+    void layoutLater(BuildingFloor *floor, const QRect &changed = QRect());
+    void layoutObjectLater(BuildingObject *object);
+
     inline void schedulePending()
     {
         if (!pending) {
@@ -229,7 +233,7 @@ private:
     bool pending;
     bool pendingRecreateAll;
     bool pendingBuildingResized;
-    QSet<BuildingFloor*> pendingLayoutToSquares; // LayoutToSquares
+    QMap<BuildingFloor*,QRegion> pendingLayoutToSquares; // LayoutToSquares
     QMap<BuildingFloor*,QRegion> pendingSquaresToTileLayers; // BuildingSquaresToTileLayers
     QSet<BuildingFloor*> pendingEraseUserTiles; // TileLayer::erase on all user-tile layers
     QMap<BuildingFloor*,QMap<QString,QRegion> > pendingUserTilesToLayer; // floorTilesToLayer
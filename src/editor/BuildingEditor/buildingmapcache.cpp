@@ -0,0 +1,515 @@
+/*
+ * Copyright 2013, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "buildingmapcache.h"
+
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingmap.h"
+#include "buildingtiles.h"
+
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
+
+#include "map.h"
+#include "mapcache.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+#define CACHE_MAGIC 0x505A4243 // PZBC
+#define CACHE_VERSION 1
+
+namespace {
+
+QMutex sVersionsMutex;
+QByteArray sVersions; // From BuildingMapCache::updateVersions()
+
+} // namespace
+
+ConvertedBuilding::ConvertedBuilding() :
+    mFloorCount(0),
+    mMap(nullptr)
+{
+}
+
+ConvertedBuilding::~ConvertedBuilding()
+{
+    delete mMap;
+}
+
+ConvertedBuilding *ConvertedBuilding::fromBuilding(Building *building)
+{
+    // This follows BuildingMap::BuildingToMap() and BuildingMap::mergedMap().
+    Map::Orientation orient = static_cast<Map::Orientation>(BuildingMap::defaultOrientation());
+
+    int maxLevel =  building->floorCount() - 1;
+    int extraForWalls = 1;
+    int extra = (orient == Map::LevelIsometric)
+            ? extraForWalls : maxLevel * 3 + extraForWalls;
+    QSize mapSize(building->width() + extra,
+                  building->height() + extra);
+
+    ConvertedBuilding *converted = new ConvertedBuilding;
+    converted->mFloorCount = building->floorCount();
+    converted->mMap = new Map(orient, mapSize.width(), mapSize.height(), 64, 32);
+
+    const QStringList sectionNames = BuildingMap::requiredLayerNames();
+
+    foreach (BuildingFloor *floor, building->floors()) {
+        floor->LayoutToSquares();
+
+        QRect bounds = floor->bounds(1, 1);
+        int offset = (orient == Map::LevelIsometric)
+                ? 0 : (maxLevel - floor->level()) * 3;
+
+        foreach (QString name, BuildingMap::layerNames(floor->level())) {
+            QString layerName = BuildingMap::tr("%1_%2").arg(floor->level()).arg(name);
+            converted->mMap->addLayer(new TileLayer(layerName, 0, 0,
+                                                    mapSize.width(), mapSize.height()));
+
+            // The automatically-generated tiles, as in
+            // BuildingMap::BuildingSquaresToTileLayers().
+            QVector<int> cells(mapSize.width() * mapSize.height(), EmptyCell);
+            int section = sectionNames.indexOf(name);
+            if (section != -1) { // Skip user-added layers.
+                for (int x = bounds.x(); x <= bounds.right(); x++) {
+                    for (int y = bounds.y(); y <= bounds.bottom(); y++) {
+                        const BuildingFloor::Square &square = floor->squares[x][y];
+                        BuildingTile *btile = square.mTiles[section];
+                        if (!btile) {
+                            BuildingTileEntry *entry = square.mEntries[section];
+                            if (entry && !entry->isNone())
+                                btile = entry->tile(square.mEntryEnum[section]);
+                        }
+                        if (!btile || btile->isNone())
+                            continue;
+                        cells[(y + offset) * mapSize.width() + x + offset] =
+                                converted->cellFor(btile->mTilesetName, btile->mIndex);
+                    }
+                }
+            }
+            converted->mCells += cells;
+
+            // The user-drawn tiles, as in BuildingMap::userTilesToLayer().
+            QVector<int> userCells;
+            if (floor->grimeLayers().contains(name)) {
+                userCells.fill(EmptyCell, mapSize.width() * mapSize.height());
+                for (int x = bounds.left(); x <= bounds.right(); x++) {
+                    for (int y = bounds.top(); y <= bounds.bottom(); y++) {
+                        QString tileName = floor->grimeAt(name, x, y);
+                        if (tileName.isEmpty())
+                            continue;
+                        QString tilesetName;
+                        int index;
+                        int &cell = userCells[y * mapSize.width() + x];
+                        if (BuildingTilesMgr::parseTileName(tileName, tilesetName, index))
+                            cell = converted->cellFor(tilesetName, index);
+                        else
+                            cell = MissingCell;
+                    }
+                }
+            }
+            converted->mUserCells += userCells;
+        }
+    }
+
+    foreach (BuildingFloor *floor, building->floors())
+        BuildingMap::addRoomDefObjects(converted->mMap, floor);
+
+    converted->mMap->setProperties(building->properties());
+
+    return converted;
+}
+
+int ConvertedBuilding::cellFor(const QString &tilesetName, int index)
+{
+    if (index < 0 || index > 0xFFFF)
+        return EmptyCell;
+    int tilesetIndex = mTilesetNames.indexOf(tilesetName);
+    if (tilesetIndex == -1) {
+        tilesetIndex = mTilesetNames.size();
+        mTilesetNames += tilesetName;
+    }
+    return (tilesetIndex << 16) | index;
+}
+
+Map *ConvertedBuilding::takeMap()
+{
+    Map *map = mMap;
+    mMap = nullptr;
+
+    // Add tilesets from Tilesets.txt
+    Tileset *missingTileset = TilesetManager::instance()->missingTileset();
+    Tile *missingTile = TilesetManager::instance()->missingTile();
+    map->addTileset(missingTileset);
+    foreach (Tileset *ts, TileMetaInfoMgr::instance()->tilesets())
+        map->addTileset(ts);
+
+    QVector<Tileset*> tilesets;
+    foreach (QString tilesetName, mTilesetNames)
+        tilesets += TileMetaInfoMgr::instance()->tileset(tilesetName);
+
+    int layerIndex = 0;
+    foreach (TileLayer *tl, map->tileLayers()) {
+        const QVector<int> &cells = mCells[layerIndex];
+        const QVector<int> &userCells = mUserCells[layerIndex];
+        ++layerIndex;
+        for (int y = 0; y < tl->height(); y++) {
+            for (int x = 0; x < tl->width(); x++) {
+                int i = y * tl->width() + x;
+                Tile *tile = nullptr;
+                if (!userCells.isEmpty() && userCells[i] != EmptyCell) {
+                    int cell = userCells[i];
+                    if (cell == MissingCell) {
+                        tile = missingTile;
+                    } else {
+                        Tileset *ts = tilesets[cell >> 16];
+                        if (!ts && mTilesetNames[cell >> 16] == missingTileset->name())
+                            ts = missingTileset;
+                        tile = ts ? ts->tileAt(cell & 0xFFFF) : missingTile;
+                    }
+                }
+                if (!tile && cells[i] != EmptyCell) {
+                    // See BuildingTilesMgr::tileFor()
+                    int cell = cells[i];
+                    Tileset *ts = tilesets[cell >> 16];
+                    int index = cell & 0xFFFF;
+                    if (!ts)
+                        tile = missingTile;
+                    else if (index >= ts->tileCount())
+                        tile = ts->isMissing() ? ts->tileAt(0) : missingTile;
+                    else
+                        tile = ts->tileAt(index);
+                }
+                if (tile)
+                    tl->setCell(x, y, Cell(tile));
+            }
+        }
+    }
+
+    return map;
+}
+
+/////
+
+ConvertedBuilding *BuildingMapCache::read(const QString &tbxFileName)
+{
+    mError.clear();
+
+    mKey = key(tbxFileName);
+    if (mKey.isEmpty()) {
+        mError = tr("Couldn't read %1").arg(tbxFileName);
+        return nullptr;
+    }
+
+    QString fileName = MapCache::cacheFileName(tbxFileName);
+    if (!QFileInfo::exists(fileName)) {
+        mError = tr("No cache file for %1").arg(tbxFileName);
+        return nullptr;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        mError = tr("Couldn't open %1").arg(fileName);
+        return nullptr;
+    }
+    const QByteArray data = file.readAll();
+    file.close();
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version, payloadSize;
+    quint16 checksum;
+    QByteArray fileKey;
+    in >> magic >> version >> fileKey >> payloadSize >> checksum;
+
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC) {
+        mError = tr("%1 isn't a building cache file").arg(fileName);
+        return nullptr;
+    }
+    if (version != CACHE_VERSION) {
+        mError = tr("%1 is from a different version").arg(fileName);
+        return nullptr;
+    }
+    if (fileKey != mKey) {
+        mError = tr("%1 is out of date").arg(fileName);
+        return nullptr;
+    }
+
+    const qint64 headerSize = in.device()->pos();
+    if (data.size() - headerSize != qint64(payloadSize) ||
+            qChecksum(data.constData() + headerSize, payloadSize) != checksum) {
+        mError = tr("%1 is corrupt").arg(fileName);
+        return nullptr;
+    }
+
+    ConvertedBuilding *converted = readPayload(in);
+    if (!converted && mError.isEmpty())
+        mError = tr("%1 is corrupt").arg(fileName);
+    return converted;
+}
+
+bool BuildingMapCache::write(const ConvertedBuilding *converted, const QString &tbxFileName)
+{
+    mError.clear();
+
+    // The key from read() is used if there was one, in case the .tbx file
+    // changed since the building was read.
+    if (mKey.isEmpty())
+        mKey = key(tbxFileName);
+    if (mKey.isEmpty()) {
+        mError = tr("Couldn't read %1").arg(tbxFileName);
+        return false;
+    }
+
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        writePayload(converted, out);
+    }
+
+    QString fileName = MapCache::cacheFileName(tbxFileName);
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+        mError = tr("Couldn't create the cache directory for %1").arg(tbxFileName);
+        return false;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        mError = tr("Couldn't open %1 for writing").arg(fileName);
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION) << mKey
+        << quint32(payload.size())
+        << qChecksum(payload.constData(), payload.size());
+    out.writeRawData(payload.constData(), payload.size());
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        mError = tr("Error writing %1").arg(fileName);
+        return false;
+    }
+    return true;
+}
+
+void BuildingMapCache::updateVersions()
+{
+    // BuildingFloor::LayoutToSquares() looks at the tile definitions when
+    // placing wall grime.
+    TileDefWatcher *tileDefWatcher = getTileDefWatcher();
+    tileDefWatcher->check();
+    QString tileDefFileName = tileDefWatcher->fileName();
+    QFileInfo tileDefInfo(tileDefFileName);
+
+    QByteArray versions;
+    {
+        QDataStream out(&versions, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << qint32(BuildingTilesMgr::instance()->revision())
+            << qint32(TileMetaInfoMgr::instance()->revision())
+            << tileDefFileName
+            << qint64(tileDefInfo.exists() ? tileDefInfo.size() : 0)
+            << qint64(tileDefInfo.exists() ? tileDefInfo.lastModified().toMSecsSinceEpoch() : 0);
+    }
+
+    QMutexLocker locker(&sVersionsMutex);
+    sVersions = versions;
+}
+
+QByteArray BuildingMapCache::key(const QString &tbxFileName)
+{
+    QFile file(tbxFileName);
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (!hash.addData(&file))
+        return QByteArray();
+
+    QMutexLocker locker(&sVersionsMutex);
+    hash.addData(sVersions);
+
+    return hash.result();
+}
+
+static void writeCells(QDataStream &out, const QVector<int> &cells)
+{
+    // Run-length encoded, most cells are empty.
+    out << qint32(cells.size());
+    int i = 0;
+    while (i < cells.size()) {
+        int value = cells[i];
+        int count = 1;
+        while (i + count < cells.size() && cells[i + count] == value)
+            ++count;
+        out << qint32(count) << qint32(value);
+        i += count;
+    }
+}
+
+static bool readCells(QDataStream &in, QVector<int> &cells, int tilesetCount)
+{
+    qint32 size;
+    in >> size;
+    if (in.status() != QDataStream::Ok || size < 0)
+        return false;
+    cells.resize(size);
+    int i = 0;
+    while (i < size) {
+        qint32 count, value;
+        in >> count >> value;
+        if (in.status() != QDataStream::Ok || count <= 0 || count > size - i)
+            return false;
+        if (value < ConvertedBuilding::MissingCell || (value >= 0 && (value >> 16) >= tilesetCount))
+            return false;
+        for (int j = 0; j < count; j++)
+            cells[i++] = value;
+    }
+    return true;
+}
+
+ConvertedBuilding *BuildingMapCache::readPayload(QDataStream &in)
+{
+    qint32 orientation, width, height, tileWidth, tileHeight, floorCount;
+    QMap<QString,QString> properties;
+    QStringList tilesetNames;
+    qint32 layerCount;
+    in >> orientation >> width >> height >> tileWidth >> tileHeight >> floorCount
+       >> properties >> tilesetNames >> layerCount;
+    if (in.status() != QDataStream::Ok || width <= 0 || height <= 0 ||
+            floorCount < 0 || layerCount < 0)
+        return nullptr;
+
+    // The layers depend on TMXConfig.txt.
+    QStringList expectedLayerNames;
+    for (int level = 0; level < floorCount; level++) {
+        foreach (QString name, BuildingMap::layerNames(level))
+            expectedLayerNames += BuildingMap::tr("%1_%2").arg(level).arg(name);
+    }
+
+    ConvertedBuilding *converted = new ConvertedBuilding;
+    converted->mTilesetNames = tilesetNames;
+    converted->mFloorCount = floorCount;
+    converted->mMap = new Map(static_cast<Map::Orientation>(orientation),
+                              width, height, tileWidth, tileHeight);
+    Map *map = converted->mMap;
+
+    QStringList tileLayerNames;
+    for (int i = 0; i < layerCount; i++) {
+        quint8 type;
+        QString name;
+        in >> type >> name;
+        if (in.status() != QDataStream::Ok) {
+            delete converted;
+            return nullptr;
+        }
+        if (type == 0) {
+            QVector<int> cells, userCells;
+            if (!readCells(in, cells, tilesetNames.size()) ||
+                    cells.size() != width * height ||
+                    !readCells(in, userCells, tilesetNames.size()) ||
+                    (!userCells.isEmpty() && userCells.size() != width * height)) {
+                delete converted;
+                return nullptr;
+            }
+            map->addLayer(new TileLayer(name, 0, 0, width, height));
+            converted->mCells += cells;
+            converted->mUserCells += userCells;
+            tileLayerNames += name;
+        } else if (type == 1) {
+            ObjectGroup *objectGroup = new ObjectGroup(name, 0, 0, width, height);
+            map->addLayer(objectGroup);
+            qint32 objectCount;
+            in >> objectCount;
+            if (in.status() != QDataStream::Ok || objectCount < 0) {
+                delete converted;
+                return nullptr;
+            }
+            for (int j = 0; j < objectCount; j++) {
+                QString objectName, objectType;
+                QPointF pos;
+                QSizeF size;
+                in >> objectName >> objectType >> pos >> size;
+                objectGroup->addObject(new MapObject(objectName, objectType, pos, size));
+            }
+        } else {
+            delete converted;
+            return nullptr;
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        delete converted;
+        return nullptr;
+    }
+
+    if (tileLayerNames != expectedLayerNames) {
+        mError = tr("The layers in TMXConfig.txt have changed");
+        delete converted;
+        return nullptr;
+    }
+
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+        map->setProperty(it.key(), it.value());
+
+    return converted;
+}
+
+void BuildingMapCache::writePayload(const ConvertedBuilding *converted, QDataStream &out)
+{
+    const Map *map = converted->mMap;
+
+    QMap<QString,QString> properties = map->properties();
+    out << qint32(map->orientation()) << qint32(map->width()) << qint32(map->height())
+        << qint32(map->tileWidth()) << qint32(map->tileHeight()) << qint32(converted->mFloorCount)
+        << properties << converted->mTilesetNames << qint32(map->layerCount());
+
+    int tileLayerIndex = 0;
+    foreach (Layer *layer, map->layers()) {
+        if (TileLayer *tl = layer->asTileLayer()) {
+            out << quint8(0) << tl->name();
+            writeCells(out, converted->mCells[tileLayerIndex]);
+            writeCells(out, converted->mUserCells[tileLayerIndex]);
+            ++tileLayerIndex;
+        } else if (ObjectGroup *og = layer->asObjectGroup()) {
+            out << quint8(1) << og->name() << qint32(og->objectCount());
+            foreach (MapObject *mapObject, og->objects())
+                out << mapObject->name() << mapObject->type()
+                    << mapObject->position() << mapObject->size();
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILDINGMAPCACHE_H
+#define BUILDINGMAPCACHE_H
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVector>
+
+class QDataStream;
+
+namespace Tiled {
+class Map;
+}
+
+namespace BuildingEditor {
+
+class Building;
+
+/**
+  * The map BuildingMap::mergedMap() and BuildingMap::addRoomDefObjects() would
+  * create for a building, with its tile layers stored by tileset name and
+  * tile index.  fromBuilding() doesn't use TileMetaInfoMgr, MapComposite or
+  * any MapRenderer, so it can run in a MapReaderWorker thread on a building
+  * that hasn't been through BuildingReader::fix() yet, while holding
+  * BuildingTilesMgr::lock() for reading.  takeMap() must be called in the GUI
+  * thread.
+  */
+class ConvertedBuilding
+{
+public:
+    ConvertedBuilding();
+    ~ConvertedBuilding();
+
+    static ConvertedBuilding *fromBuilding(Building *building);
+
+    /**
+      * Returns the names of every tileset used by the building's tiles.
+      */
+    const QStringList &tilesetNames() const
+    { return mTilesetNames; }
+
+    /**
+      * Sets the cells of the map's tile layers and returns the map, which the
+      * caller then owns.  The map has the missing tileset and all the
+      * tilesets in TileMetaInfoMgr, but no references are added to them.
+      */
+    Tiled::Map *takeMap();
+
+    enum {
+        EmptyCell = -1,
+        MissingCell = -2
+    };
+
+private:
+    friend class BuildingMapCache;
+
+    int cellFor(const QString &tilesetName, int index);
+
+    // One entry per tile layer in mMap, one int per cell.  A cell is either
+    // EmptyCell, MissingCell or an index into mTilesetNames in the high 16
+    // bits and a tile index in the low 16 bits.  mUserCells holds the
+    // user-drawn tiles which are drawn over the building's own tiles, or an
+    // empty vector if the layer has no user-drawn tiles.
+    QList<QVector<int> > mCells;
+    QList<QVector<int> > mUserCells;
+    QStringList mTilesetNames;
+    int mFloorCount;
+    Tiled::Map *mMap;
+};
+
+/**
+  * Reads and writes ConvertedBuilding in the .pzeditor directory next to a
+  * .tbx file.  The cache file is used only if it was created from a .tbx
+  * file with the same contents, with the same BuildingTiles.txt, Tilesets.txt,
+  * TMXConfig.txt and tile definitions.
+  */
+class BuildingMapCache
+{
+    Q_DECLARE_TR_FUNCTIONS(BuildingMapCache)
+
+public:
+    /**
+      * Records what the cache keys depend on besides the .tbx file: the
+      * BuildingTiles.txt and Tilesets.txt revisions and the tile definitions
+      * file.  Those can change in the GUI thread at any time, so call this
+      * there before queueing a building; read() and write() use the last
+      * values recorded.
+      */
+    static void updateVersions();
+
+    ConvertedBuilding *read(const QString &tbxFileName);
+    bool write(const ConvertedBuilding *converted, const QString &tbxFileName);
+
+    QString errorString() const
+    { return mError; }
+
+private:
+    QByteArray key(const QString &tbxFileName);
+    ConvertedBuilding *readPayload(QDataStream &in);
+    void writePayload(const ConvertedBuilding *converted, QDataStream &out);
+
+    QByteArray mKey;
+    QString mError;
+};
+
+} // namespace BuildingEditor
+
+#endif // BUILDINGMAPCACHE_H
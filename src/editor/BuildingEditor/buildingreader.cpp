@@ -328,7 +328,7 @@ private:
     Room *getRoom(BuildingFloor *floor, int x, int y, int index);
 
     void decodeCSVTileData(BuildingFloor *floor, const QString &layerName, const QString &text);
-    QString getUserTile(BuildingFloor *floor, int x, int y, int index);
+    quint32 getUserTile(BuildingFloor *floor, int x, int y, int index);
 
     BuildingObject *readObject(BuildingFloor *floor);
 
@@ -352,7 +352,7 @@ private:
     QList<FurnitureTiles*> mFurnitureTiles;
     QList<BuildingTileEntry*> mEntries;
     QMap<QString,BuildingTileEntry*> mEntryMap;
-    QStringList mUserTiles;
+    QVector<quint32> mUserTiles; // BuildingTilesMgr::tileNameId()
     int mVersion;
 
     FakeBuildingTilesMgr mFakeBuildingTilesMgr;
@@ -671,7 +671,7 @@ void BuildingReaderPrivate::readUserTiles()
                                .arg(tileName));
                 return;
             }
-            mUserTiles += tileName;
+            mUserTiles += BuildingTilesMgr::tileNameId(tileName);
             xml.skipCurrentElement();
         } else
             readUnknownElement();
@@ -1153,7 +1153,7 @@ void BuildingReaderPrivate::decodeCSVTileData(BuildingFloor *floor,
                                .arg(x + 1).arg(y + 1).arg(floor->level()));
                 return;
             }
-            floor->setGrime(layerName, x, y, getUserTile(floor, x, y, index));
+            floor->setGrimeId(layerName, x, y, getUserTile(floor, x, y, index));
         }
         start = end + 1;
         if (++x == floor->width() + 1) {
@@ -1180,19 +1180,19 @@ void BuildingReaderPrivate::decodeCSVTileData(BuildingFloor *floor,
                            .arg(x + 1).arg(y + 1).arg(floor->level()));
             return;
         }
-        floor->setGrime(layerName, x, y, getUserTile(floor, x, y, index));
+        floor->setGrimeId(layerName, x, y, getUserTile(floor, x, y, index));
     }
 }
 
-QString BuildingReaderPrivate::getUserTile(BuildingFloor *floor, int x, int y, int index)
+quint32 BuildingReaderPrivate::getUserTile(BuildingFloor *floor, int x, int y, int index)
 {
     if (!index)
-        return QString();
+        return 0;
     if (index > 0 && index - 1 < mUserTiles.size())
         return mUserTiles.at(index - 1);
     xml.raiseError(tr("Invalid tile index at (%1,%2) on floor %3")
                    .arg(x).arg(y).arg(floor->level()));
-    return QString();
+    return 0;
 }
 
 void BuildingReaderPrivate::readUnknownElement()
@@ -27,8 +27,10 @@
 #include "tile.h"
 #include "tileset.h"
 
+#include <QAtomicInt>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
 #include <QMessageBox>
 
 using namespace BuildingEditor;
@@ -39,6 +41,81 @@ static const char *TXT_FILE = "BuildingTiles.txt";
 
 /////
 
+namespace {
+
+// The tile names in FloorTileGrid are interned and stored as 32-bit ids.
+// The names are kept in chunks that never move once allocated, so looking
+// up the name for an id doesn't need to lock the mutex.  An id can only be
+// obtained after its name has been stored.
+class TileNameTable
+{
+public:
+    enum {
+        ChunkShift = 10,
+        ChunkSize = 1 << ChunkShift,
+        ChunkMask = ChunkSize - 1,
+        MaxChunks = 4096
+    };
+
+    TileNameTable() :
+        mCount(1) // id 0 is the empty name
+    {
+        for (int i = 0; i < MaxChunks; i++)
+            mChunks[i] = nullptr;
+        mChunks[0] = new QString[ChunkSize];
+    }
+
+    ~TileNameTable()
+    {
+        for (int i = 0; i < MaxChunks; i++)
+            delete[] mChunks[i];
+    }
+
+    quint32 id(const QString &tileName)
+    {
+        if (tileName.isEmpty())
+            return 0;
+        QMutexLocker locker(&mMutex);
+        QHash<QString,quint32>::const_iterator it = mIds.find(tileName);
+        if (it != mIds.end())
+            return *it;
+        int id = mCount.loadAcquire();
+        int chunk = id >> ChunkShift;
+        if (chunk >= MaxChunks) {
+            qWarning("TileNameTable: too many tile names");
+            return 0;
+        }
+        if (!mChunks[chunk])
+            mChunks[chunk] = new QString[ChunkSize];
+        mChunks[chunk][id & ChunkMask] = tileName;
+        mIds.insert(tileName, id);
+        mCount.storeRelease(id + 1);
+        return id;
+    }
+
+    const QString &name(quint32 id) const
+    {
+        if (id >= quint32(mCount.loadAcquire()))
+            return mChunks[0][0];
+        return mChunks[id >> ChunkShift][id & ChunkMask];
+    }
+
+    int count() const
+    { return mCount.loadAcquire(); }
+
+private:
+    QMutex mMutex;
+    QHash<QString,quint32> mIds;
+    QString *mChunks[MaxChunks];
+    QAtomicInt mCount;
+};
+
+static TileNameTable gTileNames;
+
+} // namespace
+
+/////
+
 BuildingTilesMgr *BuildingTilesMgr::mInstance = 0;
 
 BuildingTilesMgr *BuildingTilesMgr::instance()
@@ -59,7 +136,9 @@ BuildingTilesMgr::BuildingTilesMgr() :
     mNoneTiledTile(0),
     mNoneBuildingTile(0),
     mNoneCategory(0),
-    mNoneTileEntry(0)
+    mNoneTileEntry(0),
+    mRevision(0),
+    mSourceRevision(0)
 {
     mCatCurtains = new BTC_Curtains(QLatin1String("Curtains"));
     mCatDoors = new BTC_Doors(QLatin1String("Doors"));
@@ -123,6 +202,17 @@ BuildingTilesMgr::BuildingTilesMgr() :
     mNoneCategory = new NoneBuildingTileCategory();
     mNoneTileEntry = new NoneBuildingTileEntry(mNoneCategory);
 
+    // Connected before the signals below are forwarded, so tileForId()
+    // is up-to-date when they are received.
+    connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
+            this, &BuildingTilesMgr::resetTileForId);
+    connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAboutToBeRemoved,
+            this, &BuildingTilesMgr::resetTileForId);
+    connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetRemoved,
+            this, &BuildingTilesMgr::resetTileForId);
+    connect(TilesetManager::instance(), &TilesetManager::tilesetChanged,
+            this, &BuildingTilesMgr::resetTileForId);
+
     // Forward these signals (backwards compatibility).
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
             this, &BuildingTilesMgr::tilesetAdded);
@@ -159,6 +249,7 @@ BuildingTile *BuildingTilesMgr::get(const QString &tileName, int offset)
 
     QString adjustedName = adjustTileNameIndex(tileName, offset); // also normalized
 
+    QMutexLocker locker(&mTileByNameMutex);
     if (!mTileByName.contains(adjustedName))
         add(adjustedName);
     return mTileByName[adjustedName];
@@ -333,6 +424,8 @@ static BuildingTileEntry *readTileEntry(BuildingTileCategory *category,
 
 bool BuildingTilesMgr::readTxt()
 {
+    QWriteLocker locker(&mLock);
+
     QFileInfo info(txtPath());
     if (!info.exists()) {
         mError = tr("The %1 file doesn't exist.").arg(txtName());
@@ -638,6 +731,47 @@ Tiled::Tile *BuildingTilesMgr::tileFor(const QString &tileName)
     return tileset->tileAt(index);
 }
 
+quint32 BuildingTilesMgr::tileNameId(const QString &tileName)
+{
+    return gTileNames.id(tileName);
+}
+
+const QString &BuildingTilesMgr::tileNameForId(quint32 id)
+{
+    return gTileNames.name(id);
+}
+
+Tile *BuildingTilesMgr::tileForId(quint32 id)
+{
+    if (!id)
+        return nullptr;
+    if (int(id) >= mTileForId.size()) {
+        int count = gTileNames.count();
+        mTileForId.resize(count);
+        mTileForIdValid.resize(count);
+    }
+    if (mTileForIdValid.testBit(id))
+        return mTileForId[id];
+
+    // Same as BuildingMap::userTilesToLayer() always did.
+    Tile *tile = TilesetManager::instance()->missingTile();
+    QString tilesetName;
+    int index;
+    if (parseTileName(tileNameForId(id), tilesetName, index)) {
+        if (Tileset *tileset = TileMetaInfoMgr::instance()->tileset(tilesetName))
+            tile = tileset->tileAt(index);
+    }
+    mTileForId[id] = tile;
+    mTileForIdValid.setBit(id);
+    return tile;
+}
+
+void BuildingTilesMgr::resetTileForId()
+{
+    mTileForId.clear();
+    mTileForIdValid.clear();
+}
+
 Tile *BuildingTilesMgr::tileFor(BuildingTile *tile, int offset)
 {
     if (tile->isNone())
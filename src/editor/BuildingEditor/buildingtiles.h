@@ -18,9 +18,12 @@
 #ifndef BUILDINGTILES_H
 #define BUILDINGTILES_H
 
+#include <QBitArray>
 #include <QImage>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QReadWriteLock>
 #include <QRect>
 #include <QString>
 #include <QStringList>
@@ -688,10 +691,20 @@ public:
     BuildingTilesMgr();
     ~BuildingTilesMgr();
 
-    BuildingTile *add(const QString &tileName);
-
     BuildingTile *get(const QString &tileName, int offset = 0);
 
+    /**
+      * MapReaderWorker threads read the categories and their entries while
+      * reading and converting a building, and hold this for reading while
+      * they do.  Anything that changes the categories or entries must hold
+      * it for writing.  get() has its own lock and may be called either way.
+      */
+    QReadWriteLock &lock()
+    { return mLock; }
+
+    int revision() const
+    { return mRevision; }
+
     const QList<BuildingTileCategory*> &categories() const
     { return mCategories; }
 
@@ -733,6 +746,21 @@ public:
     Tiled::Tile *tileFor(const QString &tileName);
     Tiled::Tile *tileFor(BuildingTile *tile, int offset = 0);
 
+    /**
+      * User-drawn tile names are interned so FloorTileGrid can store them as
+      * 32-bit ids.  Id 0 is the empty name.  These two may be called from
+      * any thread.
+      */
+    static quint32 tileNameId(const QString &tileName);
+    static const QString &tileNameForId(quint32 id);
+
+    /**
+      * Returns the tile for a user-drawn tile name id.  The missing tile is
+      * returned if the tileset doesn't exist.  The result is cached until
+      * tilesets are added, removed or changed.
+      */
+    Tiled::Tile *tileForId(quint32 id);
+
     BuildingTile *fromTiledTile(Tiled::Tile *tile);
 
     BuildingTile *noneTile() const
@@ -800,6 +828,9 @@ signals:
     void entryTileChanged(BuildingTileEntry *entry);
 
 private:
+    BuildingTile *add(const QString &tileName);
+    void resetTileForId();
+
     static BuildingTilesMgr *mInstance;
 
     QList<BuildingTileCategory*> mCategories;
@@ -807,6 +838,11 @@ private:
 
     QList<BuildingTile*> mTiles;
     QMap<QString,BuildingTile*> mTileByName;
+    QMutex mTileByNameMutex; // get() is called by MapReaderWorker threads
+    QReadWriteLock mLock;
+
+    QVector<Tiled::Tile*> mTileForId;
+    QBitArray mTileForIdValid;
 
     Tiled::Tile *mMissingTile;
     Tiled::Tile *mNoneTiledTile;
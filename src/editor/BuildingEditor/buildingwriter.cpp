@@ -28,6 +28,8 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QSet>
 #include <QTemporaryFile>
 #include <QXmlStreamWriter>
 
@@ -254,24 +256,30 @@ public:
 
     void writeUserTiles(QXmlStreamWriter &w)
     {
+        QSet<quint32> ids;
         foreach (BuildingFloor *floor, mBuilding->floors()) {
-            foreach (QString layerName, floor->grimeLayers()) {
+            foreach (FloorTileGrid *grid, floor->grime()) {
+                if (grid->isEmpty())
+                    continue;
                 for (int x = 0; x <= floor->width(); x++) {
                     for (int y = 0; y <= floor->height(); y++) {
-                        QString tileName = floor->grimeAt(layerName, x, y);
-                        if (!tileName.isEmpty() && !mUserTilesMap.contains(tileName))
-                            mUserTilesMap[tileName] = tileName;
+                        if (quint32 id = grid->idAt(x, y))
+                            ids.insert(id);
                     }
                 }
             }
         }
+        foreach (quint32 id, ids)
+            mUserTilesMap[BuildingTilesMgr::tileNameForId(id)] = id;
 
         w.writeStartElement(QLatin1String("user_tiles"));
-        foreach (QString tileName, mUserTilesMap.values()) { // sorted
+        int index = 0;
+        QMap<QString,quint32>::const_iterator it;
+        for (it = mUserTilesMap.constBegin(); it != mUserTilesMap.constEnd(); it++) { // sorted
             w.writeStartElement(QLatin1String("tile"));
-            w.writeAttribute(QLatin1String("tile"), tileName);
+            w.writeAttribute(QLatin1String("tile"), it.key());
             w.writeEndElement(); // </tile>
-
+            mUserTileIndex[it.value()] = ++index;
         }
         w.writeEndElement(); // </user_tiles>
     }
@@ -310,14 +318,15 @@ public:
                 continue;
             text.clear();
             text += newline;
+            FloorTileGrid *grid = floor->grime()[layerName];
             count = 0, max = (floor->height() + 1) * (floor->width() + 1);
             for (int y = 0; y <= floor->height(); y++) {
                 for (int x = 0; x <= floor->width(); x++) {
-                    QString tileName = floor->grimeAt(layerName, x, y);
-                    if (tileName.isEmpty())
+                    quint32 id = grid->idAt(x, y);
+                    if (!id)
                         text += zero;
                     else
-                        text += QString::number(mUserTilesMap.values().indexOf(tileName) + 1);
+                        text += QString::number(mUserTileIndex[id]);
                     if (++count < max)
                         text += comma;
                 }
@@ -470,7 +479,8 @@ public:
     QList<FurnitureTiles*> mFurnitureTiles;
     QList<BuildingTileEntry*> mTileEntries;
     QMap<QString,BuildingTileEntry*> mEntriesByCategoryName;
-    QMap<QString,QString> mUserTilesMap;
+    QMap<QString,quint32> mUserTilesMap; // tile name -> BuildingTilesMgr::tileNameId()
+    QHash<quint32,int> mUserTileIndex; // 1-based index in <user_tiles>
 };
 
 /////
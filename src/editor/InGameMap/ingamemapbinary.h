@@ -0,0 +1,70 @@
+/*
+ * Copyright 2021, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INGAMEMAPBINARY_H
+#define INGAMEMAPBINARY_H
+
+#include <QByteArray>
+
+// Shared by InGameMapWriterBinary and InGameMapReaderBinary.
+
+#define IGMB_VERSION1 1
+#define IGMB_VERSION2 2
+#define IGMB_VERSION_LATEST IGMB_VERSION2
+
+// Version 2 header flags
+#define IGMB_FLAG_ZLIB 0x01
+
+namespace InGameMapBinary
+{
+
+inline quint32 zigzag(qint32 v)
+{
+    return (quint32(v) << 1) ^ quint32(v >> 31);
+}
+
+inline qint32 unzigzag(quint32 v)
+{
+    return qint32(v >> 1) ^ -qint32(v & 1);
+}
+
+inline void writeVarint(QByteArray &out, quint32 v)
+{
+    while (v >= 0x80) {
+        out += char((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+inline bool readVarint(const QByteArray &in, int &pos, quint32 &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= in.size())
+            return false;
+        const quint8 b = quint8(in.at(pos++));
+        v |= quint32(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+} // namespace InGameMapBinary
+
+#endif // INGAMEMAPBINARY_H
@@ -19,30 +19,33 @@
 #define INGAMEMAPCELL_H
 
 #include <QList>
+#include <QString>
 
 class WorldCell;
 
 class InGameMapCell;
 
+// Coordinates are whole squares relative to the cell's top-left, which is
+// all the .bin format stores.
 class InGameMapPoint
 {
 public:
     InGameMapPoint()
-        : x(0.0)
-        , y(0.0)
+        : x(0)
+        , y(0)
     {
 
     }
 
-    InGameMapPoint(double x, double y)
+    InGameMapPoint(qint32 x, qint32 y)
         : x(x)
         , y(y)
     {
 
     }
 
-    double x;
-    double y;
+    qint32 x;
+    qint32 y;
 
     bool operator==(const InGameMapPoint& rhs) const {
         return x == rhs.x && y == rhs.y;
@@ -88,16 +91,60 @@ public:
 class InGameMapGeometry
 {
 public:
+    enum class Type : quint8
+    {
+        INVALID,
+        Point,
+        LineString,
+        Polygon
+    };
+
+    InGameMapGeometry()
+        : mType(Type::INVALID)
+    {
+
+    }
+
     bool isLineString() const
-    { return mType == QLatin1String("LineString"); }
+    { return mType == Type::LineString; }
 
     bool isPoint() const
-    { return mType == QLatin1String("Point"); }
+    { return mType == Type::Point; }
 
     bool isPolygon() const
-    { return mType == QLatin1String("Polygon"); }
+    { return mType == Type::Polygon; }
+
+    // The names used in the .xml and .bin files.
+    QString typeName() const
+    { return typeToName(mType); }
+
+    static QString typeToName(Type type)
+    {
+        switch (type) {
+        case Type::INVALID:
+            break;
+        case Type::Point:
+            return QStringLiteral("Point");
+        case Type::LineString:
+            return QStringLiteral("LineString");
+        case Type::Polygon:
+            return QStringLiteral("Polygon");
+        }
+        return QString();
+    }
+
+    static Type typeFromName(const QString &name)
+    {
+        if (name == QLatin1String("Point"))
+            return Type::Point;
+        if (name == QLatin1String("LineString"))
+            return Type::LineString;
+        if (name == QLatin1String("Polygon"))
+            return Type::Polygon;
+        return Type::INVALID;
+    }
 
-    QString mType;
+    Type mType;
     QList<InGameMapCoordinates> mCoordinates;
 };
 
@@ -458,8 +458,7 @@ QVariant InGameMapModel::data(const QModelIndex &index, int role) const
         case Qt::CheckStateRole: {
             if (mCellDoc) {
                 // Don't check SubMapItem::isVisible because it changes during CellScene::updateCurrentLevelHighlight()
-                InGameMapFeatureItem *sceneItem = mCellDoc->scene()->itemForInGameMapFeature(feature);
-                bool visible = sceneItem ? sceneItem->isVisible() : false /*sceneItem ? sceneItem->subMap()->isVisible() : false*/;
+                bool visible = mCellDoc->scene()->isInGameMapFeatureVisible(feature);
                 return visible ? Qt::Checked : Qt::Unchecked;
             }
             break;
@@ -469,7 +468,7 @@ QVariant InGameMapModel::data(const QModelIndex &index, int role) const
             for (auto& property : feature->properties()) {
                 propertyString += QStringLiteral(" %1=%2").arg(property.mKey).arg(property.mValue);
             }
-            return feature->mGeometry.mType + propertyString;
+            return feature->mGeometry.typeName() + propertyString;
         }
         case Qt::EditRole:
             return QVariant();
@@ -21,6 +21,7 @@
 #include "mainwindow.h"
 #include "mapcomposite.h"
 #include "mapmanager.h"
+#include "perftrace.h"
 #include "progress.h"
 #include "world.h"
 #include "worldcell.h"
@@ -63,6 +64,8 @@ InGameMapFeatureGenerator::InGameMapFeatureGenerator(QObject *parent) :
 
 bool InGameMapFeatureGenerator::generateWorld(WorldDocument *worldDoc, InGameMapFeatureGenerator::GenerateMode mode, FeatureType type)
 {
+    PERF_SCOPE("InGameMap: generate world");
+
     auto start = std::chrono::high_resolution_clock::now();
     mFeatureType = type;
 
@@ -162,6 +165,7 @@ bool InGameMapFeatureGenerator::shouldGenerateCell(WorldCell *cell)
 
 bool InGameMapFeatureGenerator::generateCell(WorldCell *cell)
 {
+    PERF_SCOPE("InGameMap: generate cell");
 
     if (!shouldGenerateCell(cell))
     {
@@ -656,7 +660,7 @@ bool InGameMapFeatureGenerator::processObjectGroupNew(WorldCell* cell, ObjectGro
 
 
 
-            feature->mGeometry.mType = QStringLiteral("Polygon");
+            feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
             InGameMapCoordinates coords;
 
             coords += InGameMapPoint(x, y);
@@ -948,7 +952,7 @@ bool InGameMapFeatureGenerator::processObjectGroup(WorldCell *cell, ObjectGroup
         property.mValue = QStringLiteral("yes");
         feature->properties() += property;
 
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : nodes) {
             coords += InGameMapPoint(point.x(), point.y());
@@ -1052,7 +1056,7 @@ bool InGameMapFeatureGenerator::processObjectGroup(WorldCell *cell, MapInfo *map
             feature->properties() += property;
         }
 
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : nodes) {
             coords += InGameMapPoint(point.x(), point.y());
@@ -1264,7 +1268,7 @@ bool InGameMapFeatureGenerator::doWater(WorldCell *cell, MapInfo *mapInfo)
         for (auto* cell : qAsConst(cells)) {
             if (cell->isEmpty())
                 continue;
-            if ((cell->tile->id() == 0 || cell->tile->id() == 5 || cell->tile->id() == 6 || cell->tile->id() == 7) && (cell->tile->tileset()->name() == QStringLiteral("blends_natural_02"))) {
+            if ((cell->tile()->id() == 0 || cell->tile()->id() == 5 || cell->tile()->id() == 6 || cell->tile()->id() == 7) && (cell->tile()->tileset()->name() == QStringLiteral("blends_natural_02"))) {
                 return true;
             }
         }
@@ -1326,7 +1330,7 @@ bool InGameMapFeatureGenerator::doWater(WorldCell *cell, MapInfo *mapInfo)
         ClipperLib::Path simple = poly->outer;
         simplifyPolygon(simple);
         if (simple.size() < 3) continue;
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -1392,7 +1396,7 @@ bool InGameMapFeatureGenerator::doTrees(WorldCell *cell, MapInfo *mapInfo)
         for (auto* cell : qAsConst(cells)) {
             if (cell->isEmpty())
                 continue;
-            if ((cell->tile->id() >= 8 && cell->tile->id() <= 15 && cell->tile->tileset()->name().startsWith(QLatin1String("vegetation_trees"))) || (cell->tile->id() == 0 && cell->tile->tileset()->name() == QStringLiteral("jumbo_tree_01"))) {
+            if ((cell->tile()->id() >= 8 && cell->tile()->id() <= 15 && cell->tile()->tileset()->name().startsWith(QLatin1String("vegetation_trees"))) || (cell->tile()->id() == 0 && cell->tile()->tileset()->name() == QStringLiteral("jumbo_tree_01"))) {
                 return true;
             }
         }
@@ -1492,7 +1496,7 @@ bool InGameMapFeatureGenerator::doTrees(WorldCell *cell, MapInfo *mapInfo)
 
         InGameMapFeature* feature = new InGameMapFeature(&cell->inGameMap());
         feature->properties().set(QStringLiteral("natural"), QStringLiteral("forest"));
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -1527,7 +1531,7 @@ bool InGameMapFeatureGenerator::doTrees(WorldCell *cell, MapInfo *mapInfo)
             InGameMapFeature* feature = new InGameMapFeature(&cell->inGameMap());
             feature->properties().set(QStringLiteral("natural"), QStringLiteral("forest"));
             feature->properties().set(QStringLiteral("hole"), nextID);
-            feature->mGeometry.mType = QStringLiteral("Polygon");
+            feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
             InGameMapCoordinates coords;
             simple = hole;
             simplifyPolygon(simple);
@@ -1645,7 +1649,7 @@ bool InGameMapFeatureGenerator::doRoadMain(WorldCell* cell, MapInfo* mapInfo)
             // blends_street_01_85
             // blends_street_01_86
             // blends_street_01_87
-            if ((cell->tile->id() == 32 || cell->tile->id() == 37 || cell->tile->id() == 38 || cell->tile->id() == 39 || cell->tile->id() == 80 || cell->tile->id() == 85 || cell->tile->id() == 86 || cell->tile->id() == 87) && (cell->tile->tileset()->name() == QStringLiteral("blends_street_01"))) {
+            if ((cell->tile()->id() == 32 || cell->tile()->id() == 37 || cell->tile()->id() == 38 || cell->tile()->id() == 39 || cell->tile()->id() == 80 || cell->tile()->id() == 85 || cell->tile()->id() == 86 || cell->tile()->id() == 87) && (cell->tile()->tileset()->name() == QStringLiteral("blends_street_01"))) {
                 return true;
             }
         }
@@ -1693,7 +1697,7 @@ bool InGameMapFeatureGenerator::doRoadMain(WorldCell* cell, MapInfo* mapInfo)
         ClipperLib::Path simple = poly->outer;
         simplifyPolygonRoad(simple, threshold, size);
         if (simple.size() < 4) continue;
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -1767,7 +1771,7 @@ bool InGameMapFeatureGenerator::doRoadSecondary(WorldCell* cell, MapInfo* mapInf
             // blends_street_01_101
             // blends_street_01_102
             // blends_street_01_103
-            if ((cell->tile->id() == 96 || cell->tile->id() == 101 || cell->tile->id() == 102 || cell->tile->id() == 103) && (cell->tile->tileset()->name() == QStringLiteral("blends_street_01"))) {
+            if ((cell->tile()->id() == 96 || cell->tile()->id() == 101 || cell->tile()->id() == 102 || cell->tile()->id() == 103) && (cell->tile()->tileset()->name() == QStringLiteral("blends_street_01"))) {
                 return true;
             }
         }
@@ -1815,7 +1819,7 @@ bool InGameMapFeatureGenerator::doRoadSecondary(WorldCell* cell, MapInfo* mapInf
         ClipperLib::Path simple = poly->outer;
         simplifyPolygonRoad(simple, threshold, size);
         if (simple.size() < 4) continue;
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -1891,7 +1895,7 @@ bool InGameMapFeatureGenerator::doRoadTertiary(WorldCell* cell, MapInfo* mapInfo
             // blends_street_01_53
             // blends_street_01_54
             // blends_street_01_55
-            if ((cell->tile->id() == 48 || cell->tile->id() == 53 || cell->tile->id() == 54 || cell->tile->id() == 55 || cell->tile->id() == 16 || cell->tile->id() == 21) && (cell->tile->tileset()->name() == QStringLiteral("blends_street_01"))) {
+            if ((cell->tile()->id() == 48 || cell->tile()->id() == 53 || cell->tile()->id() == 54 || cell->tile()->id() == 55 || cell->tile()->id() == 16 || cell->tile()->id() == 21) && (cell->tile()->tileset()->name() == QStringLiteral("blends_street_01"))) {
                 return true;
             }
         }
@@ -1939,7 +1943,7 @@ bool InGameMapFeatureGenerator::doRoadTertiary(WorldCell* cell, MapInfo* mapInfo
         ClipperLib::Path simple = poly->outer;
         simplifyPolygonRoad(simple, threshold, size);
         if (simple.size() < 4) continue;
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -2014,7 +2018,7 @@ bool InGameMapFeatureGenerator::doRoadTrail(WorldCell* cell, MapInfo* mapInfo)
             // blends_natural_01_69
             // blends_natural_01_70
             // blends_natural_01_71
-            if ((cell->tile->id() == 64 || cell->tile->id() == 69 || cell->tile->id() == 70 || cell->tile->id() == 71 || cell->tile->id() == 80 || cell->tile->id() == 85 || cell->tile->id() == 86 || cell->tile->id() == 87) && (cell->tile->tileset()->name() == QStringLiteral("blends_natural_01"))) {
+            if ((cell->tile()->id() == 64 || cell->tile()->id() == 69 || cell->tile()->id() == 70 || cell->tile()->id() == 71 || cell->tile()->id() == 80 || cell->tile()->id() == 85 || cell->tile()->id() == 86 || cell->tile()->id() == 87) && (cell->tile()->tileset()->name() == QStringLiteral("blends_natural_01"))) {
                 return true;
             }
         }
@@ -2064,7 +2068,7 @@ bool InGameMapFeatureGenerator::doRoadTrail(WorldCell* cell, MapInfo* mapInfo)
             
             simplifyPolygonRoad(simple, threshold, size);
             if (simple.size() < 4) continue;
-            feature->mGeometry.mType = QStringLiteral("Polygon");
+            feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
             InGameMapCoordinates coords;
             for (auto& point : simple) {
                 coords += InGameMapPoint(point.X, point.Y);
@@ -2139,7 +2143,7 @@ bool InGameMapFeatureGenerator::doRailroad(WorldCell* cell, MapInfo* mapInfo)
             if (cell->isEmpty())
                 continue;
             //industry_railroad_01_xx
-            if ((cell->tile->id() >= 0) && (cell->tile->tileset()->name() == QStringLiteral("industry_railroad_01"))) {
+            if ((cell->tile()->id() >= 0) && (cell->tile()->tileset()->name() == QStringLiteral("industry_railroad_01"))) {
                 return true;
             }
         }
@@ -2189,7 +2193,7 @@ bool InGameMapFeatureGenerator::doRailroad(WorldCell* cell, MapInfo* mapInfo)
         ClipperLib::Path simple = poly->outer;
         simplifyPolygonRoad(simple, threshold, size);
         if (simple.size() < 4) continue;
-        feature->mGeometry.mType = QStringLiteral("Polygon");
+        feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
         InGameMapCoordinates coords;
         for (auto& point : simple) {
             coords += InGameMapPoint(point.X, point.Y);
@@ -26,9 +26,314 @@
 #include <quazip.h>
 #include <quazipfile.h>
 
+#include <QBuffer>
 #include <QFileDialog>
+#include <QImageReader>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include <cmath>
+#include <functional>
+
+namespace {
+
+const int TILE_SIZE = 256;
+const int MAX_LEVELS = 5;
+
+// Writes encoded tiles into the ZIP file.  QuaZip isn't thread-safe, so only
+// this thread touches it until finish() returns.
+class PyramidZipWriter : public QThread
+{
+public:
+    PyramidZipWriter(QuaZip& zip, QSemaphore& slots)
+        : mZip(zip)
+        , mSlots(slots)
+        , mFinished(false)
+    {
+    }
+
+    void add(const QString& fileName, const QByteArray& data)
+    {
+        QMutexLocker locker(&mMutex);
+        mQueue += qMakePair(fileName, data);
+        mCondition.wakeOne();
+    }
+
+    void finish()
+    {
+        {
+            QMutexLocker locker(&mMutex);
+            mFinished = true;
+            mCondition.wakeOne();
+        }
+        wait();
+    }
+
+    QStringList errors() const
+    {
+        return mErrors;
+    }
+
+protected:
+    void run() override
+    {
+        forever {
+            QPair<QString, QByteArray> entry;
+            {
+                QMutexLocker locker(&mMutex);
+                while (mQueue.isEmpty() && !mFinished)
+                    mCondition.wait(&mMutex);
+                if (mQueue.isEmpty())
+                    return;
+                entry = mQueue.takeFirst();
+            }
+            if (entry.second.isEmpty()) {
+                mErrors += QStringLiteral("ERROR encoding %1").arg(entry.first);
+            } else {
+                QuaZipFile file(&mZip);
+                QuaZipNewInfo newInfo(entry.first);
+                if (file.open(QIODevice::WriteOnly, newInfo) == false) {
+                    mErrors += QStringLiteral("Error opening %1 in ZIP file").arg(entry.first);
+                } else {
+                    if (file.write(entry.second) != entry.second.size())
+                        mErrors += QStringLiteral("ERROR writing %1 to ZIP file").arg(entry.first);
+                    file.close();
+                }
+            }
+            mSlots.release();
+        }
+    }
+
+private:
+    QuaZip& mZip;
+    QSemaphore& mSlots;
+    QMutex mMutex;
+    QWaitCondition mCondition;
+    QList<QPair<QString, QByteArray>> mQueue;
+    bool mFinished;
+    QStringList mErrors;
+};
+
+class EncodeTileTask : public QRunnable
+{
+public:
+    EncodeTileTask(PyramidZipWriter& writer, const QString& fileName, const QImage& image)
+        : mWriter(writer)
+        , mFileName(fileName)
+        , mImage(image)
+    {
+    }
+
+    void run() override
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (mImage.save(&buffer, "PNG") == false)
+            data.clear();
+        mWriter.add(mFileName, data);
+    }
+
+private:
+    PyramidZipWriter& mWriter;
+    QString mFileName;
+    QImage mImage;
+};
+
+bool isTransparent(const QImage& image)
+{
+    for (int y = 0; y < image.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); x++) {
+            if (qAlpha(line[x]) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Returns a tile that is the 2x box-filtered version of four tiles from the
+// level above.  Null images are fully-transparent tiles.
+QImage downsampleTiles(const QImage& topLeft, const QImage& topRight,
+                       const QImage& bottomLeft, const QImage& bottomRight)
+{
+    const QImage *quads[4] = { &topLeft, &topRight, &bottomLeft, &bottomRight };
+    QImage result;
+    for (int q = 0; q < 4; q++) {
+        const QImage& src = *quads[q];
+        if (src.isNull())
+            continue;
+        if (result.isNull()) {
+            result = QImage(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+            result.fill(Qt::transparent);
+        }
+        const int ox = (q % 2) * TILE_SIZE / 2;
+        const int oy = (q / 2) * TILE_SIZE / 2;
+        for (int y = 0; y < TILE_SIZE / 2; y++) {
+            const QRgb *s0 = reinterpret_cast<const QRgb*>(src.constScanLine(y * 2));
+            const QRgb *s1 = reinterpret_cast<const QRgb*>(src.constScanLine(y * 2 + 1));
+            QRgb *d = reinterpret_cast<QRgb*>(result.scanLine(oy + y)) + ox;
+            for (int x = 0; x < TILE_SIZE / 2; x++) {
+                const QRgb a = s0[x * 2], b = s0[x * 2 + 1];
+                const QRgb c = s1[x * 2], e = s1[x * 2 + 1];
+                d[x] = qRgba((qRed(a) + qRed(b) + qRed(c) + qRed(e) + 2) / 4,
+                             (qGreen(a) + qGreen(b) + qGreen(c) + qGreen(e) + 2) / 4,
+                             (qBlue(a) + qBlue(b) + qBlue(c) + qBlue(e) + 2) / 4,
+                             (qAlpha(a) + qAlpha(b) + qAlpha(c) + qAlpha(e) + 2) / 4);
+            }
+        }
+    }
+    if (!result.isNull() && isTransparent(result))
+        return QImage();
+    return result;
+}
+
+} // namespace
+
+/**
+  * Creates the tiles for every level of the pyramid.  The source image is read
+  * one row of tiles at a time, and each level is produced by downsampling the
+  * level above it two rows at a time, so only a few rows of tiles per level
+  * are in memory at once.  PNG encoding happens on a thread pool.
+  */
+class PyramidBuilder
+{
+public:
+    PyramidBuilder(QuaZip& zip, std::function<void(const QString&)> log)
+        : mLog(log)
+        , mSlots(64)
+        , mWriter(zip, mSlots)
+        , mTileCount(0)
+        , mSkippedCount(0)
+    {
+    }
+
+    bool build(const QString& inputFileName)
+    {
+        QImageReader reader(inputFileName);
+        QSize size = reader.size();
+        QImage fullImage;
+        // Most formats (PNG included) can't decode part of an image, in
+        // which case the whole image is read once.
+        const bool readBands = size.isValid() && reader.supportsOption(QImageIOHandler::ClipRect);
+        if (!readBands) {
+            fullImage = reader.read();
+            if (fullImage.isNull()) {
+                mLog(QStringLiteral("Error reading %1").arg(inputFileName));
+                return false;
+            }
+            size = fullImage.size();
+        }
+
+        for (int level = 0; level < MAX_LEVELS; level++) {
+            float width = float(size.width()) / (1 << level);
+            float height = float(size.height()) / (1 << level);
+            Level L;
+            L.columns = std::ceil(width / TILE_SIZE);
+            L.rows = std::ceil(height / TILE_SIZE);
+            mLevels += L;
+            mLog(QStringLiteral("Creating images for level %1. width x height = %2 x %3").arg(level).arg(L.columns).arg(L.rows));
+            if (width <= TILE_SIZE && height <= TILE_SIZE) {
+                break;
+            }
+        }
+
+        mWriter.start();
+
+        bool ok = true;
+        const Level& top = mLevels.first();
+        for (int row = 0; row < top.rows; row++) {
+            QRect bandRect = QRect(0, row * TILE_SIZE, size.width(), TILE_SIZE) & QRect(QPoint(), size);
+            QImage band;
+            if (readBands) {
+                QImageReader bandReader(inputFileName);
+                bandReader.setClipRect(bandRect);
+                band = bandReader.read();
+                if (band.isNull()) {
+                    mLog(QStringLiteral("Error reading %1").arg(inputFileName));
+                    ok = false;
+                    break;
+                }
+            } else {
+                band = fullImage.copy(bandRect);
+            }
+            band = band.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+            QVector<QImage> tiles(top.columns);
+            for (int col = 0; col < top.columns; col++) {
+                QImage tile = band.copy(col * TILE_SIZE, 0, TILE_SIZE, TILE_SIZE);
+                if (!isTransparent(tile))
+                    tiles[col] = tile;
+            }
+            addRow(0, row, tiles);
+            mLog(QStringLiteral("Finished row %1 of %2").arg(row + 1).arg(top.rows));
+        }
+
+        mPool.waitForDone();
+        mWriter.finish();
+
+        for (const QString& error : mWriter.errors()) {
+            mLog(error);
+        }
+        mLog(QStringLiteral("Wrote %1 tiles, skipped %2 transparent tiles").arg(mTileCount).arg(mSkippedCount));
+
+        return ok && mWriter.errors().isEmpty();
+    }
+
+private:
+    struct Level
+    {
+        int columns;
+        int rows;
+        QList<QVector<QImage>> pending;
+    };
+
+    void addRow(int level, int row, const QVector<QImage>& tiles)
+    {
+        for (int col = 0; col < tiles.size(); col++) {
+            if (tiles[col].isNull()) {
+                mSkippedCount++;
+                continue;
+            }
+            QString fileName = QStringLiteral("%1/tile%2x%3.png").arg(level).arg(col).arg(row);
+            mSlots.acquire();
+            mPool.start(new EncodeTileTask(mWriter, fileName, tiles[col]));
+            mTileCount++;
+        }
+
+        if (level + 1 >= mLevels.size())
+            return;
+
+        Level& L = mLevels[level];
+        L.pending += tiles;
+        if (L.pending.size() < 2 && row < L.rows - 1)
+            return;
+
+        const QVector<QImage> top = L.pending.first();
+        const QVector<QImage> bottom = (L.pending.size() > 1) ? L.pending.last() : QVector<QImage>(top.size());
+        L.pending.clear();
+
+        QVector<QImage> next(mLevels[level + 1].columns);
+        for (int col = 0; col < next.size(); col++) {
+            int c0 = col * 2, c1 = col * 2 + 1;
+            next[col] = downsampleTiles(top.value(c0), top.value(c1),
+                                        bottom.value(c0), bottom.value(c1));
+        }
+        addRow(level + 1, row / 2, next);
+    }
+
+    std::function<void(const QString&)> mLog;
+    QSemaphore mSlots;
+    PyramidZipWriter mWriter;
+    QThreadPool mPool;
+    QList<Level> mLevels;
+    int mTileCount;
+    int mSkippedCount;
+};
 
 InGameMapImagePyramidWindow::InGameMapImagePyramidWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -89,11 +394,6 @@ void InGameMapImagePyramidWindow::createZip()
     ui->logText->clear();
     QString inputFileName = ui->inputNameEdit->text();
     log(QStringLiteral("Reading %1").arg(inputFileName));
-    QImage image(inputFileName);
-    if (image.isNull()) {
-        log(QStringLiteral("Error reading %1").arg(inputFileName));
-        return;
-    }
 
     QuaZip zip(ui->outputNameEdit->text());
     if (zip.open(QuaZip::Mode::mdCreate) == false) {
@@ -101,55 +401,16 @@ void InGameMapImagePyramidWindow::createZip()
         return;
     }
 
-    int tileSize = 256;
-    int levels = 5;
-    for (int level = 0; level < levels; level++) {
-        float width = float(image.width()) / (1 << level);
-        float height = float(image.height()) / (1 << level);
-        QImage scaledImage = image.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        int columns = std::ceil(width / tileSize);
-        int rows = std::ceil(height / tileSize);
-        log(QStringLiteral("Creating images for level %1. width x height = %2 x %3").arg(level).arg(columns).arg(rows));
-        for (int row = 0; row < rows; row++) {
-            for (int col = 0; col < columns; col++) {
-                QImage subImage = scaledImage.copy(col * tileSize, row * tileSize, tileSize, tileSize);
-                writeImageToZip(zip, subImage, col, row, level);
-            }
-        }
-        if (width <= tileSize && height <= tileSize) {
-            break;
-        }
+    PyramidBuilder builder(zip, [this](const QString& str) { log(str); });
+    if (builder.build(inputFileName)) {
+        writePyramidTxt(zip);
     }
 
-    writePyramidTxt(zip);
-
     zip.close();
 
     log(QStringLiteral("FINISHED."));
 }
 
-void InGameMapImagePyramidWindow::writeImageToZip(QuaZip &zip, const QImage &image, int col, int row, int level)
-{
-    QString fileName = QStringLiteral("%1/tile%2x%3.png").arg(level).arg(col).arg(row);
-
-    log(QStringLiteral("Adding %1 to ZIP").arg(fileName));
-
-//    zip.setCurrentFile(fileName);
-
-    QuaZipFile file(&zip);
-    QuaZipNewInfo newInfo(fileName);
-    if (file.open(QIODevice::WriteOnly, newInfo) == false) {
-        log(QStringLiteral("Error opening %1 in ZIP file").arg(fileName));
-        return;
-    }
-    if (image.save(&file, "PNG") == false) {
-        log(QStringLiteral("ERROR writing %1 to ZIP file").arg(fileName));
-        file.close();
-        return;
-    }
-    file.close();
-}
-
 void InGameMapImagePyramidWindow::writePyramidTxt(QuaZip &zip)
 {
     QString fileName = QStringLiteral("pyramid.txt");
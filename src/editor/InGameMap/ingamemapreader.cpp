@@ -167,7 +167,7 @@ private:
 
         const QXmlStreamAttributes atts = xml.attributes();
 
-        feature.mGeometry.mType = atts.value(QLatin1String("type")).toString();
+        feature.mGeometry.mType = InGameMapGeometry::typeFromName(atts.value(QLatin1String("type")).toString());
 
         while (xml.readNextStartElement()) {
             if (xml.name() == QLatin1String("coordinates"))
@@ -200,8 +200,8 @@ private:
         const QXmlStreamAttributes atts = xml.attributes();
 
         InGameMapPoint point;
-        point.x = atts.value(QLatin1String("x")).toDouble();
-        point.y = atts.value(QLatin1String("y")).toDouble();
+        point.x = qRound(atts.value(QLatin1String("x")).toDouble());
+        point.y = qRound(atts.value(QLatin1String("y")).toDouble());
 
         coordinates += point;
 
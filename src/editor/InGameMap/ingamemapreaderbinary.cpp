@@ -0,0 +1,430 @@
+/*
+ * Copyright 2021, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ingamemapreaderbinary.h"
+
+#include "ingamemapbinary.h"
+
+#include "world.h"
+#include "worldcell.h"
+
+#include "compression.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QVector>
+
+using namespace InGameMapBinary;
+
+class InGameMapReaderBinaryPrivate
+{
+    Q_DECLARE_TR_FUNCTIONS(InGameMapReaderBinary)
+
+public:
+    InGameMapReaderBinaryPrivate()
+        : mVersion(0)
+        , mWidth(0)
+        , mHeight(0)
+        , mFlags(0)
+    {
+    }
+
+    bool open(const QString &fileName)
+    {
+        close();
+
+        mFile.setFileName(fileName);
+        if (!mFile.open(QFile::ReadOnly)) {
+            mError = tr("Unable to read file: %1").arg(fileName);
+            return false;
+        }
+
+        QDataStream in(&mFile);
+        in.setByteOrder(QDataStream::LittleEndian);
+
+        quint8 sig[4];
+        in >> sig[0] >> sig[1] >> sig[2] >> sig[3];
+        if (sig[0] != 'I' || sig[1] != 'G' || sig[2] != 'M' || sig[3] != 'B') {
+            mError = tr("Not an in-game map file: %1").arg(fileName);
+            close();
+            return false;
+        }
+
+        qint32 version, width, height;
+        in >> version >> width >> height;
+        if (version != IGMB_VERSION1 && version != IGMB_VERSION2) {
+            mError = tr("Unsupported in-game map version %1").arg(version);
+            close();
+            return false;
+        }
+        if (width <= 0 || height <= 0 || width * height > 1000 * 1000) {
+            mError = tr("Invalid in-game map size %1x%2").arg(width).arg(height);
+            close();
+            return false;
+        }
+        mVersion = version;
+        mWidth = width;
+        mHeight = height;
+
+        if (mVersion == IGMB_VERSION2) {
+            qint32 flags;
+            in >> flags;
+            mFlags = flags;
+        }
+
+        if (!readStringTable(in)) {
+            close();
+            return false;
+        }
+
+        mCellOffsets.fill(-1, mWidth * mHeight);
+        mCellSizes.fill(0, mWidth * mHeight);
+
+        bool ok = (mVersion == IGMB_VERSION2) ? readIndexV2(in) : scanCellsV1(in);
+        if (!ok) {
+            if (mError.isEmpty())
+                mError = tr("Corrupt in-game map file: %1").arg(fileName);
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        mFile.close();
+        mVersion = mWidth = mHeight = mFlags = 0;
+        mStrings.clear();
+        mPropertySets.clear();
+        mCellOffsets.clear();
+        mCellSizes.clear();
+    }
+
+    bool readCell(int index, InGameMapCell *cell, QPoint *worldPos)
+    {
+        if (mCellOffsets[index] == -1)
+            return true;
+
+        if (!mFile.seek(mCellOffsets[index])) {
+            mError = mFile.errorString();
+            return false;
+        }
+
+        if (mVersion == IGMB_VERSION1) {
+            QDataStream in(&mFile);
+            in.setByteOrder(QDataStream::LittleEndian);
+            if (!readCellV1(in, cell, worldPos)) {
+                mError = tr("Corrupt cell data");
+                return false;
+            }
+            return true;
+        }
+
+        QByteArray block = mFile.read(mCellSizes[index]);
+        if (block.size() != int(mCellSizes[index])) {
+            mError = tr("Unexpected end of file");
+            return false;
+        }
+        if (mFlags & IGMB_FLAG_ZLIB)
+            block = Tiled::decompress(block, block.size() * 4);
+        if (!readCellV2(block, cell, worldPos)) {
+            mError = tr("Corrupt cell data");
+            return false;
+        }
+        return true;
+    }
+
+    World *readWorld(World *world)
+    {
+        const QPoint& worldOrigin = world->getGenerateLotsSettings().worldOrigin;
+
+        for (int i = 0; i < mWidth * mHeight; i++) {
+            InGameMapCell temp(nullptr);
+            QPoint pos;
+            if (!readCell(i, &temp, &pos))
+                return nullptr;
+            if (temp.mFeatures.isEmpty())
+                continue;
+            pos -= worldOrigin;
+            if (!world->contains(pos.x(), pos.y())) {
+                mError = tr("Invalid cell coordinates %1,%2").arg(pos.x()).arg(pos.y());
+                return nullptr;
+            }
+            InGameMapCell &target = world->cellAt(pos)->inGameMap();
+            for (auto* feature : qAsConst(temp.mFeatures)) {
+                feature->mOwner = &target;
+                target.mFeatures += feature;
+            }
+            temp.mFeatures.clear();
+        }
+
+        return world;
+    }
+
+private:
+    bool readStringTable(QDataStream &in)
+    {
+        qint32 count;
+        in >> count;
+        if (in.status() != QDataStream::Ok || count < 0) {
+            mError = tr("Corrupt string table");
+            return false;
+        }
+        mStrings.reserve(count);
+        for (int i = 0; i < count; i++) {
+            quint16 length;
+            in >> length;
+            QByteArray utf8(length, Qt::Uninitialized);
+            if (in.readRawData(utf8.data(), length) != length) {
+                mError = tr("Corrupt string table");
+                return false;
+            }
+            mStrings += QString::fromUtf8(utf8);
+        }
+        return true;
+    }
+
+    bool readIndexV2(QDataStream &in)
+    {
+        qint32 count, size;
+        in >> count >> size;
+        if (in.status() != QDataStream::Ok || count < 0 || size < 0)
+            return false;
+        const QByteArray data = mFile.read(size);
+        if (data.size() != size)
+            return false;
+        int pos = 0;
+        for (int i = 0; i < count; i++) {
+            InGameMapProperties properties;
+            quint32 n, key, value;
+            if (!readVarint(data, pos, n))
+                return false;
+            for (quint32 j = 0; j < n; j++) {
+                if (!readVarint(data, pos, key) || !readVarint(data, pos, value))
+                    return false;
+                if (key >= quint32(mStrings.size()) || value >= quint32(mStrings.size()))
+                    return false;
+                properties += InGameMapProperty(mStrings[key], mStrings[value]);
+            }
+            mPropertySets += properties;
+        }
+
+        QVector<quint32> offsets(mWidth * mHeight);
+        for (int i = 0; i < mWidth * mHeight; i++)
+            in >> offsets[i] >> mCellSizes[i];
+        if (in.status() != QDataStream::Ok)
+            return false;
+
+        const qint64 dataStart = mFile.pos();
+        for (int i = 0; i < mWidth * mHeight; i++) {
+            if (mCellSizes[i] > 0)
+                mCellOffsets[i] = dataStart + offsets[i];
+        }
+        return true;
+    }
+
+    bool scanCellsV1(QDataStream &in)
+    {
+        for (int i = 0; i < mWidth * mHeight; i++) {
+            const qint64 offset = mFile.pos();
+            qint32 x;
+            in >> x;
+            if (in.status() != QDataStream::Ok)
+                return false;
+            if (x == -1)
+                continue;
+            mFile.seek(offset);
+            if (!readCellV1(in, nullptr, nullptr))
+                return false;
+            mCellOffsets[i] = offset;
+        }
+        return true;
+    }
+
+    // If cell is null the data is only skipped over.
+    bool readCellV1(QDataStream &in, InGameMapCell *cell, QPoint *worldPos)
+    {
+        qint32 x, y, featureCount;
+        in >> x >> y >> featureCount;
+        if (in.status() != QDataStream::Ok || featureCount < 0)
+            return false;
+        if (worldPos)
+            *worldPos = QPoint(x, y);
+
+        for (int i = 0; i < featureCount; i++) {
+            quint16 type;
+            quint8 coordsCount;
+            in >> type >> coordsCount;
+            InGameMapFeature* feature = nullptr;
+            if (cell) {
+                if (type >= mStrings.size())
+                    return false;
+                feature = new InGameMapFeature(cell);
+                cell->mFeatures += feature;
+                feature->mGeometry.mType = InGameMapGeometry::typeFromName(mStrings[type]);
+            }
+            for (int j = 0; j < coordsCount; j++) {
+                quint16 pointCount;
+                in >> pointCount;
+                if (!feature) {
+                    if (in.skipRawData(pointCount * 4) != pointCount * 4)
+                        return false;
+                    continue;
+                }
+                InGameMapCoordinates coords;
+                coords.reserve(pointCount);
+                for (int k = 0; k < pointCount; k++) {
+                    qint16 px, py;
+                    in >> px >> py;
+                    coords += InGameMapPoint(px, py);
+                }
+                feature->mGeometry.mCoordinates += coords;
+            }
+            quint8 propertyCount;
+            in >> propertyCount;
+            for (int j = 0; j < propertyCount; j++) {
+                quint16 key, value;
+                in >> key >> value;
+                if (!feature)
+                    continue;
+                if (key >= mStrings.size() || value >= mStrings.size())
+                    return false;
+                feature->mProperties += InGameMapProperty(mStrings[key], mStrings[value]);
+            }
+            if (in.status() != QDataStream::Ok)
+                return false;
+        }
+        return true;
+    }
+
+    bool readCellV2(const QByteArray &block, InGameMapCell *cell, QPoint *worldPos)
+    {
+        int pos = 0;
+        quint32 x, y, featureCount;
+        if (!readVarint(block, pos, x) || !readVarint(block, pos, y) ||
+                !readVarint(block, pos, featureCount))
+            return false;
+        if (worldPos)
+            *worldPos = QPoint(unzigzag(x), unzigzag(y));
+
+        for (quint32 i = 0; i < featureCount; i++) {
+            quint32 type, properties, coordsCount;
+            if (!readVarint(block, pos, type) || !readVarint(block, pos, properties) ||
+                    !readVarint(block, pos, coordsCount))
+                return false;
+            if (type >= quint32(mStrings.size()) || properties >= quint32(mPropertySets.size()))
+                return false;
+            InGameMapFeature* feature = new InGameMapFeature(cell);
+            cell->mFeatures += feature;
+            feature->mGeometry.mType = InGameMapGeometry::typeFromName(mStrings[type]);
+            feature->mProperties = mPropertySets[properties];
+
+            qint32 prevX = 0, prevY = 0;
+            for (quint32 j = 0; j < coordsCount; j++) {
+                quint32 pointCount, dx, dy;
+                if (!readVarint(block, pos, pointCount) || pointCount > quint32(block.size()))
+                    return false;
+                InGameMapCoordinates coords;
+                coords.reserve(pointCount);
+                for (quint32 k = 0; k < pointCount; k++) {
+                    if (!readVarint(block, pos, dx) || !readVarint(block, pos, dy))
+                        return false;
+                    prevX += unzigzag(dx);
+                    prevY += unzigzag(dy);
+                    coords += InGameMapPoint(prevX, prevY);
+                }
+                feature->mGeometry.mCoordinates += coords;
+            }
+        }
+        return pos == block.size();
+    }
+
+public:
+    QString mError;
+    QFile mFile;
+    int mVersion;
+    int mWidth;
+    int mHeight;
+    int mFlags;
+    QStringList mStrings;
+    QList<InGameMapProperties> mPropertySets;
+    QVector<qint64> mCellOffsets;
+    QVector<quint32> mCellSizes;
+};
+
+/////
+
+InGameMapReaderBinary::InGameMapReaderBinary()
+    : d(new InGameMapReaderBinaryPrivate)
+{
+}
+
+InGameMapReaderBinary::~InGameMapReaderBinary()
+{
+    delete d;
+}
+
+bool InGameMapReaderBinary::open(const QString &fileName)
+{
+    d->mError.clear();
+    return d->open(fileName);
+}
+
+void InGameMapReaderBinary::close()
+{
+    d->close();
+}
+
+int InGameMapReaderBinary::version() const
+{
+    return d->mVersion;
+}
+
+int InGameMapReaderBinary::width() const
+{
+    return d->mWidth;
+}
+
+int InGameMapReaderBinary::height() const
+{
+    return d->mHeight;
+}
+
+bool InGameMapReaderBinary::readCell(int x, int y, InGameMapCell *cell)
+{
+    if (!d->mFile.isOpen() || x < 0 || y < 0 || x >= d->mWidth || y >= d->mHeight) {
+        d->mError = InGameMapReaderBinaryPrivate::tr("Invalid cell coordinates %1,%2").arg(x).arg(y);
+        return false;
+    }
+    return d->readCell(x + y * d->mWidth, cell, nullptr);
+}
+
+World *InGameMapReaderBinary::readWorld(const QString &fileName, World *world)
+{
+    if (!open(fileName))
+        return nullptr;
+    World *result = d->readWorld(world);
+    close();
+    return result;
+}
+
+QString InGameMapReaderBinary::errorString() const
+{
+    return d->mError;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2021, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INGAMEMAPREADERBINARY_H
+#define INGAMEMAPREADERBINARY_H
+
+#include <QString>
+
+class InGameMapCell;
+class World;
+
+class InGameMapReaderBinaryPrivate;
+
+/**
+  * Reads files written by InGameMapWriterBinary.  Cells can be read one at a
+  * time after open().  Version 2 files have an index of cell offsets; for
+  * version 1 files open() scans the file once to build the same index.
+  */
+class InGameMapReaderBinary
+{
+public:
+    InGameMapReaderBinary();
+    ~InGameMapReaderBinary();
+
+    bool open(const QString &fileName);
+    void close();
+
+    int version() const;
+    int width() const;
+    int height() const;
+
+    /**
+      * Appends the features of cell \a x,\a y in the file to \a cell.
+      */
+    bool readCell(int x, int y, InGameMapCell *cell);
+
+    World *readWorld(const QString &fileName, World *world);
+
+    QString errorString() const;
+
+private:
+    InGameMapReaderBinaryPrivate *d;
+};
+
+#endif // INGAMEMAPREADERBINARY_H
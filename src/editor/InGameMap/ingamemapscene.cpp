@@ -34,8 +34,11 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QKeyEvent>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QtMath>
 
+#include <algorithm>
+
 InGameMapFeatureItem::InGameMapFeatureItem(InGameMapFeature* feature, CellScene *scene, QGraphicsItem *parent)
     : QGraphicsItem(parent)
     , mWorldDoc(scene->worldDocument())
@@ -279,7 +282,7 @@ void InGameMapFeatureItem::synchWithFeature()
         break;
     case Type::Point: {
         InGameMapPoint center = mFeature->mGeometry.mCoordinates[0][0];
-        mPolygon += { center.x , center.y };
+        mPolygon += QPointF(center.x, center.y);
         QPointF scenePos = mRenderer->tileToPixelCoords(mPolygon[0] + mDragOffset);
         QRectF bounds(scenePos.x() - 10, scenePos.y() - 10, 20, 20);
         if (bounds != mBoundingRect) {
@@ -601,7 +604,7 @@ QVariant FeatureHandle::itemChange(GraphicsItemChange change, const QVariant &va
         else if (change == ItemPositionHasChanged) {
             const QPointF newPos = value.toPointF();
             QPointF tileCoords = renderer->pixelToTileCoordsNearest(newPos, 0);
-            InGameMapPoint point = { tileCoords.x(), tileCoords.y()};
+            InGameMapPoint point(qRound(tileCoords.x()), qRound(tileCoords.y()));
             mFeatureItem->movePoint(mCoordIndex, mPointIndex, point);
         }
     }
@@ -611,6 +614,535 @@ QVariant FeatureHandle::itemChange(GraphicsItemChange change, const QVariant &va
 
 /////
 
+void InGameMapGeometryStore::clear()
+{
+    mPoints.clear();
+    mRingStart.clear();
+    mGarbage = 0;
+}
+
+InGameMapGeometryStore::Feature InGameMapGeometryStore::append(const InGameMapGeometry &geometry)
+{
+    Feature feature;
+    feature.mType = geometry.mType;
+    feature.mFirstRing = mRingStart.size();
+    feature.mRingCount = geometry.mCoordinates.size();
+    for (const InGameMapCoordinates &coords : geometry.mCoordinates) {
+        mRingStart += mPoints.size();
+        for (const InGameMapPoint &point : coords)
+            mPoints += QPoint(point.x, point.y);
+    }
+    mRingStart += mPoints.size();
+    return feature;
+}
+
+void InGameMapGeometryStore::release(const Feature &feature)
+{
+    mGarbage += mRingStart[feature.mFirstRing + feature.mRingCount] - mRingStart[feature.mFirstRing];
+}
+
+/////
+
+namespace {
+
+// The furthest a simplified outline strays from the real one, in scene
+// pixels, at each level of detail.  Level N is used once a scene pixel is
+// smaller than 1 / LOD_TOLERANCE[N] screen pixels.
+const qreal LOD_TOLERANCE[] = { 0, 4, 16, 64 };
+
+const qreal BUCKET_SIZE = 512;
+const int MAX_BUCKETS = 64; // across or down
+
+// Douglas-Peucker
+QPolygonF simplified(const QPolygonF &polygon, qreal tolerance)
+{
+    if (polygon.size() <= 2)
+        return polygon;
+
+    QVector<bool> keep(polygon.size(), false);
+    keep.first() = keep.last() = true;
+
+    const float tolerance2 = float(tolerance * tolerance);
+    QVector<QPair<int,int>> stack;
+    stack += qMakePair(0, polygon.size() - 1);
+    while (!stack.isEmpty()) {
+        const QPair<int,int> span = stack.takeLast();
+        const QVector2D p1(polygon[span.first]);
+        const QVector2D p2(polygon[span.second]);
+        int farthest = -1;
+        float farthestDist = tolerance2;
+        for (int i = span.first + 1; i < span.second; i++) {
+            // A closed ring starts and ends on the same point.
+            const QVector2D p(polygon[i]);
+            float d = (p1 == p2) ? (p - p1).lengthSquared()
+                                 : distanceOfPointToLineSegment(p1, p2, p);
+            if (d > farthestDist) {
+                farthest = i;
+                farthestDist = d;
+            }
+        }
+        if (farthest != -1) {
+            keep[farthest] = true;
+            stack += qMakePair(span.first, farthest);
+            stack += qMakePair(farthest, span.second);
+        }
+    }
+
+    QPolygonF result;
+    for (int i = 0; i < polygon.size(); i++) {
+        if (keep[i])
+            result += polygon[i];
+    }
+    return result;
+}
+
+} // namespace
+
+InGameMapFeaturesItem::InGameMapFeaturesItem(WorldCell *cell, Tiled::MapRenderer *renderer, QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , mCell(cell)
+    , mRenderer(renderer)
+    , mAdjacent(false)
+    , mHoverIndex(-1)
+    , mIndexDirty(true)
+    , mColumns(0)
+    , mRows(0)
+    , mMark(0)
+{
+    setFlag(ItemUsesExtendedStyleOption); // for exposedRect
+    setAcceptHoverEvents(true);
+    synchWithCell();
+}
+
+QRectF InGameMapFeaturesItem::boundingRect() const
+{
+    return mBoundingRect;
+}
+
+void InGameMapFeaturesItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    int level = 0;
+    while ((level + 1 < LOD_COUNT) && (LOD_TOLERANCE[level + 1] * lod <= 1.0))
+        ++level;
+
+    QVector<int> indices;
+    for (int index : entriesIn(option->exposedRect)) {
+        const Entry &entry = mEntries[index];
+        if (!entry.mVisible || entry.mHasItem)
+            continue;
+        if (entry.mGeometry.mType == InGameMapGeometry::Type::INVALID)
+            continue;
+        // Skip anything smaller than a screen pixel.
+        if ((entry.mBounds.width() * lod < 1.0) && (entry.mBounds.height() * lod < 1.0))
+            continue;
+        indices += index;
+    }
+
+    QPen pen(Qt::black);
+    pen.setJoinStyle(Qt::RoundJoin);
+    pen.setCapStyle(Qt::RoundCap);
+    pen.setWidth(2);
+    pen.setCosmetic(true);
+
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    // Like InGameMapFeatureItem, lines and polygons are outlined in black
+    // and drawn again in color one pixel higher.
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    for (int index : qAsConst(indices)) {
+        Entry &entry = mEntries[index];
+        if (entry.mGeometry.mType != InGameMapGeometry::Type::Point)
+            painter->drawPath(path(entry, level));
+    }
+
+    auto drawInColor = [&](bool points, int index, const QColor &color) {
+        Entry &entry = mEntries[index];
+        if ((entry.mGeometry.mType == InGameMapGeometry::Type::Point) != points)
+            return;
+        QColor brushColor = color;
+        brushColor.setAlpha(50);
+        pen.setColor(color);
+        painter->setPen(pen);
+        if (entry.mGeometry.mType == InGameMapGeometry::Type::LineString)
+            painter->setBrush(Qt::NoBrush);
+        else
+            painter->setBrush(brushColor);
+        painter->drawPath(path(entry, level));
+    };
+
+    for (int pass = 0; pass < 2; pass++) {
+        const bool points = (pass == 0);
+        if (!points)
+            painter->translate(0, -1);
+        for (int index : qAsConst(indices)) {
+            if (index != mHoverIndex)
+                drawInColor(points, index, Qt::darkBlue);
+        }
+        if (indices.contains(mHoverIndex))
+            drawInColor(points, mHoverIndex, Qt::blue);
+    }
+}
+
+void InGameMapFeaturesItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event)
+{
+    int hoverIndex = mAdjacent ? -1 : entryAt(event->pos(), nullptr);
+    if (hoverIndex == mHoverIndex)
+        return;
+    if (mHoverIndex != -1)
+        update(mEntries[mHoverIndex].mBounds);
+    mHoverIndex = hoverIndex;
+    if (mHoverIndex != -1)
+        update(mEntries[mHoverIndex].mBounds);
+}
+
+void InGameMapFeaturesItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event)
+{
+    Q_UNUSED(event)
+    if (mHoverIndex != -1) {
+        update(mEntries[mHoverIndex].mBounds);
+        mHoverIndex = -1;
+    }
+}
+
+void InGameMapFeaturesItem::setAdjacent(bool adjacent)
+{
+    mAdjacent = adjacent;
+    setAcceptHoverEvents(!adjacent);
+}
+
+void InGameMapFeaturesItem::synchWithCell()
+{
+    mStore.clear();
+    mEntries.clear();
+    mHoverIndex = -1;
+    for (InGameMapFeature *feature : mCell->inGameMap().features())
+        mEntries += makeEntry(feature);
+    updateBoundingRect();
+    update();
+}
+
+void InGameMapFeaturesItem::featureAdded(int index)
+{
+    InGameMapFeature *feature = mCell->inGameMap().features().at(index);
+    mEntries.insert(index, makeEntry(feature));
+    mHoverIndex = -1;
+    updateBoundingRect();
+    update(mEntries[index].mBounds);
+}
+
+void InGameMapFeaturesItem::featureAboutToBeRemoved(int index)
+{
+    const Entry &entry = mEntries[index];
+    update(entry.mBounds);
+    mStore.release(entry.mGeometry);
+    mEntries.remove(index);
+    mHoverIndex = -1;
+    updateBoundingRect();
+    if (mStore.needsCompacting())
+        compact();
+}
+
+void InGameMapFeaturesItem::featureChanged(int index)
+{
+    Entry &entry = mEntries[index];
+    update(entry.mBounds);
+    mStore.release(entry.mGeometry);
+    Entry changed = makeEntry(entry.mFeature);
+    changed.mVisible = entry.mVisible;
+    changed.mHasItem = entry.mHasItem;
+    entry = changed;
+    update(entry.mBounds);
+    updateBoundingRect();
+    if (mStore.needsCompacting())
+        compact();
+}
+
+void InGameMapFeaturesItem::setFeatureVisible(InGameMapFeature *feature, bool visible)
+{
+    int index = indexOf(feature);
+    if (index == -1 || mEntries[index].mVisible == visible)
+        return;
+    mEntries[index].mVisible = visible;
+    update(mEntries[index].mBounds);
+}
+
+bool InGameMapFeaturesItem::isFeatureVisible(InGameMapFeature *feature) const
+{
+    int index = indexOf(feature);
+    return (index != -1) && mEntries[index].mVisible;
+}
+
+void InGameMapFeaturesItem::setFeatureHasItem(InGameMapFeature *feature, bool hasItem)
+{
+    int index = indexOf(feature);
+    if (index == -1 || mEntries[index].mHasItem == hasItem)
+        return;
+    mEntries[index].mHasItem = hasItem;
+    update(mEntries[index].mBounds);
+}
+
+InGameMapFeature *InGameMapFeaturesItem::featureAt(const QPointF &pos, int *coordIndex)
+{
+    int index = entryAt(pos, coordIndex);
+    return (index == -1) ? nullptr : mEntries[index].mFeature;
+}
+
+InGameMapFeaturesItem::Entry InGameMapFeaturesItem::makeEntry(InGameMapFeature *feature)
+{
+    Entry entry;
+    entry.mFeature = feature;
+    entry.mGeometry = mStore.append(feature->mGeometry);
+
+    if (entry.mGeometry.mType == InGameMapGeometry::Type::Point) {
+        if (mStore.ringSize(entry.mGeometry, 0) > 0) {
+            QPointF center = ringPolygon(entry, 0).first();
+            entry.mBounds = QRectF(center.x() - 10, center.y() - 10, 20, 20).adjusted(-1, -1, 1, 1);
+        }
+        return entry;
+    }
+
+    QRectF bounds;
+    for (int ring = 0; ring < ringsToDraw(entry); ring++)
+        bounds |= ringPolygon(entry, ring).boundingRect();
+    if (!bounds.isNull())
+        entry.mBounds = bounds.adjusted(-2, -3, 2, 2);
+    return entry;
+}
+
+int InGameMapFeaturesItem::indexOf(InGameMapFeature *feature) const
+{
+    for (int i = 0; i < mEntries.size(); i++) {
+        if (mEntries[i].mFeature == feature)
+            return i;
+    }
+    return -1;
+}
+
+QPolygonF InGameMapFeaturesItem::ringPolygon(const Entry &entry, int ring) const
+{
+    const int size = mStore.ringSize(entry.mGeometry, ring);
+    const QPoint *points = mStore.ringPoints(entry.mGeometry, ring);
+    QPolygonF polygon(size);
+    for (int i = 0; i < size; i++)
+        polygon[i] = mRenderer->tileToPixelCoords(points[i].x(), points[i].y());
+    return polygon;
+}
+
+// Polygons are an outline and its holes, the rest use the first
+// coordinates only.
+int InGameMapFeaturesItem::ringsToDraw(const Entry &entry) const
+{
+    if (entry.mGeometry.mType == InGameMapGeometry::Type::Polygon)
+        return entry.mGeometry.mRingCount;
+    return qMin(entry.mGeometry.mRingCount, 1);
+}
+
+const QPainterPath &InGameMapFeaturesItem::path(Entry &entry, int level)
+{
+    if (!(entry.mPathsValid & (1 << level))) {
+        entry.mPaths[level] = createPath(entry, level);
+        entry.mPathsValid |= (1 << level);
+    }
+    return entry.mPaths[level];
+}
+
+QPainterPath InGameMapFeaturesItem::createPath(const Entry &entry, int level) const
+{
+    QPainterPath path;
+
+    switch (entry.mGeometry.mType) {
+    case InGameMapGeometry::Type::INVALID:
+        break;
+    case InGameMapGeometry::Type::Point:
+        if (mStore.ringSize(entry.mGeometry, 0) > 0)
+            path.addEllipse(ringPolygon(entry, 0).first(), 10, 10);
+        break;
+    case InGameMapGeometry::Type::LineString:
+        if (entry.mGeometry.mRingCount > 0) {
+            QPolygonF polygon = simplified(ringPolygon(entry, 0), LOD_TOLERANCE[level]);
+            if (polygon.size() >= 2) {
+                path.moveTo(polygon.first());
+                for (int i = 1; i < polygon.size(); i++)
+                    path.lineTo(polygon[i]);
+            }
+        }
+        break;
+    case InGameMapGeometry::Type::Polygon:
+        // Holes are left unfilled by the fill rule.
+        path.setFillRule(Qt::OddEvenFill);
+        for (int ring = 0; ring < entry.mGeometry.mRingCount; ring++) {
+            QPolygonF polygon = simplified(ringPolygon(entry, ring), LOD_TOLERANCE[level]);
+            if (polygon.size() < 3) {
+                if (ring == 0)
+                    break; // too small to draw at this level
+                continue;
+            }
+            path.addPolygon(polygon);
+            path.closeSubpath();
+        }
+        break;
+    }
+
+    return path;
+}
+
+// Writes out every feature's geometry again, without the garbage left by
+// changed and removed features.  The cached paths are still valid.
+void InGameMapFeaturesItem::compact()
+{
+    mStore.clear();
+    for (Entry &entry : mEntries)
+        entry.mGeometry = mStore.append(entry.mFeature->mGeometry);
+}
+
+void InGameMapFeaturesItem::updateBoundingRect()
+{
+    QRectF bounds;
+    for (const Entry &entry : qAsConst(mEntries))
+        bounds |= entry.mBounds;
+    if (bounds != mBoundingRect) {
+        prepareGeometryChange();
+        mBoundingRect = bounds;
+    }
+    mMarks.fill(0, mEntries.size());
+    mMark = 0;
+    mIndexDirty = true;
+}
+
+void InGameMapFeaturesItem::updateIndex()
+{
+    if (!mIndexDirty)
+        return;
+    mIndexDirty = false;
+
+    mBuckets.clear();
+    mIndexBounds = mBoundingRect;
+    if (mIndexBounds.isEmpty()) {
+        mColumns = mRows = 0;
+        return;
+    }
+    mColumns = qBound(1, qCeil(mIndexBounds.width() / BUCKET_SIZE), MAX_BUCKETS);
+    mRows = qBound(1, qCeil(mIndexBounds.height() / BUCKET_SIZE), MAX_BUCKETS);
+    mBucketSize = QSizeF(mIndexBounds.width() / mColumns, mIndexBounds.height() / mRows);
+    mBuckets.resize(mColumns * mRows);
+
+    for (int i = 0; i < mEntries.size(); i++) {
+        const QRectF &bounds = mEntries[i].mBounds;
+        if (bounds.isEmpty())
+            continue;
+        QRect range = bucketRange(bounds);
+        for (int y = range.top(); y <= range.bottom(); y++) {
+            for (int x = range.left(); x <= range.right(); x++)
+                mBuckets[x + y * mColumns] += i;
+        }
+    }
+}
+
+QRect InGameMapFeaturesItem::bucketRange(const QRectF &rect) const
+{
+    QPointF topLeft = rect.topLeft() - mIndexBounds.topLeft();
+    QPointF bottomRight = rect.bottomRight() - mIndexBounds.topLeft();
+    int x1 = qBound(0, qFloor(topLeft.x() / mBucketSize.width()), mColumns - 1);
+    int y1 = qBound(0, qFloor(topLeft.y() / mBucketSize.height()), mRows - 1);
+    int x2 = qBound(0, qFloor(bottomRight.x() / mBucketSize.width()), mColumns - 1);
+    int y2 = qBound(0, qFloor(bottomRight.y() / mBucketSize.height()), mRows - 1);
+    return QRect(QPoint(x1, y1), QPoint(x2, y2));
+}
+
+// Returns the entries whose bounds intersect rect, in drawing order.
+QVector<int> InGameMapFeaturesItem::entriesIn(const QRectF &rect)
+{
+    updateIndex();
+
+    QVector<int> result;
+    if (mBuckets.isEmpty() || !rect.intersects(mIndexBounds))
+        return result;
+
+    if (++mMark == 0) {
+        mMarks.fill(0);
+        mMark = 1;
+    }
+
+    QRect range = bucketRange(rect);
+    for (int y = range.top(); y <= range.bottom(); y++) {
+        for (int x = range.left(); x <= range.right(); x++) {
+            for (int index : mBuckets[x + y * mColumns]) {
+                if (mMarks[index] == mMark)
+                    continue;
+                mMarks[index] = mMark;
+                if (mEntries[index].mBounds.intersects(rect))
+                    result += index;
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Like InGameMapFeatureItem::shape() a feature is hit near its outline, not
+// inside it.
+int InGameMapFeaturesItem::entryAt(const QPointF &pos, int *coordIndex)
+{
+    const float maxDist = 10 / float(viewZoom());
+    const QRectF rect(pos.x() - maxDist, pos.y() - maxDist, maxDist * 2, maxDist * 2);
+    const QVector2D p(pos);
+
+    int closest = -1, closestRing = -1;
+    float closestDist = maxDist;
+    for (int index : entriesIn(rect)) {
+        const Entry &entry = mEntries[index];
+        if (!entry.mVisible || entry.mHasItem)
+            continue;
+        switch (entry.mGeometry.mType) {
+        case InGameMapGeometry::Type::INVALID:
+            break;
+        case InGameMapGeometry::Type::Point:
+            if (entry.mBounds.contains(pos)) {
+                closest = index;
+                closestRing = 0;
+                closestDist = 0;
+            }
+            break;
+        case InGameMapGeometry::Type::LineString:
+        case InGameMapGeometry::Type::Polygon: {
+            const bool closed = entry.mGeometry.mType == InGameMapGeometry::Type::Polygon;
+            for (int ring = 0; ring < ringsToDraw(entry); ring++) {
+                QPolygonF polygon = ringPolygon(entry, ring);
+                const int segments = closed ? polygon.size() : polygon.size() - 1;
+                for (int i = 0; i < segments; i++) {
+                    QVector2D p1(polygon[i]);
+                    QVector2D p2(polygon[(i + 1) % polygon.size()]);
+                    float d = qSqrt(qAbs(distanceOfPointToLineSegment(p1, p2, p)));
+                    if (d < closestDist) {
+                        closest = index;
+                        closestRing = ring;
+                        closestDist = d;
+                    }
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    if (coordIndex)
+        *coordIndex = closestRing;
+    return closest;
+}
+
+qreal InGameMapFeaturesItem::viewZoom() const
+{
+    if (!scene() || scene()->views().isEmpty())
+        return 1.0;
+    auto view = static_cast<CellView*>(scene()->views().first());
+    return qMin(view->zoomable()->scale(), 1.0);
+}
+
+/////
+
 SINGLETON_IMPL(CreateInGameMapPointTool)
 SINGLETON_IMPL(CreateInGameMapPolygonTool)
 SINGLETON_IMPL(CreateInGameMapPolylineTool)
@@ -691,8 +1223,8 @@ void CreateInGameMapFeatureTool::mousePressEvent(QGraphicsSceneMouseEvent *event
                 InGameMapFeature* feature = new InGameMapFeature(&mScene->cell()->inGameMap());
                 InGameMapCoordinates coords;
                 for (QPointF& point : mPolygon)
-                    coords += InGameMapPoint(point.x(), point.y());
-                feature->mGeometry.mType = QLatin1String("Polygon");
+                    coords += InGameMapPoint(qRound(point.x()), qRound(point.y()));
+                feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
                 feature->mGeometry.mCoordinates += coords;
                 mScene->worldDocument()->addInGameMapFeature(mScene->cell(), mScene->cell()->inGameMap().mFeatures.size(), feature);
             }
@@ -702,8 +1234,8 @@ void CreateInGameMapFeatureTool::mousePressEvent(QGraphicsSceneMouseEvent *event
                 InGameMapFeature* feature = new InGameMapFeature(&mScene->cell()->inGameMap());
                 InGameMapCoordinates coords;
                 for (QPointF& point : mPolygon)
-                    coords += InGameMapPoint(point.x(), point.y());
-                feature->mGeometry.mType = QLatin1String("LineString");
+                    coords += InGameMapPoint(qRound(point.x()), qRound(point.y()));
+                feature->mGeometry.mType = InGameMapGeometry::Type::LineString;
                 feature->mGeometry.mCoordinates += coords;
                 mScene->worldDocument()->addInGameMapFeature(mScene->cell(), mScene->cell()->inGameMap().mFeatures.size(), feature);
             }
@@ -813,8 +1345,8 @@ void CreateInGameMapFeatureTool::addPoint(const QPointF &scenePos)
         InGameMapFeature* feature = new InGameMapFeature(&mScene->cell()->inGameMap());
         QPointF cellPos = mScene->renderer()->pixelToTileCoordsNearest(scenePos);
         InGameMapCoordinates coords;
-        coords += InGameMapPoint(cellPos.x(), cellPos.y());
-        feature->mGeometry.mType = QLatin1String("Point");
+        coords += InGameMapPoint(qRound(cellPos.x()), qRound(cellPos.y()));
+        feature->mGeometry.mType = InGameMapGeometry::Type::Point;
         feature->mGeometry.mCoordinates += coords;
         mScene->worldDocument()->addInGameMapFeature(mScene->cell(), mScene->cell()->inGameMap().mFeatures.size(), feature);
         return;
@@ -832,7 +1364,7 @@ void CreateInGameMapFeatureTool::addPoint(const QPointF &scenePos)
             coords += InGameMapPoint(maxX, minY);
             coords += InGameMapPoint(maxX, maxY);
             coords += InGameMapPoint(minX, maxY);
-            feature->mGeometry.mType = QLatin1String("Polygon");
+            feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
             feature->mGeometry.mCoordinates += coords;
             mScene->worldDocument()->addInGameMapFeature(mScene->cell(), mScene->cell()->inGameMap().mFeatures.size(), feature);
             mPolygon.clear();
@@ -927,7 +1459,7 @@ void EditInGameMapFeatureTool::mousePressEvent(QGraphicsSceneMouseEvent *event)
         if ((clickedItem != nullptr) && (clickedItem == mSelectedFeatureItem) && (clickedItem->mSelectedCoordIndex == clickedItem->mHoverCoordIndex)) {
             if (mSelectedFeatureItem->mAddPointIndex != -1) {
                 QPointF tilePos = mScene->renderer()->pixelToTileCoordsNearest(mSelectedFeatureItem->mAddPointPos);
-                InGameMapPoint point(tilePos.x(), tilePos.y());
+                InGameMapPoint point(qRound(tilePos.x()), qRound(tilePos.y()));
                 int coordIndex = mSelectedFeatureItem->mHoverCoordIndex;
                 InGameMapCoordinates coords = mSelectedFeature->mGeometry.mCoordinates[coordIndex];
                 coords.insert(mSelectedFeatureItem->mAddPointIndex + 1, point);
@@ -936,7 +1468,18 @@ void EditInGameMapFeatureTool::mousePressEvent(QGraphicsSceneMouseEvent *event)
             return;
         }
         if (clickedItem == nullptr) {
-            mScene->setSelectedInGameMapFeatureItems(QSet<InGameMapFeatureItem*>());
+            // Only selected features have an InGameMapFeatureItem.  The
+            // CellScene creates one for the clicked feature.
+            int coordIndex;
+            InGameMapFeature* feature = mScene->inGameMapFeatureAt(event->scenePos(), &coordIndex);
+            QList<InGameMapFeature*> selection;
+            if (feature != nullptr)
+                selection += feature;
+            mScene->document()->setSelectedInGameMapFeatures(selection);
+            if (InGameMapFeatureItem* item = mScene->itemForInGameMapFeature(feature)) {
+                item->setSelectedCoordIndex(coordIndex);
+                setSelectedItem(item);
+            }
         } else {
             qDebug() << clickedItem->mHoverCoordIndex;
             clickedItem->mSelectedCoordIndex = clickedItem->mHoverCoordIndex;
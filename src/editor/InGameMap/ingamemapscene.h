@@ -20,13 +20,15 @@
 
 #include "scenetools.h"
 
+#include "ingamemapcell.h"
+
+#include <QPainterPath>
+#include <QVector>
+
 class CellScene;
+class WorldCell;
 class WorldDocument;
 
-class InGameMapCoordinates;
-class InGameMapFeature;
-class InGameMapPoint;
-
 namespace Tiled {
 class MapRenderer;
 }
@@ -113,6 +115,149 @@ protected:
     int mSelectedCoordIndex = -1; // 0=outer,  1,2,3,...=hole
 };
 
+/**
+  * The geometry of a cell's features packed into two arrays.  Feature rings
+  * are runs of mPoints; a feature with N rings owns N+1 entries in
+  * mRingStart, ring i being the points from mRingStart[first + i] up to
+  * mRingStart[first + i + 1].  Changed features are appended again and the
+  * old points become garbage until compact() is called.
+  */
+class InGameMapGeometryStore
+{
+public:
+    struct Feature
+    {
+        Feature()
+            : mType(InGameMapGeometry::Type::INVALID)
+            , mFirstRing(0)
+            , mRingCount(0)
+        {}
+
+        InGameMapGeometry::Type mType;
+        int mFirstRing;
+        int mRingCount;
+    };
+
+    InGameMapGeometryStore()
+        : mGarbage(0)
+    {}
+
+    void clear();
+    Feature append(const InGameMapGeometry &geometry);
+    void release(const Feature &feature);
+
+    int ringSize(const Feature &feature, int ring) const
+    { return mRingStart[feature.mFirstRing + ring + 1] - mRingStart[feature.mFirstRing + ring]; }
+
+    const QPoint *ringPoints(const Feature &feature, int ring) const
+    { return mPoints.constData() + mRingStart[feature.mFirstRing + ring]; }
+
+    bool needsCompacting() const
+    { return mGarbage > 1024 && mGarbage > mPoints.size() / 2; }
+
+    int pointCount() const
+    { return mPoints.size(); }
+
+private:
+    QVector<QPoint> mPoints;
+    QVector<int> mRingStart;
+    int mGarbage;
+};
+
+/**
+  * Draws every feature of one cell.  Feature outlines are cached as
+  * QPainterPaths, once per level of detail, the coarser levels simplified to
+  * within a screen pixel at the zoom they are used for.  Features are found
+  * for drawing and hit-testing through a grid of buckets over the item.
+  *
+  * Features that have an InGameMapFeatureItem (the selected ones) are left
+  * for that item to draw.
+  */
+class InGameMapFeaturesItem : public QGraphicsItem
+{
+public:
+    InGameMapFeaturesItem(WorldCell *cell, Tiled::MapRenderer *renderer, QGraphicsItem *parent = nullptr);
+
+    QRectF boundingRect() const override;
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *) override;
+
+    void hoverMoveEvent(QGraphicsSceneHoverEvent *event) override;
+    void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
+
+    void setAdjacent(bool adjacent);
+
+    void synchWithCell();
+    void featureAdded(int index);
+    void featureAboutToBeRemoved(int index);
+    void featureChanged(int index);
+
+    void setFeatureVisible(InGameMapFeature *feature, bool visible);
+    bool isFeatureVisible(InGameMapFeature *feature) const;
+
+    void setFeatureHasItem(InGameMapFeature *feature, bool hasItem);
+
+    /**
+      * Returns the feature whose outline is nearest \a pos, in item
+      * coordinates, and the index of that outline in \a coordIndex.
+      */
+    InGameMapFeature *featureAt(const QPointF &pos, int *coordIndex = nullptr);
+
+private:
+    enum { LOD_COUNT = 4 };
+
+    class Entry
+    {
+    public:
+        Entry()
+            : mFeature(nullptr)
+            , mVisible(true)
+            , mHasItem(false)
+            , mPathsValid(0)
+        {}
+
+        InGameMapFeature *mFeature;
+        InGameMapGeometryStore::Feature mGeometry;
+        QRectF mBounds; // including the pen
+        bool mVisible;
+        bool mHasItem;
+        quint8 mPathsValid; // bit per level of detail
+        QPainterPath mPaths[LOD_COUNT];
+    };
+
+    Entry makeEntry(InGameMapFeature *feature);
+    int indexOf(InGameMapFeature *feature) const;
+    QPolygonF ringPolygon(const Entry &entry, int ring) const;
+    int ringsToDraw(const Entry &entry) const;
+    const QPainterPath &path(Entry &entry, int level);
+    QPainterPath createPath(const Entry &entry, int level) const;
+    void compact();
+    void updateBoundingRect();
+
+    void updateIndex();
+    QRect bucketRange(const QRectF &rect) const;
+    QVector<int> entriesIn(const QRectF &rect);
+    int entryAt(const QPointF &pos, int *coordIndex);
+    qreal viewZoom() const;
+
+    WorldCell *mCell;
+    Tiled::MapRenderer *mRenderer;
+    InGameMapGeometryStore mStore;
+    QVector<Entry> mEntries;
+    QRectF mBoundingRect;
+    bool mAdjacent;
+    int mHoverIndex;
+
+    bool mIndexDirty;
+    QRectF mIndexBounds;
+    int mColumns;
+    int mRows;
+    QSizeF mBucketSize;
+    QVector<QVector<int>> mBuckets;
+    QVector<quint32> mMarks; // so entriesIn() returns entries in several buckets once
+    quint32 mMark;
+};
+
 class FeatureHandle;
 
 class BaseInGameMapFeatureTool : public BaseCellSceneTool
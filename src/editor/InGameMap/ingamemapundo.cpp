@@ -34,6 +34,11 @@ AddRemoveInGameMapFeature::~AddRemoveInGameMapFeature()
     delete mFeature;
 }
 
+qint64 AddRemoveInGameMapFeature::memoryUsage() const
+{
+    return mFeature ? UndoMemory::memoryUsage(mFeature) : 0;
+}
+
 void AddRemoveInGameMapFeature::addFeature()
 {
     mDocument->undoRedo().addInGameMapFeature(mCell, mIndex, mFeature);
@@ -128,13 +133,42 @@ SetInGameMapCoordinates::SetInGameMapCoordinates(WorldDocument *doc, WorldCell*
     , mCell(cell)
     , mFeatureIndex(featureIndex)
     , mCoordsIndex(coordsIndex)
-    , mCoords(coords)
+    , mHead(0)
+    , mTail(0)
 {
+    const InGameMapCoordinates &old = cell->inGameMap().mFeatures[featureIndex]->mGeometry.mCoordinates[coordsIndex];
+    int count = qMin(old.size(), coords.size());
+    while (mHead < count && old[mHead] == coords[mHead])
+        mHead++;
+    while (mTail < count - mHead && old[old.size() - 1 - mTail] == coords[coords.size() - 1 - mTail])
+        mTail++;
+
+    InGameMapCoordinates changed;
+    changed.reserve(coords.size() - mHead - mTail);
+    for (int i = mHead; i < coords.size() - mTail; i++)
+        changed += coords[i];
+    mCoords.setCoordinates(changed);
 }
 
 void SetInGameMapCoordinates::swap()
 {
-    mCoords = mDocument->undoRedo().setInGameMapCoordinates(mCell, mFeatureIndex, mCoordsIndex, mCoords);
+    const InGameMapCoordinates &current = mCell->inGameMap().mFeatures[mFeatureIndex]->mGeometry.mCoordinates[mCoordsIndex];
+    InGameMapCoordinates changed = mCoords.coordinates();
+
+    InGameMapCoordinates coords;
+    coords.reserve(mHead + changed.size() + mTail);
+    for (int i = 0; i < mHead; i++)
+        coords += current[i];
+    coords += changed;
+    for (int i = current.size() - mTail; i < current.size(); i++)
+        coords += current[i];
+
+    InGameMapCoordinates old = mDocument->undoRedo().setInGameMapCoordinates(mCell, mFeatureIndex, mCoordsIndex, coords);
+
+    changed.clear();
+    for (int i = mHead; i < old.size() - mTail; i++)
+        changed += old[i];
+    mCoords.setCoordinates(changed);
 }
 
 /////
@@ -151,12 +185,13 @@ AddRemoveInGameMapHole::AddRemoveInGameMapHole(WorldDocument *doc, WorldCell *ce
 
 void AddRemoveInGameMapHole::addHole()
 {
-    mDocument->undoRedo().addInGameMapHole(mCell, mFeatureIndex, mHoleIndex, mHole);
+    mDocument->undoRedo().addInGameMapHole(mCell, mFeatureIndex, mHoleIndex, mHole.coordinates());
+    mHole.setCoordinates(InGameMapCoordinates()); // removeHole() gets it back
 }
 
 void AddRemoveInGameMapHole::removeHole()
 {
-    mHole = mDocument->undoRedo().removeInGameMapHole(mCell, mFeatureIndex, mHoleIndex);
+    mHole.setCoordinates(mDocument->undoRedo().removeInGameMapHole(mCell, mFeatureIndex, mHoleIndex));
 }
 
 /////
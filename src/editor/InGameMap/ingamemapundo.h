@@ -19,6 +19,7 @@
 #define INGAMEMAPUNDO_H
 
 #include "ingamemapcell.h"
+#include "undomemory.h"
 
 #include <QCoreApplication>
 #include <QUndoCommand>
@@ -26,12 +27,14 @@
 class WorldCell;
 class WorldDocument;
 
-class AddRemoveInGameMapFeature : public QUndoCommand
+class AddRemoveInGameMapFeature : public QUndoCommand, public UndoCommandMemory
 {
 public:
     AddRemoveInGameMapFeature(WorldDocument *doc, WorldCell *cell, int index, InGameMapFeature* feature);
     ~AddRemoveInGameMapFeature();
 
+    qint64 memoryUsage() const override;
+
 protected:
     void addFeature();
     void removeFeature();
@@ -165,7 +168,12 @@ private:
     InGameMapProperties mProperties;
 };
 
-class SetInGameMapCoordinates : public QUndoCommand
+/**
+  * Only the points that differ between the old and new coordinates are kept.
+  * Moving one point or inserting a point into a long polygon stores a single
+  * point rather than two copies of the whole polygon.
+  */
+class SetInGameMapCoordinates : public QUndoCommand, public UndoCommandMemory
 {
 public:
     SetInGameMapCoordinates(WorldDocument *doc, WorldCell *cell, int featureIndex, int coordsIndex, const InGameMapCoordinates& coords);
@@ -173,6 +181,12 @@ public:
     void undo() override { swap(); }
     void redo() override { swap(); }
 
+    qint64 memoryUsage() const override
+    { return mCoords.memoryUsage(); }
+
+    void compress() override
+    { mCoords.compress(); }
+
 private:
     void swap();
 
@@ -180,14 +194,22 @@ private:
     WorldCell *mCell;
     int mFeatureIndex;
     int mCoordsIndex;
-    InGameMapCoordinates mCoords;
+    int mHead; // Number of points at the start that didn't change
+    int mTail; // Number of points at the end that didn't change
+    CompressedCoordinates mCoords; // The points between mHead and mTail
 };
 
-class AddRemoveInGameMapHole : public QUndoCommand
+class AddRemoveInGameMapHole : public QUndoCommand, public UndoCommandMemory
 {
 public:
     AddRemoveInGameMapHole(WorldDocument *doc, WorldCell *cell, int featureIndex, int holeIndex, const InGameMapCoordinates &hole);
 
+    qint64 memoryUsage() const override
+    { return mHole.memoryUsage(); }
+
+    void compress() override
+    { mHole.compress(); }
+
 protected:
     void addHole();
     void removeHole();
@@ -196,7 +218,7 @@ protected:
     WorldCell *mCell;
     int mFeatureIndex;
     int mHoleIndex;
-    InGameMapCoordinates mHole;
+    CompressedCoordinates mHole;
 };
 
 class AddInGameMapHole : public AddRemoveInGameMapHole
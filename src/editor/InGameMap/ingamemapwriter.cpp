@@ -102,7 +102,7 @@ public:
         w.writeStartElement(QLatin1String("feature"));
 
         w.writeStartElement(QLatin1String("geometry"));
-        w.writeAttribute(QLatin1String("type"), feature->mGeometry.mType);
+        w.writeAttribute(QLatin1String("type"), feature->mGeometry.typeName());
         for (auto& coords : feature->mGeometry.mCoordinates) {
             w.writeStartElement(QLatin1String("coordinates"));
             for (auto& point : coords) {
@@ -17,20 +17,24 @@
 
 #include "ingamemapwriterbinary.h"
 
+#include "ingamemapbinary.h"
+
 #include "world.h"
 #include "worldcell.h"
 
+#include "compression.h"
+
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QMap>
 #include <QTemporaryFile>
 #include <QXmlStreamWriter>
 
-#define VERSION1 1
-#define VERSION_LATEST 1
+using namespace InGameMapBinary;
 
 class InGameMapWriterBinaryPrivate
 {
@@ -39,6 +43,8 @@ class InGameMapWriterBinaryPrivate
 public:
     InGameMapWriterBinaryPrivate()
         : mWorld(nullptr)
+        , mVersion(IGMB_VERSION1)
+        , mCompressCells(false)
     {
     }
 
@@ -67,11 +73,16 @@ public:
     {
         w << quint8('I') << quint8('G') << quint8('M') << quint8('B');
 
-        w << qint32(VERSION_LATEST);
+        w << qint32(mVersion);
 
         w << qint32(world->width());
         w << qint32(world->height());
 
+        if (mVersion == IGMB_VERSION2) {
+            writeWorldV2(w, world);
+            return;
+        }
+
         writeStringTable(w, world);
 
         for (int y = 0; y < world->height(); y++) {
@@ -98,7 +109,7 @@ public:
             for (int x = 0; x < world->width(); x++) {
                 WorldCell *cell = world->cellAt(x, y);
                 for (auto* feature : qAsConst(cell->inGameMap().mFeatures)) {
-                    addString(feature->mGeometry.mType);
+                    addString(feature->mGeometry.typeName());
                     for (auto& property : feature->mProperties) {
                         addString(property.mKey);
                         addString(property.mValue);
@@ -133,7 +144,7 @@ public:
 
     void writeFeature(QDataStream &w, InGameMapFeature* feature)
     {
-        SaveStringIndex(w, feature->mGeometry.mType);
+        SaveStringIndex(w, feature->mGeometry.typeName());
         
             w << qint8(feature->mGeometry.mCoordinates.size());
             for (auto& coords : feature->mGeometry.mCoordinates) {
@@ -153,6 +164,101 @@ public:
         
     }
 
+    void writeWorldV2(QDataStream &w, World *world)
+    {
+        w << qint32(mCompressCells ? IGMB_FLAG_ZLIB : 0);
+
+        writeStringTable(w, world);
+        writePropertyDictionary(w, world);
+
+        // Each cell is encoded separately so that the index of offsets can be
+        // written before the cell data.
+        QVector<QByteArray> blocks(world->width() * world->height());
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                WorldCell *cell = world->cellAt(x, y);
+                if (cell->inGameMap().features().isEmpty())
+                    continue;
+                QByteArray &block = blocks[x + y * world->width()];
+                writeCellV2(block, cell);
+                if (mCompressCells)
+                    block = Tiled::compress(block, Tiled::Zlib);
+            }
+        }
+
+        quint32 offset = 0;
+        for (const QByteArray &block : qAsConst(blocks)) {
+            w << offset << quint32(block.size());
+            offset += block.size();
+        }
+        for (const QByteArray &block : qAsConst(blocks)) {
+            w.writeRawData(block.constData(), block.size());
+        }
+    }
+
+    // Features share a small number of distinct property lists.
+    void writePropertyDictionary(QDataStream &w, World *world)
+    {
+        QList<QByteArray> entries;
+
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                WorldCell *cell = world->cellAt(x, y);
+                for (auto* feature : qAsConst(cell->inGameMap().mFeatures)) {
+                    QByteArray entry;
+                    writeVarint(entry, feature->mProperties.size());
+                    for (auto& property : feature->mProperties) {
+                        writeVarint(entry, mStringTable[property.mKey]);
+                        writeVarint(entry, mStringTable[property.mValue]);
+                    }
+                    if (mPropertyDictionary.contains(entry))
+                        continue;
+                    mPropertyDictionary.insert(entry, entries.size());
+                    entries += entry;
+                }
+            }
+        }
+
+        const QByteArray data = entries.join();
+        w << qint32(entries.size());
+        w << qint32(data.size());
+        w.writeRawData(data.constData(), data.size());
+    }
+
+    void writeCellV2(QByteArray &out, WorldCell *cell)
+    {
+        const QPoint worldOrigin = cell->world()->getGenerateLotsSettings().worldOrigin;
+        writeVarint(out, zigzag(worldOrigin.x() + cell->x()));
+        writeVarint(out, zigzag(worldOrigin.y() + cell->y()));
+
+        writeVarint(out, cell->inGameMap().mFeatures.size());
+
+        for (auto* feature : qAsConst(cell->inGameMap().mFeatures)) {
+            writeVarint(out, mStringTable[feature->mGeometry.typeName()]);
+
+            QByteArray entry;
+            writeVarint(entry, feature->mProperties.size());
+            for (auto& property : feature->mProperties) {
+                writeVarint(entry, mStringTable[property.mKey]);
+                writeVarint(entry, mStringTable[property.mValue]);
+            }
+            writeVarint(out, mPropertyDictionary[entry]);
+
+            // Each point is stored relative to the previous one.
+            int prevX = 0, prevY = 0;
+            writeVarint(out, feature->mGeometry.mCoordinates.size());
+            for (auto& coords : feature->mGeometry.mCoordinates) {
+                writeVarint(out, coords.size());
+                for (auto& point : coords) {
+                    writeVarint(out, zigzag(int(point.x) - prevX));
+                    writeVarint(out, zigzag(int(point.y) - prevY));
+                    prevX = int(point.x);
+                    prevY = int(point.y);
+                }
+            }
+        }
+    }
+
     void SaveString(QDataStream& w, const QString& str)
     {
         QByteArray utf8 = str.toUtf8();
@@ -171,6 +277,9 @@ public:
     QString mError;
     QDir mMapDir;
     QMap<QString, int> mStringTable;
+    QHash<QByteArray, int> mPropertyDictionary;
+    int mVersion;
+    bool mCompressCells;
 };
 
 /////
@@ -185,6 +294,22 @@ InGameMapWriterBinary::~InGameMapWriterBinary()
     delete d;
 }
 
+void InGameMapWriterBinary::setVersion(int version)
+{
+    Q_ASSERT(version == IGMB_VERSION1 || version == IGMB_VERSION2);
+    d->mVersion = version;
+}
+
+int InGameMapWriterBinary::version() const
+{
+    return d->mVersion;
+}
+
+void InGameMapWriterBinary::setCompressCells(bool compress)
+{
+    d->mCompressCells = compress;
+}
+
 bool InGameMapWriterBinary::writeWorld(World *world, const QString &filePath)
 {
     QTemporaryFile tempFile;
@@ -31,6 +31,19 @@ public:
     InGameMapWriterBinary();
     ~InGameMapWriterBinary();
 
+    /**
+      * Version 1 is what the game reads.  Version 2 adds an index of cell
+      * offsets, delta-encoded points and a dictionary of property lists, and
+      * can be read one cell at a time with InGameMapReaderBinary.
+      */
+    void setVersion(int version);
+    int version() const;
+
+    /**
+      * Version 2 only: compress each cell's data with zlib.
+      */
+    void setCompressCells(bool compress);
+
     bool writeWorld(World *world, const QString &filePath);
     void writeWorld(World *world, QIODevice *device, const QString &absDirPath);
 
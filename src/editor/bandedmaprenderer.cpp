@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bandedmaprenderer.h"
+
+#include "mapcomposite.h"
+
+#include "maprenderer.h"
+#include "tilelayer.h"
+#include "ztilelayergroup.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace Tiled;
+
+namespace {
+
+/**
+  * The ordered cells of every square of a CompositeLayerGroup, gathered
+  * once so any number of threads can draw them.
+  */
+class LayerGroupSnapshot : public ZTileLayerGroup
+{
+public:
+    LayerGroupSnapshot(CompositeLayerGroup *layerGroup, const MapRenderer *renderer) :
+        ZTileLayerGroup(layerGroup->mMap, layerGroup->level()),
+        mBounds(layerGroup->bounds()),
+        mDrawMargins(layerGroup->drawMargins()),
+        mBoundingRect(layerGroup->boundingRect(renderer))
+    {
+        if (mBounds.isEmpty())
+            return;
+
+        layerGroup->prepareDrawing(renderer, mBoundingRect.toAlignedRect());
+
+        // Like the renderers, only the cells are cleared between squares.
+        QVector<const Cell*> cells(40);
+        QVector<qreal> opacities(40);
+        mFirst.reserve(mBounds.width() * mBounds.height() + 1);
+        for (int y = mBounds.top(); y <= mBounds.bottom(); y++) {
+            for (int x = mBounds.left(); x <= mBounds.right(); x++) {
+                mFirst += mCells.size();
+                cells.resize(0);
+                if (!layerGroup->orderedCellsAt(QPoint(x, y), cells, opacities))
+                    continue;
+                for (int i = 0; i < cells.size(); i++) {
+                    mCells += *cells[i];
+                    mOpacities += opacities.value(i, 1.0);
+                }
+            }
+        }
+        mFirst += mCells.size();
+    }
+
+    QRect bounds() const override
+    { return mBounds; }
+
+    QMargins drawMargins() const override
+    { return mDrawMargins; }
+
+    QRectF boundingRect(const MapRenderer *renderer) const override
+    { Q_UNUSED(renderer) return mBoundingRect; }
+
+    void prepareDrawing(const MapRenderer *renderer, const QRect &rect) override
+    { Q_UNUSED(renderer) Q_UNUSED(rect) }
+
+    bool orderedCellsAt(const QPoint &point, QVector<const Cell*> &cells,
+                        QVector<qreal> &opacities) const override
+    {
+        if (!mBounds.contains(point))
+            return false;
+        const int index = (point.x() - mBounds.x()) + (point.y() - mBounds.y()) * mBounds.width();
+        const int first = mFirst[index];
+        const int count = mFirst[index + 1] - first;
+        if (count == 0)
+            return false;
+        opacities.resize(count);
+        for (int i = 0; i < count; i++) {
+            cells += &mCells[first + i];
+            opacities[i] = mOpacities[first + i];
+        }
+        return true;
+    }
+
+private:
+    QRect mBounds;
+    QMargins mDrawMargins;
+    QRectF mBoundingRect;
+    QVector<int> mFirst; // Index into mCells for each square, plus one past the end
+    QVector<Cell> mCells;
+    QVector<qreal> mOpacities;
+};
+
+struct DrawItem
+{
+    DrawItem() : mGroup(nullptr), mLayer(nullptr) {}
+    ZTileLayerGroup *mGroup;
+    const TileLayer *mLayer;
+};
+
+class BandTask : public QRunnable
+{
+public:
+    BandTask(const MapRenderer *renderer, const QVector<DrawItem> &items,
+             uchar *bits, const QSize &size, int bytesPerLine, QImage::Format format,
+             const QTransform &transform, QPainter::RenderHints hints) :
+        mRenderer(renderer),
+        mItems(items),
+        mBits(bits),
+        mSize(size),
+        mBytesPerLine(bytesPerLine),
+        mFormat(format),
+        mTransform(transform),
+        mHints(hints)
+    {
+    }
+
+    void run() override
+    {
+        QImage band(mBits, mSize.width(), mSize.height(), mBytesPerLine, mFormat);
+        QPainter painter(&band);
+        painter.setRenderHints(mHints);
+        painter.setTransform(mTransform);
+        const QRectF exposed = mTransform.inverted().mapRect(QRectF(QPointF(), QSizeF(mSize)));
+        foreach (const DrawItem &item, mItems) {
+            if (item.mGroup)
+                mRenderer->drawTileLayerGroup(&painter, item.mGroup, exposed);
+            else
+                mRenderer->drawTileLayer(&painter, item.mLayer, exposed);
+            if (mRenderer->mAbortDrawing && *mRenderer->mAbortDrawing)
+                break;
+        }
+    }
+
+private:
+    const MapRenderer *mRenderer;
+    QVector<DrawItem> mItems;
+    uchar *mBits;
+    QSize mSize;
+    int mBytesPerLine;
+    QImage::Format mFormat;
+    QTransform mTransform;
+    QPainter::RenderHints mHints;
+};
+
+} // namespace
+
+BandedMapRenderer::BandedMapRenderer(MapComposite *mapComposite, MapRenderer *renderer) :
+    mMapComposite(mapComposite),
+    mRenderer(renderer),
+    mThreadCount(QThread::idealThreadCount()),
+    mRenderHints(QPainter::SmoothPixmapTransform)
+{
+}
+
+void BandedMapRenderer::setThreadCount(int count)
+{
+    mThreadCount = (count > 0) ? count : QThread::idealThreadCount();
+}
+
+bool BandedMapRenderer::render(QImage &image, const QTransform &transform)
+{
+    if (image.isNull())
+        return true;
+
+    QList<LayerGroupSnapshot*> snapshots;
+    QVector<DrawItem> items;
+    foreach (MapComposite::ZOrderItem zo, mMapComposite->zOrder()) {
+        DrawItem item;
+        if (zo.group) {
+            snapshots += new LayerGroupSnapshot(zo.group, mRenderer);
+            item.mGroup = snapshots.last();
+        } else if (TileLayer *tl = zo.layer->asTileLayer()) {
+            if (mLayerFilter && !mLayerFilter(tl))
+                continue;
+            item.mLayer = tl;
+        } else {
+            continue;
+        }
+        items += item;
+    }
+
+    // Twice as many bands as threads, since some bands have more tiles.
+    const int bandCount = qBound(1, mThreadCount * 2, qMax(1, image.height() / 32));
+    const int bandHeight = (image.height() + bandCount - 1) / bandCount;
+
+    uchar *bits = image.bits(); // detach before the threads start
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(mThreadCount);
+    for (int top = 0; top < image.height(); top += bandHeight) {
+        const QSize size(image.width(), qMin(bandHeight, image.height() - top));
+        threadPool.start(new BandTask(mRenderer, items,
+                                      bits + qint64(top) * image.bytesPerLine(),
+                                      size, image.bytesPerLine(), image.format(),
+                                      transform * QTransform::fromTranslate(0, -top),
+                                      mRenderHints));
+    }
+    threadPool.waitForDone();
+
+    qDeleteAll(snapshots);
+
+    return !(mRenderer->mAbortDrawing && *mRenderer->mAbortDrawing);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BANDEDMAPRENDERER_H
+#define BANDEDMAPRENDERER_H
+
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#include <functional>
+
+class MapComposite;
+
+namespace Tiled {
+class MapRenderer;
+class TileLayer;
+}
+
+/**
+  * Draws a whole MapComposite into an image using several threads.
+  *
+  * The image is split into horizontal bands and each band is drawn by its
+  * own thread through a QImage that shares the band's rows.  Every band is
+  * drawn with the same transformation offset by a whole number of rows, and
+  * the renderer widens each band by the tile draw margins, so the result is
+  * the same as drawing the whole image with one QPainter.
+  *
+  * CompositeLayerGroup isn't safe to read from several threads, so the
+  * ordered cells of every level are copied into read-only snapshots first.
+  * The MapComposite must not change until render() returns.
+  */
+class BandedMapRenderer
+{
+public:
+    BandedMapRenderer(MapComposite *mapComposite, Tiled::MapRenderer *renderer);
+
+    /**
+      * Sets how many threads draw bands.  The default is
+      * QThread::idealThreadCount().
+      */
+    void setThreadCount(int count);
+    int threadCount() const { return mThreadCount; }
+
+    void setRenderHints(QPainter::RenderHints hints)
+    { mRenderHints = hints; }
+
+    /**
+      * Tile layers outside the layer groups are only drawn if \a filter
+      * returns true for them.
+      */
+    void setLayerFilter(const std::function<bool(const Tiled::TileLayer*)> &filter)
+    { mLayerFilter = filter; }
+
+    /**
+      * Draws every level and tile layer, in MapComposite::zOrder() order,
+      * into \a image.  \a transform maps scene coordinates to the image.
+      * Returns false if drawing was aborted through MapRenderer::mAbortDrawing.
+      */
+    bool render(QImage &image, const QTransform &transform);
+
+private:
+    MapComposite *mMapComposite;
+    Tiled::MapRenderer *mRenderer;
+    int mThreadCount;
+    QPainter::RenderHints mRenderHints;
+    std::function<bool(const Tiled::TileLayer*)> mLayerFilter;
+};
+
+#endif // BANDEDMAPRENDERER_H
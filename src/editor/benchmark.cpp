@@ -0,0 +1,2286 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include "bandedmaprenderer.h"
+#include "bmpblender.h"
+#include "bmptotmx.h"
+#include "lotfilesmanager.h"
+#include "lotinspector.h"
+#include "mapcomposite.h"
+#include "mapmanager.h"
+#include "preferences.h"
+#include "syntheticworld.h"
+#include "tilechunkcache.h"
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
+#include "tmxtobmp.h"
+#include "world.h"
+#include "worldcell.h"
+#include "worlddocument.h"
+#include "worldscene.h"
+#include "worldreader.h"
+#include "worldscript.h"
+#include "worldwriter.h"
+
+#include "navigation/chunkdatafile.h"
+
+#include "BuildingEditor/building.h"
+#include "BuildingEditor/buildingfloor.h"
+#include "BuildingEditor/buildingmap.h"
+#include "BuildingEditor/buildingmapcache.h"
+#include "BuildingEditor/buildingobjects.h"
+#include "BuildingEditor/buildingtemplates.h"
+#include "BuildingEditor/buildingtiles.h"
+#include "BuildingEditor/buildingtmx.h"
+
+#include "InGameMap/ingamemapcell.h"
+#include "InGameMap/ingamemapreaderbinary.h"
+#include "InGameMap/ingamemapscene.h"
+#include "InGameMap/ingamemapwriterbinary.h"
+
+#include "map.h"
+#include "mapcache.h"
+#include "mapobject.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "tilesetpixelcache.h"
+#include "zlevelrenderer.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QReadLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QtMath>
+
+#include <algorithm>
+#include <random>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+using namespace Tiled;
+using namespace BuildingEditor;
+
+namespace {
+
+/**
+  * Creates random buildings with rooms, doors, windows, stairs and user
+  * tiles.  Their tiles come from a blank tileset added to TileMetaInfoMgr,
+  * so no Tiles Directory is needed.
+  */
+class SyntheticBuildings
+{
+public:
+    SyntheticBuildings(quint32 seed);
+    ~SyntheticBuildings();
+
+    Building *create(int floorCount);
+
+    /**
+      * Makes one random change to \a floor, as the editor's tools would.
+      * Returns the squares LayoutToSquares() must be told about because it
+      * can't find the change itself.
+      */
+    QRect edit(BuildingFloor *floor);
+
+    int random(int min, int max)
+    { return std::uniform_int_distribution<int>(min, max)(mRandom); }
+
+private:
+    BuildingTileEntry *createEntry(BuildingTileCategory *category);
+    void addDoor(BuildingFloor *floor);
+    void addWindow(BuildingFloor *floor);
+    QString randomTileName();
+
+    std::mt19937 mRandom;
+    QList<BuildingTileEntry*> mEntries;
+    BuildingTileEntry *mExteriorWall;
+    BuildingTileEntry *mInteriorWall;
+    BuildingTileEntry *mFloor;
+    BuildingTileEntry *mDoor;
+    BuildingTileEntry *mDoor2;
+    BuildingTileEntry *mDoorFrame;
+    BuildingTileEntry *mWindow;
+    BuildingTileEntry *mCurtains;
+    BuildingTileEntry *mStairs;
+    BuildingTileEntry *mGrimeFloor;
+    BuildingTileEntry *mGrimeWall;
+};
+
+const char *BUILDING_TILESET_NAME = "benchmark_building";
+
+SyntheticBuildings::SyntheticBuildings(quint32 seed) :
+    mRandom(seed)
+{
+    // createEntryFromSingleTile() uses tiles up to 30 past the one given, so
+    // each entry gets 32 tiles.
+    QString tilesetName = QLatin1String(BUILDING_TILESET_NAME);
+    if (!TileMetaInfoMgr::instance()->tileset(tilesetName)) {
+        Tileset *ts = new Tileset(tilesetName, 64, 128);
+        ts->loadFromNothing(QSize(8 * 64, 48 * 128), QString());
+        TileMetaInfoMgr::instance()->addTileset(ts);
+    }
+
+    BuildingTilesMgr *btiles = BuildingTilesMgr::instance();
+    mExteriorWall = createEntry(btiles->catEWalls());
+    mInteriorWall = createEntry(btiles->catIWalls());
+    mFloor = createEntry(btiles->catFloors());
+    mDoor = createEntry(btiles->catDoors());
+    mDoor2 = createEntry(btiles->catDoors());
+    mDoorFrame = createEntry(btiles->catDoorFrames());
+    mWindow = createEntry(btiles->catWindows());
+    mCurtains = createEntry(btiles->catCurtains());
+    mStairs = createEntry(btiles->catStairs());
+    mGrimeFloor = createEntry(btiles->catGrimeFloor());
+    mGrimeWall = createEntry(btiles->catGrimeWall());
+}
+
+SyntheticBuildings::~SyntheticBuildings()
+{
+    qDeleteAll(mEntries);
+}
+
+BuildingTileEntry *SyntheticBuildings::createEntry(BuildingTileCategory *category)
+{
+    QString tileName = BuildingTilesMgr::nameForTile(QLatin1String(BUILDING_TILESET_NAME),
+                                                     mEntries.size() * 32);
+    BuildingTileEntry *entry = category->createEntryFromSingleTile(tileName);
+    mEntries += entry;
+    return entry;
+}
+
+Building *SyntheticBuildings::create(int floorCount)
+{
+    Building *building = new Building(random(6, 20), random(6, 20));
+    for (int n = 0; n < Building::TileCount; n++)
+        building->setTile(n, 0);
+    building->setTile(Building::ExteriorWall, mExteriorWall);
+    building->setTile(Building::Door, mDoor);
+    building->setTile(Building::DoorFrame, mDoorFrame);
+    building->setTile(Building::Window, mWindow);
+    building->setTile(Building::Curtains, mCurtains);
+    building->setTile(Building::Stairs, mStairs);
+    building->setTile(Building::GrimeWall, mGrimeWall);
+
+    for (int i = 0; i < 3; i++) {
+        Room *room = new Room();
+        room->Name = QString(QLatin1String("Room %1")).arg(i + 1);
+        room->internalName = QString(QLatin1String("room%1")).arg(i + 1);
+        room->Color = qRgb(random(0, 255), random(0, 255), random(0, 255));
+        room->setTile(Room::InteriorWall, mInteriorWall);
+        room->setTile(Room::InteriorWallTrim, 0);
+        room->setTile(Room::Floor, mFloor);
+        room->setTile(Room::GrimeFloor, mGrimeFloor);
+        room->setTile(Room::GrimeWall, mGrimeWall);
+        building->insertRoom(i, room);
+    }
+
+    int width = building->width(), height = building->height();
+    for (int level = 0; level < floorCount; level++) {
+        BuildingFloor *floor = new BuildingFloor(building, level);
+        building->insertFloor(level, floor);
+
+        foreach (Room *room, building->rooms()) {
+            int x1 = random(0, width - 2), y1 = random(0, height - 2);
+            int x2 = random(x1 + 1, width - 1), y2 = random(y1 + 1, height - 1);
+            for (int y = y1; y <= y2; y++)
+                for (int x = x1; x <= x2; x++)
+                    floor->SetRoomAt(x, y, room);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            addDoor(floor);
+            addWindow(floor);
+        }
+
+        if (level < floorCount - 1) {
+            Stairs *stairs = new Stairs(floor, random(0, width - 5), random(0, height - 1),
+                                        BuildingObject::W);
+            stairs->setTile(mStairs);
+            floor->insertObject(floor->objectCount(), stairs);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            floor->setGrime(i % 2 ? QLatin1String("Walls") : QLatin1String("Floor"),
+                            random(0, width - 1), random(0, height - 1), randomTileName());
+        }
+    }
+
+    return building;
+}
+
+QRect SyntheticBuildings::edit(BuildingFloor *floor)
+{
+    Building *building = floor->building();
+    const int width = floor->width(), height = floor->height();
+    const QList<BuildingObject*> &objects = floor->objects();
+
+    switch (random(0, 5)) {
+    case 0: {
+        // Paint a room, or erase one.
+        int index = random(-1, building->roomCount() - 1);
+        Room *room = (index >= 0) ? building->room(index) : 0;
+        int x1 = random(0, width - 1), y1 = random(0, height - 1);
+        int x2 = qMin(x1 + random(0, 3), width - 1), y2 = qMin(y1 + random(0, 3), height - 1);
+        for (int y = y1; y <= y2; y++)
+            for (int x = x1; x <= x2; x++)
+                floor->SetRoomAt(x, y, room);
+        break;
+    }
+    case 1:
+        if (random(0, 1))
+            addDoor(floor);
+        else
+            addWindow(floor);
+        break;
+    case 2:
+        if (!objects.isEmpty())
+            delete floor->removeObject(random(0, objects.size() - 1));
+        break;
+    case 3:
+        if (!objects.isEmpty()) {
+            BuildingObject *object = objects.at(random(0, objects.size() - 1));
+            int right = object->asStairs() ? width - 5 : width - 1;
+            object->setPos(random(0, right), random(0, height - 1));
+        }
+        break;
+    case 4:
+        // Changing an object's tiles doesn't change its bounds.
+        foreach (BuildingObject *object, objects) {
+            if (Door *door = object->asDoor()) {
+                door->setTile((door->tile() == mDoor) ? mDoor2 : mDoor);
+                return BuildingFloor::layoutBounds(door);
+            }
+        }
+        break;
+    case 5: {
+        // Neither does changing the user tiles.
+        int x = random(0, width - 1), y = random(0, height - 1);
+        floor->setGrime(QLatin1String("Walls"), x, y,
+                        random(0, 1) ? randomTileName() : QString());
+        return QRect(x, y, 1, 1);
+    }
+    }
+    return QRect();
+}
+
+void SyntheticBuildings::addDoor(BuildingFloor *floor)
+{
+    bool north = random(0, 1);
+    Door *door = new Door(floor, random(0, floor->width() - 1), random(0, floor->height() - 1),
+                          north ? BuildingObject::N : BuildingObject::W);
+    door->setTile(mDoor);
+    door->setTile(mDoorFrame, 1);
+    floor->insertObject(floor->objectCount(), door);
+}
+
+void SyntheticBuildings::addWindow(BuildingFloor *floor)
+{
+    bool north = random(0, 1);
+    Window *window = new Window(floor, random(0, floor->width() - 1), random(0, floor->height() - 1),
+                                north ? BuildingObject::N : BuildingObject::W);
+    window->setTile(mWindow);
+    window->setTile(mCurtains, Window::TileCurtains);
+    floor->insertObject(floor->objectCount(), window);
+}
+
+QString SyntheticBuildings::randomTileName()
+{
+    return BuildingTilesMgr::nameForTile(QLatin1String(BUILDING_TILESET_NAME),
+                                         random(0, 8 * 48 - 1));
+}
+
+} // namespace
+
+Benchmark::Benchmark() :
+    mSeed(1),
+    mWorldSize(4),
+    mIterations(5)
+{
+}
+
+bool Benchmark::parseArguments(const QStringList &args)
+{
+    int index = args.indexOf(QLatin1String("--benchmark"));
+    if (index == -1)
+        return false;
+
+    mDirectory = args.value(index + 1);
+    for (int i = 1; i < args.size() - 1; i++) {
+        const QString &arg = args[i];
+        const QString &value = args[i + 1];
+        if (arg == QLatin1String("--seed"))
+            mSeed = value.toUInt();
+        else if (arg == QLatin1String("--size"))
+            mWorldSize = qMax(1, value.toInt());
+        else if (arg == QLatin1String("--iterations"))
+            mIterations = qMax(1, value.toInt());
+        else if (arg == QLatin1String("--output"))
+            mOutputFile = value;
+        else if (arg == QLatin1String("--tiles"))
+            mTilesDirectory = value;
+    }
+    return true;
+}
+
+int Benchmark::run()
+{
+    QTextStream err(stderr);
+    if (mDirectory.isEmpty() || mDirectory.startsWith(QLatin1String("--"))) {
+        err << "Usage: PZWorldEd --benchmark <dir> [--seed <n>] [--size <cells>]"
+               " [--iterations <n>] [--tiles <dir>] [--output <file.json>]\n";
+        return 1;
+    }
+    mDirectory = QDir(mDirectory).absolutePath();
+    if (mOutputFile.isEmpty())
+        mOutputFile = QDir(mDirectory).filePath(QLatin1String("benchmark.json"));
+
+    SyntheticWorld world(mSeed);
+    world.setWorldSize(mWorldSize, mWorldSize);
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!world.generate(mDirectory)) {
+        err << world.errorString() << "\n";
+        return 1;
+    }
+    Result generate;
+    generate.name = QLatin1String("Generate synthetic world");
+    generate.items = world.cellMapFiles().size();
+    generate.nsecs += timer.nsecsElapsed();
+    mResults += generate;
+
+    bool ok = benchTMXRead(world) &&
+            benchTMXWrite(world) &&
+            benchMapCache(world) &&
+            benchMapComposite(world) &&
+            benchBuildingConversion() &&
+            benchBuildingLayout() &&
+            benchLotFiles(world) &&
+            benchBmpBlender(world) &&
+            benchBmpToTmx(world) &&
+            benchTMXToBMP(world) &&
+            benchWorldReadWrite(world) &&
+            benchWorldBinary(world) &&
+            benchWorldScene() &&
+            benchInGameMap(world) &&
+            benchInGameMapScene() &&
+            benchLuaScript(world) &&
+            benchTileGrid(world) &&
+            benchCellViewPan(world) &&
+            benchBandedRender(world) &&
+            benchTilesetLoad();
+    if (!ok) {
+        err << mError << "\n";
+        return 1;
+    }
+
+    if (!writeResults()) {
+        err << mError << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+bool Benchmark::benchTMXRead(const SyntheticWorld &world)
+{
+    return measure("TMX read", world.cellMapFiles().size(), [&]() {
+        foreach (const QString &fileName, world.cellMapFiles()) {
+            MapReader reader;
+            Map *map = reader.readMap(fileName);
+            if (!map) {
+                mError = reader.errorString();
+                return false;
+            }
+            qDeleteAll(map->tilesets());
+            delete map;
+        }
+        return true;
+    });
+}
+
+// Saves every cell map into memory with one thread and the default zlib
+// level, then with several threads, then with the fastest level.  The
+// output of each is read back and compared with the original map.
+bool Benchmark::benchTMXWrite(const SyntheticWorld &world)
+{
+    QList<Map*> maps;
+    foreach (const QString &fileName, world.cellMapFiles()) {
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            foreach (Map *map, maps) {
+                qDeleteAll(map->tilesets());
+                delete map;
+            }
+            return false;
+        }
+        maps += map;
+    }
+
+    struct Variant
+    {
+        const char *name;
+        int threadCount;
+        int compressionLevel;
+    };
+    const Variant variants[] = {
+        { "TMX write serial", 1, -1 },
+        { "TMX write parallel", 0, -1 },
+        { "TMX write parallel fast", 0, 1 }
+    };
+
+    bool ok = true;
+    for (const Variant &variant : variants) {
+        QList<QByteArray> output;
+        ok = measure(variant.name, maps.size(), [&]() {
+            output.clear();
+            foreach (Map *map, maps) {
+                QBuffer buffer;
+                buffer.open(QIODevice::WriteOnly);
+                MapWriter writer;
+                writer.setLayerDataFormat(MapWriter::Base64Gzip);
+                writer.setThreadCount(variant.threadCount);
+                writer.setCompressionLevel(variant.compressionLevel);
+                writer.writeMap(map, &buffer, QFileInfo(world.cellMapFiles().first()).absolutePath());
+                output += buffer.data();
+            }
+            return true;
+        });
+        if (!ok)
+            break;
+
+        qint64 bytes = 0;
+        for (int i = 0; ok && i < maps.size(); i++) {
+            bytes += output[i].size();
+            QBuffer buffer(&output[i]);
+            buffer.open(QIODevice::ReadOnly);
+            MapReader reader;
+            Map *map = reader.readMap(&buffer, QFileInfo(world.cellMapFiles()[i]).absolutePath());
+            if (!map) {
+                mError = reader.errorString();
+                ok = false;
+                break;
+            }
+            if (!sameTileLayers(maps[i], map)) {
+                mError = tr("%1 changed after saving and reading it again").arg(world.cellMapFiles()[i]);
+                ok = false;
+            }
+            qDeleteAll(map->tilesets());
+            delete map;
+        }
+        if (ok)
+            mResults.last().extra[QLatin1String("bytes")] = double(bytes);
+    }
+
+    foreach (Map *map, maps) {
+        qDeleteAll(map->tilesets());
+        delete map;
+    }
+    return ok;
+}
+
+// Tiles are compared by tileset name and id, since the maps don't share
+// tilesets.
+bool Benchmark::sameTileLayers(const Map *a, const Map *b)
+{
+    if (a->layerCount() != b->layerCount())
+        return false;
+    for (int i = 0; i < a->layerCount(); i++) {
+        const TileLayer *tlA = a->layerAt(i)->asTileLayer();
+        const TileLayer *tlB = b->layerAt(i)->asTileLayer();
+        if (!tlA || !tlB) {
+            if (tlA || tlB)
+                return false;
+            continue;
+        }
+        if (tlA->name() != tlB->name() || tlA->bounds() != tlB->bounds())
+            return false;
+        for (int y = 0; y < tlA->height(); y++) {
+            for (int x = 0; x < tlA->width(); x++) {
+                const Cell &cellA = tlA->cellAt(x, y);
+                const Cell &cellB = tlB->cellAt(x, y);
+                if (cellA.isEmpty() != cellB.isEmpty())
+                    return false;
+                if (cellA.isEmpty())
+                    continue;
+                if (cellA.tile()->id() != cellB.tile()->id() ||
+                        cellA.tile()->tileset()->name() != cellB.tile()->tileset()->name() ||
+                        cellA.flippedHorizontally() != cellB.flippedHorizontally() ||
+                        cellA.flippedVertically() != cellB.flippedVertically())
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Benchmark::sameObjectGroups(const Map *a, const Map *b)
+{
+    if (a->layerCount() != b->layerCount())
+        return false;
+    for (int i = 0; i < a->layerCount(); i++) {
+        const ObjectGroup *ogA = a->layerAt(i)->asObjectGroup();
+        const ObjectGroup *ogB = b->layerAt(i)->asObjectGroup();
+        if (!ogA || !ogB) {
+            if (ogA || ogB)
+                return false;
+            continue;
+        }
+        if (ogA->name() != ogB->name() || ogA->objectCount() != ogB->objectCount())
+            return false;
+        for (int j = 0; j < ogA->objectCount(); j++) {
+            const MapObject *objA = ogA->objects().at(j);
+            const MapObject *objB = ogB->objects().at(j);
+            if (objA->name() != objB->name() || objA->type() != objB->type() ||
+                    objA->bounds() != objB->bounds())
+                return false;
+        }
+    }
+    return true;
+}
+
+bool Benchmark::benchMapCache(const SyntheticWorld &world)
+{
+    // The same maps are read from the TMX files and from the cache, so the
+    // two results can be compared side by side.
+    QList<Map*> maps;
+    bool ok = measure("Map cache TMX read", world.cellMapFiles().size(), [&]() {
+        foreach (Map *map, maps) {
+            qDeleteAll(map->tilesets());
+            delete map;
+        }
+        maps.clear();
+        foreach (const QString &fileName, world.cellMapFiles()) {
+            MapReader reader;
+            Map *map = reader.readMap(fileName);
+            if (!map) {
+                mError = reader.errorString();
+                return false;
+            }
+            maps += map;
+        }
+        return true;
+    });
+    if (ok) {
+        qint64 bytes = 0;
+        foreach (const QString &fileName, world.cellMapFiles())
+            bytes += QFileInfo(fileName).size();
+        mResults.last().extra[QLatin1String("bytes")] = double(bytes);
+    }
+
+    ok = ok && measure("Map cache write", maps.size(), [&]() {
+        for (int i = 0; i < maps.size(); i++) {
+            MapCache cache;
+            if (!cache.writeMap(maps[i], world.cellMapFiles()[i])) {
+                mError = cache.errorString();
+                return false;
+            }
+        }
+        return true;
+    });
+
+    ok = ok && measure("Map cache read", maps.size(), [&]() {
+        for (int i = 0; i < maps.size(); i++) {
+            MapCache cache;
+            Map *map = cache.readMap(world.cellMapFiles()[i]);
+            if (!map) {
+                mError = cache.errorString();
+                return false;
+            }
+            bool same = sameTileLayers(maps[i], map);
+            qDeleteAll(map->tilesets());
+            delete map;
+            if (!same) {
+                mError = tr("%1 read from the cache differs from the TMX file").arg(world.cellMapFiles()[i]);
+                return false;
+            }
+        }
+        return true;
+    });
+    if (ok) {
+        qint64 bytes = 0;
+        foreach (const QString &fileName, world.cellMapFiles())
+            bytes += QFileInfo(MapCache::cacheFileName(fileName)).size();
+        Result &tmx = mResults[mResults.size() - 3];
+        Result &cache = mResults.last();
+        QList<qint64> tmxSorted = tmx.nsecs, cacheSorted = cache.nsecs;
+        std::sort(tmxSorted.begin(), tmxSorted.end());
+        std::sort(cacheSorted.begin(), cacheSorted.end());
+        cache.extra[QLatin1String("bytes")] = double(bytes);
+        cache.extra[QLatin1String("speedup")] = double(tmxSorted[tmxSorted.size() / 2])
+                / qMax(qint64(1), cacheSorted[cacheSorted.size() / 2]);
+    }
+
+    foreach (Map *map, maps) {
+        qDeleteAll(map->tilesets());
+        delete map;
+    }
+    return ok;
+}
+
+bool Benchmark::benchMapComposite(const SyntheticWorld &world)
+{
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+
+    // Every cell and lot map is read once; each iteration builds the
+    // composites and gathers the ordered cells like LotFilesManager does.
+    QMap<QString,MapInfo*> mapInfos;
+    QStringList fileNames = world.cellMapFiles() + world.lotMapFiles();
+    foreach (const QString &fileName, fileNames) {
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            delete pzw;
+            return false;
+        }
+        mapInfos[fileName] = MapManager::instance()->newFromMap(map, fileName);
+    }
+
+    bool ok = measure("MapComposite flatten", pzw->width() * pzw->height(), [&]() {
+        QVector<const Tiled::Cell*> cells(40);
+        foreach (WorldCell *cell, pzw->cells()) {
+            MapComposite mapComposite(mapInfos[cell->mapFilePath()]);
+            foreach (WorldCellLot *lot, cell->lots())
+                mapComposite.addMap(mapInfos[lot->mapName()], lot->pos(), lot->level());
+            foreach (CompositeLayerGroup *lg, mapComposite.layerGroups()) {
+                lg->prepareDrawing2();
+                for (int y = 0; y < mapComposite.map()->height(); y++) {
+                    for (int x = 0; x < mapComposite.map()->width(); x++) {
+                        cells.resize(0);
+                        lg->orderedCellsAt2(QPoint(x, y), cells);
+                    }
+                }
+            }
+        }
+        return true;
+    });
+
+    foreach (MapInfo *mapInfo, mapInfos) {
+        qDeleteAll(mapInfo->map()->tilesets());
+        delete mapInfo->map();
+        delete mapInfo;
+    }
+    delete pzw;
+    return ok;
+}
+
+// Converts random buildings the way MapReaderWorker does and the way the
+// GUI thread used to, with BuildingMap, and fails if the maps differ.  The
+// layers come from TMXConfig.txt, so this is skipped if it can't be read.
+bool Benchmark::benchBuildingConversion()
+{
+    BuildingTMX *tmx = BuildingTMX::instance();
+    if (tmx->tileLayerNamesForLevel(0).isEmpty() && !tmx->readTxt()) {
+        QTextStream(stdout) << "Skipping building conversion: " << tmx->errorString() << "\n";
+        return true;
+    }
+
+    SyntheticBuildings synthetic(mSeed);
+    QList<Building*> buildings;
+    for (int i = 0; i < 20; i++)
+        buildings += synthetic.create(1 + i % 3);
+
+    QList<Map*> converted, reference;
+    bool ok = measure("Building convert", buildings.size(), [&]() {
+        qDeleteAll(converted);
+        converted.clear();
+        QReadLocker locker(&BuildingTilesMgr::instance()->lock());
+        foreach (Building *building, buildings) {
+            ConvertedBuilding *cb = ConvertedBuilding::fromBuilding(building);
+            converted += cb->takeMap();
+            delete cb;
+        }
+        return true;
+    });
+
+    ok = ok && measure("Building convert BuildingMap", buildings.size(), [&]() {
+        foreach (Map *map, reference) {
+            TilesetManager::instance()->removeReferences(map->tilesets());
+            delete map;
+        }
+        reference.clear();
+        foreach (Building *building, buildings) {
+            BuildingMap bmap(building);
+            Map *map = bmap.mergedMap();
+            bmap.addRoomDefObjects(map);
+            map->setProperties(building->properties());
+            reference += map;
+        }
+        return true;
+    });
+
+    for (int i = 0; ok && i < buildings.size(); i++) {
+        if (!sameTileLayers(converted[i], reference[i]) ||
+                !sameObjectGroups(converted[i], reference[i]) ||
+                converted[i]->properties() != reference[i]->properties()) {
+            mError = tr("Building %1 converted differently than BuildingMap").arg(i);
+            ok = false;
+        }
+    }
+
+    qDeleteAll(converted);
+    foreach (Map *map, reference) {
+        TilesetManager::instance()->removeReferences(map->tilesets());
+        delete map;
+    }
+    qDeleteAll(buildings);
+    return ok;
+}
+
+// Makes random edits to buildings and fails if laying out only the changed
+// squares ever gives a different floor than laying out the whole floor.
+// Debug builds replace a partial layout that differs with a full one before
+// returning, so those mismatches are counted by LayoutToSquares() itself.
+bool Benchmark::benchBuildingLayout()
+{
+    SyntheticBuildings synthetic(mSeed);
+    const int editCount = 500;
+    int mismatches = 0;
+
+    bool ok = measure("Building layout edits", editCount, [&]() {
+        Building *building = synthetic.create(2);
+        foreach (BuildingFloor *floor, building->floors())
+            floor->LayoutToSquares();
+#ifndef QT_NO_DEBUG
+        const int mismatchesBefore = BuildingFloor::layoutMismatches();
+#endif
+        for (int i = 0; i < editCount && !mismatches; i++) {
+            BuildingFloor *edited = building->floor(synthetic.random(0, building->floorCount() - 1));
+            QRect changed = synthetic.edit(edited);
+            // Objects on the floor below change the layout of the floor above.
+            foreach (BuildingFloor *floor, building->floors()) {
+                floor->LayoutToSquares((floor == edited) ? changed : QRect());
+                QVector<QVector<BuildingFloor::Square> > partial = floor->squares;
+                floor->LayoutToSquares();
+                if (floor->squares != partial) {
+                    mError = tr("Level %1 differs from a full layout after %2 edits (seed %3)")
+                            .arg(floor->level()).arg(i + 1).arg(mSeed);
+                    ++mismatches;
+                }
+            }
+        }
+#ifndef QT_NO_DEBUG
+        if (!mismatches && BuildingFloor::layoutMismatches() != mismatchesBefore) {
+            mError = tr("A partial building layout differed from a full layout (seed %1)").arg(mSeed);
+            ++mismatches;
+        }
+#endif
+        delete building;
+        return true;
+    });
+
+    return ok && !mismatches;
+}
+
+bool Benchmark::benchBmpBlender(const SyntheticWorld &world)
+{
+    QList<Map*> maps;
+    foreach (const QString &fileName, world.cellMapFiles()) {
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            return false;
+        }
+        maps += map;
+    }
+
+    // The synthetic tilesets aren't in Tilesets.txt, so this measures the
+    // BMP to tile-name grids and blending, not tile lookup.
+    bool ok = measure("BmpBlender blend cell", maps.size(), [&]() {
+        foreach (Map *map, maps) {
+            BmpBlender blender(map);
+            blender.markDirty(0, 0, map->width() - 1, map->height() - 1);
+            blender.flush(QRect(0, 0, map->width(), map->height()));
+        }
+        return true;
+    });
+
+    foreach (Map *map, maps) {
+        qDeleteAll(map->tilesets());
+        delete map;
+    }
+    return ok;
+}
+
+// Lot generation, chunkdata and lotpack reading all work on the same
+// composites, so they share one setup.  Map loading is left out, it is
+// timed by "TMX read".  "Lot generation" includes writing the chunkdata
+// file, which "Chunkdata write" times on its own.
+bool Benchmark::benchLotFiles(const SyntheticWorld &world)
+{
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+    WorldDocument worldDoc(pzw);
+
+    QDir dir(mDirectory);
+    if (!dir.mkpath(QLatin1String("lots"))) {
+        mError = tr("Couldn't create the lots directory in\n%1").arg(mDirectory);
+        return false;
+    }
+
+    // One pixel of the Zombie Spawn Map covers one 10x10 chunk.
+    QString spawnMapFile = dir.filePath(QLatin1String("spawnmap.png"));
+    QImage spawnMap(pzw->width() * 30, pzw->height() * 30, QImage::Format_RGB32);
+    spawnMap.fill(qRgb(128, 128, 128));
+    if (!spawnMap.save(spawnMapFile)) {
+        mError = tr("Couldn't write the Zombie Spawn Map.\n%1").arg(spawnMapFile);
+        return false;
+    }
+
+    GenerateLotsSettings settings;
+    settings.exportDir = dir.filePath(QLatin1String("lots"));
+    settings.zombieSpawnMap = spawnMapFile;
+    settings.tileDefFolder = dir.filePath(QLatin1String("Tiles"));
+    pzw->setGenerateLotsSettings(settings);
+
+    LotFilesManager *lotFiles = LotFilesManager::instance();
+    if (!lotFiles->prepare(&worldDoc)) {
+        mError = lotFiles->errorString();
+        return false;
+    }
+
+    QMap<QString,MapInfo*> mapInfos;
+    QStringList fileNames = world.cellMapFiles() + world.lotMapFiles();
+    foreach (const QString &fileName, fileNames) {
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            deleteCellMaps(mapInfos);
+            return false;
+        }
+        mapInfos[fileName] = MapManager::instance()->newFromMap(map, fileName);
+    }
+
+    auto compose = [&](WorldCell *cell, MapComposite &mapComposite) {
+        foreach (WorldCellLot *lot, cell->lots())
+            mapComposite.addMap(mapInfos[lot->mapName()], lot->pos(), lot->level());
+        mapComposite.generateRoadLayers(QPoint(cell->x() * 300, cell->y() * 300),
+                                        pzw->roads());
+    };
+
+    const int cellCount = pzw->width() * pzw->height();
+
+    bool ok = measure("Lot generation", cellCount, [&]() {
+        foreach (WorldCell *cell, pzw->cells()) {
+            MapComposite mapComposite(mapInfos[cell->mapFilePath()]);
+            compose(cell, mapComposite);
+            if (!lotFiles->generateCell(cell, &mapComposite)) {
+                mError = lotFiles->errorString();
+                return false;
+            }
+        }
+        return true;
+    });
+
+    ok = ok && measure("Chunkdata write", cellCount, [&]() {
+        foreach (WorldCell *cell, pzw->cells()) {
+            MapComposite mapComposite(mapInfos[cell->mapFilePath()]);
+            compose(cell, mapComposite);
+            foreach (CompositeLayerGroup *lg, mapComposite.layerGroups())
+                lg->prepareDrawing2();
+            Navigate::ChunkDataFile cdf;
+            cdf.fromMap(cell->x(), cell->y(), &mapComposite,
+                        QList<LotFile::RoomRect*>(), settings);
+        }
+        return true;
+    });
+
+    qint64 chunks = 0;
+    ok = ok && measure("Lotpack read", cellCount, [&]() {
+        chunks = 0;
+        foreach (WorldCell *cell, pzw->cells()) {
+            LotInspect::CellReader reader(settings.exportDir, cell->x(), cell->y());
+            if (!reader.readHeader() || !reader.openLotPack()) {
+                mError = reader.errors().join(QLatin1Char('\n'));
+                return false;
+            }
+            LotInspect::Chunk chunk;
+            for (int i = 0; i < reader.chunkCount(); i++) {
+                if (!reader.readChunk(i, chunk)) {
+                    mError = reader.errors().join(QLatin1Char('\n'));
+                    return false;
+                }
+            }
+            chunks += reader.chunkCount();
+        }
+        return true;
+    });
+    if (ok)
+        mResults.last().extra[QLatin1String("chunks")] = chunks;
+
+    deleteCellMaps(mapInfos);
+    return ok;
+}
+
+// The synthetic tilesets aren't in Tilesets.txt, so the maps written here
+// have no tiles, only the BMP images, rules and blends.  This measures the
+// conversion and writing, not tile lookup.
+bool Benchmark::benchBmpToTmx(const SyntheticWorld &world)
+{
+    // Rules.txt, Blends.txt and MapBaseXML.txt are installed next to the
+    // executable; without them there is nothing to convert with.
+    BMPToTMX *bmpToTmx = BMPToTMX::instance();
+    if (!QFileInfo::exists(bmpToTmx->defaultRulesFile()) ||
+            !QFileInfo::exists(bmpToTmx->defaultBlendsFile()) ||
+            !QFileInfo::exists(bmpToTmx->defaultMapBaseXMLFile()))
+        return true;
+
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+    WorldDocument worldDoc(pzw);
+
+    QDir dir(mDirectory);
+    if (!dir.mkpath(QLatin1String("bmptotmx"))) {
+        mError = tr("Couldn't create the bmptotmx directory in\n%1").arg(mDirectory);
+        return false;
+    }
+
+    // Grass with dirt patches and a grid of roads, and grass and trees in
+    // the vegetation image, all colors from Rules.txt.
+    const QColor ground[] = { QColor(90, 100, 35), QColor(117, 117, 47),
+                              QColor(145, 135, 60), QColor(120, 70, 20) };
+    const QColor vegetation[] = { QColor(0, 255, 0), QColor(0, 128, 0) };
+    std::mt19937 random(mSeed);
+    auto number = [&](int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(random);
+    };
+    QImage bmp(pzw->width() * 300, pzw->height() * 300, QImage::Format_RGB32);
+    QImage bmpVeg(bmp.size(), QImage::Format_RGB32);
+    bmp.fill(ground[0]);
+    bmpVeg.fill(Qt::black);
+    {
+        QPainter painter(&bmp);
+        QPainter painterVeg(&bmpVeg);
+        const int patches = pzw->width() * pzw->height() * 200;
+        for (int i = 0; i < patches; i++) {
+            QRect r(number(0, bmp.width() - 1), number(0, bmp.height() - 1),
+                    number(2, 30), number(2, 30));
+            painter.fillRect(r, ground[number(0, 3)]);
+            r.translate(number(-50, 50), number(-50, 50));
+            painterVeg.fillRect(r, vegetation[number(0, 1)]);
+        }
+        for (int i = 0; i < bmp.width(); i += 100) {
+            painter.fillRect(i, 0, 8, bmp.height(), QColor(100, 100, 100));
+            painter.fillRect(0, i, bmp.width(), 8, QColor(100, 100, 100));
+            painterVeg.fillRect(i, 0, 8, bmp.height(), Qt::black);
+            painterVeg.fillRect(0, i, bmp.width(), 8, Qt::black);
+        }
+    }
+    QString bmpFile = dir.filePath(QLatin1String("bmptotmx/synthetic.png"));
+    QString bmpVegFile = dir.filePath(QLatin1String("bmptotmx/synthetic_veg.png"));
+    if (!bmp.save(bmpFile) || !bmpVeg.save(bmpVegFile)) {
+        mError = tr("Couldn't write the BMP images in\n%1").arg(dir.filePath(QLatin1String("bmptotmx")));
+        return false;
+    }
+    pzw->insertBmp(0, new WorldBMP(pzw, 0, 0, pzw->width(), pzw->height(), bmpFile));
+
+    BMPToTMXSettings settings;
+    settings.exportDir = dir.filePath(QLatin1String("bmptotmx"));
+    pzw->setBMPToTMXSettings(settings);
+
+    if (!bmpToTmx->prepare(&worldDoc)) {
+        mError = bmpToTmx->errorString();
+        return false;
+    }
+
+    QList<WorldCell*> cells = pzw->cells().toList();
+    bool ok = measure("BMP to TMX", cells.size(), [&]() {
+        if (!bmpToTmx->generateCells(cells)) {
+            mError = bmpToTmx->errorString();
+            return false;
+        }
+        return true;
+    });
+
+    bmpToTmx->finish();
+    return ok;
+}
+
+// Writes the buildings image of a world larger than the synthetic one, with
+// the synthetic cells in its top-left corner, by patching a .bmp file one row
+// of cells at a time and the old way with the whole image in memory.  Fails
+// if the pixels differ, or if patching used memory for the whole image.
+bool Benchmark::benchTMXToBMP(const SyntheticWorld &world)
+{
+    WorldReader reader;
+    World *source = reader.readWorld(world.worldFileName());
+    if (!source) {
+        mError = reader.errorString();
+        return false;
+    }
+
+    const int worldSize = 16;
+    World *pzw = new World(worldSize, worldSize);
+    foreach (WorldCell *sourceCell, source->cells()) {
+        WorldCell *cell = pzw->cellAt(sourceCell->pos());
+        if (!cell)
+            continue;
+        cell->setMapFilePath(sourceCell->mapFilePath());
+        foreach (WorldCellLot *lot, sourceCell->lots())
+            cell->insertLot(cell->lots().size(), new WorldCellLot(cell, lot));
+    }
+    delete source;
+    WorldDocument worldDoc(pzw);
+
+    // Only the buildings image is written, which doesn't read the BMP.
+    pzw->insertBmp(0, new WorldBMP(pzw, 0, 0, worldSize, worldSize, QString()));
+
+    QDir dir(mDirectory);
+    dir.mkpath(QLatin1String("tmxtobmp"));
+    const QString patchedFile = dir.filePath(QLatin1String("tmxtobmp/buildings.bmp"));
+    const QString wholeFile = dir.filePath(QLatin1String("tmxtobmp/buildings_whole.bmp"));
+
+    if (!TMXToBMP::hasInstance())
+        new TMXToBMP();
+    TMXToBMP &tmxToBmp = TMXToBMP::instance();
+
+    TMXToBMPSettings settings;
+    settings.doMain = false;
+    settings.doVegetation = false;
+    settings.doBuildings = true;
+
+    auto generate = [&](bool patch, const QString &fileName, qint64 &peakMemory) {
+        settings.buildingsFile = fileName;
+        pzw->setTMXToBMPSettings(settings);
+        tmxToBmp.setPatchImages(patch);
+        qint64 memoryBefore = residentMemory();
+        bool peakReset = resetPeakResidentMemory();
+        if (!tmxToBmp.generateImages(&worldDoc, TMXToBMP::GenerateAll)) {
+            mError = tmxToBmp.errorString();
+            return false;
+        }
+        if (peakReset && memoryBefore >= 0)
+            peakMemory = qMax(peakMemory, peakResidentMemory() - memoryBefore);
+        return true;
+    };
+
+    const int cellCount = worldSize * worldSize;
+    qint64 patchedPeak = -1, wholePeak = -1;
+    bool ok = measure("TMX to BMP buildings", cellCount, [&]() {
+        return generate(true, patchedFile, patchedPeak);
+    });
+    if (ok && patchedPeak >= 0)
+        mResults.last().extra[QLatin1String("peak_memory_bytes")] = double(patchedPeak);
+    ok = ok && measure("TMX to BMP buildings whole image", cellCount, [&]() {
+        return generate(false, wholeFile, wholePeak);
+    });
+    if (ok && wholePeak >= 0)
+        mResults.last().extra[QLatin1String("peak_memory_bytes")] = double(wholePeak);
+    tmxToBmp.setPatchImages(true);
+    if (!ok)
+        return false;
+
+    const qint64 imageBytes = qint64(worldSize * 300) * (worldSize * 300) * 4;
+    if (patchedPeak > imageBytes / 2) {
+        mError = tr("Writing the buildings image used %1 MB, the whole image is %2 MB")
+                .arg(patchedPeak / (1024 * 1024)).arg(imageBytes / (1024 * 1024));
+        return false;
+    }
+
+    QImage patched(patchedFile), whole(wholeFile);
+    if (patched.isNull() || patched.size() != whole.size()) {
+        mError = tr("The buildings image couldn't be read\n%1").arg(patchedFile);
+        return false;
+    }
+    patched = patched.convertToFormat(QImage::Format_RGB32);
+    whole = whole.convertToFormat(QImage::Format_RGB32);
+    int differingPixels = 0;
+    for (int y = 0; y < patched.height(); y++) {
+        const QRgb *a = reinterpret_cast<const QRgb*>(patched.constScanLine(y));
+        const QRgb *b = reinterpret_cast<const QRgb*>(whole.constScanLine(y));
+        for (int x = 0; x < patched.width(); x++) {
+            if (a[x] != b[x])
+                ++differingPixels;
+        }
+    }
+    if (differingPixels) {
+        mError = tr("%1 pixels of the buildings image differ from the whole image")
+                .arg(differingPixels);
+        return false;
+    }
+    return true;
+}
+
+bool Benchmark::benchWorldReadWrite(const SyntheticWorld &world)
+{
+    bool ok = measure("World read", 1, [&]() {
+        WorldReader reader;
+        World *pzw = reader.readWorld(world.worldFileName());
+        if (!pzw) {
+            mError = reader.errorString();
+            return false;
+        }
+        delete pzw;
+        return true;
+    });
+
+    WorldReader reader;
+    World *pzw = reader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = reader.errorString();
+        return false;
+    }
+    QString fileName = QDir(mDirectory).filePath(QLatin1String("benchmark-copy.pzw"));
+    ok = ok && measure("World write", 1, [&]() {
+        WorldWriter writer;
+        if (!writer.writeWorld(pzw, fileName)) {
+            mError = writer.errorString();
+            return false;
+        }
+        return true;
+    });
+    delete pzw;
+    return ok;
+}
+
+bool Benchmark::benchWorldBinary(const SyntheticWorld &world)
+{
+    // The .pzw written from a world, with lots relative to the benchmark
+    // directory, to compare the two formats.
+    auto toXml = [&](World *pzw) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        WorldWriter writer;
+        writer.writeWorld(pzw, &buffer, mDirectory);
+        return buffer.data();
+    };
+
+    WorldReader reader;
+    World *pzw = reader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = reader.errorString();
+        return false;
+    }
+    const QByteArray xml = toXml(pzw);
+    const int cellCount = pzw->width() * pzw->height();
+
+    QString fileName = QDir(mDirectory).filePath(QLatin1String("benchmark.pzwb"));
+    bool ok = measure("World binary write", cellCount, [&]() {
+        WorldWriter writer;
+        if (!writer.writeWorld(pzw, fileName)) {
+            mError = writer.errorString();
+            return false;
+        }
+        return true;
+    });
+    delete pzw;
+    if (!ok)
+        return false;
+
+    ok = measure("World binary open", 1, [&]() {
+        WorldReader reader;
+        World *pzwb = reader.readWorld(fileName);
+        if (!pzwb) {
+            mError = reader.errorString();
+            return false;
+        }
+        delete pzwb;
+        return true;
+    });
+
+    World *pzwb = reader.readWorld(fileName);
+    if (!pzwb) {
+        mError = reader.errorString();
+        return false;
+    }
+
+    // A different cell each iteration, since a cell is only loaded once.
+    int next = 0;
+    ok = ok && measure("World binary load cell", 1, [&]() {
+        WorldCell *cell = pzwb->cellAt(next % pzwb->width(), (next / pzwb->width()) % pzwb->height());
+        next++;
+        cell->objects();
+        if (!cell->isLoaded()) {
+            mError = QLatin1String("binary world cell wasn't loaded");
+            return false;
+        }
+        return true;
+    });
+
+    // Only the edited cell is encoded again, the others are copied.
+    QString copyName = QDir(mDirectory).filePath(QLatin1String("benchmark-copy.pzwb"));
+    WorldCell *cell = pzwb->cellAt(pzwb->width() / 2, pzwb->height() / 2);
+    if (!cell->objects().isEmpty())
+        cell->objects().first()->setName(QLatin1String("edited"));
+    ok = ok && measure("World binary save edited", cellCount, [&]() {
+        WorldWriter writer;
+        if (!writer.writeWorld(pzwb, copyName)) {
+            mError = writer.errorString();
+            return false;
+        }
+        return true;
+    });
+
+    // Cells not loaded before the save are read from the new file.
+    const QByteArray edited = toXml(pzwb);
+    delete pzwb;
+    if (!ok)
+        return false;
+
+    pzwb = reader.readWorld(fileName);
+    if (!pzwb) {
+        mError = reader.errorString();
+        return false;
+    }
+    if (toXml(pzwb) != xml) {
+        mError = QLatin1String("binary world differs from the .pzw it was written from");
+        ok = false;
+    }
+    delete pzwb;
+
+    pzwb = reader.readWorld(copyName);
+    if (!pzwb) {
+        mError = reader.errorString();
+        return false;
+    }
+    if (ok && toXml(pzwb) != edited) {
+        mError = QLatin1String("saved binary world differs from the edited world");
+        ok = false;
+    }
+    delete pzwb;
+
+    return ok;
+}
+
+// Creates a WorldScene for a 100x100 world with zones in every cell and
+// times drawing it zoomed out and zoomed in, with and without zones.
+bool Benchmark::benchWorldScene()
+{
+    const int size = 100;
+    World *pzw = new World(size, size);
+    ObjectType *type = new ObjectType(QLatin1String("TownZone"));
+    pzw->insertObjectType(pzw->objectTypes().size(), type);
+    WorldObjectGroup *group = new WorldObjectGroup(pzw, QLatin1String("Zones"), Qt::yellow);
+    pzw->insertObjectGroup(pzw->objectGroups().size(), group);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            WorldCell *cell = pzw->cellAt(x, y);
+            for (int i = 0; i < 5; i++) {
+                WorldCellObject *obj = new WorldCellObject(cell, QString(), type, group,
+                                                           i * 50, i * 50, 0, 40, 40);
+                cell->insertObject(cell->objects().size(), obj);
+            }
+        }
+    }
+    WorldDocument worldDoc(pzw);
+
+    // The Preferences setters save to QSettings, so put them back afterwards.
+    Preferences *prefs = Preferences::instance();
+    const bool thumbnails = prefs->worldThumbnails();
+    const bool zones = prefs->showZonesInWorldView();
+    const bool zonesWorld = prefs->showZonesWorldInWorldView();
+    prefs->setWorldThumbnails(false);
+    prefs->setShowZonesInWorldView(false);
+    prefs->setShowZonesWorldInWorldView(false);
+
+    WorldScene *scene = 0;
+    bool ok = measure("World scene create", size * size, [&]() {
+        delete scene;
+        scene = new WorldScene(&worldDoc);
+        return true;
+    });
+    if (ok)
+        mResults.last().extra[QLatin1String("items")] = scene->items().size();
+
+    QImage image(1280, 720, QImage::Format_ARGB32_Premultiplied);
+    const QRectF whole = scene->sceneRect();
+    const QRectF zoomed = scene->boundingRect(QRect(size / 2, size / 2, 3, 3));
+    auto render = [&](const QRectF &source) {
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        scene->render(&painter, image.rect(), source);
+        return true;
+    };
+
+    ok = ok && measure("World scene repaint whole", size * size, [&]() { return render(whole); });
+    ok = ok && measure("World scene repaint zoomed", 9, [&]() { return render(zoomed); });
+    prefs->setShowZonesInWorldView(true);
+    ok = ok && measure("World scene repaint whole zones", size * size, [&]() { return render(whole); });
+    ok = ok && measure("World scene repaint zoomed zones", 9, [&]() { return render(zoomed); });
+
+    delete scene;
+    prefs->setShowZonesInWorldView(zones);
+    prefs->setShowZonesWorldInWorldView(zonesWorld);
+    prefs->setWorldThumbnails(thumbnails);
+    return ok;
+}
+
+bool Benchmark::sameInGameMapCells(const InGameMapCell &a, const InGameMapCell &b)
+{
+    if (a.mFeatures.size() != b.mFeatures.size())
+        return false;
+    for (int i = 0; i < a.mFeatures.size(); i++) {
+        const InGameMapFeature *fa = a.mFeatures[i];
+        const InGameMapFeature *fb = b.mFeatures[i];
+        if (fa->mGeometry.mType != fb->mGeometry.mType ||
+                fa->mGeometry.mCoordinates.size() != fb->mGeometry.mCoordinates.size() ||
+                fa->mProperties.size() != fb->mProperties.size())
+            return false;
+        for (int j = 0; j < fa->mGeometry.mCoordinates.size(); j++) {
+            if (fa->mGeometry.mCoordinates[j] != fb->mGeometry.mCoordinates[j])
+                return false;
+        }
+        for (int j = 0; j < fa->mProperties.size(); j++) {
+            if (fa->mProperties[j].mKey != fb->mProperties[j].mKey ||
+                    fa->mProperties[j].mValue != fb->mProperties[j].mValue)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Writes the in-game map features of the synthetic world in each .bin
+// version, and fails unless every cell reads back the same.  Reading one
+// cell is timed against reading the whole file.
+bool Benchmark::benchInGameMap(const SyntheticWorld &world)
+{
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+
+    struct Format
+    {
+        const char *name;
+        int version;
+        bool compress;
+        QString fileName;
+    };
+    QList<Format> formats;
+    formats += { "v1", 1, false, QDir(mDirectory).filePath(QLatin1String("worldmap-v1.xml.bin")) };
+    formats += { "v2", 2, false, QDir(mDirectory).filePath(QLatin1String("worldmap-v2.xml.bin")) };
+    formats += { "v2 zlib", 2, true, QDir(mDirectory).filePath(QLatin1String("worldmap-v2z.xml.bin")) };
+
+    const int cellCount = pzw->width() * pzw->height();
+    std::mt19937 random(mSeed);
+    bool ok = true;
+
+    foreach (const Format &format, formats) {
+        const QByteArray name = QByteArray("IGMB ") + format.name;
+        ok = ok && measure((name + " write").constData(), cellCount, [&]() {
+            InGameMapWriterBinary writer;
+            writer.setVersion(format.version);
+            writer.setCompressCells(format.compress);
+            if (!writer.writeWorld(pzw, format.fileName)) {
+                mError = writer.errorString();
+                return false;
+            }
+            return true;
+        });
+        if (!ok)
+            break;
+        mResults.last().extra[QLatin1String("bytes")] = double(QFileInfo(format.fileName).size());
+
+        int differingCells = 0;
+        ok = measure((name + " read").constData(), cellCount, [&]() {
+            InGameMapReaderBinary reader;
+            if (!reader.open(format.fileName)) {
+                mError = reader.errorString();
+                return false;
+            }
+            differingCells = 0;
+            for (int y = 0; y < reader.height(); y++) {
+                for (int x = 0; x < reader.width(); x++) {
+                    InGameMapCell cell(nullptr);
+                    if (!reader.readCell(x, y, &cell)) {
+                        mError = reader.errorString();
+                        return false;
+                    }
+                    if (!sameInGameMapCells(cell, pzw->cellAt(x, y)->inGameMap()))
+                        ++differingCells;
+                    cell.clear();
+                }
+            }
+            return true;
+        });
+        if (!ok)
+            break;
+        if (differingCells) {
+            mError = tr("%1 cells differ after writing and reading %2")
+                    .arg(differingCells).arg(format.fileName);
+            ok = false;
+            break;
+        }
+
+        std::uniform_int_distribution<int> randomX(0, pzw->width() - 1), randomY(0, pzw->height() - 1);
+        ok = measure((name + " read one cell").constData(), 1, [&]() {
+            InGameMapReaderBinary reader;
+            if (!reader.open(format.fileName)) {
+                mError = reader.errorString();
+                return false;
+            }
+            InGameMapCell cell(nullptr);
+            if (!reader.readCell(randomX(random), randomY(random), &cell)) {
+                mError = reader.errorString();
+                return false;
+            }
+            cell.clear();
+            return true;
+        });
+        if (!ok)
+            break;
+    }
+
+    delete pzw;
+    return ok;
+}
+
+// Fills one cell with traced-looking water polygons and roads and times
+// drawing them through an InGameMapFeaturesItem zoomed out and zoomed in,
+// and hit-testing them.
+bool Benchmark::benchInGameMapScene()
+{
+    const int cellSize = 300;
+    World *pzw = new World(1, 1);
+    WorldCell *cell = pzw->cellAt(0, 0);
+    InGameMapCell &igm = cell->inGameMap();
+    std::mt19937 random(mSeed);
+    auto coord = [&](int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(random);
+    };
+    const int featureCount = 5000;
+    for (int i = 0; i < featureCount; i++) {
+        InGameMapFeature *feature = new InGameMapFeature(&igm);
+        InGameMapCoordinates coords;
+        const int cx = coord(0, cellSize), cy = coord(0, cellSize);
+        if (i % 4) {
+            feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
+            const int radius = coord(2, 30);
+            for (int j = 0; j < 64; j++) {
+                const qreal angle = j * 2 * M_PI / 64;
+                const int r = radius + coord(-1, 1);
+                coords += InGameMapPoint(cx + qRound(r * qCos(angle)), cy + qRound(r * qSin(angle)));
+            }
+        } else {
+            feature->mGeometry.mType = InGameMapGeometry::Type::LineString;
+            int x = cx, y = cy;
+            for (int j = 0; j < 32; j++) {
+                coords += InGameMapPoint(x, y);
+                x += coord(0, 4);
+                y += coord(-2, 2);
+            }
+        }
+        feature->mGeometry.mCoordinates += coords;
+        igm.features() += feature;
+    }
+
+    Map map(Map::LevelIsometric, cellSize, cellSize, 64, 32);
+    ZLevelRenderer renderer(&map);
+
+    QGraphicsScene scene;
+    InGameMapFeaturesItem *item = nullptr;
+    bool ok = measure("In-game map item create", featureCount, [&]() {
+        delete item;
+        item = new InGameMapFeaturesItem(cell, &renderer);
+        scene.addItem(item);
+        return true;
+    });
+
+    QImage image(1280, 720, QImage::Format_ARGB32_Premultiplied);
+    const QRectF whole = item ? item->boundingRect() : QRectF();
+    const QPointF center = renderer.tileToPixelCoords(cellSize / 2, cellSize / 2);
+    const QRectF zoomed(center - QPointF(640, 360), QSizeF(1280, 720));
+    auto render = [&](const QRectF &source) {
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        scene.render(&painter, image.rect(), source);
+        return true;
+    };
+
+    ok = ok && measure("In-game map repaint whole", featureCount, [&]() { return render(whole); });
+    ok = ok && measure("In-game map repaint zoomed", featureCount, [&]() { return render(zoomed); });
+
+    const int hitCount = 10000;
+    int hits = 0;
+    ok = ok && measure("In-game map hit test", hitCount, [&]() {
+        std::mt19937 hitRandom(mSeed);
+        hits = 0;
+        for (int i = 0; i < hitCount; i++) {
+            const int x = std::uniform_int_distribution<int>(0, cellSize)(hitRandom);
+            const int y = std::uniform_int_distribution<int>(0, cellSize)(hitRandom);
+            if (item->featureAt(renderer.tileToPixelCoords(x, y)))
+                hits++;
+        }
+        return true;
+    });
+    if (ok)
+        mResults.last().extra[QLatin1String("hits")] = double(hits);
+
+    delete item;
+    delete pzw;
+    return ok;
+}
+
+bool Benchmark::benchLuaScript(const SyntheticWorld &world)
+{
+    // 10000 objects are added, then every object in the world is retagged
+    // and moved, all in one undo macro.
+    static const char *source =
+            "local cells = world:cells()\n"
+            "for i = 1, 10000 do\n"
+            "  local cell = cells[(i % #cells) + 1]\n"
+            "  cell:addObject{ group=\"Zones\", type=\"TownZone\", x=i % 300, y=(i / 300) % 300 }\n"
+            "end\n"
+            "for _,cell in ipairs(cells) do\n"
+            "  for _,obj in ipairs(cell:objects()) do\n"
+            "    obj:setType(\"Forest\")\n"
+            "    obj:setPos(obj:x() + 1, obj:y())\n"
+            "  end\n"
+            "end\n";
+
+    return measure("Lua script 10000 objects", 10000, [&]() {
+        WorldReader reader;
+        World *pzw = reader.readWorld(world.worldFileName());
+        if (!pzw) {
+            mError = reader.errorString();
+            return false;
+        }
+        WorldDocument worldDoc(pzw, world.worldFileName());
+        WorldScript script(&worldDoc);
+        if (!script.runString(QLatin1String(source), QLatin1String("benchmark"))) {
+            mError = script.errorString();
+            return false;
+        }
+        return true;
+    });
+}
+
+// Times reading and filling tile layers.  First the layers of the synthetic
+// world's maps, which range from a full floor to layers with a few objects,
+// then single 300x300 layers filled to fixed densities.
+bool Benchmark::benchTileGrid(const SyntheticWorld &world)
+{
+    QList<Map*> maps;
+    QList<TileLayer*> layers;
+    foreach (const QString &fileName, world.cellMapFiles()) {
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            return false;
+        }
+        maps += map;
+        layers += map->tileLayers();
+    }
+
+    qint64 cellCount = 0, tileCount = 0;
+    foreach (TileLayer *tl, layers) {
+        cellCount += tl->width() * tl->height();
+        SparseTileGrid::Iterator it = tl->cells(QRect(0, 0, tl->width(), tl->height()));
+        while (it.next())
+            tileCount++;
+    }
+
+    // Each pass counts the tiles it saw so the work can't be skipped, and
+    // so the different ways of reading a layer are checked against each other.
+    auto checkCount = [&](qint64 count) {
+        if (count != tileCount) {
+            mError = tr("Counted %1 tiles, expected %2").arg(count).arg(tileCount);
+            return false;
+        }
+        return true;
+    };
+
+    bool ok = measure("Tile layer cellAt", layers.size(), [&]() {
+        qint64 count = 0;
+        foreach (TileLayer *tl, layers) {
+            for (int y = 0; y < tl->height(); y++)
+                for (int x = 0; x < tl->width(); x++)
+                    if (!tl->cellAt(x, y).isEmpty())
+                        count++;
+        }
+        return checkCount(count);
+    });
+
+    ok = ok && measure("Tile layer iterate", layers.size(), [&]() {
+        qint64 count = 0;
+        foreach (TileLayer *tl, layers) {
+            SparseTileGrid::Iterator it = tl->cells(QRect(0, 0, tl->width(), tl->height()));
+            while (it.next())
+                count++;
+        }
+        return checkCount(count);
+    });
+
+    ok = ok && measure("Tile layer copy", layers.size(), [&]() {
+        qint64 count = 0;
+        foreach (TileLayer *tl, layers) {
+            TileLayer copy(tl->name(), 0, 0, tl->width(), tl->height());
+            SparseTileGrid::Iterator it = tl->cells(QRect(0, 0, tl->width(), tl->height()));
+            while (it.next()) {
+                copy.setCell(it.x(), it.y(), it.cell());
+                count++;
+            }
+        }
+        return checkCount(count);
+    });
+
+    if (ok) {
+        for (int i = mResults.size() - 3; i < mResults.size(); i++) {
+            mResults[i].extra[QLatin1String("cells")] = double(cellCount);
+            mResults[i].extra[QLatin1String("tiles")] = double(tileCount);
+        }
+    }
+
+    foreach (Map *map, maps) {
+        qDeleteAll(map->tilesets());
+        delete map;
+    }
+    if (!ok)
+        return false;
+
+    // Single layers at fixed densities.  Tiles are placed in random 4x4
+    // clumps, the way furniture and vegetation tend to be, until the layer
+    // has the wanted number of tiles.
+    QImage image(64 * 8, 128 * 4, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    Tileset tileset(QLatin1String("benchmark"), 64, 128);
+    if (!tileset.loadFromImage(image, QLatin1String("benchmark.png"))) {
+        mError = tr("Failed to create a tileset");
+        return false;
+    }
+
+    const int size = 300;
+    const int densities[] = { 1, 5, 25, 50, 100 };
+    for (int density : densities) {
+        QVector<QPoint> clumps;
+        for (int y = 0; y < size; y += 4)
+            for (int x = 0; x < size; x += 4)
+                clumps += QPoint(x, y);
+        std::shuffle(clumps.begin(), clumps.end(), std::mt19937(mSeed));
+
+        QVector<QPoint> positions;
+        const int wanted = size * size * density / 100;
+        for (int i = 0; positions.size() < wanted; i++) {
+            for (int y = clumps[i].y(); y < clumps[i].y() + 4; y++)
+                for (int x = clumps[i].x(); x < clumps[i].x() + 4; x++)
+                    if (positions.size() < wanted)
+                        positions += QPoint(x, y);
+        }
+
+        TileLayer layer(QLatin1String("benchmark"), 0, 0, size, size);
+
+        QByteArray name = "Tile grid " + QByteArray::number(density) + "% fill";
+        ok = measure(name.constData(), 1, [&]() {
+            layer.erase();
+            for (int i = 0; i < positions.size(); i++)
+                layer.setCell(positions[i].x(), positions[i].y(),
+                              Cell(tileset.tileAt(i % tileset.tileCount())));
+            return true;
+        });
+
+        name = "Tile grid " + QByteArray::number(density) + "% cellAt";
+        ok = ok && measure(name.constData(), 1, [&]() {
+            int count = 0;
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                    if (!layer.cellAt(x, y).isEmpty())
+                        count++;
+            return count == positions.size();
+        });
+
+        name = "Tile grid " + QByteArray::number(density) + "% iterate";
+        ok = ok && measure(name.constData(), 1, [&]() {
+            int count = 0;
+            SparseTileGrid::Iterator it = layer.cells(QRect(0, 0, size, size));
+            while (it.next())
+                count++;
+            return count == positions.size();
+        });
+
+        if (!ok) {
+            if (mError.isEmpty())
+                mError = tr("Tile grid %1% counted the wrong number of tiles").arg(density);
+            return false;
+        }
+        for (int i = mResults.size() - 3; i < mResults.size(); i++)
+            mResults[i].extra[QLatin1String("density")] = density;
+    }
+
+    return true;
+}
+
+// Scrolls a view of the first cell across the middle of the cell and back,
+// like panning the cell scene without OpenGL.  Each frame is drawn directly
+// through the renderer, then through a TileChunkCache per level.  With the
+// cache a frame counts as done once every chunk it shows has been drawn.
+// A few cached frames are checked against the directly drawn ones.
+bool Benchmark::benchCellViewPan(const SyntheticWorld &world)
+{
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+
+    WorldCell *cell = pzw->cellAt(0, 0);
+    QMap<QString,MapInfo*> mapInfos;
+    if (!readCellMaps(cell, mapInfos)) {
+        deleteCellMaps(mapInfos);
+        delete pzw;
+        return false;
+    }
+
+    bool ok;
+    {
+        MapComposite mapComposite(mapInfos[cell->mapFilePath()]);
+        foreach (WorldCellLot *lot, cell->lots())
+            mapComposite.addMap(mapInfos[lot->mapName()], lot->pos(), lot->level());
+        mapComposite.synch();
+
+        ZLevelRenderer renderer(mapComposite.map());
+        renderer.setMaxLevel(mapComposite.maxLevel());
+
+        const qreal scale = 0.25;
+        const QSize viewSize(1280, 720);
+        const QRectF sceneRect = mapComposite.boundingRect(&renderer);
+        QRectF view(QPointF(), QSizeF(viewSize) / scale);
+        view.moveCenter(sceneRect.center());
+        QList<QPointF> frames;
+        for (qreal x = sceneRect.left(); x + view.width() <= sceneRect.right(); x += 64 / scale)
+            frames += QPointF(x, view.top());
+        for (int i = frames.size() - 1; i >= 0; i--)
+            frames += frames[i];
+
+        QImage viewport(viewSize, QImage::Format_ARGB32_Premultiplied);
+
+        ok = measure("Cell view pan direct", frames.size(), [&]() {
+            foreach (const QPointF &pos, frames) {
+                viewport.fill(Qt::transparent);
+                QPainter painter(&viewport);
+                painter.scale(scale, scale);
+                painter.translate(-pos);
+                const QRectF exposed(pos, view.size());
+                foreach (CompositeLayerGroup *lg, mapComposite.layerGroups()) {
+                    lg->prepareDrawing(&renderer, exposed.toAlignedRect());
+                    renderer.drawTileLayerGroup(&painter, lg, exposed);
+                }
+            }
+            return true;
+        });
+
+        // A few frames drawn directly, to compare the cached frames with.
+        QList<int> checkFrames;
+        checkFrames << 0 << frames.size() / 4 << frames.size() / 2;
+        QList<QImage> references;
+        foreach (int frame, checkFrames) {
+            viewport.fill(Qt::transparent);
+            QPainter painter(&viewport);
+            painter.scale(scale, scale);
+            painter.translate(-frames[frame]);
+            const QRectF exposed(frames[frame], view.size());
+            foreach (CompositeLayerGroup *lg, mapComposite.layerGroups()) {
+                lg->prepareDrawing(&renderer, exposed.toAlignedRect());
+                renderer.drawTileLayerGroup(&painter, lg, exposed);
+            }
+            painter.end();
+            references += viewport;
+        }
+
+        // The direct pass left the layer groups prepared for its last frame,
+        // so the cache gets a MapComposite of its own that no one has drawn.
+        MapComposite cacheComposite(mapInfos[cell->mapFilePath()]);
+        foreach (WorldCellLot *lot, cell->lots())
+            cacheComposite.addMap(mapInfos[lot->mapName()], lot->pos(), lot->level());
+        cacheComposite.synch();
+
+        ZLevelRenderer cacheRenderer(cacheComposite.map());
+        cacheRenderer.setMaxLevel(cacheComposite.maxLevel());
+
+        QList<TileChunkCache*> caches;
+        foreach (CompositeLayerGroup *lg, cacheComposite.layerGroups())
+            caches += new TileChunkCache(lg, &cacheRenderer);
+
+        auto paintCached = [&](const QPointF &pos) {
+            bool queued = true;
+            while (queued) {
+                viewport.fill(Qt::transparent);
+                QPainter painter(&viewport);
+                painter.scale(scale, scale);
+                painter.translate(-pos);
+                const QRectF exposed(pos, view.size());
+                foreach (TileChunkCache *cache, caches)
+                    cache->paint(&painter, exposed);
+                queued = false;
+                foreach (TileChunkCache *cache, caches) {
+                    if (cache->isBusy()) {
+                        cache->waitForChunks();
+                        queued = true;
+                    }
+                }
+            }
+        };
+
+        qint64 slowestFrame = 0;
+        ok = ok && measure("Cell view pan chunk cache", frames.size(), [&]() {
+            foreach (TileChunkCache *cache, caches)
+                cache->clear();
+            QElapsedTimer timer;
+            foreach (const QPointF &pos, frames) {
+                timer.start();
+                paintCached(pos);
+                slowestFrame = qMax(slowestFrame, timer.nsecsElapsed());
+            }
+            return true;
+        });
+        if (ok) {
+            mResults.last().extra[QLatin1String("slowest_frame_nsecs")] = double(slowestFrame);
+            mResults.last().extra[QLatin1String("chunk_bytes")] = double(TileChunkCache::bytesUsed());
+        }
+
+        // Chunks are drawn at the same scale as the view, so only the edges
+        // of tiles may differ a little.  Missing tiles differ a lot.
+        int differingPixels = 0;
+        for (int i = 0; ok && i < checkFrames.size(); i++) {
+            foreach (TileChunkCache *cache, caches)
+                cache->clear();
+            paintCached(frames[checkFrames[i]]);
+            const QImage &reference = references[i];
+            for (int y = 0; y < viewport.height(); y++) {
+                const QRgb *a = reinterpret_cast<const QRgb*>(viewport.constScanLine(y));
+                const QRgb *b = reinterpret_cast<const QRgb*>(reference.constScanLine(y));
+                for (int x = 0; x < viewport.width(); x++) {
+                    if (qAbs(qRed(a[x]) - qRed(b[x])) > 16 || qAbs(qGreen(a[x]) - qGreen(b[x])) > 16 ||
+                            qAbs(qBlue(a[x]) - qBlue(b[x])) > 16 || qAbs(qAlpha(a[x]) - qAlpha(b[x])) > 16)
+                        ++differingPixels;
+                }
+            }
+        }
+        if (ok) {
+            mResults.last().extra[QLatin1String("differing_pixels")] = differingPixels;
+            if (differingPixels > checkFrames.size() * viewport.width() * viewport.height() / 100) {
+                mError = QLatin1String("chunk cache frames differ from the directly drawn ones");
+                ok = false;
+            }
+        }
+        for (int i = mResults.size() - 2; ok && i < mResults.size(); i++) {
+            mResults[i].extra[QLatin1String("scale")] = scale;
+            mResults[i].extra[QLatin1String("platform")] = QGuiApplication::platformName();
+        }
+
+        qDeleteAll(caches);
+    }
+
+    deleteCellMaps(mapInfos);
+    delete pzw;
+    return ok;
+}
+
+// Draws the first cell 8192 pixels wide with one QPainter, then with
+// BandedMapRenderer using more and more threads.  Fails unless each banded
+// image is the same as the single-painter one.
+bool Benchmark::benchBandedRender(const SyntheticWorld &world)
+{
+    WorldReader worldReader;
+    World *pzw = worldReader.readWorld(world.worldFileName());
+    if (!pzw) {
+        mError = worldReader.errorString();
+        return false;
+    }
+
+    WorldCell *cell = pzw->cellAt(0, 0);
+    QMap<QString,MapInfo*> mapInfos;
+    if (!readCellMaps(cell, mapInfos)) {
+        deleteCellMaps(mapInfos);
+        delete pzw;
+        return false;
+    }
+
+    bool ok;
+    {
+        MapComposite mapComposite(mapInfos[cell->mapFilePath()]);
+        foreach (WorldCellLot *lot, cell->lots())
+            mapComposite.addMap(mapInfos[lot->mapName()], lot->pos(), lot->level());
+        mapComposite.synch();
+
+        ZLevelRenderer renderer(mapComposite.map());
+        renderer.setMaxLevel(mapComposite.maxLevel());
+
+        const QRectF sceneRect = mapComposite.boundingRect(&renderer);
+        const qreal scale = 8192 / sceneRect.width();
+        const QSize imageSize = (sceneRect.size() * scale).toSize();
+        QTransform transform = QTransform::fromScale(scale, scale).translate(-sceneRect.left(), -sceneRect.top());
+        const QPainter::RenderHints hints = QPainter::SmoothPixmapTransform | QPainter::Antialiasing;
+
+        QImage reference(imageSize, QImage::Format_ARGB32);
+        ok = measure("Map image single painter", 1, [&]() {
+            reference.fill(Qt::transparent);
+            QPainter painter(&reference);
+            painter.setRenderHints(hints);
+            painter.setTransform(transform);
+            foreach (MapComposite::ZOrderItem zo, mapComposite.zOrder()) {
+                if (zo.group)
+                    renderer.drawTileLayerGroup(&painter, zo.group);
+                else if (TileLayer *tl = zo.layer->asTileLayer())
+                    renderer.drawTileLayer(&painter, tl);
+            }
+            return true;
+        });
+
+        QList<int> threadCounts;
+        for (int n = 1; n < QThread::idealThreadCount(); n *= 2)
+            threadCounts += n;
+        threadCounts += QThread::idealThreadCount();
+
+        foreach (int threadCount, threadCounts) {
+            if (!ok)
+                break;
+            QImage image(imageSize, QImage::Format_ARGB32);
+            BandedMapRenderer bandedRenderer(&mapComposite, &renderer);
+            bandedRenderer.setThreadCount(threadCount);
+            bandedRenderer.setRenderHints(hints);
+            const QByteArray name = "Map image banded x" + QByteArray::number(threadCount);
+            ok = measure(name.constData(), 1, [&]() {
+                image.fill(Qt::transparent);
+                return bandedRenderer.render(image, transform);
+            });
+            if (!ok)
+                break;
+
+            int differingPixels = 0;
+            for (int y = 0; y < image.height(); y++) {
+                const QRgb *a = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+                const QRgb *b = reinterpret_cast<const QRgb*>(reference.constScanLine(y));
+                for (int x = 0; x < image.width(); x++) {
+                    if (a[x] != b[x])
+                        ++differingPixels;
+                }
+            }
+            mResults.last().extra[QLatin1String("threads")] = threadCount;
+            mResults.last().extra[QLatin1String("differing_pixels")] = differingPixels;
+            if (differingPixels) {
+                mError = tr("%1 pixels drawn by %2 threads differ from one painter")
+                        .arg(differingPixels).arg(threadCount);
+                ok = false;
+            }
+        }
+    }
+
+    deleteCellMaps(mapInfos);
+    delete pzw;
+    return ok;
+}
+
+// Loads every tileset image in --tiles <dir> and its 2x subdirectory, and
+// reports how long it took and how much memory the tilesets use afterwards.
+// Then times the same thing through the decoded pixel cache, cold and warm.
+bool Benchmark::benchTilesetLoad()
+{
+    if (mTilesDirectory.isEmpty())
+        return true;
+
+    QStringList filters(QLatin1String("*.png"));
+    QDir dir(mTilesDirectory);
+    QFileInfoList files = dir.entryInfoList(filters, QDir::Files, QDir::Name);
+    QFileInfoList files2x = QDir(dir.filePath(QLatin1String("2x"))).entryInfoList(filters, QDir::Files, QDir::Name);
+    if (files.isEmpty() && files2x.isEmpty()) {
+        mError = tr("No tileset images in %1").arg(mTilesDirectory);
+        return false;
+    }
+
+    QList<Tileset*> tilesets;
+    qint64 memoryBefore = residentMemory();
+
+    bool ok = measure("Tileset load", files.size() + files2x.size(), [&]() {
+        qDeleteAll(tilesets);
+        tilesets.clear();
+        foreach (const QFileInfo &info, files + files2x) {
+            Tileset *ts = new Tileset(info.completeBaseName(), 64, 128);
+            if (files2x.contains(info))
+                ts->setImageSource2x(info.filePath());
+            tilesets += ts;
+            if (!ts->loadFromImage(QImage(info.filePath()), info.filePath())) {
+                mError = tr("Failed to load %1").arg(info.filePath());
+                return false;
+            }
+        }
+        return true;
+    });
+
+    if (ok) {
+        qint64 memoryAfter = residentMemory();
+        qint64 pixelBytes = 0;
+        int tileCount = 0;
+        foreach (Tileset *ts, tilesets) {
+            for (int i = 0; i < ts->tileCount(); i++) {
+                if (!ts->tileAt(i)->image().isNull())
+                    tileCount++;
+            }
+            // The tiles' images are views onto this, they have no pixels
+            // of their own.
+            if (!ts->image().isNull())
+                pixelBytes += qint64(ts->image().bytesPerLine()) * ts->image().height();
+        }
+        Result &result = mResults.last();
+        result.extra[QLatin1String("tilesets")] = tilesets.size();
+        result.extra[QLatin1String("tiles")] = tileCount;
+        result.extra[QLatin1String("atlas_bytes")] = double(pixelBytes);
+        if (memoryBefore >= 0 && memoryAfter >= 0)
+            result.extra[QLatin1String("resident_bytes")] = double(memoryAfter - memoryBefore);
+
+        QTextStream out(stdout);
+        out << "    " << tilesets.size() << " tilesets, " << tileCount << " tiles, "
+            << (pixelBytes / (1024 * 1024)) << " MB of atlas pixels";
+        if (memoryBefore >= 0 && memoryAfter >= 0)
+            out << ", " << ((memoryAfter - memoryBefore) / (1024 * 1024)) << " MB resident";
+        out << "\n";
+    }
+
+    qDeleteAll(tilesets);
+    tilesets.clear();
+
+    // Decoding through TilesetPixelCache, first with no cache files so every
+    // PNG is decoded and its cache file written, then reading the cache files.
+    // The cache files go in the benchmark directory, not the user's cache.
+    const bool cacheWasEnabled = TilesetPixelCache::isEnabled();
+    const QString cacheDirectory = TilesetPixelCache::cacheDirectory();
+    TilesetPixelCache::setEnabled(true);
+    TilesetPixelCache::setCacheDirectory(QDir(mDirectory).filePath(QLatin1String("tileset-cache")));
+
+    ok = ok && measure("Tileset load (pixel cache cold)", files.size() + files2x.size(), [&]() {
+        foreach (const QFileInfo &info, files + files2x) {
+            bool is2x = files2x.contains(info);
+            QFile::remove(TilesetPixelCache::cacheFileName(info.filePath(), is2x));
+            Tileset ts(info.completeBaseName(), 64, 128);
+            if (is2x)
+                ts.setImageSource2x(info.filePath());
+            QImage image = TilesetPixelCache().readImage(info.filePath(), is2x);
+            if (!ts.loadFromImage(image, info.filePath())) {
+                mError = tr("Failed to load %1").arg(info.filePath());
+                return false;
+            }
+        }
+        return true;
+    });
+
+    ok = ok && measure("Tileset load (pixel cache warm)", files.size() + files2x.size(), [&]() {
+        foreach (const QFileInfo &info, files + files2x) {
+            bool is2x = files2x.contains(info);
+            Tileset ts(info.completeBaseName(), 64, 128);
+            if (is2x)
+                ts.setImageSource2x(info.filePath());
+            TilesetPixelCache cache;
+            QImage image = cache.readCache(info.filePath(), is2x);
+            if (image.isNull()) {
+                mError = cache.errorString();
+                return false;
+            }
+            if (!ts.loadFromImage(image, info.filePath())) {
+                mError = tr("Failed to load %1").arg(info.filePath());
+                return false;
+            }
+        }
+        return true;
+    });
+
+    TilesetPixelCache::setCacheDirectory(cacheDirectory);
+    TilesetPixelCache::setEnabled(cacheWasEnabled);
+
+    return ok;
+}
+
+bool Benchmark::readCellMaps(WorldCell *cell, QMap<QString,MapInfo*> &mapInfos)
+{
+    QStringList fileNames(cell->mapFilePath());
+    foreach (WorldCellLot *lot, cell->lots())
+        fileNames += lot->mapName();
+    foreach (const QString &fileName, fileNames) {
+        if (mapInfos.contains(fileName))
+            continue;
+        MapReader reader;
+        Map *map = reader.readMap(fileName);
+        if (!map) {
+            mError = reader.errorString();
+            return false;
+        }
+        mapInfos[fileName] = MapManager::instance()->newFromMap(map, fileName);
+    }
+    return true;
+}
+
+void Benchmark::deleteCellMaps(const QMap<QString,MapInfo*> &mapInfos)
+{
+    foreach (MapInfo *mapInfo, mapInfos) {
+        qDeleteAll(mapInfo->map()->tilesets());
+        delete mapInfo->map();
+        delete mapInfo;
+    }
+}
+
+qint64 Benchmark::residentMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return qint64(pmc.WorkingSetSize);
+    return -1;
+#elif defined(Q_OS_LINUX)
+    QFile file(QLatin1String("/proc/self/statm"));
+    if (!file.open(QFile::ReadOnly))
+        return -1;
+    QList<QByteArray> fields = file.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+// The most memory used since resetPeakResidentMemory(), which only works on
+// Linux.
+qint64 Benchmark::peakResidentMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile file(QLatin1String("/proc/self/status"));
+    if (!file.open(QFile::ReadOnly))
+        return -1;
+    foreach (const QByteArray &line, file.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+bool Benchmark::resetPeakResidentMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile file(QLatin1String("/proc/self/clear_refs"));
+    if (!file.open(QFile::WriteOnly))
+        return false;
+    return file.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+bool Benchmark::measure(const char *name, int items, const std::function<bool()> &func)
+{
+    Result result;
+    result.name = QLatin1String(name);
+    result.items = items;
+
+    QTextStream out(stdout);
+    out << result.name << "...";
+    out.flush();
+
+    QElapsedTimer timer;
+    for (int i = 0; i < mIterations; i++) {
+        timer.start();
+        if (!func())
+            return false;
+        result.nsecs += timer.nsecsElapsed();
+    }
+
+    QList<qint64> sorted = result.nsecs;
+    std::sort(sorted.begin(), sorted.end());
+    out << " median " << QString::number(sorted[sorted.size() / 2] / 1000000.0, 'f', 2) << " ms\n";
+
+    mResults += result;
+    return true;
+}
+
+bool Benchmark::writeResults()
+{
+    QJsonArray results;
+    foreach (const Result &result, mResults) {
+        QList<qint64> sorted = result.nsecs;
+        std::sort(sorted.begin(), sorted.end());
+        qint64 total = 0;
+        QJsonArray samples;
+        foreach (qint64 nsecs, result.nsecs) {
+            total += nsecs;
+            samples += double(nsecs) / 1000000.0;
+        }
+        double median = sorted[sorted.size() / 2] / 1000000.0;
+
+        QJsonObject o;
+        o[QLatin1String("name")] = result.name;
+        o[QLatin1String("items")] = result.items;
+        o[QLatin1String("iterations")] = result.nsecs.size();
+        o[QLatin1String("min_ms")] = sorted.first() / 1000000.0;
+        o[QLatin1String("median_ms")] = median;
+        o[QLatin1String("mean_ms")] = total / 1000000.0 / result.nsecs.size();
+        o[QLatin1String("max_ms")] = sorted.last() / 1000000.0;
+        o[QLatin1String("median_ms_per_item")] = median / qMax(1, result.items);
+        o[QLatin1String("samples_ms")] = samples;
+        for (auto it = result.extra.constBegin(); it != result.extra.constEnd(); ++it)
+            o[it.key()] = it.value();
+        results += o;
+    }
+
+    QJsonObject root;
+    root[QLatin1String("seed")] = qint64(mSeed);
+    root[QLatin1String("world_size")] = mWorldSize;
+    root[QLatin1String("iterations")] = mIterations;
+    root[QLatin1String("version")] = QCoreApplication::applicationVersion();
+    root[QLatin1String("results")] = results;
+
+    QFile file(mOutputFile);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        mError = tr("Couldn't open %1 for writing.").arg(mOutputFile);
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QCoreApplication>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QStringList>
+
+#include <functional>
+
+class InGameMapCell;
+class MapInfo;
+class SyntheticWorld;
+class WorldCell;
+
+namespace Tiled {
+class Map;
+}
+
+/**
+  * Runs PZWorldEd --benchmark.  A SyntheticWorld is generated and each
+  * operation is timed over all of its cells several times, without creating
+  * the main window.  The results are written as JSON so runs can be compared.
+  */
+class Benchmark
+{
+    Q_DECLARE_TR_FUNCTIONS(Benchmark)
+
+public:
+    Benchmark();
+
+    /**
+      * Reads --benchmark <dir>, --seed <n>, --size <n>, --iterations <n>,
+      * --tiles <dir> and --output <file>.  Returns false if --benchmark
+      * wasn't given.
+      */
+    bool parseArguments(const QStringList &args);
+
+    int run();
+
+private:
+    bool benchTMXRead(const SyntheticWorld &world);
+    bool benchTMXWrite(const SyntheticWorld &world);
+    bool benchMapCache(const SyntheticWorld &world);
+    bool benchMapComposite(const SyntheticWorld &world);
+    bool benchBuildingConversion();
+    bool benchBuildingLayout();
+    bool benchLotFiles(const SyntheticWorld &world);
+    bool benchBmpBlender(const SyntheticWorld &world);
+    bool benchBmpToTmx(const SyntheticWorld &world);
+    bool benchTMXToBMP(const SyntheticWorld &world);
+    bool benchWorldReadWrite(const SyntheticWorld &world);
+    bool benchWorldBinary(const SyntheticWorld &world);
+    bool benchWorldScene();
+    bool benchInGameMap(const SyntheticWorld &world);
+    bool benchInGameMapScene();
+    bool benchLuaScript(const SyntheticWorld &world);
+    bool benchTileGrid(const SyntheticWorld &world);
+    bool benchCellViewPan(const SyntheticWorld &world);
+    bool benchBandedRender(const SyntheticWorld &world);
+    bool benchTilesetLoad();
+
+    /**
+      * Reads the map of \a cell and the maps of its lots into \a mapInfos,
+      * keyed by file name.  Free them with deleteCellMaps().
+      */
+    bool readCellMaps(WorldCell *cell, QMap<QString,MapInfo*> &mapInfos);
+    static void deleteCellMaps(const QMap<QString,MapInfo*> &mapInfos);
+    static bool sameTileLayers(const Tiled::Map *a, const Tiled::Map *b);
+    static bool sameObjectGroups(const Tiled::Map *a, const Tiled::Map *b);
+    static bool sameInGameMapCells(const InGameMapCell &a, const InGameMapCell &b);
+
+    /**
+      * Calls \a func mIterations times.  \a items is how many cells or files
+      * one call handles.  \a func returns false on error.
+      */
+    bool measure(const char *name, int items, const std::function<bool()> &func);
+
+    bool writeResults();
+
+    static qint64 residentMemory();
+    static qint64 peakResidentMemory();
+    static bool resetPeakResidentMemory();
+
+    struct Result
+    {
+        QString name;
+        int items;
+        QList<qint64> nsecs;
+        QJsonObject extra; // Added to the result as-is
+    };
+
+    QString mDirectory;
+    QString mOutputFile;
+    QString mTilesDirectory;
+    quint32 mSeed;
+    int mWorldSize;
+    int mIterations;
+    QList<Result> mResults;
+    QString mError;
+};
+
+#endif // BENCHMARK_H
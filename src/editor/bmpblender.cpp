@@ -18,6 +18,7 @@
 #include "bmpblender.h"
 
 #include "mapcomposite.h"
+#include "perftrace.h"
 #include "tilesetmanager.h"
 
 #include "BuildingEditor/buildingfloor.h"
@@ -149,6 +150,8 @@ void BmpBlender::flush(const MapRenderer *renderer, const QRect &rect, const QPo
 
 void BmpBlender::flush(const QRect &rect)
 {
+    PERF_SCOPE("Blend: flush");
+
     QRegion dirty = mDirtyRegion & rect;
     if (dirty.isEmpty())
         return;
@@ -208,7 +211,7 @@ void BmpBlender::tilesToPixels(int x1, int y1, int x2, int y2)
             if (col != qRgb(0, 0, 0))
                 continue;
 
-            if (Tile *tile = floorLayer->cellAt(x, y).tile) {
+            if (Tile *tile = floorLayer->cellAt(x, y).tile()) {
                 if (mFloorTileToRule.contains(tile))
                     mMap->rbmp(0).setPixel(x, y, mFloorTileToRule[tile]->mRule->color);
             }
@@ -309,6 +312,8 @@ static QStringList normalizeTileNames(const QStringList &tileNames)
 
 void BmpBlender::fromMap()
 {
+    PERF_SCOPE("Blend: from map");
+
     QSet<QString> tileNames;
 
     // We have to take care that any alias references exist, because when
@@ -503,6 +508,8 @@ static bool adjacentToNonBlack(const QImage &image1, const QImage &image2, int x
 
 void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
 {
+    PERF_SCOPE("Blend: images to grids");
+
     if (mTileGrids.isEmpty()) {
         foreach (QString layerName, mRuleLayers + mBlendLayers) {
             if (!mTileGrids.contains(layerName))
@@ -525,12 +532,18 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
 
     Cell emptyCell;
 
+    // Clear the area first, visiting only the cells that have tiles.
+    QRect r(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+    QList<SparseTileGrid*> tileGrids = mTileGrids.values();
+    tileGrids += mFakeTileGrid;
+    for (Tiled::SparseTileGrid *tileGrid : qAsConst(tileGrids)) {
+        SparseTileGrid::Iterator it(*tileGrid, r);
+        while (it.next())
+            tileGrid->replace(it.x(), it.y(), emptyCell);
+    }
+
     for (int y = y1; y <= y2; y++) {
         for (int x = x1; x <= x2; x++) {
-            for (Tiled::SparseTileGrid *tileGrid : qAsConst(mTileGrids)) {
-                tileGrid->replace(x, y, emptyCell);
-            }
-            mFakeTileGrid->replace(x, y, emptyCell);
             for (BlendGrid &blendGrid : mBlendGrids) {
                 blendGrid.remove(x + y * mMap->width());
             }
@@ -556,7 +569,7 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
             // Hack - If a pixel is black, and the user-drawn map tile in 0_Floor is
             // one of the Rules.txt tiles, pretend that that pixel exists in the image.
             if (floorLayer && col == black) {
-                if (Tile *tile = floorLayer->cellAt(x, y).tile) {
+                if (Tile *tile = floorLayer->cellAt(x, y).tile()) {
                     if (mFloorTileToRule.contains(tile)) {
                         RuleWrapper *ruleW = mFloorTileToRule[tile];
                         if (ruleW->mTiles.size()) {
@@ -590,6 +603,8 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
 
 void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
 {
+    PERF_SCOPE("Blend: edge tiles");
+
     x1 = qBound(0, x1, mMap->width() - 1);
     x2 = qBound(0, x2, mMap->width() - 1);
     y1 = qBound(0, y1, mMap->height() - 1);
@@ -612,10 +627,10 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
 
     for (int y = y1; y <= y2; y++) {
         for (int x = x1; x <= x2; x++) {
-            Tile *tile = grid->at(x, y).tile;
+            Tile *tile = grid->at(x, y).tile();
             if ((tile == nullptr) && ((mBlendEdgesEverywhere == true) ||
                                       adjacentToNonBlack(mMap->rbmpMain().rimage(), mMap->rbmpVeg().rimage(), x, y))) {
-                tile = mFakeTileGrid->at(x, y).tile;
+                tile = mFakeTileGrid->at(x, y).tile();
             }
 
             for (int dy = -1; dy <= +1; dy++)
@@ -628,7 +643,7 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
                     for (int i = 0; i < blendW->mBlend->exclude2.size(); i += 2) {
                         if (mapLayers.contains(blendW->mBlend->exclude2[i + 1])) {
                             TileLayer *mapLayer = mapLayers[blendW->mBlend->exclude2[i + 1]];
-                            if (Tile *tile = mapLayer->cellAt(x, y).tile) {
+                            if (Tile *tile = mapLayer->cellAt(x, y).tile()) {
                                 if (blendW->mExclude2Tiles[i/2].contains(tile)) {
                                     blendW = nullptr;
                                     break;
@@ -661,6 +676,8 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
 
 void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
 {
+    PERF_SCOPE("Blend: grids to layers");
+
     bool recreated = false;
     if (mTileLayers.isEmpty()) {
         foreach (QString layerName, mRuleLayers + mBlendLayers) {
@@ -678,6 +695,7 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
     y2 = qBound(0, y2, mMap->height() - 1);
 
     const Cell emptyCell;
+    QRect r(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
 
     foreach (QString layerName, mTileLayers.keys()) {
         SparseTileGrid *grid = mTileGrids[layerName];
@@ -685,29 +703,34 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
         BlendGrid &blendGrid = mBlendGrids[layerName];
         int n = mMap->indexOfLayer(layerName, Layer::TileLayerType);
         TileLayer *mapLayer = (n == -1) ? nullptr : mMap->layerAt(n)->asTileLayer();
-        for (int y = y1; y <= y2; y++) {
-            for (int x = x1; x <= x2; x++) {
-                Tile *tile = grid->at(x, y).tile;
-                if (tile == nullptr) {
-                    tl->setCell(x, y, emptyCell);
-                    continue;
-                }
-                // If the blend tile that is in the map is the expected one,
-                // don't override it.  This prevents a map tile which should
-                // be there from being overriden by this automatic one.
-                if (mapLayer != nullptr) {
-                    int index = x + y * mMap->width();
-                    if (blendGrid.contains(index)) {
-                        BlendWrapper *blendW = blendGrid[index];
-                        Tile *tile = mapLayer->cellAt(x, y).tile;
-                        if (blendW->mBlendTiles.contains(tile)) {
-                            tl->setCell(x, y, emptyCell);
-                            continue;
-                        }
+
+        // Only the non-empty cells of the layer and the grid are visited.
+        // First remove tiles that are no longer in the grid.
+        SparseTileGrid::Iterator itLayer = tl->cells(r);
+        while (itLayer.next()) {
+            if (grid->at(itLayer.x(), itLayer.y()).isEmpty())
+                tl->setCell(itLayer.x(), itLayer.y(), emptyCell);
+        }
+
+        SparseTileGrid::Iterator itGrid(*grid, r);
+        while (itGrid.next()) {
+            const int x = itGrid.x(), y = itGrid.y();
+            Tile *tile = itGrid.cell().tile();
+            // If the blend tile that is in the map is the expected one,
+            // don't override it.  This prevents a map tile which should
+            // be there from being overriden by this automatic one.
+            if (mapLayer != nullptr) {
+                int index = x + y * mMap->width();
+                if (blendGrid.contains(index)) {
+                    BlendWrapper *blendW = blendGrid[index];
+                    Tile *tile = mapLayer->cellAt(x, y).tile();
+                    if (blendW->mBlendTiles.contains(tile)) {
+                        tl->setCell(x, y, emptyCell);
+                        continue;
                     }
                 }
-                tl->setCell(x, y, Cell(tile));
             }
+            tl->setCell(x, y, Cell(tile));
         }
     }
 
@@ -716,7 +739,6 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
         updateWarnings();
     }
 
-    QRect r(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
     emit regionAltered(r);
 }
 
@@ -823,9 +845,9 @@ Tile *BmpBlender::getNeighbouringTile(int x, int y)
     if (x < 0 || y < 0 || x >= mMap->width() || y >= mMap->height())
         return nullptr;
     SparseTileGrid *grid = mTileGrids[STR_0Floor];
-    Tile *tile = grid->at(x, y).tile;
+    Tile *tile = grid->at(x, y).tile();
     if (!tile)
-        tile = mFakeTileGrid->at(x, y).tile;
+        tile = mFakeTileGrid->at(x, y).tile();
     return tile;
 }
 
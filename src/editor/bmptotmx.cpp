@@ -21,6 +21,7 @@
 #include "bmptotmxconfirmdialog.h"
 #include "mainwindow.h"
 #include "mapmanager.h"
+#include "perftrace.h"
 #include "preferences.h"
 #include "progress.h"
 #include "simplefile.h"
@@ -48,6 +49,8 @@
 #include <QMessageBox>
 #include <QPainter>
 #include <QStringList>
+#include <QThread>
+#include <QThreadPool>
 #include <QUndoStack>
 #include <QXmlStreamWriter>
 
@@ -70,6 +73,8 @@ void BMPToTMX::deleteInstance()
 
 BMPToTMX::BMPToTMX(QObject *parent)
     : QObject(parent)
+    , mMaxThreadCount(0)
+    , mCompressionLevel(-1)
 {
 }
 
@@ -81,6 +86,8 @@ BMPToTMX::~BMPToTMX()
 
 bool BMPToTMX::generateWorld(WorldDocument *worldDoc, BMPToTMX::GenerateMode mode)
 {
+    PERF_SCOPE("BMPToTMX: generate world");
+
     mWorldDoc = worldDoc;
     World *world = mWorldDoc->world();
 
@@ -145,6 +152,50 @@ bool BMPToTMX::generateWorld(WorldDocument *worldDoc, BMPToTMX::GenerateMode mod
             return true;
     }
 
+    if (!prepare(worldDoc))
+        return false;
+
+    PROGRESS progress(QLatin1String("Generating TMX files"));
+    QList<WorldCell*> cells;
+
+    if (mode == GenerateSelected) {
+        foreach (WorldCell *cell, worldDoc->selectedCells())
+            cells += cell;
+    } else {
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                cells += world->cellAt(x, y);
+            }
+        }
+    }
+
+    if (!generateCells(cells)) {
+        finish();
+        return false;
+    }
+
+    finish();
+
+    reportUnknownColors();
+
+    if (world->getBMPToTMXSettings().assignMapsToWorld)
+        assignMapsToCells(worldDoc, mode);
+
+    foreach (QString path, mNewFiles)
+        MapManager::instance()->newMapFileCreated(path);
+
+    // While displaying this, the MapManager's FileSystemWatcher might see some
+    // changed .tmx files, which results in the PROGRESS dialog being displayed.
+    // It's a bit odd to see the PROGRESS dialog blocked behind this messagebox.
+    QMessageBox::information(MainWindow::instance(),
+                             tr("BMP To TMX"), tr("Finished!"));
+    return true;
+}
+
+bool BMPToTMX::prepare(WorldDocument *worldDoc)
+{
+    mWorldDoc = worldDoc;
+
     if (!LoadBaseXML()) {
         mError += tr("\n(while reading MapBaseXML.txt)");
         return false;
@@ -163,55 +214,26 @@ bool BMPToTMX::generateWorld(WorldDocument *worldDoc, BMPToTMX::GenerateMode mod
 
     PROGRESS progress(QLatin1String("Reading BMP images"));
 
-    foreach (WorldBMP *bmp, world->bmps()) {
+    foreach (WorldBMP *bmp, mWorldDoc->world()->bmps()) {
         BMPToTMXImages *images = getImages(bmp->filePath(), bmp->pos());
         if (!images) {
-            goto errorExit;
+            finish();
+            return false;
         }
         mImages += images;
     }
 
-    progress.update(QLatin1String("Generating TMX files"));
-
     mUnknownColors.clear();
     mUnknownVegColors.clear();
     mNewFiles.clear();
 
-    if (mode == GenerateSelected) {
-        foreach (WorldCell *cell, worldDoc->selectedCells())
-            if (!generateCell(cell))
-                goto errorExit;
-    } else {
-        for (int y = 0; y < world->height(); y++) {
-            for (int x = 0; x < world->width(); x++) {
-                if (!generateCell(world->cellAt(x, y)))
-                    goto errorExit;
-            }
-        }
-    }
-
-    qDeleteAll(mImages);
-    mImages.clear();
-
-    reportUnknownColors();
-
-    if (world->getBMPToTMXSettings().assignMapsToWorld)
-        assignMapsToCells(worldDoc, mode);
-
-    foreach (QString path, mNewFiles)
-        MapManager::instance()->newMapFileCreated(path);
-
-    // While displaying this, the MapManager's FileSystemWatcher might see some
-    // changed .tmx files, which results in the PROGRESS dialog being displayed.
-    // It's a bit odd to see the PROGRESS dialog blocked behind this messagebox.
-    QMessageBox::information(MainWindow::instance(),
-                             tr("BMP To TMX"), tr("Finished!"));
     return true;
+}
 
-errorExit:
+void BMPToTMX::finish()
+{
     qDeleteAll(mImages);
     mImages.clear();
-    return false;
 }
 
 bool BMPToTMX::generateCell(WorldCell *cell)
@@ -220,6 +242,8 @@ bool BMPToTMX::generateCell(WorldCell *cell)
     if (!shouldGenerateCell(cell, bmpIndex))
         return true;
 
+    mCompressionLevel = Preferences::instance()->mapCompressionLevel();
+
     if (mWorldDoc->world()->getBMPToTMXSettings().updateExisting) {
         PROGRESS progress(tr("Updating TMX files (%1,%2)")
                           .arg(cell->x()).arg(cell->y()));
@@ -229,7 +253,139 @@ bool BMPToTMX::generateCell(WorldCell *cell)
     PROGRESS progress(tr("Generating TMX files (%1,%2)")
                       .arg(cell->x()).arg(cell->y()));
 
-    return WriteMap(cell, bmpIndex);
+    CellJob job;
+    job.mCell = cell;
+    job.mBmpIndex = bmpIndex;
+    job.mFilePath = tmxNameForCell(cell, cell->world()->bmps().at(bmpIndex));
+    job.mNewFile = !QFileInfo(job.mFilePath).exists();
+    job.mSuccess = WriteMap(job);
+    finishJob(job);
+    return job.mSuccess;
+}
+
+class BMPToTMX::WriteMapTask : public QRunnable
+{
+public:
+    WriteMapTask(BMPToTMX *owner, CellJob *job) :
+        mOwner(owner),
+        mJob(job)
+    {
+    }
+
+    void run()
+    {
+        // Once any cell fails, don't bother converting the remaining ones.
+        if (!mOwner->mAbortJobs.loadAcquire()) {
+            mJob->mSuccess = mOwner->WriteMap(*mJob);
+            if (!mJob->mSuccess)
+                mOwner->mAbortJobs.storeRelease(1);
+        }
+    }
+
+private:
+    BMPToTMX *mOwner;
+    CellJob *mJob;
+};
+
+bool BMPToTMX::generateCells(const QList<WorldCell *> &cells)
+{
+    // Updating existing files reads each TMX with MapReader, which loads
+    // tilesets and isn't safe to run on several threads at once.
+    if (mWorldDoc->world()->getBMPToTMXSettings().updateExisting) {
+        foreach (WorldCell *cell, cells) {
+            if (!generateCell(cell))
+                return false;
+        }
+        return true;
+    }
+
+    // Read on this thread, the tasks only see the copy.
+    mCompressionLevel = Preferences::instance()->mapCompressionLevel();
+
+    QList<CellJob*> jobs;
+    foreach (WorldCell *cell, cells) {
+        int bmpIndex;
+        if (!shouldGenerateCell(cell, bmpIndex))
+            continue;
+        CellJob *job = new CellJob;
+        job->mCell = cell;
+        job->mBmpIndex = bmpIndex;
+        job->mFilePath = tmxNameForCell(cell, cell->world()->bmps().at(bmpIndex));
+        job->mNewFile = !QFileInfo(job->mFilePath).exists();
+        jobs += job;
+    }
+
+    PROGRESS progress(tr("Generating TMX files (%1 cells)").arg(jobs.size()));
+
+    // Each task builds its own Map and BmpBlender and writes its own file.
+    // The rules, blends, layers, tilesets and BMP images are only read.
+    QThreadPool pool;
+    pool.setMaxThreadCount(maxThreadCount());
+    mAbortJobs.storeRelease(0);
+    foreach (CellJob *job, jobs) {
+        WriteMapTask *task = new WriteMapTask(this, job);
+        task->setAutoDelete(true);
+        pool.start(task);
+    }
+    while (!pool.waitForDone(100))
+        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+
+    // Merge the results in the same order the cells would have been written
+    // one at a time, so the unknown-color report doesn't depend on the
+    // number of threads.
+    bool success = true;
+    foreach (CellJob *job, jobs) {
+        if (!job->mSuccess) {
+            if (!job->mError.isEmpty()) {
+                mError = job->mError;
+                success = false;
+                break;
+            }
+            continue;
+        }
+        finishJob(*job);
+    }
+
+    qDeleteAll(jobs);
+    return success;
+}
+
+int BMPToTMX::maxThreadCount() const
+{
+    if (mMaxThreadCount > 0)
+        return mMaxThreadCount;
+    return qMax(1, QThread::idealThreadCount());
+}
+
+void BMPToTMX::finishJob(const BMPToTMX::CellJob &job)
+{
+    if (!job.mSuccess) {
+        mError = job.mError;
+        return;
+    }
+    mergeUnknownColors(mUnknownColors, job.mUnknownColors);
+    mergeUnknownColors(mUnknownVegColors, job.mUnknownVegColors);
+    if (job.mNewFile)
+        mNewFiles += job.mFilePath;
+}
+
+void BMPToTMX::mergeUnknownColors(UnknownColorMap &dest, const UnknownColorMap &src)
+{
+    UnknownColorMap::const_iterator it = src.constBegin();
+    for (; it != src.constEnd(); ++it) {
+        const QMap<QRgb,UnknownColor> &srcColors = it.value();
+        QMap<QRgb,UnknownColor> &destColors = dest[it.key()];
+        QMap<QRgb,UnknownColor>::const_iterator it2 = srcColors.constBegin();
+        for (; it2 != srcColors.constEnd(); ++it2) {
+            UnknownColor &color = destColors[it2.key()];
+            color.rgb = it2.key();
+            foreach (const QPoint &pos, it2.value().xy) {
+                if (color.xy.size() >= 50)
+                    break;
+                color.xy += pos;
+            }
+        }
+    }
 }
 
 QStringList BMPToTMX::supportedImageFormats()
@@ -243,6 +399,8 @@ QStringList BMPToTMX::supportedImageFormats()
 BMPToTMXImages *BMPToTMX::getImages(const QString &path, const QPoint &origin,
                                     QImage::Format format)
 {
+    PERF_SCOPE("BMPToTMX: read images");
+
     QFileInfo info(path);
     if (!info.exists()) {
         mError = tr("The image file can't be found.\n%1").arg(path);
@@ -638,8 +796,13 @@ void BMPToTMX::AddRule(BmpRule *rule)
         mRulesByColor1[rule->color] += mRules.last();
 }
 
-bool BMPToTMX::WriteMap(WorldCell *cell, int bmpIndex)
+bool BMPToTMX::WriteMap(BMPToTMX::CellJob &job) const
 {
+    PERF_SCOPE("BMPToTMX: write map");
+
+    WorldCell *cell = job.mCell;
+    int bmpIndex = job.mBmpIndex;
+
     Map map(Map::LevelIsometric, 300, 300, 64, 32);
     foreach (Tiled::Tileset *ts, TileMetaInfoMgr::instance()->tilesets())
         map.addTileset(ts);
@@ -684,16 +847,16 @@ bool BMPToTMX::WriteMap(WorldCell *cell, int bmpIndex)
                 for (int x = 0; x < map.width(); x++) {
                     QRgb rgb = rbmpMain.pixel(x, y);
                     if (!mRulesByColor0.contains(rgb)) {
-                        if (mUnknownColors[images->mPath][rgb].xy.size() < 50) {
-                            mUnknownColors[images->mPath][rgb].rgb = rgb;
-                            mUnknownColors[images->mPath][rgb].xy += QPoint(ix + x, iy + y);
+                        if (job.mUnknownColors[images->mPath][rgb].xy.size() < 50) {
+                            job.mUnknownColors[images->mPath][rgb].rgb = rgb;
+                            job.mUnknownColors[images->mPath][rgb].xy += QPoint(ix + x, iy + y);
                         }
                     }
                     rgb = rbmpVeg.pixel(x, y);
                     if (rgb != black && !mRulesByColor1.contains(rgb)) {
-                        if (mUnknownVegColors[images->mPath][rgb].xy.size() < 50) {
-                            mUnknownVegColors[images->mPath][rgb].rgb = rgb;
-                            mUnknownVegColors[images->mPath][rgb].xy += QPoint(ix + x, iy + y);
+                        if (job.mUnknownVegColors[images->mPath][rgb].xy.size() < 50) {
+                            job.mUnknownVegColors[images->mPath][rgb].rgb = rgb;
+                            job.mUnknownVegColors[images->mPath][rgb].xy += QPoint(ix + x, iy + y);
                         }
                     }
                 }
@@ -731,18 +894,18 @@ bool BMPToTMX::WriteMap(WorldCell *cell, int bmpIndex)
         map.rbmpVeg().rimage().fill(qRgb(0, 0, 0));
     }
 
-    QString filePath = tmxNameForCell(cell, cell->world()->bmps().at(bmpIndex));
-    if (!QFileInfo(filePath).exists())
-        mNewFiles += filePath;
-
     MapWriter writer;
     MapWriter::LayerDataFormat format = MapWriter::CSV;
     if (mWorldDoc->world()->getBMPToTMXSettings().compress)
         format = MapWriter::Base64Zlib;
     writer.setLayerDataFormat(format);
+    writer.setCompressionLevel(mCompressionLevel);
+    // The cells are already spread over a thread pool, so don't start
+    // another one for the layers of each map.
+    writer.setThreadCount(1);
     writer.setDtdEnabled(false);
-    if (!writer.writeMap(&map, filePath)) {
-        mError = writer.errorString();
+    if (!writer.writeMap(&map, job.mFilePath)) {
+        job.mError = writer.errorString();
         return false;
     }
     return true;
@@ -769,6 +932,8 @@ protected:
 
 bool BMPToTMX::UpdateMap(WorldCell *cell, int bmpIndex)
 {
+    PERF_SCOPE("BMPToTMX: update map");
+
     QString filePath = cell->mapFilePath();
     if (filePath.isEmpty() || !QFileInfo(filePath).exists())
         return true;
@@ -801,6 +966,7 @@ bool BMPToTMX::UpdateMap(WorldCell *cell, int bmpIndex)
 //    if (mWorldDoc->world()->getBMPToTMXSettings().compress)
         format = MapWriter::Base64Zlib;
     writer.setLayerDataFormat(format);
+    writer.setCompressionLevel(mCompressionLevel);
     writer.setDtdEnabled(false);
     if (!writer.writeMap(map, filePath)) {
         delete map;
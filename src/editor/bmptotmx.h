@@ -18,6 +18,7 @@
 #ifndef BMPTOTMX_H
 #define BMPTOTMX_H
 
+#include <QAtomicInt>
 #include <QImage>
 #include <QMap>
 #include <QObject>
@@ -56,7 +57,24 @@ public:
     };
 
     bool generateWorld(WorldDocument *worldDoc, GenerateMode mode);
+
+    /**
+      * Reads the rules, blends, map layers and BMP images for \a worldDoc.
+      * generateWorld() calls this.  To use generateCells() on its own,
+      * call this first and finish() afterwards to free the images.
+      */
+    bool prepare(WorldDocument *worldDoc);
+    void finish();
+
     bool generateCell(WorldCell *cell);
+    bool generateCells(const QList<WorldCell*> &cells);
+
+    /**
+     * The maximum number of cells converted at the same time by
+     * generateCells().  Zero means QThread::idealThreadCount().
+     */
+    void setMaxThreadCount(int count) { mMaxThreadCount = count; }
+    int maxThreadCount() const;
 
     QString errorString() const { return mError; }
 
@@ -83,8 +101,43 @@ private:
 
     void AddRule(Tiled::BmpRule *rule);
 
-    bool WriteMap(WorldCell *cell, int bmpIndex);
+    struct UnknownColor {
+        QRgb rgb;
+        QList<QPoint> xy;
+    };
+    typedef QMap<QString,QMap<QRgb,UnknownColor> > UnknownColorMap;
+
+    /**
+     * Everything WriteMap() needs to convert one cell, and everything it
+     * produces.  Jobs never touch BMPToTMX's members except for read-only
+     * access to the rules, blends, layers and BMP images, so several jobs
+     * may run at the same time.
+     */
+    class CellJob
+    {
+    public:
+        CellJob() :
+            mCell(0),
+            mBmpIndex(-1),
+            mNewFile(false),
+            mSuccess(false)
+        {}
+
+        WorldCell *mCell;
+        int mBmpIndex;
+        QString mFilePath;
+        bool mNewFile;
+        bool mSuccess;
+        QString mError;
+        UnknownColorMap mUnknownColors;
+        UnknownColorMap mUnknownVegColors;
+    };
+    class WriteMapTask;
+
+    bool WriteMap(CellJob &job) const;
     bool UpdateMap(WorldCell *cell, int bmpIndex);
+    void finishJob(const CellJob &job);
+    static void mergeUnknownColors(UnknownColorMap &dest, const UnknownColorMap &src);
 
     Tiled::Tile *getTileFromTileName(const QString &tileName);
 
@@ -135,14 +188,14 @@ private:
 
     QString mError;
 
-    struct UnknownColor {
-        QRgb rgb;
-        QList<QPoint> xy;
-    };
-    QMap<QString,QMap<QRgb,UnknownColor> > mUnknownColors;
-    QMap<QString,QMap<QRgb,UnknownColor> > mUnknownVegColors;
+    UnknownColorMap mUnknownColors;
+    UnknownColorMap mUnknownVegColors;
 
     QStringList mNewFiles;
+
+    int mMaxThreadCount;
+    int mCompressionLevel;
+    QAtomicInt mAbortJobs;
 };
 
 #endif // BMPTOTMX_H
@@ -28,6 +28,7 @@
 #include "preferences.h"
 #include "progress.h"
 #include "scenetools.h"
+#include "tilechunkcache.h"
 #include "tilesetmanager.h"
 #include "undoredo.h"
 #include "world.h"
@@ -1246,6 +1247,7 @@ CompositeLayerGroupItem::CompositeLayerGroupItem(CellScene *cellScene, Composite
     , mScene(cellScene)
     , mLayerGroup(layerGroup)
     , mRenderer(renderer)
+    , mChunkCache(nullptr)
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
@@ -1257,6 +1259,7 @@ CompositeLayerGroupItem::CompositeLayerGroupItem(CellScene *cellScene, Composite
 CompositeLayerGroupItem::~CompositeLayerGroupItem()
 {
     qDeleteAll(mVBO);
+    delete mChunkCache;
 }
 
 void CompositeLayerGroupItem::synchWithTileLayers()
@@ -1275,6 +1278,12 @@ QRectF CompositeLayerGroupItem::boundingRect() const
     return mBoundingRect;
 }
 
+void CompositeLayerGroupItem::invalidateChunkCache()
+{
+    if (mChunkCache)
+        mChunkCache->invalidate();
+}
+
 void CompositeLayerGroupItem::paint(QPainter *p, const QStyleOptionGraphicsItem *option, QWidget *)
 {
     if (mScene->isDestroying()) {
@@ -1326,8 +1335,15 @@ exposed = QRect(); // FIXME: flush area covered by whole VBOTiles
             }
         }
     } else {
-        mLayerGroup->prepareDrawing(mRenderer, option->exposedRect.toAlignedRect());
-        mRenderer->drawTileLayerGroup(p, mLayerGroup, option->exposedRect);
+        if (mChunkCache == nullptr) {
+            mChunkCache = new TileChunkCache(mLayerGroup, mRenderer);
+            QObject::connect(mChunkCache, &TileChunkCache::chunkReady, mChunkCache,
+                             [this](const QRectF &sceneRect) { update(sceneRect); });
+        }
+        if (!mChunkCache->paint(p, option->exposedRect)) {
+            mLayerGroup->prepareDrawing(mRenderer, option->exposedRect.toAlignedRect());
+            mRenderer->drawTileLayerGroup(p, mLayerGroup, option->exposedRect);
+        }
     }
 
 #ifdef _DEBUG
@@ -4369,6 +4385,7 @@ CellScene::CellScene(QObject *parent)
     , mDocument(0)
     , mRenderer(0)
     , mDnDItem(0)
+    , mInGameMapFeaturesItem(nullptr)
     , mDarkRectangle(new QGraphicsRectItem)
     , mGridItem(new CellGridItem(this))
     , mMapBordersItem(new QGraphicsPolygonItem)
@@ -4461,6 +4478,9 @@ void CellScene::setTool(AbstractTool *tool)
     }
 
     bool bFeatureToolActive = dynamic_cast<BaseInGameMapFeatureTool*>(mActiveTool) != nullptr;
+    if (mInGameMapFeaturesItem) {
+        mInGameMapFeaturesItem->setVisible(bFeatureToolActive);
+    }
     for (InGameMapFeatureItem* item : qAsConst(mFeatureItems)) {
         item->setVisible(bFeatureToolActive);
     }
@@ -4637,6 +4657,13 @@ InGameMapFeatureItem *CellScene::itemForInGameMapFeature(InGameMapFeature *featu
     return nullptr;
 }
 
+InGameMapFeature *CellScene::inGameMapFeatureAt(const QPointF &scenePos, int *coordIndex)
+{
+    if (!mInGameMapFeaturesItem)
+        return nullptr;
+    return mInGameMapFeaturesItem->featureAt(mInGameMapFeaturesItem->mapFromScene(scenePos), coordIndex);
+}
+
 void CellScene::setSelectedSubMapItems(const QSet<SubMapItem *> &selected)
 {
     QList<WorldCellLot*> selection;
@@ -4738,11 +4765,19 @@ void CellScene::setObjectVisible(WorldCellObject *obj, bool visible)
 
 void CellScene::setInGameMapFeatureVisible(InGameMapFeature *feature, bool visible)
 {
+    if (mInGameMapFeaturesItem) {
+        mInGameMapFeaturesItem->setFeatureVisible(feature, visible);
+    }
     if (InGameMapFeatureItem* item = itemForInGameMapFeature(feature)) {
         item->setVisible(visible);
     }
 }
 
+bool CellScene::isInGameMapFeatureVisible(InGameMapFeature *feature) const
+{
+    return mInGameMapFeaturesItem && mInGameMapFeaturesItem->isFeatureVisible(feature);
+}
+
 void CellScene::setLevelOpacity(int level, qreal opacity)
 {
     if (mTileLayerGroupItems.contains(level))
@@ -4760,6 +4795,7 @@ void CellScene::setLayerOpacity(int level, TileLayer *tl, qreal opacity)
 {
     if (mTileLayerGroupItems.contains(level) && (mTileLayerGroupItems[level]->layerGroup()->layers().indexOf(tl) != -1)) {
         mTileLayerGroupItems[level]->layerGroup()->setLayerOpacity(tl, opacity);
+        mTileLayerGroupItems[level]->invalidateChunkCache();
         mTileLayerGroupItems[level]->update();
     }
 }
@@ -4771,6 +4807,14 @@ qreal CellScene::layerOpacity(int level, Tiled::TileLayer *tl) const
     return 1.0;
 }
 
+void CellScene::invalidateTileCaches()
+{
+    foreach (CompositeLayerGroupItem *item, mTileLayerGroupItems) {
+        item->invalidateChunkCache();
+        item->update();
+    }
+}
+
 void CellScene::highlightRoomUnderPointerChanged(bool highlight)
 {
     Q_UNUSED(highlight)
@@ -4785,6 +4829,7 @@ void CellScene::setHighlightRoomPosition(const QPoint &tilePos)
     if (buildingRgn - roomRgn != mMapComposite->suppressRegion() ||
             document()->currentLevel() != mMapComposite->suppressLevel()) {
         mMapComposite->setSuppressRegion(buildingRgn - roomRgn, document()->currentLevel());
+        invalidateTileCaches();
         update();
     }
     mHighlightRoomPosition = tilePos;
@@ -4861,6 +4906,9 @@ void CellScene::loadMap()
         mSubMapItems.clear();
         mSelectedSubMapItems.clear();
         mRoadItems.clear();
+        mInGameMapFeaturesItem = nullptr;
+        mFeatureItems.clear();
+        mSelectedFeatureItems.clear();
 
         // mMap, mMapInfo are shared, don't destroy
         mMap = nullptr;
@@ -4953,12 +5001,12 @@ void CellScene::loadMap()
         mRoadItems += item;
     }
 
-    for (auto* feature : cell()->inGameMap().mFeatures) {
-        InGameMapFeatureItem* item = new InGameMapFeatureItem(feature, this);
-        item->setZValue(ZVALUE_ROADITEM_UNSELECTED);
-        addItem(item);
-        mFeatureItems += item;
-    }
+    // One item draws every feature, the selected ones get their own item.
+    mInGameMapFeaturesItem = new InGameMapFeaturesItem(cell(), mRenderer);
+    mInGameMapFeaturesItem->setZValue(ZVALUE_ROADITEM_UNSELECTED);
+    mInGameMapFeaturesItem->setVisible(dynamic_cast<BaseInGameMapFeatureTool*>(mActiveTool) != nullptr);
+    addItem(mInGameMapFeaturesItem);
+    selectedInGameMapFeaturesChanged();
 
     // Explicitly set sceneRect, otherwise it will just be as large as is needed to display
     // all the items in the scene (without getting smaller, ever).
@@ -5196,20 +5244,15 @@ void CellScene::propertiesChanged(PropertyHolder* ph)
 
 void CellScene::inGameMapFeatureAdded(WorldCell *cell, int index)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
-    InGameMapFeature* feature = cell->inGameMap().mFeatures[index];
-    InGameMapFeatureItem* item = new InGameMapFeatureItem(feature, this);
-    item->setZValue(ZVALUE_ROADITEM_UNSELECTED);
-    addItem(item);
-    mFeatureItems += item;
-    doLater(ZOrder);
+    mInGameMapFeaturesItem->featureAdded(index);
 }
 
 void CellScene::inGameMapFeatureAboutToBeRemoved(WorldCell *cell, int index)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
     InGameMapFeature *feature = cell->inGameMap().mFeatures.at(index);
@@ -5218,16 +5261,18 @@ void CellScene::inGameMapFeatureAboutToBeRemoved(WorldCell *cell, int index)
         mSelectedFeatureItems.remove(item);
         removeItem(item);
         delete item;
-        doLater(ZOrder);
     }
+    mInGameMapFeaturesItem->featureAboutToBeRemoved(index);
 
 }
 
 void CellScene::inGameMapPointMoved(WorldCell *cell, int featureIndex, int coordIndex, int pointIndex)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
+    mInGameMapFeaturesItem->featureChanged(featureIndex);
+
     InGameMapFeature *feature = cell->inGameMap().mFeatures.at(featureIndex);
     if (auto* item = itemForInGameMapFeature(feature)) {
         item->synchWithFeature();
@@ -5236,9 +5281,11 @@ void CellScene::inGameMapPointMoved(WorldCell *cell, int featureIndex, int coord
 
 void CellScene::inGameMapGeometryChanged(WorldCell *cell, int featureIndex)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
+    mInGameMapFeaturesItem->featureChanged(featureIndex);
+
     InGameMapFeature *feature = cell->inGameMap().mFeatures.at(featureIndex);
     if (auto* item = itemForInGameMapFeature(feature)) {
         item->synchWithFeature();
@@ -5272,24 +5319,41 @@ void CellScene::inGameMapHoleRemoved(WorldCell *cell, int featureIndex, int hole
     }
 }
 
+// Selected features are drawn by an InGameMapFeatureItem, which the
+// EditInGameMapFeatureTool adds handles to.  The rest are drawn by
+// mInGameMapFeaturesItem.
 void CellScene::selectedInGameMapFeaturesChanged()
 {
-    auto& selected = document()->selectedInGameMapFeatures();
+    if (!mInGameMapFeaturesItem)
+        return;
 
-    QSet<InGameMapFeatureItem*> items;
-    for (auto* feature : selected) {
-        items.insert(itemForInGameMapFeature(feature));
-    }
+    auto& selected = document()->selectedInGameMapFeatures();
 
-    for (auto* item : mSelectedFeatureItems - items) {
-        item->setSelected(false);
+    for (auto* item : QList<InGameMapFeatureItem*>(mFeatureItems)) {
+        if (selected.contains(item->feature()))
+            continue;
+        mInGameMapFeaturesItem->setFeatureHasItem(item->feature(), false);
+        mFeatureItems.removeAll(item);
+        removeItem(item);
+        delete item;
     }
 
-    for (auto* item : items - mSelectedFeatureItems) {
+    for (auto* feature : selected) {
+        if (itemForInGameMapFeature(feature))
+            continue;
+        InGameMapFeatureItem* item = new InGameMapFeatureItem(feature, this);
+        item->setZValue(ZVALUE_ROADITEM_UNSELECTED);
+        item->setVisible(mInGameMapFeaturesItem->isVisible() && mInGameMapFeaturesItem->isFeatureVisible(feature));
         item->setSelected(true);
+        addItem(item);
+        mFeatureItems += item;
+        mInGameMapFeaturesItem->setFeatureHasItem(feature, true);
     }
 
-    mSelectedFeatureItems = items;
+    mSelectedFeatureItems.clear();
+    for (auto* item : qAsConst(mFeatureItems)) {
+        mSelectedFeatureItems.insert(item);
+    }
 }
 
 void CellScene::selectedInGameMapPointsChanged()
@@ -5606,8 +5670,10 @@ void CellScene::handlePendingUpdates()
         }
     }
     if (mPendingFlags & Paint) {
-        foreach (CompositeLayerGroupItem *item, mPendingGroupItems)
+        foreach (CompositeLayerGroupItem *item, mPendingGroupItems) {
+            item->invalidateChunkCache();
             item->update();
+        }
     }
 
     if (mPendingFlags & ZOrder)
@@ -5694,9 +5760,12 @@ void CellScene::roadsChanged()
 {
     mMapComposite->generateRoadLayers(QPoint(cell()->x() * 300, cell()->y() * 300),
                                       world()->roads());
-    if (mMapComposite->tileLayersForLevel(0))
-        if (mTileLayerGroupItems.contains(0))
+    if (mMapComposite->tileLayersForLevel(0)) {
+        if (mTileLayerGroupItems.contains(0)) {
+            mTileLayerGroupItems[0]->invalidateChunkCache();
             mTileLayerGroupItems[0]->update();
+        }
+    }
 }
 
 // Called when our MapComposite adds a sub-map asynchronously.
@@ -5823,8 +5892,10 @@ void CellScene::tilesetChanged(Tileset *tileset)
     if (!mMapComposite)
         return;
 
-    if (mMapComposite->isTilesetUsed(tileset))
+    if (mMapComposite->isTilesetUsed(tileset)) {
+        invalidateTileCaches();
         update();
+    }
 }
 
 bool CellScene::mapAboutToChange(MapInfo *mapInfo)
@@ -6113,10 +6184,13 @@ AdjacentMap::AdjacentMap(CellScene *scene, WorldCell *cell) :
     mMapComposite(nullptr),
     mMapInfo(nullptr),
     mObjectItemParent(new QGraphicsItemGroup),
-    mInGameMapFeatureParent(new QGraphicsItemGroup)
+    mInGameMapFeatureParent(new QGraphicsItemGroup),
+    mInGameMapFeaturesItem(new InGameMapFeaturesItem(cell, scene->renderer(), mInGameMapFeatureParent))
 {
     PROGRESS progress(tr("Loading adjacent cell %1,%2").arg(cell->x()).arg(cell->y()));
 
+    mInGameMapFeaturesItem->setAdjacent(true);
+
     mScene->addItem(mObjectItemParent);
     mScene->addItem(mInGameMapFeatureParent);
 
@@ -6191,16 +6265,6 @@ ObjectItem *AdjacentMap::itemForObject(WorldCellObject *obj)
     return 0;
 }
 
-InGameMapFeatureItem *AdjacentMap::itemForFeature(InGameMapFeature *feature)
-{
-    for (InGameMapFeatureItem *item : qAsConst(mInGameMapFeatureItems)) {
-        if (item->feature() == feature) {
-            return item;
-        }
-    }
-    return nullptr;
-}
-
 void AdjacentMap::removeItems()
 {
     delete mObjectItemParent;
@@ -6209,7 +6273,7 @@ void AdjacentMap::removeItems()
 
     delete mInGameMapFeatureParent;
     mInGameMapFeatureParent = nullptr;
-    mInGameMapFeatureItems.clear(); // deleted with parent
+    mInGameMapFeaturesItem = nullptr; // deleted with parent
 }
 
 void AdjacentMap::cellMapFileChanged(WorldCell *_cell)
@@ -6419,42 +6483,29 @@ void AdjacentMap::propertiesChanged(PropertyHolder *ph)
 
 void AdjacentMap::inGameMapFeatureAdded(WorldCell *cell, int index)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
-    InGameMapFeature *feature = cell->inGameMap().features().at(index);
-    InGameMapFeatureItem *item = new InGameMapFeatureItem(feature, scene(), mInGameMapFeatureParent);
-    item->setAdjacent(true);
-    item->synchWithFeature();
-    mInGameMapFeatureItems.insert(index, item);
-
-    setZOrder();
+    mInGameMapFeaturesItem->featureAdded(index);
 }
 
 void AdjacentMap::inGameMapFeatureAboutToBeRemoved(WorldCell *cell, int index)
 {
-    if (cell != this->cell())
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
         return;
 
-    InGameMapFeature *feature = cell->inGameMap().features().at(index);
-    if (InGameMapFeatureItem *item = itemForFeature(feature)) {
-        mInGameMapFeatureItems.removeAll(item);
-        mScene->removeItem(item);
-        delete item;
-
-        setZOrder();
-    }
+    mInGameMapFeaturesItem->featureAboutToBeRemoved(index);
 }
 
 void AdjacentMap::inGameMapPointMoved(WorldCell *cell, int featureIndex, int coordIndex, int pointIndex)
 {
+    Q_UNUSED(coordIndex)
     Q_UNUSED(pointIndex)
 
-    InGameMapFeature *feature = cell->inGameMap().features().at(featureIndex);
-    if (InGameMapFeatureItem *item = itemForFeature(feature)) {
-        item->synchWithFeature();
-        setZOrder();
-    }
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
+        return;
+
+    mInGameMapFeaturesItem->featureChanged(featureIndex);
 }
 
 void AdjacentMap::inGameMapPropertiesChanged(WorldCell *cell, int featureIndex)
@@ -6466,11 +6517,10 @@ void AdjacentMap::inGameMapPropertiesChanged(WorldCell *cell, int featureIndex)
 
 void AdjacentMap::inGameMapGeometryChanged(WorldCell *cell, int featureIndex)
 {
-    InGameMapFeature *feature = cell->inGameMap().features().at(featureIndex);
-    if (InGameMapFeatureItem *item = itemForFeature(feature)) {
-        item->synchWithFeature();
-        setZOrder();
-    }
+    if (cell != this->cell() || !mInGameMapFeaturesItem)
+        return;
+
+    mInGameMapFeaturesItem->featureChanged(featureIndex);
 }
 
 void AdjacentMap::mapLoaded(MapInfo *mapInfo)
@@ -6503,14 +6553,7 @@ void AdjacentMap::mapLoaded(MapInfo *mapInfo)
             mMapComposite->ensureMaxLevels(obj->level());
         }
 
-        qDeleteAll(mInGameMapFeatureItems);
-        mInGameMapFeatureItems.clear();
-        for (InGameMapFeature* feature : cell()->inGameMap().features()) {
-            InGameMapFeatureItem *item = new InGameMapFeatureItem(feature, scene(), mInGameMapFeatureParent);
-            item->setAdjacent(true);
-            item->synchWithFeature();
-            mInGameMapFeatureItems += item;
-        }
+        mInGameMapFeaturesItem->synchWithCell();
 
         setZOrder();
 
@@ -6589,8 +6632,8 @@ void AdjacentMap::synchObjectItemVisibility()
 void AdjacentMap::setTool(AbstractTool *tool)
 {
     bool bFeatureToolActive = dynamic_cast<BaseInGameMapFeatureTool*>(tool) != nullptr;
-    for (InGameMapFeatureItem *item : mInGameMapFeatureItems) {
-        item->setVisible(bFeatureToolActive);
+    if (mInGameMapFeaturesItem) {
+        mInGameMapFeaturesItem->setVisible(bFeatureToolActive);
     }
 }
 
@@ -6606,9 +6649,6 @@ void AdjacentMap::sceneRectChanged()
         item->synchWithObject();
 
     mInGameMapFeatureParent->setPos(offset);
-    for (InGameMapFeatureItem *item : mInGameMapFeatureItems) {
-        item->synchWithFeature();
-}
 }
 
 void AdjacentMap::loadMap()
@@ -62,6 +62,7 @@ class WorldObjectGroup;
 */
 class InGameMapFeature;
 class InGameMapFeatureItem;
+class InGameMapFeaturesItem;
 
 namespace Tiled {
 class MapRenderer;
@@ -514,6 +515,7 @@ private:
 };
 
 class LayerGroupVBO;
+class TileChunkCache;
 
 /**
   * Item that draws all the TileLayers on a single level.
@@ -531,6 +533,12 @@ public:
 
     CompositeLayerGroup *layerGroup() const { return mLayerGroup; }
 
+    /**
+      * Redraws the cached tile images when not using OpenGL.  Only needed
+      * for changes the CompositeLayerGroup doesn't count itself.
+      */
+    void invalidateChunkCache();
+
 private:
     CellScene *mScene;
     CompositeLayerGroup *mLayerGroup;
@@ -538,6 +546,7 @@ private:
     QRectF mBoundingRect;
     friend class LayerGroupVBO;
     std::array<LayerGroupVBO*,9> mVBO;
+    TileChunkCache *mChunkCache;
 };
 
 class AdjacentMap : public QObject
@@ -556,7 +565,6 @@ public:
     { return mCell; }
 
     ObjectItem *itemForObject(WorldCellObject *obj);
-    InGameMapFeatureItem *itemForFeature(InGameMapFeature *feature);
 
     void removeItems();
 
@@ -625,7 +633,7 @@ private:
     QGraphicsItem *mObjectItemParent;
     QList<ObjectItem*> mObjectItems;
     QGraphicsItem *mInGameMapFeatureParent;
-    QList<InGameMapFeatureItem*> mInGameMapFeatureItems;
+    InGameMapFeaturesItem *mInGameMapFeaturesItem;
 };
 
 class QOpenGLContext;
@@ -780,6 +788,7 @@ public:
 
     ObjectItem *itemForObject(WorldCellObject *obj);
     InGameMapFeatureItem* itemForInGameMapFeature(InGameMapFeature* feature);
+    InGameMapFeature *inGameMapFeatureAt(const QPointF &scenePos, int *coordIndex = nullptr);
 
     void setSelectedSubMapItems(const QSet<SubMapItem*> &selected);
     const QSet<SubMapItem*> &selectedSubMapItems() const
@@ -798,6 +807,7 @@ public:
     void setSubMapVisible(WorldCellLot *lot, bool visible);
     void setObjectVisible(WorldCellObject *obj, bool visible);
     void setInGameMapFeatureVisible(InGameMapFeature *feature, bool visible);
+    bool isInGameMapFeatureVisible(InGameMapFeature *feature) const;
 
     void setLevelOpacity(int level, qreal opacity);
     qreal levelOpacity(int level);
@@ -805,6 +815,12 @@ public:
     void setLayerOpacity(int level, Tiled::TileLayer *tl, qreal opacity);
     qreal layerOpacity(int level, Tiled::TileLayer *tl) const;
 
+    /**
+      * Redraws every level's cached tile images, for changes to the
+      * MapComposite that aren't otherwise reported to the scene.
+      */
+    void invalidateTileCaches();
+
     void setHighlightRoomPosition(const QPoint &tilePos);
     QRegion getBuildingRegion(const QPoint &tilePos, QRegion &roomRgn);
     QString roomNameAt(const QPointF &scenePos);
@@ -982,7 +998,8 @@ private:
     QSet<ObjectItem*> mSelectedObjectItems;
     QList<CellRoadItem*> mRoadItems;
     QSet<CellRoadItem*> mSelectedRoadItems;
-    QList<InGameMapFeatureItem*> mFeatureItems;
+    InGameMapFeaturesItem *mInGameMapFeaturesItem;
+    QList<InGameMapFeatureItem*> mFeatureItems; // selected features only
     QSet<InGameMapFeatureItem*> mSelectedFeatureItems;
     QGraphicsRectItem *mDarkRectangle;
     CellGridItem *mGridItem;
@@ -73,6 +73,7 @@ SOURCES += main.cpp\
     InGameMap/ingamemappropertiesform.cpp \
     InGameMap/ingamemappropertydialog.cpp \
     InGameMap/ingamemapreader.cpp \
+    InGameMap/ingamemapreaderbinary.cpp \
     InGameMap/ingamemapscene.cpp \
     InGameMap/ingamemapundo.cpp \
     InGameMap/ingamemapwriter.cpp \
@@ -80,6 +81,11 @@ SOURCES += main.cpp\
     tilesetstxtfile.cpp \
     worldview.cpp \
     worldscene.cpp \
+    worldwriterbinary.cpp \
+    worldreaderbinary.cpp \
+    worldbinary.cpp \
+    worldscript.cpp \
+    worldsearchindex.cpp \
     world.cpp \
     worlddocument.cpp \
     worldcell.cpp \
@@ -94,9 +100,13 @@ SOURCES += main.cpp\
     mapimagemanager.cpp \
     undoredo.cpp \
     undodock.cpp \
+    undomemory.cpp \
     mapmanager.cpp \
     basegraphicsview.cpp \
     progress.cpp \
+    benchmark.cpp \
+    syntheticworld.cpp \
+    perftrace.cpp \
     zoomable.cpp \
     scenetools.cpp \
     worldwriter.cpp \
@@ -121,7 +131,10 @@ SOURCES += main.cpp\
     copypastedialog.cpp \
     clipboard.cpp \
     lotfilesmanager.cpp \
+    lotinspector.cpp \
     road.cpp \
+    bandedmaprenderer.cpp \
+    roadlayercache.cpp \
     roadsdock.cpp \
     simplefile.cpp \
     bmptotmx.cpp \
@@ -133,11 +146,13 @@ SOURCES += main.cpp\
     newworlddialog.cpp \
     tilemetainfomgr.cpp \
     tilesetmanager.cpp \
+    tilechunkcache.cpp \
     BuildingEditor/furnituregroups.cpp \
     BuildingEditor/buildingtmx.cpp \
     BuildingEditor/buildingtiles.cpp \
     BuildingEditor/buildingobjects.cpp \
     BuildingEditor/buildingmap.cpp \
+    BuildingEditor/buildingmapcache.cpp \
     BuildingEditor/buildingfloor.cpp \
     BuildingEditor/building.cpp \
     BuildingEditor/buildingwriter.cpp \
@@ -173,6 +188,7 @@ HEADERS  += mainwindow.h \
     generatelotsfailuredialog.h \
 	Logger.h \
     InGameMap/clipper.hpp \
+    InGameMap/ingamemapbinary.h \
     InGameMap/ingamemapcell.h \
     InGameMap/ingamemapdock.h \
     InGameMap/ingamemapfeaturegenerator.h \
@@ -180,6 +196,7 @@ HEADERS  += mainwindow.h \
     InGameMap/ingamemappropertiesform.h \
     InGameMap/ingamemappropertydialog.h \
     InGameMap/ingamemapreader.h \
+    InGameMap/ingamemapreaderbinary.h \
     InGameMap/ingamemapscene.h \
     InGameMap/ingamemapundo.h \
     InGameMap/ingamemapwriter.h \
@@ -189,6 +206,11 @@ HEADERS  += mainwindow.h \
     tilesetstxtfile.h \
     worldview.h \
     worldscene.h \
+    worldwriterbinary.h \
+    worldreaderbinary.h \
+    worldbinary.h \
+    worldscript.h \
+    worldsearchindex.h \
     world.h \
     worlddocument.h \
     worldcell.h \
@@ -203,9 +225,13 @@ HEADERS  += mainwindow.h \
     mapimagemanager.h \
     undoredo.h \
     undodock.h \
+    undomemory.h \
     mapmanager.h \
     basegraphicsview.h \
     progress.h \
+    benchmark.h \
+    syntheticworld.h \
+    perftrace.h \
     zoomable.h \
     scenetools.h \
     worldwriter.h \
@@ -228,7 +254,10 @@ HEADERS  += mainwindow.h \
     copypastedialog.h \
     clipboard.h \
     lotfilesmanager.h \
+    lotinspector.h \
     road.h \
+    bandedmaprenderer.h \
+    roadlayercache.h \
     roadsdock.h \
     simplefile.h \
     bmptotmx.h \
@@ -240,11 +269,13 @@ HEADERS  += mainwindow.h \
     newworlddialog.h \
     tilemetainfomgr.h \
     tilesetmanager.h \
+    tilechunkcache.h \
     BuildingEditor/furnituregroups.h \
     BuildingEditor/buildingtmx.h \
     BuildingEditor/buildingtiles.h \
     BuildingEditor/buildingobjects.h \
     BuildingEditor/buildingmap.h \
+    BuildingEditor/buildingmapcache.h \
     BuildingEditor/buildingfloor.h \
     BuildingEditor/building.h \
     BuildingEditor/buildingwriter.h \
@@ -180,7 +180,7 @@ void LootWindow::examineMapComposite(MapComposite *mc)
                 cells.resize(0);
                 lg->orderedCellsAt2(QPoint(x, y), cells);
                 foreach (const Tiled::Cell *cell, cells) {
-                    examineTile(x, y, lg->level(), cell->tile);
+                    examineTile(x, y, lg->level(), cell->tile());
                 }
             }
         }
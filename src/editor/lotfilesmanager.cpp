@@ -24,6 +24,7 @@
 #include "mapmanager.h"
 #include "mapobject.h"
 #include "objectgroup.h"
+#include "perftrace.h"
 #include "preferences.h"
 #include "progress.h"
 #include "tilemetainfomgr.h"
@@ -101,27 +102,12 @@ struct GenerateCellFailure
 
 bool LotFilesManager::generateWorld(WorldDocument *worldDoc, GenerateMode mode)
 {
-    mWorldDoc = worldDoc;
+    PERF_SCOPE("Lots: generate world");
 
     PROGRESS progress(QLatin1String("Reading Zombie Spawn Map"));
 
-    const GenerateLotsSettings &lotSettings = mWorldDoc->world()->getGenerateLotsSettings();
-    QString spawnMap = lotSettings.zombieSpawnMap;
-    if (!QFileInfo(spawnMap).exists()) {
-        mError = tr("Couldn't find the Zombie Spawn Map image.\n%1")
-                .arg(spawnMap);
+    if (!prepare(worldDoc))
         return false;
-    }
-    ZombieSpawnMap = QImage(spawnMap);
-    if (ZombieSpawnMap.isNull()) {
-        mError = tr("Couldn't read the Zombie Spawn Map image.\n%1")
-                .arg(spawnMap);
-        return false;
-    }
-
-    if (!Navigate::IsoGridSquare::loadTileDefFiles(lotSettings, mError)) {
-        return false;
-    }
 
     QString tilesDirectory = TileMetaInfoMgr::instance()->tilesDirectory();
     if (tilesDirectory.isEmpty() || !QFileInfo(tilesDirectory).exists()) {
@@ -137,8 +123,6 @@ bool LotFilesManager::generateWorld(WorldDocument *worldDoc, GenerateMode mode)
     }
 #endif
 
-    mStats = LotFile::Stats();
-
     progress.update(QLatin1String("Generating .lot files"));
 
     World *world = worldDoc->world();
@@ -188,18 +172,54 @@ bool LotFilesManager::generateWorld(WorldDocument *worldDoc, GenerateMode mode)
     return true;
 }
 
-bool LotFilesManager::generateCell(WorldCell *cell)
+bool LotFilesManager::prepare(WorldDocument *worldDoc)
 {
-//    if (cell->x() != 5 || cell->y() != 3) return true;
-    if (cell->mapFilePath().isEmpty())
-        return true;
+    mWorldDoc = worldDoc;
+
+    const GenerateLotsSettings &lotSettings = mWorldDoc->world()->getGenerateLotsSettings();
+    QString spawnMap = lotSettings.zombieSpawnMap;
+    if (!QFileInfo(spawnMap).exists()) {
+        mError = tr("Couldn't find the Zombie Spawn Map image.\n%1")
+                .arg(spawnMap);
+        return false;
+    }
+    ZombieSpawnMap = QImage(spawnMap);
+    if (ZombieSpawnMap.isNull()) {
+        mError = tr("Couldn't read the Zombie Spawn Map image.\n%1")
+                .arg(spawnMap);
+        return false;
+    }
 
+    if (!Navigate::IsoGridSquare::loadTileDefFiles(lotSettings, mError)) {
+        return false;
+    }
+
+    mStats = LotFile::Stats();
+
+    return true;
+}
+
+bool LotFilesManager::spawnMapCovers(WorldCell *cell)
+{
     if (cell->x() * 30 + 30 > ZombieSpawnMap.width() ||
             cell->y() * 30 + 30 > ZombieSpawnMap.height()) {
         mError = tr("The Zombie Spawn Map doesn't cover cell %1,%2.")
                 .arg(cell->x()).arg(cell->y());
         return false;
     }
+    return true;
+}
+
+bool LotFilesManager::generateCell(WorldCell *cell)
+{
+    PERF_SCOPE("Lots: generate cell");
+
+//    if (cell->x() != 5 || cell->y() != 3) return true;
+    if (cell->mapFilePath().isEmpty())
+        return true;
+
+    if (!spawnMapCovers(cell))
+        return false;
 
 #if 0
     // Don't regenerate the .lot files unless the cell's map is newer than
@@ -223,6 +243,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
     PROGRESS progress(tr("Loading maps (%1,%2)")
                       .arg(cell->x()).arg(cell->y()));
 
+    PerfScope perfLoad("Lots: load maps");
+
     MapInfo *mapInfo = MapManager::instance()->loadMap(cell->mapFilePath(),
                                                        QString(), true);
     if (!mapInfo) {
@@ -257,6 +279,9 @@ bool LotFilesManager::generateCell(WorldCell *cell)
         mError = mapLoader.errorString();
         return false;
     }
+    perfLoad.release();
+
+    PerfScope perfComposite("Lots: composite");
 
     for (WorldCellLot *lot : cell->lots()) {
         MapInfo *info = MapManager::instance()->mapInfo(lot->mapName());
@@ -267,6 +292,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
     mapComposite->generateRoadLayers(QPoint(cell->x() * 300, cell->y() * 300),
                                      cell->world()->roads());
 
+    perfComposite.release();
+
     progress.update(tr("Generating .lot files (%1,%2)")
                       .arg(cell->x()).arg(cell->y()));
 #else
@@ -296,6 +323,15 @@ bool LotFilesManager::generateCell(WorldCell *cell)
     }
 #endif
 
+    return generateCell(cell, mapComposite);
+}
+
+bool LotFilesManager::generateCell(WorldCell *cell, MapComposite *mapComposite)
+{
+    if (!spawnMapCovers(cell))
+        return false;
+
+    MapInfo *mapInfo = mapComposite->mapInfo();
 
     // Check for missing tilesets.
     for (MapComposite *mc : mapComposite->maps()) {
@@ -342,6 +378,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
             mGridData[x][y].fill(LotFile::Square(), MaxLevel);
     }
 
+    PerfScope perfSquares("Lots: gather squares");
+
     Tile *missingTile = Tiled::Internal::TilesetManager::instance()->missingTile();
     QVector<const Tiled::Cell *> cells(40);
     for (CompositeLayerGroup *lg : mapComposite->layerGroups()) {
@@ -353,7 +391,7 @@ bool LotFilesManager::generateCell(WorldCell *cell)
                 cells.resize(0);
                 lg->orderedCellsAt2(QPoint(x, y), cells);
                 for (const Tiled::Cell *cell : cells) {
-                    if (cell->tile == missingTile) continue;
+                    if (cell->tile() == missingTile) continue;
                     int lx = x, ly = y;
                     if (mapInfo->orientation() == Map::Isometric) {
                         lx = x + lg->level() * 3;
@@ -369,6 +407,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
         }
     }
 
+    perfSquares.release();
+
     generateBuildingObjects(mapWidth, mapHeight);
 
     generateJumboTrees(cell, mapComposite);
@@ -383,6 +423,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
             .arg(lotSettings.worldOrigin.x() + cell->x())
             .arg(lotSettings.worldOrigin.y() + cell->y());
 
+    PerfScope perfPack("Lots: pack write");
+
     QString lotsDirectory = lotSettings.exportDir;
     QFile file(lotsDirectory + QLatin1Char('/') + fileName);
     if (!file.open(QIODevice::WriteOnly /*| QIODevice::Text*/)) {
@@ -413,8 +455,14 @@ bool LotFilesManager::generateCell(WorldCell *cell)
     for (int m = 0; m < WorldDiv * WorldDiv; m++)
         out << qint64(PositionMap[m]);
 
+    PERF_COUNTER("Lots: lotpack bytes", file.size());
+
     file.close();
 
+    perfPack.release();
+
+    PERF_SCOPE("Lots: chunk data");
+
     Navigate::ChunkDataFile cdf;
     cdf.fromMap(cell->x(), cell->y(), mapComposite, mRoomRectByLevel[0], lotSettings);
 
@@ -423,6 +471,8 @@ bool LotFilesManager::generateCell(WorldCell *cell)
 
 bool LotFilesManager::generateHeader(WorldCell *cell, MapComposite *mapComposite)
 {
+    PERF_SCOPE("Lots: rooms and tilesets");
+
     Q_UNUSED(cell)
 
     qDeleteAll(mRoomRects);
@@ -547,6 +597,8 @@ bool LotFilesManager::generateHeader(WorldCell *cell, MapComposite *mapComposite
 
 bool LotFilesManager::generateHeaderAux(WorldCell *cell, MapComposite *mapComposite)
 {
+    PERF_SCOPE("Lots: header write");
+
     Q_UNUSED(mapComposite)
 
     const GenerateLotsSettings &lotSettings = mWorldDoc->world()->getGenerateLotsSettings();
@@ -781,6 +833,8 @@ void LotFilesManager::generateBuildingObjects(int mapWidth, int mapHeight,
 
 void LotFilesManager::generateJumboTrees(WorldCell *cell, MapComposite *mapComposite)
 {
+    PERF_SCOPE("Lots: jumbo trees");
+
     const quint8 JUMBO_ZONE = 1;
     const quint8 PREVENT_JUMBO = 2;
     const quint8 REMOVE_TREE = 3;
@@ -1030,7 +1084,7 @@ int LotFilesManager::getRoomID(int x, int y, int z)
 
 uint LotFilesManager::cellToGid(const Cell *cell)
 {
-    Tileset *tileset = cell->tile->tileset();
+    Tileset *tileset = cell->tile()->tileset();
 
     QMap<const Tileset*,uint>::const_iterator i = mTilesetToFirstGid.begin();
     QMap<const Tileset*,uint>::const_iterator i_end = mTilesetToFirstGid.end();
@@ -1039,7 +1093,7 @@ uint LotFilesManager::cellToGid(const Cell *cell)
     if (i == i_end) // tileset not found
         return 0;
 
-    return i.value() + cell->tile->id();
+    return i.value() + cell->tile()->id();
 }
 
 bool LotFilesManager::processObjectGroups(WorldCell *cell, MapComposite *mapComposite)
@@ -318,7 +318,21 @@ public:
     };
 
     bool generateWorld(WorldDocument *worldDoc, GenerateMode mode);
+
+    /**
+      * Reads the Zombie Spawn Map and the tile definitions named in the
+      * Generate Lots settings of \a worldDoc.  generateWorld() calls this.
+      * To use generateCell() on its own, call this first.
+      */
+    bool prepare(WorldDocument *worldDoc);
+
     bool generateCell(WorldCell *cell);
+
+    /**
+      * Writes the .lotheader, .lotpack and chunkdata files of \a cell from
+      * \a mapComposite, which already holds the cell's map, lots and roads.
+      */
+    bool generateCell(WorldCell *cell, MapComposite *mapComposite);
     bool generateHeader(WorldCell *cell, MapComposite *mapComposite);
     bool generateHeaderAux(WorldCell *cell, MapComposite *mapComposite);
     bool generateChunk(QDataStream &out, WorldCell *cell, MapComposite *mapComposite, int cx, int cy);
@@ -336,6 +350,7 @@ public:
 signals:
         
 private:
+    bool spawnMapCovers(WorldCell *cell);
     uint cellToGid(const Tiled::Cell *cell);
     bool processObjectGroups(WorldCell *cell, MapComposite *mapComposite);
     bool processObjectGroup(WorldCell *cell, Tiled::ObjectGroup *objectGroup,
@@ -0,0 +1,901 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lotinspector.h"
+
+#include "chunkmap.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QRunnable>
+#include <QSet>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <algorithm>
+
+using namespace LotInspect;
+
+// Chunk types in chunkdata_X_Y.bin, see Navigate::ChunkDataFile.
+static const int CHUNKDATA_VERSION = 1;
+static const int CHUNKDATA_TYPES = 5;
+static const int REGULAR_CHUNK = 2;
+
+// Stop collecting errors for a cell once it is clearly broken.
+static const int MAX_ERRORS = 50;
+
+static int chunksPerCell()
+{
+    return IsoChunkMap::ChunkGridWidth * IsoChunkMap::ChunkGridWidth;
+}
+
+static QString chunkName(int index)
+{
+    // Chunks are stored column by column.
+    return QString(QLatin1String("chunk %1,%2"))
+            .arg(index / IsoChunkMap::ChunkGridWidth)
+            .arg(index % IsoChunkMap::ChunkGridWidth);
+}
+
+CellReader::CellReader(const QString &directory, int cellX, int cellY) :
+    mDirectory(directory),
+    mCellX(cellX),
+    mCellY(cellY),
+    mLotPack(0)
+{
+    mHeader.version = 0;
+    mHeader.width = mHeader.height = mHeader.levels = 0;
+}
+
+CellReader::~CellReader()
+{
+    delete mLotPack;
+}
+
+QString CellReader::headerFileName() const
+{
+    return QString(QLatin1String("%1/%2_%3.lotheader"))
+            .arg(mDirectory).arg(mCellX).arg(mCellY);
+}
+
+QString CellReader::lotPackFileName() const
+{
+    return QString(QLatin1String("%1/world_%2_%3.lotpack"))
+            .arg(mDirectory).arg(mCellX).arg(mCellY);
+}
+
+QString CellReader::chunkDataFileName() const
+{
+    return QString(QLatin1String("%1/chunkdata_%2_%3.bin"))
+            .arg(mDirectory).arg(mCellX).arg(mCellY);
+}
+
+void CellReader::error(const QString &message)
+{
+    if (mErrors.size() < MAX_ERRORS)
+        mErrors += message;
+    else if (mErrors.size() == MAX_ERRORS)
+        mErrors += tr("too many errors");
+}
+
+bool CellReader::readHeader()
+{
+    QFile file(headerFileName());
+    if (!file.open(QFile::ReadOnly)) {
+        error(tr("can't open %1").arg(QDir::toNativeSeparators(file.fileName())));
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    // Counts are checked against the file size so a corrupt file can't make
+    // us allocate huge lists.
+    qint64 maxCount = file.size() / 4;
+
+    Header &h = mHeader;
+    h.version = IsoLot::readInt(in);
+    int tileCount = IsoLot::readInt(in);
+    if (tileCount < 0 || tileCount > maxCount) {
+        error(tr("header: bad tile count %1").arg(tileCount));
+        return false;
+    }
+    for (int n = 0; n < tileCount; ++n)
+        h.tilesUsed += IsoLot::readString(in).trimmed();
+
+    IsoLot::readByte(in);
+
+    h.width = IsoLot::readInt(in);
+    h.height = IsoLot::readInt(in);
+    h.levels = IsoLot::readInt(in);
+    if (h.width != IsoChunkMap::ChunksPerWidth || h.height != IsoChunkMap::ChunksPerWidth) {
+        error(tr("header: chunk size is %1x%2, expected %3x%3")
+              .arg(h.width).arg(h.height).arg(IsoChunkMap::ChunksPerWidth));
+        return false;
+    }
+    if (h.levels < 1 || h.levels > IsoChunkMap::MaxLevels) {
+        error(tr("header: bad number of levels %1").arg(h.levels));
+        return false;
+    }
+
+    int numRooms = IsoLot::readInt(in);
+    if (numRooms < 0 || numRooms > maxCount) {
+        error(tr("header: bad room count %1").arg(numRooms));
+        return false;
+    }
+    const QRect cellRect(0, 0, IsoChunkMap::CellSize, IsoChunkMap::CellSize);
+    for (int n = 0; n < numRooms && in.status() == QDataStream::Ok; ++n) {
+        Header::Room room;
+        room.name = IsoLot::readString(in);
+        room.level = IsoLot::readInt(in);
+        if (room.level < 0 || room.level >= h.levels)
+            error(tr("room %1 \"%2\" is on level %3").arg(n).arg(room.name).arg(room.level));
+        int rects = IsoLot::readInt(in);
+        if (rects < 0 || rects > maxCount) {
+            error(tr("room %1 \"%2\" has %3 rects").arg(n).arg(room.name).arg(rects));
+            return false;
+        }
+        for (int rc = 0; rc < rects; ++rc) {
+            int x = IsoLot::readInt(in);
+            int y = IsoLot::readInt(in);
+            int width = IsoLot::readInt(in);
+            int height = IsoLot::readInt(in);
+            QRect r(x, y, width, height);
+            if (r.isEmpty() || !cellRect.contains(r))
+                error(tr("room %1 \"%2\" has rect %3,%4 %5x%6 outside the cell")
+                      .arg(n).arg(room.name).arg(x).arg(y).arg(width).arg(height));
+            room.rects += r;
+        }
+        room.objects = IsoLot::readInt(in);
+        if (room.objects < 0 || room.objects > maxCount) {
+            error(tr("room %1 \"%2\" has %3 objects").arg(n).arg(room.name).arg(room.objects));
+            return false;
+        }
+        for (int m = 0; m < room.objects * 3; ++m)
+            IsoLot::readInt(in);
+        h.rooms += room;
+    }
+
+    int numBuildings = IsoLot::readInt(in);
+    if (numBuildings < 0 || numBuildings > maxCount) {
+        error(tr("header: bad building count %1").arg(numBuildings));
+        return false;
+    }
+    QSet<int> roomsInBuildings;
+    for (int n = 0; n < numBuildings && in.status() == QDataStream::Ok; ++n) {
+        int numbRooms = IsoLot::readInt(in);
+        if (numbRooms < 0 || numbRooms > maxCount) {
+            error(tr("building %1 has %2 rooms").arg(n).arg(numbRooms));
+            return false;
+        }
+        QList<int> building;
+        for (int m = 0; m < numbRooms; ++m) {
+            int roomID = IsoLot::readInt(in);
+            if (roomID < 0 || roomID >= numRooms)
+                error(tr("building %1 has unknown room %2").arg(n).arg(roomID));
+            else if (roomsInBuildings.contains(roomID))
+                error(tr("room %1 is in more than one building").arg(roomID));
+            roomsInBuildings += roomID;
+            building += roomID;
+        }
+        h.buildings += building;
+    }
+
+    h.zombieDensity.resize(chunksPerCell());
+    if (in.readRawData(h.zombieDensity.data(), h.zombieDensity.size()) != h.zombieDensity.size()
+            || in.status() != QDataStream::Ok) {
+        error(tr("header: file ends early"));
+        return false;
+    }
+    if (!in.atEnd())
+        error(tr("header: %1 unused bytes at end of file").arg(file.size() - file.pos()));
+
+    return true;
+}
+
+bool CellReader::openLotPack()
+{
+    delete mLotPack;
+    mLotPack = new QFile(lotPackFileName());
+    mOffsets.clear();
+    if (!mLotPack->open(QFile::ReadOnly)) {
+        error(tr("can't open %1").arg(QDir::toNativeSeparators(mLotPack->fileName())));
+        return false;
+    }
+
+    QDataStream in(mLotPack);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    qint64 fileSize = mLotPack->size();
+    int count = IsoLot::readInt(in);
+    if (count != chunksPerCell())
+        error(tr("lotpack: offset table has %1 entries, expected %2").arg(count).arg(chunksPerCell()));
+    if (count < 0 || 4 + qint64(count) * 8 > fileSize) {
+        error(tr("lotpack: offset table is larger than the file"));
+        return false;
+    }
+
+    QVector<qint64> offsets(count);
+    for (int i = 0; i < count; ++i)
+        in >> offsets[i];
+
+    // Generate Lots writes the chunks in order right after the table, so
+    // each chunk ends where the next one starts.
+    qint64 tableEnd = 4 + qint64(count) * 8;
+    if (count && offsets[0] != tableEnd)
+        error(tr("lotpack: %1 starts at %2, expected %3").arg(chunkName(0))
+              .arg(offsets[0]).arg(tableEnd));
+    for (int i = 0; i < count; ++i) {
+        qint64 previous = i ? offsets[i - 1] : tableEnd;
+        if (offsets[i] < previous || offsets[i] > fileSize) {
+            error(tr("lotpack: %1 has bad offset %2").arg(chunkName(i)).arg(offsets[i]));
+            return false;
+        }
+    }
+
+    mOffsets = offsets;
+    return true;
+}
+
+qint64 CellReader::chunkSize(int index) const
+{
+    qint64 end = (index + 1 < mOffsets.size()) ? mOffsets[index + 1] : mLotPack->size();
+    return end - mOffsets[index];
+}
+
+QByteArray CellReader::chunkBytes(int index)
+{
+    if (!mLotPack->seek(mOffsets[index]))
+        return QByteArray();
+    return mLotPack->read(chunkSize(index));
+}
+
+bool CellReader::readChunk(int index, Chunk &chunk)
+{
+    const int width = IsoChunkMap::ChunksPerWidth;
+    const int levels = mHeader.levels;
+    const int total = width * width * levels;
+
+    QByteArray bytes = chunkBytes(index);
+    QDataStream in(bytes);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    chunk.resize(width, levels);
+
+    // Same run-length encoding IsoLot reads: a count of -1 is followed by the
+    // number of empty squares, otherwise the count is one more than the
+    // number of tiles and is followed by the room ID and the tiles.
+    int skip = 0;
+    int squareIndex = 0;
+    for (int z = 0; z < levels; ++z) {
+        for (int x = 0; x < width; ++x) {
+            for (int y = 0; y < width; ++y, ++squareIndex) {
+                if (skip > 0) {
+                    --skip;
+                    continue;
+                }
+                int count = IsoLot::readInt(in);
+                if (in.status() != QDataStream::Ok) {
+                    error(tr("lotpack: %1 ends early at square %2,%3,%4")
+                          .arg(chunkName(index)).arg(x).arg(y).arg(z));
+                    return false;
+                }
+                if (count == -1) {
+                    skip = IsoLot::readInt(in);
+                    if (skip < 1 || skip > total - squareIndex) {
+                        error(tr("lotpack: %1 skips %2 squares at square %3,%4,%5")
+                              .arg(chunkName(index)).arg(skip).arg(x).arg(y).arg(z));
+                        return false;
+                    }
+                    --skip;
+                    continue;
+                }
+                if (count < 2 || count > bytes.size() / 4) {
+                    error(tr("lotpack: %1 has bad count %2 at square %3,%4,%5")
+                          .arg(chunkName(index)).arg(count).arg(x).arg(y).arg(z));
+                    return false;
+                }
+                Square &square = chunk.square(x, y, z);
+                square.room = IsoLot::readInt(in);
+                if (square.room < -1 || square.room >= mHeader.rooms.size())
+                    error(tr("lotpack: %1 has unknown room %2 at square %3,%4,%5")
+                          .arg(chunkName(index)).arg(square.room).arg(x).arg(y).arg(z));
+                square.tiles.reserve(count - 1);
+                for (int n = 1; n < count; ++n) {
+                    int tile = IsoLot::readInt(in);
+                    if (tile < 0 || tile >= mHeader.tilesUsed.size())
+                        error(tr("lotpack: %1 has unknown tile %2 at square %3,%4,%5")
+                              .arg(chunkName(index)).arg(tile).arg(x).arg(y).arg(z));
+                    square.tiles += tile;
+                }
+            }
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        error(tr("lotpack: %1 ends early").arg(chunkName(index)));
+        return false;
+    }
+    if (!in.atEnd())
+        error(tr("lotpack: %1 has %2 unused bytes").arg(chunkName(index))
+              .arg(bytes.size() - in.device()->pos()));
+
+    return true;
+}
+
+bool CellReader::readChunkData()
+{
+    mChunkData.clear();
+
+    QFile file(chunkDataFileName());
+    if (!file.exists())
+        return false; // Older exports don't have it
+    if (!file.open(QFile::ReadOnly)) {
+        error(tr("can't open %1").arg(QDir::toNativeSeparators(file.fileName())));
+        return false;
+    }
+
+    QDataStream in(&file); // BigEndian, like ChunkDataFile
+    qint16 version;
+    in >> version;
+    if (version != CHUNKDATA_VERSION)
+        error(tr("chunkdata: version is %1, expected %2").arg(version).arg(CHUNKDATA_VERSION));
+
+    const int squares = IsoChunkMap::ChunksPerWidth * IsoChunkMap::ChunksPerWidth;
+    QVector<QByteArray> chunks(chunksPerCell());
+
+    // ChunkDataFile writes the chunks row by row.
+    for (int yy = 0; yy < IsoChunkMap::ChunkGridWidth; ++yy) {
+        for (int xx = 0; xx < IsoChunkMap::ChunkGridWidth; ++xx) {
+            int index = xx * IsoChunkMap::ChunkGridWidth + yy;
+            quint8 type;
+            in >> type;
+            if (in.status() != QDataStream::Ok) {
+                error(tr("chunkdata: file ends early"));
+                return false;
+            }
+            if (type >= CHUNKDATA_TYPES) {
+                error(tr("chunkdata: %1 has unknown type %2").arg(chunkName(index)).arg(type));
+                return false;
+            }
+            QByteArray &chunk = chunks[index];
+            chunk += char(type);
+            if (type == REGULAR_CHUNK) {
+                chunk.resize(1 + squares);
+                if (in.readRawData(chunk.data() + 1, squares) != squares) {
+                    error(tr("chunkdata: file ends early"));
+                    return false;
+                }
+            }
+        }
+    }
+
+    if (!in.atEnd())
+        error(tr("chunkdata: %1 unused bytes at end of file").arg(file.size() - file.pos()));
+
+    mChunkData = chunks;
+    return true;
+}
+
+/////
+
+CellStats::CellStats() :
+    tilesUsed(0),
+    rooms(0),
+    roomObjects(0),
+    buildings(0),
+    zombieMin(0),
+    zombieMax(0),
+    zombieAverage(0),
+    lotPackBytes(0),
+    chunkBytesMin(0),
+    chunkBytesMax(0),
+    squares(0),
+    tiles(0),
+    chunkDataTypes(CHUNKDATA_TYPES, 0)
+{
+}
+
+CellDiff::CellDiff() :
+    chunksChanged(0),
+    squaresChanged(0)
+{
+}
+
+/////
+
+namespace {
+
+class CheckCellTask : public QRunnable
+{
+public:
+    CheckCellTask(const QString &directory, const QPoint &cell, CellStats *result) :
+        mDirectory(directory),
+        mCell(cell),
+        mResult(result)
+    {
+    }
+
+    void run()
+    {
+        *mResult = LotInspector::checkCell(mDirectory, mCell);
+    }
+
+private:
+    QString mDirectory;
+    QPoint mCell;
+    CellStats *mResult;
+};
+
+class DiffCellTask : public QRunnable
+{
+public:
+    DiffCellTask(const QString &dirA, const QString &dirB, const QPoint &cell,
+                 CellDiff *result) :
+        mDirA(dirA),
+        mDirB(dirB),
+        mCell(cell),
+        mResult(result)
+    {
+    }
+
+    void run()
+    {
+        *mResult = LotInspector::diffCell(mDirA, mDirB, mCell);
+    }
+
+private:
+    QString mDirA;
+    QString mDirB;
+    QPoint mCell;
+    CellDiff *mResult;
+};
+
+bool pointLessThan(const QPoint &a, const QPoint &b)
+{
+    return (a.y() < b.y()) || (a.y() == b.y() && a.x() < b.x());
+}
+
+// Splits cells sorted by pointLessThan into rows.
+QList<QList<QPoint> > cellRows(const QList<QPoint> &cells)
+{
+    QList<QList<QPoint> > rows;
+    foreach (const QPoint &cell, cells) {
+        if (rows.isEmpty() || rows.last().first().y() != cell.y())
+            rows += QList<QPoint>();
+        rows.last() += cell;
+    }
+    return rows;
+}
+
+QString roomName(const Header &header, int room)
+{
+    if (room < 0 || room >= header.rooms.size())
+        return QString();
+    return QString(QLatin1String("%1@%2")).arg(header.rooms[room].name)
+            .arg(header.rooms[room].level);
+}
+
+QStringList tileNames(const Header &header, const Square &square)
+{
+    QStringList names;
+    foreach (int tile, square.tiles)
+        names += header.tilesUsed.value(tile, QLatin1String("?"));
+    return names;
+}
+
+QString describeSquare(const Header &header, const Square &square)
+{
+    if (square.isEmpty())
+        return QLatin1String("empty");
+    QString room = roomName(header, square.room);
+    QString tiles = tileNames(header, square).join(QLatin1String(" "));
+    if (room.isEmpty())
+        return tiles;
+    return QString(QLatin1String("%1 (room %2)")).arg(tiles).arg(room);
+}
+
+QStringList roomKeys(const Header &header)
+{
+    QStringList keys;
+    foreach (const Header::Room &room, header.rooms) {
+        QString key = QString(QLatin1String("%1@%2")).arg(room.name).arg(room.level);
+        foreach (const QRect &r, room.rects)
+            key += QString(QLatin1String(" %1,%2,%3,%4")).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height());
+        keys += key;
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+QString firstFew(const QSet<QString> &names)
+{
+    QStringList list = names.toList();
+    std::sort(list.begin(), list.end());
+    if (list.size() > 5) {
+        int more = list.size() - 5;
+        list = list.mid(0, 5);
+        list += QString(QLatin1String("(%1 more)")).arg(more);
+    }
+    return list.join(QLatin1String(", "));
+}
+
+} // namespace
+
+/////
+
+LotInspector::LotInspector()
+{
+}
+
+QList<QPoint> LotInspector::cellsInDirectory(const QString &directory)
+{
+    QList<QPoint> cells;
+    QDir dir(directory);
+    QStringList filters(QLatin1String("*.lotheader"));
+    foreach (QFileInfo info, dir.entryInfoList(filters, QDir::Files)) {
+        QStringList split = info.baseName().split(QLatin1Char('_'));
+        if (split.size() != 2)
+            continue;
+        bool okX, okY;
+        int x = split[0].toInt(&okX);
+        int y = split[1].toInt(&okY);
+        if (okX && okY)
+            cells += QPoint(x, y);
+    }
+    std::sort(cells.begin(), cells.end(), pointLessThan);
+    return cells;
+}
+
+CellStats LotInspector::checkCell(const QString &directory, const QPoint &cell)
+{
+    CellStats stats;
+    stats.cell = cell;
+
+    CellReader reader(directory, cell.x(), cell.y());
+    if (reader.readHeader()) {
+        const Header &header = reader.header();
+        stats.tilesUsed = header.tilesUsed.size();
+        stats.rooms = header.rooms.size();
+        foreach (const Header::Room &room, header.rooms)
+            stats.roomObjects += room.objects;
+        stats.buildings = header.buildings.size();
+        stats.zombieMin = 255;
+        qint64 zombieSum = 0;
+        for (int i = 0; i < header.zombieDensity.size(); i++) {
+            int density = quint8(header.zombieDensity[i]);
+            stats.zombieMin = qMin(stats.zombieMin, density);
+            stats.zombieMax = qMax(stats.zombieMax, density);
+            zombieSum += density;
+        }
+        stats.zombieAverage = zombieSum / double(qMax(1, header.zombieDensity.size()));
+
+        if (reader.openLotPack()) {
+            QVector<qint64> tileCounts(header.tilesUsed.size(), 0);
+            Chunk chunk;
+            for (int i = 0; i < reader.chunkCount(); i++) {
+                qint64 size = reader.chunkSize(i);
+                stats.lotPackBytes += size;
+                stats.chunkBytesMin = i ? qMin(stats.chunkBytesMin, size) : size;
+                stats.chunkBytesMax = qMax(stats.chunkBytesMax, size);
+                if (!reader.readChunk(i, chunk))
+                    continue;
+                foreach (const Square &square, chunk.squares) {
+                    if (square.isEmpty())
+                        continue;
+                    stats.squares++;
+                    stats.tiles += square.tiles.size();
+                    foreach (int tile, square.tiles) {
+                        if (tile >= 0 && tile < tileCounts.size())
+                            tileCounts[tile]++;
+                    }
+                }
+            }
+            for (int i = 0; i < tileCounts.size(); i++) {
+                if (tileCounts[i])
+                    stats.tileCounts[header.tilesUsed[i]] += tileCounts[i];
+            }
+        }
+    }
+
+    if (reader.readChunkData()) {
+        for (int i = 0; i < chunksPerCell(); i++)
+            stats.chunkDataTypes[quint8(reader.chunkData(i).at(0))]++;
+    }
+
+    stats.errors = reader.errors();
+    return stats;
+}
+
+CellDiff LotInspector::diffCell(const QString &dirA, const QString &dirB,
+                                const QPoint &cell)
+{
+    CellDiff diff;
+    diff.cell = cell;
+
+    CellReader readerA(dirA, cell.x(), cell.y());
+    CellReader readerB(dirB, cell.x(), cell.y());
+    bool okA = readerA.readHeader();
+    bool okB = readerB.readHeader();
+    if (!okA || !okB) {
+        foreach (QString error, readerA.errors())
+            diff.lines += tr("A: %1").arg(error);
+        foreach (QString error, readerB.errors())
+            diff.lines += tr("B: %1").arg(error);
+        return diff;
+    }
+
+    const Header &headerA = readerA.header();
+    const Header &headerB = readerB.header();
+
+    if (headerA.version != headerB.version)
+        diff.lines += tr("version %1 -> %2").arg(headerA.version).arg(headerB.version);
+    if (headerA.levels != headerB.levels)
+        diff.lines += tr("levels %1 -> %2").arg(headerA.levels).arg(headerB.levels);
+
+    QSet<QString> tilesA = headerA.tilesUsed.toSet();
+    QSet<QString> tilesB = headerB.tilesUsed.toSet();
+    QSet<QString> removed = tilesA - tilesB;
+    QSet<QString> added = tilesB - tilesA;
+    if (!removed.isEmpty())
+        diff.lines += tr("%1 tiles no longer used: %2").arg(removed.size()).arg(firstFew(removed));
+    if (!added.isEmpty())
+        diff.lines += tr("%1 tiles now used: %2").arg(added.size()).arg(firstFew(added));
+
+    // Rooms are compared by name, level and rects since their IDs depend on
+    // the order the buildings were placed in.
+    QStringList roomsA = roomKeys(headerA);
+    QStringList roomsB = roomKeys(headerB);
+    if (roomsA != roomsB) {
+        QSet<QString> setA = roomsA.toSet(), setB = roomsB.toSet();
+        diff.lines += tr("rooms %1 -> %2 (%3 removed, %4 added)")
+                .arg(roomsA.size()).arg(roomsB.size())
+                .arg((setA - setB).size()).arg((setB - setA).size());
+    }
+    if (headerA.buildings.size() != headerB.buildings.size())
+        diff.lines += tr("buildings %1 -> %2").arg(headerA.buildings.size()).arg(headerB.buildings.size());
+
+    if (headerA.zombieDensity != headerB.zombieDensity) {
+        int changed = 0;
+        for (int i = 0; i < headerA.zombieDensity.size(); i++) {
+            if (headerA.zombieDensity[i] != headerB.zombieDensity.at(i))
+                changed++;
+        }
+        diff.lines += tr("zombie density differs in %1 chunks").arg(changed);
+    }
+
+    bool hasA = readerA.readChunkData();
+    bool hasB = readerB.readChunkData();
+    if (hasA != hasB) {
+        diff.lines += hasA ? tr("chunkdata only in A") : tr("chunkdata only in B");
+    } else if (hasA) {
+        int changed = 0;
+        for (int i = 0; i < chunksPerCell(); i++) {
+            if (readerA.chunkData(i) != readerB.chunkData(i))
+                changed++;
+        }
+        if (changed)
+            diff.lines += tr("chunkdata differs in %1 chunks").arg(changed);
+    }
+
+    okA = readerA.openLotPack();
+    okB = readerB.openLotPack();
+    if (okA && okB && readerA.chunkCount() == readerB.chunkCount()) {
+        // If the tile and room tables are identical the chunks can be
+        // compared byte for byte and only decoded when they differ.
+        bool sameTables = headerA.tilesUsed == headerB.tilesUsed &&
+                roomsA == roomsB && headerA.levels == headerB.levels;
+        Chunk chunkA, chunkB;
+        for (int i = 0; i < readerA.chunkCount(); i++) {
+            if (sameTables && readerA.chunkBytes(i) == readerB.chunkBytes(i))
+                continue;
+            if (!readerA.readChunk(i, chunkA) || !readerB.readChunk(i, chunkB))
+                continue;
+            int cx = i / IsoChunkMap::ChunkGridWidth;
+            int cy = i % IsoChunkMap::ChunkGridWidth;
+            bool chunkChanged = false;
+            int levels = qMax(headerA.levels, headerB.levels);
+            for (int z = 0; z < levels; z++) {
+                for (int x = 0; x < IsoChunkMap::ChunksPerWidth; x++) {
+                    for (int y = 0; y < IsoChunkMap::ChunksPerWidth; y++) {
+                        Square empty;
+                        const Square &sqA = (z < headerA.levels) ? chunkA.square(x, y, z) : empty;
+                        const Square &sqB = (z < headerB.levels) ? chunkB.square(x, y, z) : empty;
+                        if (tileNames(headerA, sqA) == tileNames(headerB, sqB) &&
+                                roomName(headerA, sqA.room) == roomName(headerB, sqB.room))
+                            continue;
+                        chunkChanged = true;
+                        if (diff.squaresChanged++ < MAX_SQUARES_REPORTED) {
+                            int wx = cell.x() * IsoChunkMap::CellSize + cx * IsoChunkMap::ChunksPerWidth + x;
+                            int wy = cell.y() * IsoChunkMap::CellSize + cy * IsoChunkMap::ChunksPerWidth + y;
+                            diff.lines += tr("square %1,%2,%3: %4 -> %5")
+                                    .arg(wx).arg(wy).arg(z)
+                                    .arg(describeSquare(headerA, sqA))
+                                    .arg(describeSquare(headerB, sqB));
+                        }
+                    }
+                }
+            }
+            if (chunkChanged)
+                diff.chunksChanged++;
+        }
+    }
+    foreach (QString error, readerA.errors())
+        diff.lines += tr("A: %1").arg(error);
+    foreach (QString error, readerB.errors())
+        diff.lines += tr("B: %1").arg(error);
+
+    if (diff.squaresChanged > MAX_SQUARES_REPORTED)
+        diff.lines += tr("(%1 more squares)").arg(diff.squaresChanged - MAX_SQUARES_REPORTED);
+
+    return diff;
+}
+
+bool LotInspector::check(const QString &directory, QTextStream &out)
+{
+    QList<QPoint> cells = cellsInDirectory(directory);
+    if (cells.isEmpty()) {
+        out << tr("No .lotheader files in %1\n").arg(QDir::toNativeSeparators(directory));
+        return false;
+    }
+
+    int badCells = 0;
+    qint64 totalBytes = 0, totalSquares = 0, totalRooms = 0, totalBuildings = 0;
+    QHash<QString,qint64> totalTileCounts;
+
+    QThreadPool threadPool;
+    foreach (const QList<QPoint> &row, cellRows(cells)) {
+        QVector<CellStats> results(row.size());
+        for (int i = 0; i < row.size(); i++)
+            threadPool.start(new CheckCellTask(directory, row[i], &results[i]));
+        threadPool.waitForDone();
+
+        foreach (const CellStats &stats, results) {
+            out << tr("cell %1,%2: %3 tiles used, %4 rooms (%5 objects), %6 buildings, "
+                      "zombies %7-%8 avg %9, lotpack %10 bytes (chunks %11-%12), "
+                      "%13 squares with %14 tiles")
+                   .arg(stats.cell.x()).arg(stats.cell.y())
+                   .arg(stats.tilesUsed).arg(stats.rooms).arg(stats.roomObjects)
+                   .arg(stats.buildings)
+                   .arg(stats.zombieMin).arg(stats.zombieMax).arg(stats.zombieAverage, 0, 'f', 1)
+                   .arg(stats.lotPackBytes).arg(stats.chunkBytesMin).arg(stats.chunkBytesMax)
+                   .arg(stats.squares).arg(stats.tiles);
+            out << tr(", chunkdata empty/solid/regular/water/room %1/%2/%3/%4/%5\n")
+                   .arg(stats.chunkDataTypes[0]).arg(stats.chunkDataTypes[1])
+                   .arg(stats.chunkDataTypes[2]).arg(stats.chunkDataTypes[3])
+                   .arg(stats.chunkDataTypes[4]);
+            foreach (const QString &error, stats.errors)
+                out << "    " << tr("ERROR: %1").arg(error) << "\n";
+            if (!stats.errors.isEmpty())
+                badCells++;
+
+            totalBytes += stats.lotPackBytes;
+            totalSquares += stats.squares;
+            totalRooms += stats.rooms;
+            totalBuildings += stats.buildings;
+            for (auto it = stats.tileCounts.constBegin(); it != stats.tileCounts.constEnd(); ++it)
+                totalTileCounts[it.key()] += it.value();
+        }
+        out.flush();
+    }
+
+    out << tr("\n%1 cells, %2 with errors, %3 rooms, %4 buildings, %5 squares, "
+              "%6 lotpack bytes\n")
+           .arg(cells.size()).arg(badCells).arg(totalRooms).arg(totalBuildings)
+           .arg(totalSquares).arg(totalBytes);
+
+    QMultiMap<qint64,QString> byCount;
+    for (auto it = totalTileCounts.constBegin(); it != totalTileCounts.constEnd(); ++it)
+        byCount.insert(it.value(), it.key());
+    out << tr("Most used tiles:\n");
+    int shown = 0;
+    for (auto it = byCount.constEnd(); it != byCount.constBegin() && shown < 20; ++shown) {
+        --it;
+        out << "    " << it.value() << " " << it.key() << "\n";
+    }
+
+    return badCells == 0;
+}
+
+bool LotInspector::diff(const QString &dirA, const QString &dirB, QTextStream &out)
+{
+    QList<QPoint> cellsA = cellsInDirectory(dirA);
+    QList<QPoint> cellsB = cellsInDirectory(dirB);
+    QSet<QPair<int,int> > setA, setB;
+    foreach (const QPoint &cell, cellsA)
+        setA += qMakePair(cell.x(), cell.y());
+    foreach (const QPoint &cell, cellsB)
+        setB += qMakePair(cell.x(), cell.y());
+
+    int differences = 0;
+    foreach (const QPoint &cell, cellsA) {
+        if (!setB.contains(qMakePair(cell.x(), cell.y()))) {
+            out << tr("cell %1,%2: only in A\n").arg(cell.x()).arg(cell.y());
+            differences++;
+        }
+    }
+    foreach (const QPoint &cell, cellsB) {
+        if (!setA.contains(qMakePair(cell.x(), cell.y()))) {
+            out << tr("cell %1,%2: only in B\n").arg(cell.x()).arg(cell.y());
+            differences++;
+        }
+    }
+
+    QList<QPoint> common;
+    foreach (const QPoint &cell, cellsA) {
+        if (setB.contains(qMakePair(cell.x(), cell.y())))
+            common += cell;
+    }
+
+    qint64 chunksChanged = 0, squaresChanged = 0;
+    QThreadPool threadPool;
+    foreach (const QList<QPoint> &row, cellRows(common)) {
+        QVector<CellDiff> results(row.size());
+        for (int i = 0; i < row.size(); i++)
+            threadPool.start(new DiffCellTask(dirA, dirB, row[i], &results[i]));
+        threadPool.waitForDone();
+
+        foreach (const CellDiff &diff, results) {
+            if (diff.isEmpty())
+                continue;
+            differences++;
+            chunksChanged += diff.chunksChanged;
+            squaresChanged += diff.squaresChanged;
+            out << tr("cell %1,%2: %3 chunks, %4 squares differ\n")
+                   .arg(diff.cell.x()).arg(diff.cell.y())
+                   .arg(diff.chunksChanged).arg(diff.squaresChanged);
+            foreach (const QString &line, diff.lines)
+                out << "    " << line << "\n";
+        }
+        out.flush();
+    }
+
+    out << tr("\n%1 cells compared, %2 differ, %3 chunks, %4 squares\n")
+           .arg(common.size()).arg(differences).arg(chunksChanged).arg(squaresChanged);
+
+    return differences == 0;
+}
+
+int LotInspector::runHeadless(const QStringList &args)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    int index = args.indexOf(QLatin1String("--lotcheck"));
+    if (index != -1) {
+        if (index + 1 >= args.size()) {
+            err << "Usage: PZWorldEd --lotcheck <dir>\n";
+            return 1;
+        }
+        LotInspector inspector;
+        return inspector.check(args[index + 1], out) ? 0 : 1;
+    }
+
+    index = args.indexOf(QLatin1String("--lotdiff"));
+    if (index != -1) {
+        if (index + 2 >= args.size()) {
+            err << "Usage: PZWorldEd --lotdiff <dirA> <dirB>\n";
+            return 1;
+        }
+        LotInspector inspector;
+        return inspector.diff(args[index + 1], args[index + 2], out) ? 0 : 1;
+    }
+
+    return -1;
+}
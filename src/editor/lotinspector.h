@@ -0,0 +1,232 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOTINSPECTOR_H
+#define LOTINSPECTOR_H
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+class QTextStream;
+
+namespace LotInspect {
+
+/**
+  * The contents of a .lotheader file.
+  */
+class Header
+{
+public:
+    class Room
+    {
+    public:
+        QString name;
+        int level;
+        QList<QRect> rects;
+        int objects;
+    };
+
+    int version;
+    QStringList tilesUsed;
+    int width;
+    int height;
+    int levels;
+    QList<Room> rooms;
+    QList<QList<int> > buildings;
+    QByteArray zombieDensity;
+};
+
+/**
+  * One square of a lotpack chunk.  Tiles are indices into Header::tilesUsed.
+  */
+class Square
+{
+public:
+    Square() : room(-1) {}
+
+    bool isEmpty() const
+    { return tiles.isEmpty(); }
+
+    int room;
+    QVector<int> tiles;
+};
+
+/**
+  * The squares of one 10x10 chunk on every level, as stored in a .lotpack.
+  */
+class Chunk
+{
+public:
+    Square &square(int x, int y, int z)
+    { return squares[(z * mWidth + x) * mWidth + y]; }
+
+    void resize(int width, int levels)
+    {
+        mWidth = width;
+        squares.clear();
+        squares.resize(width * width * levels);
+    }
+
+    QVector<Square> squares;
+
+private:
+    int mWidth;
+};
+
+/**
+  * Reads the .lotheader, .lotpack and chunkdata files of one cell.  The
+  * lotpack is read one chunk at a time so a cell never has to be held in
+  * memory all at once.  Anything that doesn't match what the game expects
+  * is added to errors().
+  */
+class CellReader
+{
+    Q_DECLARE_TR_FUNCTIONS(CellReader)
+
+public:
+    CellReader(const QString &directory, int cellX, int cellY);
+    ~CellReader();
+
+    bool readHeader();
+
+    bool openLotPack();
+    int chunkCount() const
+    { return mOffsets.size(); }
+    qint64 chunkSize(int index) const;
+    QByteArray chunkBytes(int index);
+    bool readChunk(int index, Chunk &chunk);
+
+    bool readChunkData();
+    bool hasChunkData() const
+    { return !mChunkData.isEmpty(); }
+    QByteArray chunkData(int index) const
+    { return mChunkData.value(index); }
+
+    const Header &header() const
+    { return mHeader; }
+
+    QString headerFileName() const;
+    QString lotPackFileName() const;
+    QString chunkDataFileName() const;
+
+    const QStringList &errors() const
+    { return mErrors; }
+
+private:
+    void error(const QString &message);
+
+    QString mDirectory;
+    int mCellX;
+    int mCellY;
+    Header mHeader;
+    QFile *mLotPack;
+    QVector<qint64> mOffsets;
+    QVector<QByteArray> mChunkData;
+    QStringList mErrors;
+};
+
+/**
+  * Per-cell statistics gathered while checking a cell.
+  */
+class CellStats
+{
+public:
+    CellStats();
+
+    QPoint cell;
+    int tilesUsed;
+    int rooms;
+    int roomObjects;
+    int buildings;
+    int zombieMin;
+    int zombieMax;
+    double zombieAverage;
+    qint64 lotPackBytes;
+    qint64 chunkBytesMin;
+    qint64 chunkBytesMax;
+    qint64 squares;
+    qint64 tiles;
+    QVector<int> chunkDataTypes;
+    QHash<QString,qint64> tileCounts;
+    QStringList errors;
+};
+
+/**
+  * What changed between the same cell in two output directories.
+  */
+class CellDiff
+{
+public:
+    CellDiff();
+
+    bool isEmpty() const
+    { return lines.isEmpty() && !squaresChanged; }
+
+    QPoint cell;
+    int chunksChanged;
+    qint64 squaresChanged;
+    QStringList lines;
+};
+
+} // namespace LotInspect
+
+/**
+  * Checks and compares the files written by Generate Lots.
+  *
+  *   PZWorldEd --lotcheck <dir>
+  *       validates every cell in <dir> and prints per-cell statistics.
+  *   PZWorldEd --lotdiff <dirA> <dirB>
+  *       prints the differences between two directories cell by cell,
+  *       chunk by chunk and square by square.  Squares are compared by tile
+  *       name and room name so renumbered tiles or rooms are not reported.
+  *
+  * Cells are processed in parallel one row at a time, so memory use depends
+  * on the width of the world and not its size.
+  */
+class LotInspector
+{
+    Q_DECLARE_TR_FUNCTIONS(LotInspector)
+
+public:
+    LotInspector();
+
+    bool check(const QString &directory, QTextStream &out);
+    bool diff(const QString &dirA, const QString &dirB, QTextStream &out);
+
+    static QList<QPoint> cellsInDirectory(const QString &directory);
+
+    static LotInspect::CellStats checkCell(const QString &directory, const QPoint &cell);
+    static LotInspect::CellDiff diffCell(const QString &dirA, const QString &dirB,
+                                         const QPoint &cell);
+
+    /**
+      * Handles "--lotcheck <dir>" and "--lotdiff <dirA> <dirB>".  Returns
+      * -1 if neither option is present, otherwise the process exit code.
+      */
+    static int runHeadless(const QStringList &args);
+
+    // The number of differing squares printed for each cell.
+    static const int MAX_SQUARES_REPORTED = 20;
+};
+
+#endif // LOTINSPECTOR_H
@@ -19,12 +19,17 @@
 #include "mainwindow.h"
 
 #ifdef ZOMBOID
+#include "benchmark.h"
+#include "worldscript.h"
+#include "lotinspector.h"
 #include "documentmanager.h"
 #include "toolmanager.h"
 #include "preferences.h"
 #include "mapimagemanager.h"
 #include "mapmanager.h"
+#include "perftrace.h"
 #include "progress.h"
+#include "roadlayercache.h"
 #include "tilemetainfomgr.h"
 #include "tilesetmanager.h"
 #include <QTextStream>
@@ -39,13 +44,50 @@ using namespace Tiled::Internal;
 
 
 
+namespace {
+
+// Writes the PZWORLDED_TRACE files however main() returns, including from
+// --benchmark, --script, --lotcheck and --lotdiff.
+class PerfTraceWriter
+{
+public:
+    PerfTraceWriter(const QString &fileName) :
+        mFileName(fileName)
+    {
+        if (!mFileName.isEmpty())
+            PerfTrace::setEnabled(true);
+    }
+
+    ~PerfTraceWriter()
+    {
+        if (mFileName.isEmpty() || !PerfTrace::isEnabled())
+            return;
+        PerfTrace::writeChromeTrace(mFileName);
+        PerfTrace::writeSummary(mFileName + QLatin1String(".txt"));
+    }
+
+private:
+    QString mFileName;
+};
+
+} // namespace
+
 int main(int argc, char *argv[])
 {
 #if ZOMBOID
     QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+    // The benchmark draws into images only, so it runs without a display.
+    for (int i = 1; i < argc; i++) {
+        if (!qstrcmp(argv[i], "--benchmark") && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
 #endif
     QApplication a(argc, argv);
 
+    // Set PZWORLDED_TRACE=<file.json> to record timings of long operations.
+    PerfTraceWriter traceWriter(QString::fromLocal8Bit(qgetenv("PZWORLDED_TRACE")));
+
     a.setOrganizationName(QLatin1String("TheIndieStone"));
     a.setApplicationName(QLatin1String("PZWorldEd"));
 #ifdef BUILD_INFO_VERSION
@@ -71,6 +113,37 @@ int main(int argc, char *argv[])
     QImageReader::setAllocationLimit(0);
 #endif
 
+    // PZWorldEd --benchmark <dir> times loading and exporting a generated
+    // world and exits without showing the main window.
+    Benchmark benchmark;
+    if (benchmark.parseArguments(a.arguments())) {
+        int ret = benchmark.run();
+        RoadLayerCache::deleteInstance();
+        MapManager::deleteInstance();
+        TilesetManager::deleteInstance();
+        Preferences::deleteInstance();
+        return ret;
+    }
+
+    // PZWorldEd --script <file.lua> <world.pzw> [--save]
+    int scriptIndex = a.arguments().indexOf(QLatin1String("--script"));
+    if (scriptIndex != -1) {
+        int ret = WorldScript::runHeadless(a.arguments().mid(scriptIndex + 1));
+        RoadLayerCache::deleteInstance();
+        MapManager::deleteInstance();
+        TilesetManager::deleteInstance();
+        Preferences::deleteInstance();
+        return ret;
+    }
+
+    // PZWorldEd --lotcheck <dir>
+    // PZWorldEd --lotdiff <dirA> <dirB>
+    int lotRet = LotInspector::runHeadless(a.arguments());
+    if (lotRet != -1) {
+        Preferences::deleteInstance();
+        return lotRet;
+    }
+
     MainWindow w;
     w.show();
 
@@ -101,6 +174,7 @@ int main(int argc, char *argv[])
     Preferences::deleteInstance();
     MapImageManager::deleteInstance();
     MapManager::deleteInstance();
+    RoadLayerCache::deleteInstance();
     TileMetaInfoMgr::deleteInstance();
     TilesetManager::deleteInstance();
 
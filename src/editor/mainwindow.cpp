@@ -265,6 +265,8 @@ MainWindow::MainWindow(QWidget *parent)
             this, &MainWindow::TMXToBMPAll);
     connect(ui->actionTMXToBMPSelected, &QAction::triggered,
             this, &MainWindow::TMXToBMPSelected);
+    connect(ui->actionTMXToBMPChanged, &QAction::triggered,
+            this, &MainWindow::TMXToBMPChanged);
     connect(ui->actionLUAObjectDump, &QAction::triggered, this, &MainWindow::WriteSpawnPoints);
     connect(ui->actionWriteObjects, &QAction::triggered, this, &MainWindow::WriteWorldObjects);
     connect(ui->actionFromToAll, &QAction::triggered,
@@ -339,6 +341,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(ui->actionLotPackViewer, &QAction::triggered, this, &MainWindow::lotpackviewer);
     connect(ui->actionLootInspector, &QAction::triggered, this, &MainWindow::lootInspector);
+    connect(ui->actionRunScript, &QAction::triggered, this, &MainWindow::runScript);
 //    connect(ui->actionReadOldWaterDotLua, &QAction::triggered, this, &MainWindow::readOldWaterDotLua);
 
     connect(ui->actionAboutQt, &QAction::triggered, qApp, &QApplication::aboutQt);
@@ -759,7 +762,7 @@ void MainWindow::openFile()
     QString filter = tr("All Files (*)");
     filter += QLatin1String(";;");
 
-    QString selectedFilter = tr("PZWorldEd world files (*.pzw)");
+    QString selectedFilter = tr("PZWorldEd world files (*.pzw *.pzwb)");
     filter += selectedFilter;
 
     QStringList fileNames =
@@ -1146,6 +1149,44 @@ void MainWindow::lootInspector()
     }
 }
 
+#include "worldscript.h"
+void MainWindow::runScript()
+{
+    WorldDocument *worldDoc = 0;
+    if (mCurrentDocument) {
+        worldDoc = mCurrentDocument->asWorldDocument();
+        if (CellDocument *cellDoc = mCurrentDocument->asCellDocument())
+            worldDoc = cellDoc->worldDocument();
+    }
+    if (!worldDoc)
+        return;
+
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Run Lua Script"),
+                                                    Preferences::instance()->openFileDirectory(),
+                                                    tr("Lua files (*.lua)"));
+    if (fileName.isEmpty())
+        return;
+
+    PROGRESS progress(tr("Running %1").arg(QFileInfo(fileName).fileName()), this);
+
+    WorldScript script(worldDoc);
+    bool ok = script.runFile(fileName);
+    progress.release();
+
+    if (!ok) {
+        QMessageBox::critical(this, tr("Run Lua Script"),
+                              tr("The script failed and its changes were undone.\n\n%1")
+                              .arg(script.errorString()));
+        return;
+    }
+    if (!script.output().isEmpty()) {
+        QMessageBox box(QMessageBox::Information, tr("Run Lua Script"),
+                        tr("The script finished."), QMessageBox::Ok, this);
+        box.setDetailedText(script.output());
+        box.exec();
+    }
+}
+
 #include "waterflow.h"
 void MainWindow::readOldWaterDotLua()
 {
@@ -1283,9 +1324,9 @@ void MainWindow::FromToAux(bool selectedOnly)
                 for (int x = 0; x < tl->width(); x++) {
                     for (int y = 0; y < tl->height(); y++) {
                         Cell cell = tl->cellAt(x, y);
-                        if (!cell.tile) continue;
-                        if (tileMapping.contains(qMakePair(tl,cell.tile))) {
-                            QList<Tile*> &choices = tileMapping[qMakePair(tl,cell.tile)];
+                        if (!cell.tile()) continue;
+                        if (tileMapping.contains(qMakePair(tl,cell.tile()))) {
+                            QList<Tile*> &choices = tileMapping[qMakePair(tl,cell.tile())];
                             tl->setCell(x, y, Cell(choices[qrand() % choices.size()]));
                         }
                     }
@@ -1396,7 +1437,10 @@ bool MainWindow::saveFileAs()
         suggestedFileName = fileInfo.path();
         suggestedFileName += QLatin1Char('/');
         suggestedFileName += fileInfo.completeBaseName();
-        suggestedFileName += QLatin1String(".pzw");
+        if (fileInfo.suffix() == QLatin1String("pzwb"))
+            suggestedFileName += QLatin1String(".pzwb");
+        else
+            suggestedFileName += QLatin1String(".pzw");
     } else {
         QString path = Preferences::instance()->openFileDirectory();
         if (path.isEmpty() || !QDir(path).exists())
@@ -1408,7 +1452,8 @@ bool MainWindow::saveFileAs()
 
     const QString fileName =
             QFileDialog::getSaveFileName(this, QString(), suggestedFileName,
-                                         tr("PZWorldEd world files (*.pzw)"));
+                                         tr("PZWorldEd world files (*.pzw);;"
+                                            "PZWorldEd binary world files (*.pzwb)"));
     if (!fileName.isEmpty()) {
         Preferences::instance()->setOpenFileDirectory(QFileInfo(fileName).absolutePath());
         return saveFile(fileName);
@@ -1566,6 +1611,11 @@ void MainWindow::TMXToBMPSelected()
     _TMXToBMP(this, mCurrentDocument, TMXToBMP::GenerateSelected);
 }
 
+void MainWindow::TMXToBMPChanged()
+{
+    _TMXToBMP(this, mCurrentDocument, TMXToBMP::GenerateChanged);
+}
+
 void MainWindow::resizeWorld()
 {
     WorldDocument *worldDoc = mCurrentDocument->asWorldDocument();
@@ -2110,7 +2160,7 @@ void MainWindow::splitInGameMapPolygon()
 
     InGameMapFeature* feature2 = new InGameMapFeature(&cellDoc->cell()->inGameMap());
     InGameMapGeometry& geom = feature2->mGeometry;
-    geom.mType = QLatin1String("Polygon");
+    geom.mType = InGameMapGeometry::Type::Polygon;
     geom.mCoordinates << coords2;
     feature2->mProperties = feature->properties();
 
@@ -2383,6 +2433,7 @@ void MainWindow::overwriteInGameMapFeaturesXML()
     }
 
     InGameMapWriterBinary writerBinary;
+    writerBinary.setVersion(Preferences::instance()->worldMapBinaryVersion());
     if (!writerBinary.writeWorld(worldDoc->world(), fileName + QStringLiteral(".bin"))) {
         qWarning("Failed to write InGameMap Binary.");
         return;
@@ -2470,6 +2521,7 @@ void MainWindow::writeInGameMapFeaturesXML()
     else {
 
         InGameMapWriterBinary writerBinary;
+        writerBinary.setVersion(Preferences::instance()->worldMapBinaryVersion());
         if (!writerBinary.writeWorld(worldDoc->world(), fileName + QStringLiteral(".bin"))) {
             qWarning("Failed to write InGameMap Binary.");
             return;
@@ -2634,9 +2686,11 @@ void MainWindow::updateActions()
     ui->actionTMXToBMPAll->setEnabled(worldDoc != 0);
     ui->actionTMXToBMPSelected->setEnabled(worldDoc &&
                                            worldDoc->selectedCellCount());
+    ui->actionTMXToBMPChanged->setEnabled(worldDoc != 0);
 
     ui->actionLUAObjectDump->setEnabled(worldDoc != 0);
     ui->actionWriteObjects->setEnabled(worldDoc != 0);
+    ui->actionRunScript->setEnabled(hasDoc);
 
     ui->actionCopy->setEnabled(worldDoc);
     ui->actionPaste->setEnabled(worldDoc && !Clipboard::instance()->isEmpty());
@@ -112,6 +112,7 @@ public slots:
 
     void TMXToBMPAll();
     void TMXToBMPSelected();
+    void TMXToBMPChanged();
 
     void resizeWorld();
 
@@ -171,6 +172,7 @@ public slots:
     void BuildingsToPNG();
 
     void lootInspector();
+    void runScript();
 
     void readOldWaterDotLua();
 
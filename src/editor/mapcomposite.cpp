@@ -98,6 +98,7 @@ CompositeLayerGroup::CompositeLayerGroup(MapComposite *owner, int level)
     , mOwner(owner)
     , mAnyVisibleLayers(false)
     , mNeedsSynch(true)
+    , mChangeCount(0)
     , mNoBlendCell(Tiled::Internal::TilesetManager::instance()->noBlendTile())
 #if 1 // ROAD_CRUD
     , mRoadLayer0(0)
@@ -518,7 +519,7 @@ bool CompositeLayerGroup::orderedCellsAt3(const QPoint &pos, QVector<TilePlusLay
                         cells.resize(root->mKeepFloorLayerCount);
                         cleared = true;
                     }
-                    cells.append(TilePlusLayer(tl->name(), cell->tile, mVisibleLayers[index], mLayerOpacity[index]));
+                    cells.append(TilePlusLayer(tl->name(), cell->tile(), mVisibleLayers[index], mLayerOpacity[index]));
                     if (mMaxFloorLayer >= index)
                         mOwner->mKeepFloorLayerCount = cells.size();
                     continue;
@@ -532,7 +533,7 @@ bool CompositeLayerGroup::orderedCellsAt3(const QPoint &pos, QVector<TilePlusLay
                 }
             }
             if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
-                aboveLotCells += TilePlusLayer(tl->name(), cell->tile, mVisibleLayers[index], mLayerOpacity[index]);
+                aboveLotCells += TilePlusLayer(tl->name(), cell->tile(), mVisibleLayers[index], mLayerOpacity[index]);
                 continue;
             }
             if (!cell->isEmpty()) {
@@ -551,7 +552,7 @@ bool CompositeLayerGroup::orderedCellsAt3(const QPoint &pos, QVector<TilePlusLay
                     }
                     cleared = true;
                 }
-                cells.append(TilePlusLayer(tl->name(), cell->tile, mVisibleLayers[index], mLayerOpacity[index]));
+                cells.append(TilePlusLayer(tl->name(), cell->tile(), mVisibleLayers[index], mLayerOpacity[index]));
                 if (owner()->parent() == root) {
                     cells.last().mSubMap = owner();
                 }
@@ -618,6 +619,7 @@ bool CompositeLayerGroup::isLayerEmpty(int index) const
 
 void CompositeLayerGroup::synch()
 {
+    mChangeCount++;
     mMaxFloorLayer = -1;
     if (!mVisible) {
         mAnyVisibleLayers = false;
@@ -708,10 +710,21 @@ void CompositeLayerGroup::synch()
         }
     }
 
+    // The layers of lots aren't edited, so only the blocks of a layer that
+    // have tiles in them need to be drawn.  This keeps lots that only use
+    // part of their map from being prepared for drawing when the area with
+    // tiles in it isn't exposed.
+    const bool useCellBounds = mOwner->parent() && !mOwner->mapInfo()->isBeingEdited();
+
     int index = 0;
     foreach (TileLayer *tl, mLayers) {
         if (!isLayerEmpty(index)) {
-            unionTileRects(r, tl->bounds().translated(mOwner->orientAdjustTiles() * mLevel), r);
+            QRect bounds = tl->bounds();
+#if SPARSE_TILELAYER
+            if (useCellBounds)
+                bounds = tl->cellBounds().translated(tl->position());
+#endif
+            unionTileRects(r, bounds.translated(mOwner->orientAdjustTiles() * mLevel), r);
             maxMargins(m, tl->drawMargins(), m);
             mAnyVisibleLayers = true;
         }
@@ -762,6 +775,7 @@ void CompositeLayerGroup::saveVisibility()
 void CompositeLayerGroup::restoreVisibility()
 {
     mVisibleLayers = mSavedVisibleLayers;
+    mChangeCount++;
 }
 
 void CompositeLayerGroup::saveOpacity()
@@ -772,6 +786,7 @@ void CompositeLayerGroup::saveOpacity()
 void CompositeLayerGroup::restoreOpacity()
 {
     mLayerOpacity = mSavedOpacity;
+    mChangeCount++;
 }
 
 bool CompositeLayerGroup::setBmpBlendLayers(const QList<TileLayer *> &layers)
@@ -789,7 +804,10 @@ bool CompositeLayerGroup::setBmpBlendLayers(const QList<TileLayer *> &layers)
         }
     }
 
-    return old != mBmpBlendLayers;
+    if (old == mBmpBlendLayers)
+        return false;
+    mChangeCount++;
+    return true;
 }
 
 #ifdef BUILDINGED
@@ -844,6 +862,7 @@ bool CompositeLayerGroup::setLayerVisibility(TileLayer *tl, bool visible)
     if (visible != mVisibleLayers[index]) {
         mVisibleLayers[index] = visible;
         mNeedsSynch = true;
+        mChangeCount++;
     }
     return mNeedsSynch;
 }
@@ -891,6 +910,7 @@ bool CompositeLayerGroup::setLayerOpacity(TileLayer *tl, qreal opacity)
     Q_ASSERT(index != -1);
     if (mLayerOpacity[index] != opacity) {
         mLayerOpacity[index] = opacity;
+        mChangeCount++;
         return true;
     }
     return false;
@@ -916,6 +936,8 @@ void CompositeLayerGroup::synchSubMapLayerOpacity(const QString &layerName, qrea
 
 bool CompositeLayerGroup::regionAltered(Tiled::TileLayer *tl)
 {
+    mChangeCount++;
+
     QMargins m;
     maxMargins(mDrawMargins, tl->drawMargins(), m);
     if (m != mDrawMargins) {
@@ -1887,47 +1909,7 @@ void MapComposite::setSuppressRegion(const QRegion &rgn, int level)
 
 #if 1 // ROAD_CRUD
 #include "road.h"
-#include "tileset.h"
-#include <QRegion>
-
-static QList<Road*> roadsWithEndpoint(const QPoint &roadPos,
-                                      const QList<Road*> &roads,
-                                      Road *exclude)
-{
-    QList<Road*> result;
-    foreach (Road *road, roads) {
-        if (road == exclude)
-            continue;
-        if (road->start() == roadPos || road->end() == roadPos)
-            result += road;
-    }
-    return result;
-}
-
-static Tile *parseTileDescription(const QString &tileName,
-                                  const QList<Tileset*> &tilesets)
-{
-    if (tileName.isEmpty())
-        return 0;
-    int n = tileName.lastIndexOf(QLatin1Char('_'));
-    if (n < 0)
-        return 0;
-    QString tilesetName = tileName.mid(0, n);
-    int tileID = tileName.mid(n + 1).toInt();
-    foreach (Tileset *ts, tilesets) {
-        if (ts->name() == tilesetName) { // FIXME: file-name not tileset-name!!!
-            if (tileID < ts->tileCount())
-                return ts->tileAt(tileID);
-            break;
-        }
-    }
-    return 0;
-}
-
-static Tile *tileForRoad(Road *road, const QList<Tileset*> &tilesets)
-{
-    return parseTileDescription(road->tileName(), tilesets);
-}
+#include "roadlayercache.h"
 
 void MapComposite::generateRoadLayers(const QPoint &roadPos, const QList<Road *> &roads)
 {
@@ -1942,130 +1924,17 @@ void MapComposite::generateRoadLayers(const QPoint &roadPos, const QList<Road *>
     mRoadLayer1->erase();
     mRoadLayer0->erase();
 
-    // Fill roads with road tile
-
-    foreach (Road *road, roadsInCell) {
-        Tile *tile;
-        if (!(tile = tileForRoad(road, mMap->tilesets())))
-            continue;
-        Cell cell0(tile);
-        QRect roadBounds = road->bounds();
-        roadBounds.translate(-roadPos); // layer coordinates
-        for (int x = roadBounds.left(); x <= roadBounds.right(); x++) {
-            for (int y = roadBounds.top(); y <= roadBounds.bottom(); y++) {
-                if (mRoadLayer0->contains(x, y))
-                    mRoadLayer0->setCell(x, y, cell0);
-            }
-        }
-    }
-
-    // Traffic lines
+    if (roadsInCell.isEmpty())
+        return;
 
-    foreach (Road *road, roadsInCell) {
-        if (!road->trafficLines())
-            continue;
-        Tile *tileInnerNS = parseTileDescription(road->trafficLines()->inner.ns,
-                                                 mMap->tilesets());
-        Tile *tileInnerWE = parseTileDescription(road->trafficLines()->inner.we,
-                                                 mMap->tilesets());
-        Tile *tileInnerNW = parseTileDescription(road->trafficLines()->inner.nw,
-                                                 mMap->tilesets());
-        Tile *tileInnerSW = parseTileDescription(road->trafficLines()->inner.sw,
-                                                 mMap->tilesets());
-
-        Tile *tileOuterNS = parseTileDescription(road->trafficLines()->outer.ns,
-                                                 mMap->tilesets());
-        Tile *tileOuterWE = parseTileDescription(road->trafficLines()->outer.we,
-                                                 mMap->tilesets());
-        Tile *tileOuterNE = parseTileDescription(road->trafficLines()->outer.ne,
-                                                 mMap->tilesets());
-        Tile *tileOuterSE = parseTileDescription(road->trafficLines()->outer.se,
-                                                 mMap->tilesets());
-        QRect roadBounds = road->bounds();
-        roadBounds.translate(-roadPos); // layer coordinates
-        QList<Road*> roadsAtStart = roadsWithEndpoint(road->start(), roadsInCell,
-                                                      road);
-        QList<Road*> roadsAtEnd = roadsWithEndpoint(road->end(), roadsInCell,
-                                                    road);
-        if (road->isVertical()) {
-            int x = road->x1() - roadPos.x();
-            int y1 = roadBounds.top(), y2 = roadBounds.bottom();
-            if (roadsAtStart.count()) {
-                if (road->orient() == Road::NorthSouth)
-                    y1 += road->width() / 2;
-                else
-                    y2 -= road->width() -  road->width() / 2;
-            }
-            if (roadsAtEnd.count()) {
-                if (road->orient() == Road::NorthSouth)
-                    y2 -= road->width() -  road->width() / 2;
-                else
-                    y1 += road->width() / 2;
-            }
-            for (int y = y1; y <= y2; y++) {
-                if (tileInnerNS && mRoadLayer1->contains(x, y)) {
-                    Tile *curTile = mRoadLayer1->cellAt(x, y).tile;
-                    if (curTile == tileInnerWE)
-                        mRoadLayer1->setCell(x, y, Cell(tileInnerNW));
-                    else if (curTile == tileOuterWE)
-                        mRoadLayer1->setCell(x, y, Cell(tileInnerSW));
-                    else if (curTile == tileInnerNW || curTile == tileInnerSW)
-                        ;
-                    else
-                        mRoadLayer1->setCell(x, y, Cell(tileInnerNS));
-                }
-                if (tileOuterNS && mRoadLayer1->contains(x-1, y) && road->width() > 1) {
-                    Tile *curTile = mRoadLayer1->cellAt(x-1, y).tile;
-                    if (curTile == tileInnerWE)
-                        mRoadLayer1->setCell(x-1, y, Cell(tileOuterNE));
-                    else if (curTile == tileOuterWE)
-                        mRoadLayer1->setCell(x-1, y, Cell(tileOuterSE));
-                    else if (curTile == tileOuterNE || curTile == tileOuterSE)
-                        ;
-                    else
-                        mRoadLayer1->setCell(x-1, y, Cell(tileOuterNS));
-                }
-            }
-        } else {
-            int y = road->y1() - roadPos.y();
-            int x1 = roadBounds.left(), x2 = roadBounds.right();
-            if (roadsAtStart.count()) {
-                if (road->orient() == Road::WestEast)
-                    x1 += road->width() / 2;
-                else
-                    x2 -= road->width() -  road->width() / 2;
-            }
-            if (roadsAtEnd.count()) {
-                if (road->orient() == Road::WestEast)
-                    x2 -= road->width() -  road->width() / 2;
-                else
-                    x1 += road->width() / 2;
-            }
-            for (int x = x1; x <= x2; x++) {
-                if (tileInnerWE && mRoadLayer1->contains(x, y)) {
-                    Tile *curTile = mRoadLayer1->cellAt(x, y).tile;
-                    if (curTile == tileOuterNS)
-                        mRoadLayer1->setCell(x, y, Cell(tileOuterNE));
-                    else if (curTile == tileInnerNS)
-                        mRoadLayer1->setCell(x, y, Cell(tileInnerNW));
-                    else if (curTile == tileOuterNE || curTile == tileInnerNW)
-                        ;
-                    else
-                        mRoadLayer1->setCell(x, y, Cell(tileInnerWE));
-                }
-                if (tileOuterWE && mRoadLayer1->contains(x, y-1) && road->width() > 1) {
-                    Tile *curTile = mRoadLayer1->cellAt(x, y-1).tile;
-                    if (curTile == tileOuterNS)
-                        mRoadLayer1->setCell(x, y-1, Cell(tileOuterSE));
-                    else if (curTile == tileInnerNS)
-                        mRoadLayer1->setCell(x, y-1, Cell(tileInnerSW));
-                    else if (curTile == tileOuterSE || curTile == tileInnerSW)
-                        ;
-                    else
-                        mRoadLayer1->setCell(x, y-1, Cell(tileOuterWE));
-                }
-            }
-        }
-    }
+    // The tiles are only rasterized again when the roads in this cell change.
+    QVector<Tile*> tiles;
+    const RoadLayers &layers = RoadLayerCache::instance()->roadLayers(
+                roadPos, mRoadLayer0->bounds().size(), roadsInCell, mMap->tilesets(),
+                tiles);
+    foreach (const RoadLayers::RoadTile &rt, layers.mLayer0)
+        mRoadLayer0->setCell(rt.x, rt.y, Cell(tiles[rt.tile]));
+    foreach (const RoadLayers::RoadTile &rt, layers.mLayer1)
+        mRoadLayer1->setCell(rt.x, rt.y, Cell(tiles[rt.tile]));
 }
 #endif // ROAD_CRUD
@@ -129,6 +129,12 @@ public:
 
     bool regionAltered(Tiled::TileLayer *tl);
 
+    /**
+      * Incremented whenever something that affects drawing this group changes:
+      * tiles, layer visibility or opacity, or the visible sub-maps.
+      */
+    int changeCount() const { return mChangeCount; }
+
     void setNeedsSynch(bool synch) { mNeedsSynch = synch; }
     bool needsSynch() const { return mNeedsSynch; }
     bool isLayerEmpty(int index) const;
@@ -181,6 +187,7 @@ private:
     MapComposite *mOwner;
     bool mAnyVisibleLayers;
     bool mNeedsSynch;
+    int mChangeCount;
     QRect mTileBounds;
     QRect mSubMapTileBounds;
     QMargins mDrawMargins;
@@ -20,6 +20,7 @@
 #ifdef WORLDED
 #include "bmptotmx.h"
 #endif // WORLDED
+#include "bandedmaprenderer.h"
 #include "bmpblender.h"
 #include "imagelayer.h"
 #include "isometricrenderer.h"
@@ -29,6 +30,7 @@
 #include "mapmanager.h"
 #include "objectgroup.h"
 #include "orthogonalrenderer.h"
+#include "perftrace.h"
 #include "preferences.h"
 #include "progress.h"
 #include "staggeredrenderer.h"
@@ -262,6 +264,8 @@ MapImage *MapImageManager::getZombieSpawnImage(const QString &imageName, const Q
 
 MapImageManager::ImageData MapImageManager::generateMapImage(const QString &mapFilePath, bool force)
 {
+    PERF_SCOPE("Thumbnail: generate");
+
 #if 0
     if (mapFilePath == QLatin1String("<fail>")) {
         QImage image(IMAGE_WIDTH, 256, QImage::Format_ARGB32);
@@ -385,6 +389,8 @@ void MapImageManager::paintDummyImage(ImageData &data, MapInfo *mapInfo)
 // BMP To TMX image thumbnail
 MapImageManager::ImageData MapImageManager::generateBMPImage(const QString &bmpFilePath)
 {
+    PERF_SCOPE("Thumbnail: generate BMP");
+
     QSize imageSize = BMPToTMX::instance()->validateImages(bmpFilePath);
     if (imageSize.isEmpty()) {
         mError = BMPToTMX::instance()->errorString();
@@ -523,6 +529,8 @@ MapImageManager::ImageData MapImageManager::generateZombieSpawnImage(const QStri
 
 MapImageManager::ImageData MapImageManager::readImageData(const QFileInfo &imageDataFileInfo)
 {
+    PERF_SCOPE("Thumbnail: read data");
+
     ImageData data;
     QFile file(imageDataFileInfo.absoluteFilePath());
     if (!file.open(QIODevice::ReadOnly))
@@ -571,6 +579,8 @@ MapImageManager::ImageData MapImageManager::readImageData(const QFileInfo &image
 
 void MapImageManager::writeImageData(const QFileInfo &imageDataFileInfo, const MapImageManager::ImageData &data)
 {
+    PERF_SCOPE("Thumbnail: write data");
+
     QFile file(imageDataFileInfo.absoluteFilePath());
     if (!file.open(QIODevice::WriteOnly))
         return;
@@ -1056,11 +1066,13 @@ void MapImageReaderWorker::work()
 
         Job job = mJobs.takeAt(0);
 
+        PerfScope perfRead("Thumbnail: read image");
         QImage *image = new QImage(job.imageFileName);
 #ifdef WORLDED
         if (!image->isNull())
             *image = image->convertToFormat(QImage::Format_ARGB4444_Premultiplied);
 #endif // WORLDED
+        perfRead.release();
 
 #ifndef QT_NO_DEBUG
         Sleep::msleep(250);
@@ -1168,6 +1180,8 @@ void MapImageRenderWorker::resume(MapImage *mapImage)
 
 MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 {
+    PERF_SCOPE("Thumbnail: render");
+
     Map *map = mapComposite->map();
 
     MapRenderer *renderer = NULL;
@@ -1216,29 +1230,19 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 
     QImage image(mapSize, QImage::Format_ARGB32);
     image.fill(Qt::transparent);
-    QPainter painter(&image);
-
-    painter.setRenderHints(QPainter::SmoothPixmapTransform |
-                           QPainter::Antialiasing);
-    painter.setTransform(QTransform::fromScale(scale, scale).translate(-sceneRect.left(), -sceneRect.top()));
 
-    foreach (MapComposite::ZOrderItem zo, mapComposite->zOrder()) {
-        if (zo.group) {
-            renderer->drawTileLayerGroup(&painter, zo.group);
-        } else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
-                continue;
-            renderer->drawTileLayer(&painter, tl);
-        }
-        if (aborted()) {
-            painter.end();
-            delete renderer;
-            return MapImageData();
-        }
+    BandedMapRenderer bandedRenderer(mapComposite, renderer);
+    bandedRenderer.setRenderHints(QPainter::SmoothPixmapTransform |
+                                  QPainter::Antialiasing);
+    bandedRenderer.setLayerFilter([](const TileLayer *tl) {
+        return !tl->name().contains(QLatin1String("NoRender"));
+    });
+    QTransform transform = QTransform::fromScale(scale, scale).translate(-sceneRect.left(), -sceneRect.top());
+    if (!bandedRenderer.render(image, transform) || aborted()) {
+        delete renderer;
+        return MapImageData();
     }
 
-    painter.end();
-
     for (int y = 0; y < image.height(); y++) {
         QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
         for (int x = 0; x < image.width(); x++) {
@@ -18,12 +18,14 @@
 #include "mapmanager.h"
 
 #include "mapcomposite.h"
+#include "perftrace.h"
 #include "preferences.h"
 #include "progress.h"
 #include "tilemetainfomgr.h"
 #include "tilesetmanager.h"
 
 #include "map.h"
+#include "mapcache.h"
 #include "mapreader.h"
 #include "mapobject.h"
 #include "objectgroup.h"
@@ -35,8 +37,10 @@
 using namespace SharedTools;
 
 #include "BuildingEditor/building.h"
+#include "BuildingEditor/buildingfloor.h"
 #include "BuildingEditor/buildingreader.h"
 #include "BuildingEditor/buildingmap.h"
+#include "BuildingEditor/buildingmapcache.h"
 #include "BuildingEditor/buildingobjects.h"
 #include "BuildingEditor/buildingtiles.h"
 #include "BuildingEditor/furnituregroups.h"
@@ -90,6 +94,7 @@ MapManager::MapManager() :
             this, &MapManager::fileChangedTimeout);
 
     qRegisterMetaType<MapInfo*>("BuildingEditor::Building*");
+    qRegisterMetaType<MapInfo*>("BuildingEditor::ConvertedBuilding*");
     qRegisterMetaType<MapInfo*>("MapInfo*");
 
     mMapReaderThread.resize(16);
@@ -100,7 +105,7 @@ MapManager::MapManager() :
         mMapReaderWorker[i]->moveToThread(mMapReaderThread[i]);
         connect(mMapReaderWorker[i], qOverload<Map*,MapInfo*>(&MapReaderWorker::loaded),
                 this, &MapManager::mapLoadedByThread);
-        connect(mMapReaderWorker[i], qOverload<BuildingEditor::Building*,MapInfo*>(&MapReaderWorker::loaded),
+        connect(mMapReaderWorker[i], qOverload<BuildingEditor::ConvertedBuilding*,BuildingEditor::Building*,MapInfo*>(&MapReaderWorker::loaded),
                 this, &MapManager::buildingLoadedByThread);
         connect(mMapReaderWorker[i], &MapReaderWorker::failedToLoad,
                 this, &MapManager::failedToLoadByThread);
@@ -231,6 +236,12 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
         return mapInfo;
     }
     mapInfo->mLoading = true;
+    if (mapFilePath.endsWith(QLatin1String(".tbx"))) {
+        // Read the tile definitions used by BuildingFloor::LayoutToSquares()
+        // and the revisions used by the cache key in this thread, before
+        // any MapReaderWorker needs them.
+        BuildingEditor::BuildingMapCache::updateVersions();
+    }
     QMetaObject::invokeMethod(mMapReaderWorker[mNextThreadForJob], "addJob",
                               Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
                               Q_ARG(int,priority));
@@ -742,6 +753,8 @@ void MapManager::metaTilesetRemoved(Tileset *tileset)
 
 void MapManager::mapLoadedByThread(Map *map, MapInfo *mapInfo)
 {
+    PERF_SCOPE("Map: finish load");
+
     if (mapInfo != mWaitingForMapInfo && mDeferralDepth > 0) {
         noise() << "MAP LOADED BY THREAD - DEFERR" << mapInfo->path();
         mDeferredMaps += MapDeferral(mapInfo, map);
@@ -798,27 +811,25 @@ void MapManager::mapLoadedByThread(Map *map, MapInfo *mapInfo)
     emit mapLoaded(mapInfo);
 }
 
-void MapManager::buildingLoadedByThread(Building *building, MapInfo *mapInfo)
+void MapManager::buildingLoadedByThread(ConvertedBuilding *converted,
+                                        Building *building, MapInfo *mapInfo)
 {
-    MapManagerDeferral deferral;
+    PERF_SCOPE("Map: finish building load");
 
-    BuildingReader reader;
-    reader.fix(building);
-
-    BuildingMap::loadNeededTilesets(building);
+    MapManagerDeferral deferral;
 
-    BuildingMap bmap(building);
-    Map *map = bmap.mergedMap();
-    bmap.addRoomDefObjects(map);
+    // The worker thread converted the building without calling fix(), which
+    // deletes the tiles BuildingReader created while reading it.
+    if (building) {
+        BuildingReader reader;
+        reader.fix(building);
+        delete building;
+    }
 
-#if 0
-    map->setProperty(QStringLiteral("Legend"), QStringLiteral("CommunityServices"));
-    map->setProperty(QStringLiteral("File"), QFileInfo(mapInfo->path()).fileName());
-#else
-    map->setProperties(building->properties());
-#endif
+    BuildingMap::loadNeededTilesets(converted->tilesetNames());
 
-    delete building;
+    Map *map = converted->takeMap();
+    delete converted;
 
     QSet<Tileset*> usedTilesets = map->usedTilesets();
     usedTilesets.remove(TilesetManager::instance()->missingTileset());
@@ -826,10 +837,6 @@ void MapManager::buildingLoadedByThread(Building *building, MapInfo *mapInfo)
     //TileMetaInfoMgr::instance()->loadTilesets({ usedTilesets.begin(), usedTilesets.end() });
     TileMetaInfoMgr::instance()->loadTilesets({ usedTilesets.toList() });
 
-    // The map references TileMetaInfoMgr's tilesets, but we add a reference
-    // to them ourself below.
-    TilesetManager::instance()->removeReferences(map->tilesets());
-
     mapLoadedByThread(map, mapInfo);
 }
 
@@ -897,9 +904,10 @@ void MapReaderWorker::work()
         debugJobs("take job");
 
         if (job.mapInfo->path().endsWith(QLatin1String(".tbx"))) {
-            Building *building = loadBuilding(job.mapInfo);
-            if (building)
-                emit loaded(building, job.mapInfo);
+            Building *building = nullptr;
+            ConvertedBuilding *converted = loadBuilding(job.mapInfo, &building);
+            if (converted)
+                emit loaded(converted, building, job.mapInfo);
             else
                 emit failedToLoad(mError, job.mapInfo);
         } else {
@@ -966,21 +974,72 @@ protected:
 
 Map *MapReaderWorker::loadMap(MapInfo *mapInfo)
 {
+    PERF_SCOPE("Map: read TMX");
+
+    // The binary cache is rebuilt whenever it is missing or out of date.
+    bool useCache = Preferences::instance()->useMapCache();
+    if (useCache) {
+        PERF_SCOPE("Map: read cache");
+        MapCache cache;
+        if (Map *map = cache.readMap(mapInfo->path())) {
+            PERF_COUNTER("Map: cache hits", 1);
+            return map;
+        }
+    }
+
+    PerfScope perfParse("Map: parse TMX");
     MapReaderWorker_MapReader reader;
 //    reader.setTilesetImageCache(TilesetManager::instance()->imageCache()); // not thread-safe class
     Map *map = reader.readMap(mapInfo->path());
-    if (!map)
+    if (!map) {
         mError = reader.errorString();
+        return map;
+    }
+    perfParse.release();
+
+    if (useCache) {
+        PERF_SCOPE("Map: write cache");
+        MapCache cache;
+        if (!cache.writeMap(map, mapInfo->path()))
+            noise() << "MapCache: " << cache.errorString();
+    }
     return map;
 }
 
-Building *MapReaderWorker::loadBuilding(MapInfo *mapInfo)
+ConvertedBuilding *MapReaderWorker::loadBuilding(MapInfo *mapInfo, Building **building)
 {
+    PERF_SCOPE("Map: read TBX");
+
+    // The building is converted to a map here rather than in the GUI thread.
+    // When the cache is used, the .tbx file isn't parsed at all.
+    bool useCache = Preferences::instance()->useMapCache();
+    BuildingMapCache cache;
+    if (useCache) {
+        if (ConvertedBuilding *converted = cache.read(mapInfo->path()))
+            return converted;
+    }
+
+    // Keeps the BuildingTiles.txt categories from changing under the reader
+    // and LayoutToSquares().
+    QReadLocker locker(&BuildingTilesMgr::instance()->lock());
+
+    PerfScope perfParse("Map: parse TBX");
     BuildingReader reader;
-    Building *building = reader.read(mapInfo->path());
-    if (!building)
+    *building = reader.read(mapInfo->path());
+    if (!*building) {
         mError = reader.errorString();
-    return building;
+        return nullptr;
+    }
+    perfParse.release();
+
+    PerfScope perfConvert("Map: convert building");
+    ConvertedBuilding *converted = ConvertedBuilding::fromBuilding(*building);
+    perfConvert.release();
+    locker.unlock();
+
+    if (useCache && !cache.write(converted, mapInfo->path()))
+        noise() << "BuildingMapCache: " << cache.errorString();
+    return converted;
 }
 
 void MapReaderWorker::debugJobs(const char *msg)
@@ -30,6 +30,7 @@ class MapInfo;
 
 namespace BuildingEditor {
 class Building;
+class ConvertedBuilding;
 }
 
 class MapReaderWorker : public BaseWorker
@@ -41,7 +42,8 @@ public:
 
 signals:
     void loaded(Tiled::Map *map, MapInfo *mapInfo);
-    void loaded(BuildingEditor::Building *building, MapInfo *mapInfo);
+    void loaded(BuildingEditor::ConvertedBuilding *converted,
+                BuildingEditor::Building *building, MapInfo *mapInfo);
     void failedToLoad(const QString error, MapInfo *mapInfo);
 
 public slots:
@@ -51,7 +53,8 @@ public slots:
 
 private:
     Tiled::Map *loadMap(MapInfo *mapInfo);
-    BuildingEditor::Building *loadBuilding(MapInfo *mapInfo);
+    BuildingEditor::ConvertedBuilding *loadBuilding(MapInfo *mapInfo,
+                                                    BuildingEditor::Building **building);
 
     class Job {
     public:
@@ -221,7 +224,8 @@ private slots:
     void metaTilesetRemoved(Tiled::Tileset *tileset);
 
     void mapLoadedByThread(Tiled::Map *map, MapInfo *mapInfo);
-    void buildingLoadedByThread(BuildingEditor::Building *building, MapInfo *mapInfo);
+    void buildingLoadedByThread(BuildingEditor::ConvertedBuilding *converted,
+                                BuildingEditor::Building *building, MapInfo *mapInfo);
     void failedToLoadByThread(const QString error, MapInfo *mapInfo);
 
     void processDeferrals();
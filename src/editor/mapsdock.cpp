@@ -131,7 +131,7 @@ void MapsDock::selectionChanged()
     QFileInfo info(path);
     if (info.isDir())
         return;
-    if (info.suffix() == QLatin1String("pzw"))
+    if (info.suffix() == QLatin1String("pzw") || info.suffix() == QLatin1String("pzwb"))
         return;
     MapImage *mapImage = MapImageManager::instance()->getMapImage(path);
     if (mapImage) {
@@ -205,7 +205,8 @@ MapsView::MapsView(QWidget *parent)
     filters << QLatin1String("*.tmx")
             << QLatin1String("*.tbx")
             << QLatin1String("*.lot")
-            << QLatin1String("*.pzw");
+            << QLatin1String("*.pzw")
+            << QLatin1String("*.pzwb");
     foreach (QString format, BMPToTMX::supportedImageFormats())
         filters << QLatin1String("*.") + format;
     model->setNameFilters(filters);
@@ -273,6 +274,6 @@ void MapsView::onActivated(const QModelIndex &index)
         prefs->setMapsDirectory(fileInfo.canonicalFilePath());
         return;
     }
-    if (fileInfo.suffix() == QLatin1String("pzw"))
+    if (fileInfo.suffix() == QLatin1String("pzw") || fileInfo.suffix() == QLatin1String("pzwb"))
         MainWindow::instance()->openFile(fileInfo.canonicalFilePath(),0);
 }
@@ -54,12 +54,12 @@ IsoGridSquare::IsoGridSquare(int x, int y, int z, IsoChunk *chunk) :
     foreach (const Tiled::Cell *cell, cells) {
         TileDefTileset *tdts = NULL;
         foreach (TileDefFile *tdefFile, mTileDefFiles) {
-            tdts = tdefFile->tileset(cell->tile->tileset()->name());
+            tdts = tdefFile->tileset(cell->tile()->tileset()->name());
             if (tdts != NULL)
                 break;
         }
         if (tdts != NULL) {
-            TileDefTile *tdt = tdts->tile(cell->tile->id() % tdts->mColumns, cell->tile->id() / tdts->mColumns);
+            TileDefTile *tdt = tdts->tile(cell->tile()->id() % tdts->mColumns, cell->tile()->id() / tdts->mColumns);
             if (tdt == NULL)
                 continue;
             foreach (QString key, tdt->mProperties.keys()) {
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perftrace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+struct PerfEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 value; // duration of a phase, or counter increment
+    bool counter;
+};
+
+class PerfThreadBuffer
+{
+public:
+    enum { Capacity = 64 * 1024 };
+
+    PerfThreadBuffer(int threadId, const QString &threadName) :
+        mThreadId(threadId),
+        mThreadName(threadName),
+        mEvents(Capacity),
+        mCount(0)
+    {
+    }
+
+    // Only the owning thread calls this.
+    void add(const char *name, qint64 start, qint64 value, bool counter)
+    {
+        quint64 count = mCount.load(std::memory_order_relaxed);
+        PerfEvent &e = mEvents[int(count % Capacity)];
+        e.name = name;
+        e.start = start;
+        e.value = value;
+        e.counter = counter;
+        mCount.store(count + 1, std::memory_order_release);
+    }
+
+    QVector<PerfEvent> events(quint64 &dropped) const
+    {
+        quint64 count = mCount.load(std::memory_order_acquire);
+        quint64 n = qMin(count, quint64(Capacity));
+        dropped = count - n;
+        QVector<PerfEvent> result;
+        result.reserve(int(n));
+        for (quint64 i = count - n; i < count; i++)
+            result += mEvents[int(i % Capacity)];
+        return result;
+    }
+
+    int mThreadId;
+    QString mThreadName;
+
+private:
+    QVector<PerfEvent> mEvents;
+    std::atomic<quint64> mCount;
+};
+
+// The buffers are never freed, so events recorded by threads that have
+// finished can still be written out.
+QMutex gBuffersMutex;
+QList<PerfThreadBuffer*> gBuffers;
+thread_local PerfThreadBuffer *tBuffer = nullptr;
+
+std::chrono::steady_clock::time_point gStartTime = std::chrono::steady_clock::now();
+
+PerfThreadBuffer *threadBuffer()
+{
+    if (tBuffer)
+        return tBuffer;
+
+    QString name;
+    QThread *thread = QThread::currentThread();
+    if (qApp && thread == qApp->thread())
+        name = QLatin1String("GUI");
+    else if (!thread->objectName().isEmpty())
+        name = thread->objectName();
+
+    QMutexLocker locker(&gBuffersMutex);
+    int threadId = gBuffers.size() + 1;
+    if (name.isEmpty())
+        name = QString(QLatin1String("Thread %1")).arg(threadId);
+    tBuffer = new PerfThreadBuffer(threadId, name);
+    gBuffers += tBuffer;
+    return tBuffer;
+}
+
+QList<PerfThreadBuffer*> threadBuffers()
+{
+    QMutexLocker locker(&gBuffersMutex);
+    return gBuffers;
+}
+
+QString jsonString(const char *s)
+{
+    QString result = QString::fromLatin1(s);
+    result.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    result.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return QLatin1Char('"') + result + QLatin1Char('"');
+}
+
+QString micros(qint64 nsecs)
+{
+    return QString::number(nsecs / 1000.0, 'f', 3);
+}
+
+QString millis(qint64 nsecs)
+{
+    return QString::number(nsecs / 1000000.0, 'f', 3);
+}
+
+} // namespace
+
+bool PerfTrace::mEnabled = false;
+
+void PerfTrace::setEnabled(bool enabled)
+{
+    if (enabled && !mEnabled)
+        gStartTime = std::chrono::steady_clock::now();
+    mEnabled = enabled;
+}
+
+qint64 PerfTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - gStartTime).count();
+}
+
+void PerfTrace::addPhase(const char *name, qint64 start, qint64 duration)
+{
+    threadBuffer()->add(name, start, duration, false);
+}
+
+void PerfTrace::addCounter(const char *name, qint64 value)
+{
+    threadBuffer()->add(name, now(), value, true);
+}
+
+bool PerfTrace::writeChromeTrace(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    QList<PerfEvent> counters;
+    foreach (PerfThreadBuffer *buffer, threadBuffers()) {
+        if (!first)
+            out << ",\n";
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->mThreadId
+            << ",\"args\":{\"name\":\"" << buffer->mThreadName << "\"}}";
+
+        quint64 dropped;
+        foreach (const PerfEvent &e, buffer->events(dropped)) {
+            if (e.counter) {
+                counters += e;
+                continue;
+            }
+            out << ",\n{\"name\":" << jsonString(e.name)
+                << ",\"cat\":\"PZWorldEd\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->mThreadId
+                << ",\"ts\":" << micros(e.start) << ",\"dur\":" << micros(e.value) << "}";
+        }
+    }
+
+    // Counters are recorded as increments; the trace shows the running total
+    // over all threads.  The same name may have more than one address, so
+    // the totals are kept by value, as in summary().
+    std::stable_sort(counters.begin(), counters.end(), [](const PerfEvent &a, const PerfEvent &b) {
+        return a.start < b.start;
+    });
+    QHash<QByteArray,qint64> totals;
+    foreach (const PerfEvent &e, counters) {
+        qint64 &total = totals[QByteArray(e.name)];
+        total += e.value;
+        if (!first)
+            out << ",\n";
+        first = false;
+        out << "{\"name\":" << jsonString(e.name)
+            << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << micros(e.start)
+            << ",\"args\":{\"value\":" << total << "}}";
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    return file.error() == QFile::NoError;
+}
+
+bool PerfTrace::writeSummary(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+    QTextStream out(&file);
+    out << summary();
+    out.flush();
+    return file.error() == QFile::NoError;
+}
+
+QString PerfTrace::summary()
+{
+    struct Stats
+    {
+        Stats() : name(nullptr), counter(false), count(0), total(0), max(0) {}
+        const char *name;
+        bool counter;
+        qint64 count;
+        qint64 total;
+        qint64 max;
+    };
+
+    // Names are literals, but the same literal may have more than one
+    // address, so compare them by value.
+    QHash<QByteArray,Stats> statsByName;
+    quint64 totalDropped = 0;
+    foreach (PerfThreadBuffer *buffer, threadBuffers()) {
+        quint64 dropped;
+        foreach (const PerfEvent &e, buffer->events(dropped)) {
+            Stats &stats = statsByName[QByteArray(e.name)];
+            stats.name = e.name;
+            stats.counter = e.counter;
+            stats.count++;
+            stats.total += e.value;
+            stats.max = qMax(stats.max, e.value);
+        }
+        totalDropped += dropped;
+    }
+
+    QList<Stats> phases, counters;
+    foreach (const Stats &stats, statsByName) {
+        if (stats.counter)
+            counters += stats;
+        else
+            phases += stats;
+    }
+    auto byTotal = [](const Stats &a, const Stats &b) { return a.total > b.total; };
+    std::sort(phases.begin(), phases.end(), byTotal);
+    std::sort(counters.begin(), counters.end(), byTotal);
+
+    QString result;
+    QTextStream out(&result);
+    out << QString(QLatin1String("%1 %2 %3 %4 %5\n"))
+           .arg(QLatin1String("Phase"), -40)
+           .arg(QLatin1String("Count"), 10)
+           .arg(QLatin1String("Total ms"), 14)
+           .arg(QLatin1String("Mean ms"), 12)
+           .arg(QLatin1String("Max ms"), 12);
+    foreach (const Stats &stats, phases) {
+        out << QString(QLatin1String("%1 %2 %3 %4 %5\n"))
+               .arg(QString::fromLatin1(stats.name), -40)
+               .arg(stats.count, 10)
+               .arg(millis(stats.total), 14)
+               .arg(millis(stats.total / stats.count), 12)
+               .arg(millis(stats.max), 12);
+    }
+    if (!counters.isEmpty()) {
+        out << QString(QLatin1String("\n%1 %2\n"))
+               .arg(QLatin1String("Counter"), -40)
+               .arg(QLatin1String("Total"), 10);
+        foreach (const Stats &stats, counters) {
+            out << QString(QLatin1String("%1 %2\n"))
+                   .arg(QString::fromLatin1(stats.name), -40)
+                   .arg(stats.total, 10);
+        }
+    }
+    if (totalDropped)
+        out << QString(QLatin1String("\n%1 events were overwritten in full ring buffers.\n"))
+               .arg(totalDropped);
+    out.flush();
+    return result;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+#include <QString>
+
+/**
+  * Records timed phases and counters into a fixed-size ring buffer per thread.
+  * Recording is off unless the PZWORLDED_TRACE environment variable names an
+  * output file; main() then writes a Chrome trace-event file (load it in
+  * chrome://tracing or Perfetto) and a summary table next to it on exit.
+  *
+  * Phase and counter names must be string literals, they are stored by
+  * pointer.  When recording is off a PERF_SCOPE costs one test of a bool.
+  */
+class PerfTrace
+{
+public:
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled()
+    { return mEnabled; }
+
+    /**
+      * Nanoseconds since setEnabled(true) was called.
+      */
+    static qint64 now();
+
+    static void addPhase(const char *name, qint64 start, qint64 duration);
+    static void addCounter(const char *name, qint64 value);
+
+    /**
+      * Events are read without stopping the threads that record them, so
+      * these should be called when no work is being done.
+      */
+    static bool writeChromeTrace(const QString &fileName);
+    static bool writeSummary(const QString &fileName);
+    static QString summary();
+
+private:
+    static bool mEnabled;
+};
+
+class PerfScope
+{
+public:
+    PerfScope(const char *name) :
+        mName(PerfTrace::isEnabled() ? name : nullptr),
+        mStart(mName ? PerfTrace::now() : 0)
+    {
+    }
+
+    /**
+      * Ends the phase before the end of the enclosing scope.
+      */
+    void release()
+    {
+        if (mName)
+            PerfTrace::addPhase(mName, mStart, PerfTrace::now() - mStart);
+        mName = nullptr;
+    }
+
+    ~PerfScope()
+    {
+        release();
+    }
+
+private:
+    const char *mName;
+    qint64 mStart;
+
+    Q_DISABLE_COPY(PerfScope)
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+
+#ifdef PERF_TRACE_DISABLED
+#define PERF_SCOPE(name) do {} while (0)
+#define PERF_COUNTER(name, value) do {} while (0)
+#else
+#define PERF_SCOPE(name) PerfScope PERF_CONCAT(perfScope, __LINE__)(name)
+#define PERF_COUNTER(name, value) \
+    do { if (PerfTrace::isEnabled()) PerfTrace::addCounter(name, value); } while (0)
+#endif
+
+#endif // PERFTRACE_H
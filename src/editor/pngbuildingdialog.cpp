@@ -201,7 +201,7 @@ bool PNGBuildingDialog::generateCell(WorldCell *cell)
                 cells.resize(0);
                 if (layerGroup->orderedCellsAt2(QPoint(x, y), cells)) {
                     foreach (const Cell *tileCell, cells) {
-                        if (tilesets.contains(tileCell->tile->tileset())) {
+                        if (tilesets.contains(tileCell->tile()->tileset())) {
                             mImage.setPixel(cell->x() * 300 + x, cell->y() * 300 + y, treeColor);
                             break;
                         }
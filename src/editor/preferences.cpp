@@ -17,6 +17,8 @@
 
 #include "preferences.h"
 
+#include "tilesetpixelcache.h"
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QSettings>
@@ -101,6 +103,12 @@ Preferences::Preferences()
     mShowOtherWorlds = mSettings->value(QLatin1String("ShowOtherWorlds"), true).toBool();
     mUseOpenGL = mSettings->value(QLatin1String("OpenGL"), false).toBool();
     mWorldThumbnails = mSettings->value(QLatin1String("WorldThumbnails"), false).toBool();
+    mUseMapCache = mSettings->value(QLatin1String("MapCache"), false).toBool();
+    mUseTilesetCache = mSettings->value(QLatin1String("TilesetCache"), false).toBool();
+    Tiled::TilesetPixelCache::setEnabled(mUseTilesetCache);
+    mUndoMemoryLimit = mSettings->value(QLatin1String("UndoMemoryLimit"), 256).toInt();
+    mMapCompressionLevel = mSettings->value(QLatin1String("MapCompressionLevel"), -1).toInt();
+    mWorldMapBinaryVersion = mSettings->value(QLatin1String("WorldMapBinaryVersion"), 1).toInt();
     mShowAdjacentMaps = mSettings->value(QLatin1String("ShowAdjacentMaps"), true).toBool();
     mLoadLastActivProject = mSettings->value(QLatin1String("LoadLastActivProject"), true).toBool();
     menableDarkTheme = mSettings->value(QLatin1String("EnableDarkTheme"), true).toBool();
@@ -331,6 +339,64 @@ void Preferences::setWorldThumbnails(bool thumbs)
     emit worldThumbnailsChanged(mWorldThumbnails);
 }
 
+void Preferences::setUseMapCache(bool useCache)
+{
+    if (mUseMapCache == useCache)
+        return;
+
+    mUseMapCache = useCache;
+    mSettings->setValue(QLatin1String("Interface/MapCache"), mUseMapCache);
+
+    emit useMapCacheChanged(mUseMapCache);
+}
+
+void Preferences::setUseTilesetCache(bool useCache)
+{
+    if (mUseTilesetCache == useCache)
+        return;
+
+    mUseTilesetCache = useCache;
+    mSettings->setValue(QLatin1String("Interface/TilesetCache"), mUseTilesetCache);
+    Tiled::TilesetPixelCache::setEnabled(mUseTilesetCache);
+
+    emit useTilesetCacheChanged(mUseTilesetCache);
+}
+
+void Preferences::setUndoMemoryLimit(int megabytes)
+{
+    if (mUndoMemoryLimit == megabytes)
+        return;
+
+    mUndoMemoryLimit = megabytes;
+    mSettings->setValue(QLatin1String("Interface/UndoMemoryLimit"), mUndoMemoryLimit);
+
+    emit undoMemoryLimitChanged(mUndoMemoryLimit);
+}
+
+void Preferences::setMapCompressionLevel(int level)
+{
+    level = qBound(-1, level, 9);
+    if (mMapCompressionLevel == level)
+        return;
+
+    mMapCompressionLevel = level;
+    mSettings->setValue(QLatin1String("Interface/MapCompressionLevel"), mMapCompressionLevel);
+
+    emit mapCompressionLevelChanged(mMapCompressionLevel);
+}
+
+void Preferences::setWorldMapBinaryVersion(int version)
+{
+    version = qBound(1, version, 2);
+    if (mWorldMapBinaryVersion == version)
+        return;
+
+    mWorldMapBinaryVersion = version;
+    mSettings->setValue(QLatin1String("Interface/WorldMapBinaryVersion"), mWorldMapBinaryVersion);
+
+    emit worldMapBinaryVersionChanged(mWorldMapBinaryVersion);
+}
+
 QString Preferences::openFileDirectory() const
 {
     return mOpenFileDirectory;
@@ -75,6 +75,29 @@ public:
     bool worldThumbnails() const { return mWorldThumbnails; }
     void setWorldThumbnails(bool thumbs);
 
+    bool useMapCache() const { return mUseMapCache; }
+    void setUseMapCache(bool useCache);
+
+    bool useTilesetCache() const { return mUseTilesetCache; }
+    void setUseTilesetCache(bool useCache);
+
+    int undoMemoryLimit() const { return mUndoMemoryLimit; }
+    void setUndoMemoryLimit(int megabytes);
+
+    /**
+     * The zlib level used for the tile layers of maps written by BMP To TMX,
+     * from 0 (none) to 9 (smallest).  -1 is zlib's default level.
+     */
+    int mapCompressionLevel() const { return mMapCompressionLevel; }
+    void setMapCompressionLevel(int level);
+
+    /**
+     * The InGameMapWriterBinary version of the .bin file written next to the
+     * in-game map .xml file.  Version 1 is what the game reads.
+     */
+    int worldMapBinaryVersion() const { return mWorldMapBinaryVersion; }
+    void setWorldMapBinaryVersion(int version);
+
     bool showObjects() const { return mShowObjects; }
     bool showObjectNames() const { return mShowObjectNames; }
     bool showBMPs() const { return mShowBMPs; }
@@ -140,6 +163,11 @@ signals:
 
     void useOpenGLChanged(bool useOpenGL);
     void worldThumbnailsChanged(bool thumbs);
+    void useMapCacheChanged(bool useCache);
+    void useTilesetCacheChanged(bool useCache);
+    void undoMemoryLimitChanged(int megabytes);
+    void mapCompressionLevelChanged(int level);
+    void worldMapBinaryVersionChanged(int version);
 
     void showObjectsChanged(bool show);
     void showObjectNamesChanged(bool show);
@@ -214,6 +242,11 @@ private:
     QColor mGridColor;
     bool mUseOpenGL;
     bool mWorldThumbnails;
+    bool mUseMapCache;
+    bool mUseTilesetCache;
+    int mUndoMemoryLimit;
+    int mMapCompressionLevel;
+    int mWorldMapBinaryVersion;
     bool mShowObjects;
     bool mShowObjectNames;
     bool mShowBMPs;
@@ -48,6 +48,11 @@ PreferencesDialog::PreferencesDialog(WorldDocument* worldDoc, QWidget* parent)
 
     ui->openGL->setChecked(prefs->useOpenGL());
     ui->thumbnails->setChecked(prefs->worldThumbnails());
+    ui->mapCache->setChecked(prefs->useMapCache());
+    ui->tilesetCache->setChecked(prefs->useTilesetCache());
+    ui->undoMemoryLimit->setValue(prefs->undoMemoryLimit());
+    ui->mapCompressionLevel->setValue(prefs->mapCompressionLevel());
+    ui->worldMapBinaryVersion->setCurrentIndex(prefs->worldMapBinaryVersion() - 1);
     ui->showAdjacent->setChecked(prefs->showAdjacentMaps());
     ui->LoadLastActiv->setChecked(prefs->LoadLastActivProject());
     ui->enableDarkTheme->setChecked(prefs->enableDarkTheme());
@@ -100,6 +105,11 @@ void PreferencesDialog::accept()
     Tiled::TileMetaInfoMgr::instance()->changeTilesDirectory(mTilesDirectory);
     prefs->setUseOpenGL(ui->openGL->isChecked());
     prefs->setWorldThumbnails(ui->thumbnails->isChecked());
+    prefs->setUseMapCache(ui->mapCache->isChecked());
+    prefs->setUseTilesetCache(ui->tilesetCache->isChecked());
+    prefs->setUndoMemoryLimit(ui->undoMemoryLimit->value());
+    prefs->setMapCompressionLevel(ui->mapCompressionLevel->value());
+    prefs->setWorldMapBinaryVersion(ui->worldMapBinaryVersion->currentIndex() + 1);
     prefs->setGridColor(mGridColor);
     prefs->setShowAdjacentMaps(ui->showAdjacent->isChecked());
     prefs->setZombieSpawnImageOpacity(ui->zombieSpawnImageOpacity->value() / 100.0);
@@ -36,6 +36,7 @@ Progress *Progress::instance()
 Progress::Progress()
     : mMainWindow(0)
     , mDialog(0)
+    , mLabel(0)
     , mDepth(0)
 {
     mInstance = this;
@@ -62,22 +63,29 @@ void Progress::setMainWindow(QWidget *mainWindow)
 //TIM BAKER 07032023
 bool Progress::isVisible()
 {
-    return mDialog->isVisible();
+    return mDialog && mDialog->isVisible();
 }
 
 void Progress::hide()
 {
-    mDialog->hide();
+    if (mDialog)
+        mDialog->hide();
 }
 
 void Progress::show()
 {
-    mDialog->show();
+    if (mDialog)
+        mDialog->show();
 }
 
 
+// Without a main window, as when running --benchmark, nothing is shown.
 void Progress::begin(const QString &text)
 {
+    if (!mDialog) {
+        mDepth++;
+        return;
+    }
     mLabel->setText(text);
     if (mDepth++ == 0)
         mDialog->show();
@@ -87,6 +95,8 @@ void Progress::begin(const QString &text)
 void Progress::update(const QString &text)
 {
     Q_ASSERT(mDepth > 0);
+    if (!mDialog)
+        return;
     mLabel->setText(text);
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 }
@@ -95,7 +105,7 @@ void Progress::end()
 {
     Q_ASSERT(mDepth > 0);
 //    mDialog->setValue(mDialog->maximum()); // hides dialog!
-    if (--mDepth == 0)
+    if (--mDepth == 0 && mDialog)
         mDialog->hide();
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 }
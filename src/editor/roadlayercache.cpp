@@ -0,0 +1,355 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "roadlayercache.h"
+
+#include "road.h"
+
+#include "tileset.h"
+
+#include <QDataStream>
+#include <QStringList>
+
+using namespace Tiled;
+
+// Enough for every cell visible in a few cell scenes plus a lot-generation
+// pass over its neighbours.
+static const int MAX_ENTRIES = 128;
+
+RoadLayerCache *RoadLayerCache::mInstance = 0;
+
+RoadLayerCache *RoadLayerCache::instance()
+{
+    if (!mInstance)
+        mInstance = new RoadLayerCache;
+    return mInstance;
+}
+
+void RoadLayerCache::deleteInstance()
+{
+    delete mInstance;
+    mInstance = 0;
+}
+
+RoadLayerCache::RoadLayerCache()
+{
+}
+
+RoadLayerCache::~RoadLayerCache()
+{
+    qDeleteAll(mEntries);
+}
+
+static Tile *parseTileDescription(const QString &tileName,
+                                  const QList<Tileset*> &tilesets)
+{
+    if (tileName.isEmpty())
+        return 0;
+    int n = tileName.lastIndexOf(QLatin1Char('_'));
+    if (n < 0)
+        return 0;
+    QString tilesetName = tileName.mid(0, n);
+    int tileID = tileName.mid(n + 1).toInt();
+    foreach (Tileset *ts, tilesets) {
+        if (ts->name() == tilesetName) { // FIXME: file-name not tileset-name!!!
+            if (tileID < ts->tileCount())
+                return ts->tileAt(tileID);
+            break;
+        }
+    }
+    return 0;
+}
+
+static QStringList tileNamesForRoad(Road *road)
+{
+    QStringList names;
+    names += road->tileName();
+    if (TrafficLines *lines = road->trafficLines()) {
+        names += lines->inner.ns;
+        names += lines->inner.we;
+        names += lines->inner.nw;
+        names += lines->inner.sw;
+        names += lines->outer.ns;
+        names += lines->outer.we;
+        names += lines->outer.ne;
+        names += lines->outer.se;
+    }
+    return names;
+}
+
+const RoadLayers &RoadLayerCache::roadLayers(const QPoint &roadPos, const QSize &size,
+                                             const QList<Road *> &roads,
+                                             const QList<Tileset *> &tilesets,
+                                             QVector<Tile *> &tiles)
+{
+    tiles.resize(1);
+    tiles[0] = 0;
+    if (roads.isEmpty())
+        return mEmpty;
+
+    // Each style's tile names are looked up once.  Names that resolve to the
+    // same tile share an index, so comparing indices gives the same answer
+    // as comparing the tiles themselves.
+    QHash<QString,int> tileIndex;
+    QByteArray signature;
+    QDataStream out(&signature, QIODevice::WriteOnly);
+    out << size << roadPos << roads.size();
+    foreach (Road *road, roads) {
+        out << road->start() << road->end() << road->width()
+            << bool(road->trafficLines());
+        foreach (const QString &tileName, tileNamesForRoad(road)) {
+            if (!tileIndex.contains(tileName)) {
+                Tile *tile = parseTileDescription(tileName, tilesets);
+                int index = tiles.indexOf(tile);
+                if (index == -1) {
+                    index = tiles.size();
+                    tiles += tile;
+                }
+                tileIndex[tileName] = index;
+            }
+            out << quint16(tileIndex[tileName]);
+        }
+    }
+
+    Key key(roads.first()->world(), qMakePair(roadPos.x(), roadPos.y()));
+    Entry *entry = mEntries.value(key);
+    if (entry) {
+        mRecent.removeOne(key);
+    } else {
+        if (mEntries.size() >= MAX_ENTRIES)
+            delete mEntries.take(mRecent.takeFirst());
+        entry = new Entry;
+        mEntries[key] = entry;
+    }
+    mRecent += key;
+
+    if (entry->mSignature != signature) {
+        entry->mBounds = QRect(roadPos, size);
+        entry->mSignature = signature;
+        rasterize(roadPos, size, roads, tileIndex, entry->mLayers);
+    }
+
+    return entry->mLayers;
+}
+
+void RoadLayerCache::invalidate(World *world, const QRect &roadBounds)
+{
+    foreach (const Key &key, mEntries.keys()) {
+        if (key.first != world)
+            continue;
+        if (mEntries[key]->mBounds.intersects(roadBounds)) {
+            delete mEntries.take(key);
+            mRecent.removeOne(key);
+        }
+    }
+}
+
+void RoadLayerCache::removeWorld(World *world)
+{
+    foreach (const Key &key, mEntries.keys()) {
+        if (key.first == world) {
+            delete mEntries.take(key);
+            mRecent.removeOne(key);
+        }
+    }
+}
+
+static QList<Road*> roadsWithEndpoint(const QPoint &roadPos,
+                                      const QList<Road*> &roads,
+                                      Road *exclude)
+{
+    QList<Road*> result;
+    foreach (Road *road, roads) {
+        if (road == exclude)
+            continue;
+        if (road->start() == roadPos || road->end() == roadPos)
+            result += road;
+    }
+    return result;
+}
+
+namespace {
+
+// A layer-sized grid of tile indices used while rasterizing.
+class RoadGrid
+{
+public:
+    RoadGrid(const QSize &size)
+        : mWidth(size.width())
+        , mHeight(size.height())
+        , mTiles(mWidth * mHeight, 0)
+    {
+    }
+
+    bool contains(int x, int y) const
+    { return x >= 0 && y >= 0 && x < mWidth && y < mHeight; }
+
+    quint16 at(int x, int y) const
+    { return mTiles[x + y * mWidth]; }
+
+    void set(int x, int y, quint16 tile)
+    { mTiles[x + y * mWidth] = tile; }
+
+    void toSparse(QVector<RoadLayers::RoadTile> &result) const
+    {
+        result.clear();
+        for (int y = 0; y < mHeight; y++) {
+            for (int x = 0; x < mWidth; x++) {
+                if (quint16 tile = at(x, y)) {
+                    RoadLayers::RoadTile rt = { quint16(x), quint16(y), tile };
+                    result += rt;
+                }
+            }
+        }
+        result.squeeze();
+    }
+
+private:
+    int mWidth;
+    int mHeight;
+    QVector<quint16> mTiles;
+};
+
+} // namespace
+
+void RoadLayerCache::rasterize(const QPoint &roadPos, const QSize &size,
+                               const QList<Road *> &roads,
+                               const QHash<QString, int> &tileIndex,
+                               RoadLayers &layers)
+{
+    RoadGrid layer0(size), layer1(size);
+
+    // Fill roads with road tile
+
+    foreach (Road *road, roads) {
+        quint16 tile;
+        if (!(tile = tileIndex[road->tileName()]))
+            continue;
+        QRect roadBounds = road->bounds();
+        roadBounds.translate(-roadPos); // layer coordinates
+        for (int x = roadBounds.left(); x <= roadBounds.right(); x++) {
+            for (int y = roadBounds.top(); y <= roadBounds.bottom(); y++) {
+                if (layer0.contains(x, y))
+                    layer0.set(x, y, tile);
+            }
+        }
+    }
+
+    // Traffic lines
+
+    foreach (Road *road, roads) {
+        if (!road->trafficLines())
+            continue;
+        quint16 tileInnerNS = tileIndex[road->trafficLines()->inner.ns];
+        quint16 tileInnerWE = tileIndex[road->trafficLines()->inner.we];
+        quint16 tileInnerNW = tileIndex[road->trafficLines()->inner.nw];
+        quint16 tileInnerSW = tileIndex[road->trafficLines()->inner.sw];
+
+        quint16 tileOuterNS = tileIndex[road->trafficLines()->outer.ns];
+        quint16 tileOuterWE = tileIndex[road->trafficLines()->outer.we];
+        quint16 tileOuterNE = tileIndex[road->trafficLines()->outer.ne];
+        quint16 tileOuterSE = tileIndex[road->trafficLines()->outer.se];
+        QRect roadBounds = road->bounds();
+        roadBounds.translate(-roadPos); // layer coordinates
+        QList<Road*> roadsAtStart = roadsWithEndpoint(road->start(), roads,
+                                                      road);
+        QList<Road*> roadsAtEnd = roadsWithEndpoint(road->end(), roads,
+                                                    road);
+        if (road->isVertical()) {
+            int x = road->x1() - roadPos.x();
+            int y1 = roadBounds.top(), y2 = roadBounds.bottom();
+            if (roadsAtStart.count()) {
+                if (road->orient() == Road::NorthSouth)
+                    y1 += road->width() / 2;
+                else
+                    y2 -= road->width() -  road->width() / 2;
+            }
+            if (roadsAtEnd.count()) {
+                if (road->orient() == Road::NorthSouth)
+                    y2 -= road->width() -  road->width() / 2;
+                else
+                    y1 += road->width() / 2;
+            }
+            for (int y = y1; y <= y2; y++) {
+                if (tileInnerNS && layer1.contains(x, y)) {
+                    quint16 curTile = layer1.at(x, y);
+                    if (curTile == tileInnerWE)
+                        layer1.set(x, y, tileInnerNW);
+                    else if (curTile == tileOuterWE)
+                        layer1.set(x, y, tileInnerSW);
+                    else if (curTile == tileInnerNW || curTile == tileInnerSW)
+                        ;
+                    else
+                        layer1.set(x, y, tileInnerNS);
+                }
+                if (tileOuterNS && layer1.contains(x-1, y) && road->width() > 1) {
+                    quint16 curTile = layer1.at(x-1, y);
+                    if (curTile == tileInnerWE)
+                        layer1.set(x-1, y, tileOuterNE);
+                    else if (curTile == tileOuterWE)
+                        layer1.set(x-1, y, tileOuterSE);
+                    else if (curTile == tileOuterNE || curTile == tileOuterSE)
+                        ;
+                    else
+                        layer1.set(x-1, y, tileOuterNS);
+                }
+            }
+        } else {
+            int y = road->y1() - roadPos.y();
+            int x1 = roadBounds.left(), x2 = roadBounds.right();
+            if (roadsAtStart.count()) {
+                if (road->orient() == Road::WestEast)
+                    x1 += road->width() / 2;
+                else
+                    x2 -= road->width() -  road->width() / 2;
+            }
+            if (roadsAtEnd.count()) {
+                if (road->orient() == Road::WestEast)
+                    x2 -= road->width() -  road->width() / 2;
+                else
+                    x1 += road->width() / 2;
+            }
+            for (int x = x1; x <= x2; x++) {
+                if (tileInnerWE && layer1.contains(x, y)) {
+                    quint16 curTile = layer1.at(x, y);
+                    if (curTile == tileOuterNS)
+                        layer1.set(x, y, tileOuterNE);
+                    else if (curTile == tileInnerNS)
+                        layer1.set(x, y, tileInnerNW);
+                    else if (curTile == tileOuterNE || curTile == tileInnerNW)
+                        ;
+                    else
+                        layer1.set(x, y, tileInnerWE);
+                }
+                if (tileOuterWE && layer1.contains(x, y-1) && road->width() > 1) {
+                    quint16 curTile = layer1.at(x, y-1);
+                    if (curTile == tileOuterNS)
+                        layer1.set(x, y-1, tileOuterSE);
+                    else if (curTile == tileInnerNS)
+                        layer1.set(x, y-1, tileInnerSW);
+                    else if (curTile == tileOuterSE || curTile == tileInnerSW)
+                        ;
+                    else
+                        layer1.set(x, y-1, tileOuterWE);
+                }
+            }
+        }
+    }
+
+    layer0.toSparse(layers.mLayer0);
+    layer1.toSparse(layers.mLayer1);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROADLAYERCACHE_H
+#define ROADLAYERCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QRect>
+#include <QVector>
+
+class Road;
+class World;
+
+namespace Tiled {
+class Tile;
+class Tileset;
+}
+
+/**
+  * The road tiles for one cell, as generated by MapComposite::generateRoadLayers.
+  * Only the squares that have a road tile are stored.  Tiles are indices
+  * into the list returned with them by RoadLayerCache::roadLayers().
+  */
+class RoadLayers
+{
+public:
+    struct RoadTile
+    {
+        quint16 x;
+        quint16 y;
+        quint16 tile;
+    };
+
+    QVector<RoadTile> mLayer0; // Road surface, goes in 0_Floor
+    QVector<RoadTile> mLayer1; // Traffic lines, go in 0_FloorOverlay
+};
+
+/**
+  * Remembers the road tiles generated for each cell, so the cell scene and
+  * the lot generator only rasterize roads again when something about the
+  * roads crossing that cell has changed.  The roads' coordinates, widths and
+  * tile names are compared each time, so a stale entry is never used; the
+  * WorldDocument also invalidates cells when its roads change so entries
+  * don't pile up.
+  */
+class RoadLayerCache
+{
+public:
+    static RoadLayerCache *instance();
+    static void deleteInstance();
+
+    /**
+      * Returns the road tiles for the cell of size \a size at \a roadPos
+      * in world tile coordinates.  \a roads must be the roads that
+      * intersect the cell.  Each tile name is resolved once against
+      * \a tilesets; \a tiles is set to the resolved tiles, index 0 is null.
+      * The result is valid until the next call.
+      */
+    const RoadLayers &roadLayers(const QPoint &roadPos, const QSize &size,
+                                 const QList<Road*> &roads,
+                                 const QList<Tiled::Tileset*> &tilesets,
+                                 QVector<Tiled::Tile*> &tiles);
+
+    void invalidate(World *world, const QRect &roadBounds);
+    void removeWorld(World *world);
+
+private:
+    RoadLayerCache();
+    ~RoadLayerCache();
+
+    typedef QPair<World*,QPair<int,int> > Key;
+
+    struct Entry
+    {
+        QRect mBounds;
+        QByteArray mSignature;
+        RoadLayers mLayers;
+    };
+
+    void rasterize(const QPoint &roadPos, const QSize &size,
+                   const QList<Road*> &roads, const QHash<QString,int> &tileIndex,
+                   RoadLayers &layers);
+
+    QHash<Key,Entry*> mEntries;
+    QList<Key> mRecent;
+    RoadLayers mEmpty;
+
+    static RoadLayerCache *mInstance;
+};
+
+#endif // ROADLAYERCACHE_H
@@ -186,7 +186,7 @@ void LightSwitchOverlays::update()
                         cells.clear();
                         lg->orderedCellsAt2(QPoint(x, y), cells);
                         foreach (const Cell *cell, cells) {
-                            Tile *tile = cell->tile;
+                            Tile *tile = cell->tile();
                             if (!tile) continue;
                             hasSwitch = lightSwitchTiles.contains(tile);
                             if (hasSwitch) break;
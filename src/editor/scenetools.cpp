@@ -843,6 +843,7 @@ void SubMapTool::startMoving()
 
     mMode = Moving;
 
+    mScene->invalidateTileCaches();
     foreach (SubMapItem *item, mMovingItems) {
         item->subMap()->setHiddenDuringDrag(true);
         QString path = item->subMap()->mapInfo()->path();
@@ -880,6 +881,7 @@ void SubMapTool::finishMoving(const QPointF &pos)
 
     foreach (SubMapItem *item, mMovingItems)
         item->subMap()->setHiddenDuringDrag(false);
+    mScene->invalidateTileCaches();
 
     int level = mScene->document()->currentLevel();
     QPoint startTilePos = mScene->renderer()->pixelToTileCoordsInt(mStartScenePos, level);
@@ -909,6 +911,7 @@ void SubMapTool::cancelMoving()
         item->subMap()->setHiddenDuringDrag(false);
         item->update();
     }
+    mScene->invalidateTileCaches();
 
     foreach (DnDItem *item, mDnDItems)
         mScene->removeItem(item);
@@ -2876,7 +2879,7 @@ void WorldCellTool::keyPressEvent(QKeyEvent *event)
         mDnDItems.clear();
 
         foreach (WorldCell *cell, mMovingCells)
-            mScene->itemForCell(cell)->setVisible(true);
+            mScene->setCellVisible(cell, true);
         mMovingCells.clear();
         event->accept();
     }
@@ -2891,7 +2894,7 @@ void WorldCellTool::mousePressEvent(QGraphicsSceneMouseEvent *event)
         mMousePressed = true;
         mStartScenePos = event->scenePos();
         mDropTilePos = mScene->pixelToCellCoordsInt(mStartScenePos);
-        mClickedItem = topmostItemAt(mStartScenePos);
+        mClickedCell = mScene->pointToCell(mStartScenePos);
         break;
     case Qt::RightButton:
         if (mMode == NoMode) {
@@ -2903,7 +2906,7 @@ void WorldCellTool::mousePressEvent(QGraphicsSceneMouseEvent *event)
             qDeleteAll(mDnDItems);
             mDnDItems.clear();
             foreach (WorldCell *cell, mMovingCells)
-                mScene->itemForCell(cell)->setVisible(true);
+                mScene->setCellVisible(cell, true);
             mMovingCells.clear();
         }
         break;
@@ -2917,8 +2920,8 @@ void WorldCellTool::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
     if (mMode == NoMode && mMousePressed) {
         const int dragDistance = (mStartScenePos - event->scenePos()).manhattanLength();
         if (dragDistance >= QApplication::startDragDistance()) {
-            if (mClickedItem &&
-                    mScene->worldDocument()->selectedCells().contains(mClickedItem->cell()) &&
+            if (mClickedCell &&
+                    mScene->worldDocument()->selectedCells().contains(mClickedCell) &&
                     !(event->modifiers() & (Qt::ControlModifier | Qt::ShiftModifier)))
                 startMoving();
             else
@@ -2958,11 +2961,11 @@ void WorldCellTool::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         QList<WorldCell*> newSelection;
         if (extend || toggle)
             newSelection = mScene->worldDocument()->selectedCells();
-        if (mClickedItem) {
-            if (toggle && newSelection.contains(mClickedItem->cell()))
-                newSelection.removeOne(mClickedItem->cell());
-            else if (!newSelection.contains(mClickedItem->cell()))
-                newSelection += mClickedItem->cell();
+        if (mClickedCell) {
+            if (toggle && newSelection.contains(mClickedCell))
+                newSelection.removeOne(mClickedCell);
+            else if (!newSelection.contains(mClickedCell))
+                newSelection += mClickedCell;
         }
         mScene->worldDocument()->setSelectedCells(newSelection);
         break;
@@ -2981,12 +2984,12 @@ void WorldCellTool::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
     }
 
     mMousePressed = false;
-    mClickedItem = 0;
+    mClickedCell = 0;
 }
 
 void WorldCellTool::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
 {
-    mClickedItem = topmostItemAt(event->scenePos());
+    mClickedCell = mScene->pointToCell(event->scenePos());
 }
 
 void WorldCellTool::startSelecting()
@@ -3025,16 +3028,16 @@ void WorldCellTool::startMoving()
     mMovingCells = mScene->worldDocument()->selectedCells();
 
     // Move only the clicked item, if it was not part of the selection
-    if (!mMovingCells.contains(mClickedItem->cell())) {
+    if (!mMovingCells.contains(mClickedCell)) {
         mMovingCells.clear();
-        mMovingCells += mClickedItem->cell();
+        mMovingCells += mClickedCell;
         mScene->worldDocument()->setSelectedCells(mMovingCells);
     }
 
     mMode = Moving;
 
     foreach (WorldCell *cell, mMovingCells) {
-        mScene->itemForCell(cell)->setVisible(false);
+        mScene->setCellVisible(cell, false);
         DragCellItem *dndItem = new DragCellItem(cell, mScene);
         mDnDItems.append(dndItem);
         dndItem->setZValue(1000);
@@ -3122,7 +3125,7 @@ void WorldCellTool::finishMoving(const QPointF &pos)
     mDnDItems.clear();
 
     foreach (WorldCell *cell, mMovingCells)
-        mScene->itemForCell(cell)->setVisible(true);
+        mScene->setCellVisible(cell, true);
     mMovingCells.clear();
 }
 
@@ -3142,26 +3145,26 @@ void WorldCellTool::pushCellToMove(WorldCell *cell, const QPoint &offset)
 
 void WorldCellTool::showContextMenu(const QPointF &scenePos, const QPoint &screenPos)
 {
-    WorldCellItem *item = topmostItemAt(scenePos);
-    if (!item)
+    WorldCell *cell = mScene->pointToCell(scenePos);
+    if (!cell)
         return;
 
     QMenu menu;
     QIcon tiledIcon(QLatin1String(":images/tiled-icon-16.png"));
     QAction *openAction = menu.addAction(tiledIcon, tr("Open in TileZed"));
     QAction *thumbnailAction = menu.addAction(tr("Recreate Thumbnail"));
-    if (item->cell()->mapFilePath().isEmpty()) {
+    if (cell->mapFilePath().isEmpty()) {
         openAction->setEnabled(false);
         thumbnailAction->setEnabled(false);
     }
 
     QAction *action = menu.exec(screenPos);
     if (action == openAction) {
-        QUrl url = QUrl::fromLocalFile(item->cell()->mapFilePath());
+        QUrl url = QUrl::fromLocalFile(cell->mapFilePath());
         QDesktopServices::openUrl(url);
     }
     if (action == thumbnailAction) {
-        //MapImageManager::instance()->recreateMapImage(item->mapFilePath());
+        //MapImageManager::instance()->recreateMapImage(cell->mapFilePath());
 
         mMovingCells = mScene->worldDocument()->selectedCells();
 
@@ -3173,12 +3176,6 @@ void WorldCellTool::showContextMenu(const QPointF &scenePos, const QPoint &scree
     }
 }
 
-WorldCellItem *WorldCellTool::topmostItemAt(const QPointF &scenePos)
-{
-    WorldCell *cell = mScene->pointToCell(scenePos);
-    return cell ? mScene->itemForCell(cell) : 0;
-}
-
 /////
 
 PasteCellsTool *PasteCellsTool::mInstance = 0;
@@ -831,7 +831,6 @@ protected:
 /////
 
 class DragCellItem;
-class WorldCellItem;
 class WorldCell;
 
 class QGraphicsView;
@@ -879,13 +878,11 @@ private:
         CancelMoving
     };
 
-    WorldCellItem *topmostItemAt(const QPointF &scenePos);
-
     Mode mMode;
     bool mMousePressed;
     QPointF mStartScenePos;
     QPoint mDropTilePos;
-    WorldCellItem *mClickedItem;
+    WorldCell *mClickedCell;
     QList<WorldCell*> mMovingCells;
     QList<WorldCell*> mOrderedMovingCells;
     QList<DragCellItem*> mDnDItems;
@@ -25,6 +25,7 @@
 #include "worldcell.h"
 #include "worlddocument.h"
 #include "worldscene.h"
+#include "worldsearchindex.h"
 #include "worldview.h"
 
 #include <QListWidget>
@@ -43,7 +44,7 @@ SearchDock::SearchDock(QWidget* parent)
 
     connect(ui->combo1, QOverload<int>::of(&QComboBox::activated), this, &SearchDock::comboActivated1);
     connect(ui->combo2, QOverload<int>::of(&QComboBox::activated), this, &SearchDock::comboActivated2);
-    connect(ui->lineEdit, &QLineEdit::textChanged, this, &SearchDock::searchLotFileName);
+    connect(ui->lineEdit, &QLineEdit::textChanged, this, &SearchDock::searchText);
 
     connect(ui->listWidget, &QListWidget::itemSelectionChanged, this, &SearchDock::listSelectionChanged);
     connect(ui->listWidget, &QListWidget::activated, this, &SearchDock::listActivated);
@@ -81,19 +82,10 @@ void SearchDock::setDocument(Document *doc)
     ui->combo1->setCurrentIndex(static_cast<int>(results->searchBy));
     setCombo2(results->searchBy);
     setList(results);
+    showSearchString(results);
 
-    if (results->searchBy == SearchResults::SearchBy::ObjectType) {
-        int index = ui->combo2->findText(results->searchStringObjectType);
-        if (index == -1)
-            index = 0; // Select <None>
-        ui->combo2->setCurrentIndex(index);
-        ui->combo2->setVisible(true);
-        ui->lineEdit->setVisible(false);
-    } else if (results->searchBy == SearchResults::SearchBy::LotFileName) {
-        ui->lineEdit->setText(results->searchStringLotFileName);
-        ui->combo2->setVisible(false);
-        ui->lineEdit->setVisible(true);
-    }
+    if (SearchResults::searchesMapContents(results->searchBy))
+        results->index->indexMapContents();
 }
 
 void SearchDock::clearDocument()
@@ -124,29 +116,33 @@ void SearchDock::comboActivated1(int index)
         return;
 
     SearchResults *results = searchResultsFor(worldDoc);
+    results->searchBy = static_cast<SearchResults::SearchBy>(index);
 
-    if (index == static_cast<int>(SearchResults::SearchBy::ObjectType)) {
-        setCombo2(SearchResults::SearchBy::ObjectType);
-        int index = ui->combo2->findText(results->searchStringObjectType);
-        if (index == -1)
-            index = 0; // Select <None>
-        ui->combo2->setCurrentIndex(index);
-        ui->combo2->setVisible(true);
-        ui->lineEdit->setVisible(false);
+    setCombo2(results->searchBy);
+    showSearchString(results);
+
+    switch (results->searchBy) {
+    case SearchResults::SearchBy::ObjectType:
         searchObjectType();
-    }
-    if (index == static_cast<int>(SearchResults::SearchBy::LotFileName)) {
-        ui->lineEdit->setText(results->searchStringLotFileName);
-        ui->combo2->setVisible(false);
-        ui->lineEdit->setVisible(true);
-        searchLotFileName();
+        break;
+    case SearchResults::SearchBy::ObjectGroup:
+        searchObjectGroup();
+        break;
+    default:
+        if (SearchResults::searchesMapContents(results->searchBy))
+            results->index->indexMapContents();
+        searchText();
+        break;
     }
 }
 
 void SearchDock::comboActivated2(int index)
 {
     Q_UNUSED(index);
-    searchObjectType();
+    if (ui->combo1->currentIndex() == static_cast<int>(SearchResults::SearchBy::ObjectGroup))
+        searchObjectGroup();
+    else
+        searchObjectType();
 }
 
 void SearchDock::searchObjectType()
@@ -154,63 +150,101 @@ void SearchDock::searchObjectType()
     WorldDocument *worldDoc = worldDocument();
     if (worldDoc == nullptr)
         return;
-    World* world = worldDoc->world();
 
     ObjectType* objType = ui->combo2->currentData().value<ObjectType*>();
+    if (objType == nullptr)
+        return;
 
     SearchResults* results = searchResultsFor(worldDoc);
     results->reset();
     results->searchBy = SearchResults::SearchBy::ObjectType;
-    results->searchStringObjectType = objType->name();
-
-    for (int y = 0; y < world->height(); y++) {
-        for (int x = 0; x < world->width(); x++) {
-            WorldCell* cell = world->cellAt(x, y);
-            if (cell == nullptr)
-                continue;
-            for (WorldCellObject* obj : cell->objects()) {
-                if (obj->type() == objType) {
-                    // FIXME: If the world is resized, these cells may be destroyed.
-                    results->cells += cell;
-                    break;
-                }
-            }
-        }
-    }
+    results->searchString[results->searchBy] = objType->name();
+    // FIXME: If the world is resized, these cells may be destroyed.
+    results->cells = results->index->cellsWithObjectType(objType);
 
     setList(results);
 }
 
+void SearchDock::searchObjectGroup()
+{
+    WorldDocument *worldDoc = worldDocument();
+    if (worldDoc == nullptr)
+        return;
+
+    WorldObjectGroup* og = ui->combo2->currentData().value<WorldObjectGroup*>();
+    if (og == nullptr)
+        return;
+
+    SearchResults* results = searchResultsFor(worldDoc);
+    results->reset();
+    results->searchBy = SearchResults::SearchBy::ObjectGroup;
+    results->searchString[results->searchBy] = og->name();
+    results->cells = results->index->cellsWithObjectGroup(og);
+
+    setList(results);
+}
+
+void SearchDock::searchText()
+{
+    if (ui->combo1->currentIndex() == static_cast<int>(SearchResults::SearchBy::LotFileName))
+        searchLotFileName();
+    else if (SearchResults::searchesMapContents(static_cast<SearchResults::SearchBy>(ui->combo1->currentIndex())))
+        searchMapContents();
+}
+
 void SearchDock::searchLotFileName()
 {
     WorldDocument *worldDoc = worldDocument();
     if (worldDoc == nullptr)
         return;
-    World* world = worldDoc->world();
 
     SearchResults* results = searchResultsFor(worldDoc);
     results->reset();
     results->searchBy = SearchResults::SearchBy::LotFileName;
-    results->searchStringLotFileName = ui->lineEdit->text();
-
-    for (int y = 0; y < world->height(); y++) {
-        for (int x = 0; x < world->width(); x++) {
-            WorldCell* cell = world->cellAt(x, y);
-            if (cell == nullptr)
-                continue;
-            for (WorldCellLot* lot : cell->lots()) {
-                if (lot->mapName().contains(results->searchStringLotFileName, Qt::CaseInsensitive)) {
-                    // FIXME: If the world is resized, these cells may be destroyed.
-                    results->cells += cell;
-                    break;
-                }
-            }
-        }
+    results->searchString[results->searchBy] = ui->lineEdit->text();
+    results->cells = results->index->cellsWithLotFileName(ui->lineEdit->text());
+
+    setList(results);
+}
+
+void SearchDock::searchMapContents()
+{
+    WorldDocument *worldDoc = worldDocument();
+    if (worldDoc == nullptr)
+        return;
+
+    SearchResults* results = searchResultsFor(worldDoc);
+    results->reset();
+    results->searchBy = static_cast<SearchResults::SearchBy>(ui->combo1->currentIndex());
+    QString text = ui->lineEdit->text();
+    results->searchString[results->searchBy] = text;
+
+    switch (results->searchBy) {
+    case SearchResults::SearchBy::Tileset:
+        results->cells = results->index->cellsWithTileset(text);
+        break;
+    case SearchResults::SearchBy::RoomName:
+        results->cells = results->index->cellsWithRoomName(text);
+        break;
+    case SearchResults::SearchBy::MapProperty:
+        results->cells = results->index->cellsWithMapProperty(text);
+        break;
+    default:
+        break;
     }
 
     setList(results);
 }
 
+void SearchDock::mapContentsIndexed(WorldDocument *worldDoc)
+{
+    if (worldDoc != worldDocument())
+        return;
+    SearchResults* results = searchResultsFor(worldDoc, false);
+    if (results && SearchResults::searchesMapContents(results->searchBy))
+        searchMapContents();
+}
+
 void SearchDock::setList(SearchResults *results)
 {
     mSynching = true;
@@ -285,6 +319,7 @@ void SearchDock::documentAboutToClose(int index, Document *doc)
     if (mResults.contains(worldDoc)) {
         SearchResults* results = mResults[worldDoc];
         mResults.remove(worldDoc);
+        delete results->index;
         delete results;
     }
 }
@@ -306,6 +341,33 @@ void SearchDock::setCombo2(SearchResults::SearchBy searchBy)
                 ui->combo2->addItem(objType->name(), QVariant::fromValue(objType));
         }
     }
+
+    if (searchBy == SearchResults::SearchBy::ObjectGroup) {
+        for (WorldObjectGroup* og : world->objectGroups()) {
+            if (og->isNull())
+                ui->combo2->addItem(QLatin1String("<None>"), QVariant::fromValue(og));
+            else
+                ui->combo2->addItem(og->name(), QVariant::fromValue(og));
+        }
+    }
+}
+
+void SearchDock::showSearchString(SearchResults *results)
+{
+    const QString &searchString = results->searchString[results->searchBy];
+    if (results->searchBy == SearchResults::SearchBy::ObjectType ||
+            results->searchBy == SearchResults::SearchBy::ObjectGroup) {
+        int index = ui->combo2->findText(searchString);
+        if (index == -1)
+            index = 0; // Select <None>
+        ui->combo2->setCurrentIndex(index);
+        ui->combo2->setVisible(true);
+        ui->lineEdit->setVisible(false);
+    } else {
+        ui->lineEdit->setText(searchString);
+        ui->combo2->setVisible(false);
+        ui->lineEdit->setVisible(true);
+    }
 }
 
 SearchResults *SearchDock::searchResultsFor(WorldDocument *worldDoc, bool create)
@@ -316,5 +378,9 @@ SearchResults *SearchDock::searchResultsFor(WorldDocument *worldDoc, bool create
         return mResults[worldDoc];
     if (!create)
         return nullptr;
-    return mResults[worldDoc] = new SearchResults();
+    SearchResults* results = new SearchResults();
+    results->index = new WorldSearchIndex(worldDoc);
+    connect(results->index, &WorldSearchIndex::mapContentsIndexed,
+            this, [this, worldDoc]() { mapContentsIndexed(worldDoc); });
+    return mResults[worldDoc] = results;
 }
@@ -3,11 +3,13 @@
 
 #include <QDockWidget>
 #include <QListWidget>
+#include <QMap>
 
 class Document;
 class CellDocument;
 class WorldCell;
 class WorldDocument;
+class WorldSearchIndex;
 
 namespace Ui {
 class SearchDock;
@@ -20,11 +22,16 @@ public:
     {
         ObjectType,
         LotFileName,
+        ObjectGroup,
+        Tileset,
+        RoomName,
+        MapProperty
     };
 
     SearchResults()
         : searchBy(SearchBy::ObjectType)
         , selectedCell(nullptr)
+        , index(nullptr)
     {
 
     }
@@ -34,11 +41,18 @@ public:
         selectedCell = nullptr;
     }
 
+    static bool searchesMapContents(SearchBy searchBy)
+    {
+        return searchBy == SearchBy::Tileset ||
+                searchBy == SearchBy::RoomName ||
+                searchBy == SearchBy::MapProperty;
+    }
+
     SearchBy searchBy;
-    QString searchStringObjectType;
-    QString searchStringLotFileName;
+    QMap<SearchBy,QString> searchString;
     QList<WorldCell*> cells;
     WorldCell* selectedCell;
+    WorldSearchIndex* index;
 };
 
 class SearchDock : public QDockWidget
@@ -58,7 +72,11 @@ private slots:
     void comboActivated1(int index);
     void comboActivated2(int index);
     void searchObjectType();
+    void searchObjectGroup();
+    void searchText();
     void searchLotFileName();
+    void searchMapContents();
+    void mapContentsIndexed(WorldDocument *worldDoc);
     void setList(SearchResults* results);
     void listSelectionChanged();
     void listActivated(const QModelIndex& index);
@@ -66,6 +84,7 @@ private slots:
 
 private:
     void setCombo2(SearchResults::SearchBy searchBy);
+    void showSearchString(SearchResults *results);
     SearchResults *searchResultsFor(WorldDocument *worldDoc, bool create = true);
 
 private:
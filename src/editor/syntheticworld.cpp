@@ -0,0 +1,496 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "syntheticworld.h"
+
+#include "world.h"
+#include "worldcell.h"
+#include "worldwriter.h"
+
+#include "InGameMap/ingamemapcell.h"
+
+#include "map.h"
+#include "mapobject.h"
+#include "mapwriter.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QRegion>
+
+using namespace Tiled;
+
+namespace {
+
+enum {
+    TilesetFloors,
+    TilesetWalls,
+    TilesetNature,
+    TilesetFurniture,
+    TilesetCount
+};
+
+const char *TILESET_NAMES[TilesetCount] = {
+    "synthetic_floors_01",
+    "synthetic_walls_01",
+    "synthetic_nature_01",
+    "synthetic_furniture_01"
+};
+
+const int TILE_WIDTH = 64;
+const int TILE_HEIGHT = 128;
+const int TILESET_COLUMNS = 8;
+const int TILESET_ROWS = 16;
+
+const int CELL_SIZE = 300;
+const int LOT_SIZE = 30;
+const int MAX_LEVEL = 3;
+
+// Nature tiles 0-15 are grass and dirt, 16-31 are trees.
+const int FIRST_TREE_TILE = 16;
+
+// Walls tiles alternate west and north.
+const int WALL_W = 0;
+const int WALL_N = 1;
+
+const QRgb BMP_GRASS = qRgb(0, 255, 0);
+const QRgb BMP_DIRT = qRgb(120, 70, 20);
+const QRgb BMP_ROAD = qRgb(100, 100, 100);
+const QRgb BMP_TREES = qRgb(255, 0, 0);
+
+const char *ROOM_NAMES[] = {
+    "kitchen", "livingroom", "bedroom", "bathroom", "hall", "storage"
+};
+
+void saveString(QDataStream &out, const QString &str)
+{
+    for (int i = 0; i < str.length(); i++)
+        out << quint8(str[i].toLatin1());
+    out << quint8('\n');
+}
+
+} // namespace
+
+SyntheticWorld::SyntheticWorld(quint32 seed) :
+    mRandom(seed),
+    mWorldWidth(4),
+    mWorldHeight(4),
+    mLotsPerCell(4)
+{
+}
+
+SyntheticWorld::~SyntheticWorld()
+{
+    qDeleteAll(mTilesets);
+}
+
+bool SyntheticWorld::generate(const QString &directory)
+{
+    QDir dir(directory);
+    if (!dir.exists() && !dir.mkpath(QLatin1String("."))) {
+        mError = tr("Couldn't create the directory.\n%1").arg(directory);
+        return false;
+    }
+    if (!dir.mkpath(QLatin1String("Tiles")) ||
+            !dir.mkpath(QLatin1String("maps/cells")) ||
+            !dir.mkpath(QLatin1String("maps/lots"))) {
+        mError = tr("Couldn't create the subdirectories in\n%1").arg(directory);
+        return false;
+    }
+
+    mCellMapFiles.clear();
+    mLotMapFiles.clear();
+
+    return writeTilesets(dir) &&
+            writeTileDefFile(dir) &&
+            writeLots(dir) &&
+            writeCells(dir) &&
+            writeWorld(dir);
+}
+
+bool SyntheticWorld::writeTilesets(const QDir &dir)
+{
+    qDeleteAll(mTilesets);
+    mTilesets.clear();
+
+    QSize imageSize(TILE_WIDTH * TILESET_COLUMNS, TILE_HEIGHT * TILESET_ROWS);
+
+    for (int i = 0; i < TilesetCount; i++) {
+        QString name = QLatin1String(TILESET_NAMES[i]);
+        QString fileName = dir.filePath(QLatin1String("Tiles/") + name + QLatin1String(".png"));
+
+        // Each tile is a flat diamond of one color, enough for the
+        // renderers to have something to draw.
+        QImage image(imageSize, QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setPen(Qt::NoPen);
+        for (int t = 0; t < TILESET_COLUMNS * TILESET_ROWS; t++) {
+            int x = (t % TILESET_COLUMNS) * TILE_WIDTH;
+            int y = (t / TILESET_COLUMNS) * TILE_HEIGHT + TILE_HEIGHT - TILE_WIDTH / 2;
+            QPolygon diamond;
+            diamond << QPoint(x + TILE_WIDTH / 2, y)
+                    << QPoint(x + TILE_WIDTH, y + TILE_WIDTH / 4)
+                    << QPoint(x + TILE_WIDTH / 2, y + TILE_WIDTH / 2)
+                    << QPoint(x, y + TILE_WIDTH / 4);
+            painter.setBrush(QColor::fromHsv((i * 90 + t * 7) % 360, 160, 200));
+            painter.drawPolygon(diamond);
+        }
+        painter.end();
+        if (!image.save(fileName)) {
+            mError = tr("Couldn't write the tileset image.\n%1").arg(fileName);
+            return false;
+        }
+
+        Tileset *tileset = new Tileset(name, TILE_WIDTH, TILE_HEIGHT);
+        tileset->loadFromNothing(imageSize, fileName);
+        mTilesets += tileset;
+    }
+
+    return true;
+}
+
+bool SyntheticWorld::writeTileDefFile(const QDir &dir)
+{
+    // TileDefFile::write() does nothing in WorldEd, so the .tiles file is
+    // written here in the same format.
+    QString fileName = dir.filePath(QLatin1String("Tiles/synthetic.tiles"));
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        mError = tr("Error opening file for writing.\n%1").arg(fileName);
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << quint8('t') << quint8('d') << quint8('e') << quint8('f');
+    out << qint32(1);
+
+    out << qint32(TilesetCount);
+    for (int i = 0; i < TilesetCount; i++) {
+        saveString(out, QLatin1String(TILESET_NAMES[i]));
+        saveString(out, QLatin1String(TILESET_NAMES[i]) + QLatin1String(".png"));
+        out << qint32(TILESET_COLUMNS);
+        out << qint32(TILESET_ROWS);
+        out << qint32(100 + i);
+        out << qint32(TILESET_COLUMNS * TILESET_ROWS);
+        for (int t = 0; t < TILESET_COLUMNS * TILESET_ROWS; t++) {
+            QMap<QString,QString> properties;
+            switch (i) {
+            case TilesetFloors:
+                properties[QLatin1String("solidfloor")] = QString();
+                break;
+            case TilesetWalls:
+                properties[(t % 2) ? QLatin1String("WallN") : QLatin1String("WallW")] = QString();
+                break;
+            case TilesetNature:
+                if (t >= FIRST_TREE_TILE)
+                    properties[QLatin1String("tree")] = QString::number(1 + t % 4);
+                else
+                    properties[QLatin1String("solidfloor")] = QString();
+                break;
+            case TilesetFurniture:
+                properties[QLatin1String("container")] = QLatin1String("crate");
+                properties[QLatin1String("IsMoveAble")] = QString();
+                break;
+            }
+            out << qint32(properties.size());
+            foreach (const QString &key, properties.keys()) {
+                saveString(out, key);
+                saveString(out, properties[key]);
+            }
+        }
+    }
+
+    return file.error() == QFile::NoError;
+}
+
+bool SyntheticWorld::writeLots(const QDir &dir)
+{
+    int lotCount = qMax(1, mLotsPerCell * 2);
+    for (int i = 0; i < lotCount; i++) {
+        QString fileName = dir.filePath(QString(QLatin1String("maps/lots/lot_%1.tmx")).arg(i + 1));
+        Map *map = createMap(LOT_SIZE, LOT_SIZE, 1);
+        MapWriter writer;
+        bool ok = writer.writeMap(map, fileName);
+        delete map;
+        if (!ok) {
+            mError = writer.errorString();
+            return false;
+        }
+        mLotMapFiles += fileName;
+    }
+    return true;
+}
+
+bool SyntheticWorld::writeCells(const QDir &dir)
+{
+    for (int y = 0; y < mWorldHeight; y++) {
+        for (int x = 0; x < mWorldWidth; x++) {
+            QString fileName = dir.filePath(QString(QLatin1String("maps/cells/cell_%1_%2.tmx")).arg(x).arg(y));
+            Map *map = createMap(CELL_SIZE, CELL_SIZE, random(20, 40));
+            addBmpRules(map);
+            MapWriter writer;
+            bool ok = writer.writeMap(map, fileName);
+            delete map;
+            if (!ok) {
+                mError = writer.errorString();
+                return false;
+            }
+            mCellMapFiles += fileName;
+        }
+    }
+    return true;
+}
+
+bool SyntheticWorld::writeWorld(const QDir &dir)
+{
+    World world(mWorldWidth, mWorldHeight);
+
+    const char *typeNames[] = { "ParkingStall", "TownZone", "Forest", "ZombiesType" };
+    QList<ObjectType*> types;
+    for (const char *name : typeNames) {
+        ObjectType *type = new ObjectType(QLatin1String(name));
+        world.insertObjectType(world.objectTypes().size(), type);
+        types += type;
+    }
+
+    WorldObjectGroup *group = new WorldObjectGroup(&world, QLatin1String("Zones"), Qt::yellow);
+    world.insertObjectGroup(world.objectGroups().size(), group);
+
+    for (int y = 0; y < mWorldHeight; y++) {
+        for (int x = 0; x < mWorldWidth; x++) {
+            WorldCell *cell = world.cellAt(x, y);
+            cell->setMapFilePath(mCellMapFiles[x + y * mWorldWidth]);
+
+            for (int i = 0; i < mLotsPerCell; i++) {
+                QString lotFileName = mLotMapFiles[random(0, mLotMapFiles.size() - 1)];
+                cell->addLot(lotFileName, random(0, CELL_SIZE - LOT_SIZE),
+                             random(0, CELL_SIZE - LOT_SIZE), 0, LOT_SIZE, LOT_SIZE);
+            }
+
+            int objectCount = random(5, 15);
+            for (int i = 0; i < objectCount; i++) {
+                int width = random(5, 60), height = random(5, 60);
+                WorldCellObject *obj = new WorldCellObject(cell, QString(),
+                        types[random(0, types.size() - 1)], group,
+                        random(0, CELL_SIZE - width), random(0, CELL_SIZE - height), 0,
+                        width, height);
+                cell->insertObject(cell->objects().size(), obj);
+            }
+
+            // Building footprints and a road for the in-game map.
+            InGameMapCell &igm = cell->inGameMap();
+            int featureCount = random(20, 40);
+            for (int i = 0; i < featureCount; i++) {
+                InGameMapFeature *feature = new InGameMapFeature(&igm);
+                feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
+                InGameMapCoordinates coords;
+                int fx = random(0, CELL_SIZE - 20), fy = random(0, CELL_SIZE - 20);
+                int fw = random(4, 20), fh = random(4, 20);
+                coords += InGameMapPoint(fx, fy);
+                coords += InGameMapPoint(fx + fw, fy);
+                coords += InGameMapPoint(fx + fw, fy + fh);
+                coords += InGameMapPoint(fx, fy + fh);
+                feature->mGeometry.mCoordinates += coords;
+                feature->mProperties += InGameMapProperty(QLatin1String("building"), QLatin1String("yes"));
+                igm.features() += feature;
+            }
+            InGameMapFeature *road = new InGameMapFeature(&igm);
+            road->mGeometry.mType = InGameMapGeometry::Type::LineString;
+            InGameMapCoordinates coords;
+            for (int i = 0; i <= 10; i++)
+                coords += InGameMapPoint(i * CELL_SIZE / 10, CELL_SIZE / 2 + random(-10, 10));
+            road->mGeometry.mCoordinates += coords;
+            road->mProperties += InGameMapProperty(QLatin1String("highway"), QLatin1String("primary"));
+            igm.features() += road;
+        }
+    }
+
+    mWorldFileName = dir.filePath(QLatin1String("synthetic.pzw"));
+    WorldWriter writer;
+    if (!writer.writeWorld(&world, mWorldFileName)) {
+        mError = writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+Map *SyntheticWorld::createMap(int width, int height, int buildingCount)
+{
+    Map *map = new Map(Map::LevelIsometric, width, height, 64, 32);
+    foreach (Tileset *tileset, mTilesets)
+        map->addTileset(tileset);
+
+    for (int z = 0; z < MAX_LEVEL; z++) {
+        map->addLayer(new TileLayer(QString(QLatin1String("%1_Floor")).arg(z), 0, 0, width, height));
+        if (z == 0)
+            map->addLayer(new TileLayer(QLatin1String("0_Vegetation"), 0, 0, width, height));
+        map->addLayer(new TileLayer(QString(QLatin1String("%1_Walls")).arg(z), 0, 0, width, height));
+        map->addLayer(new TileLayer(QString(QLatin1String("%1_Furniture")).arg(z), 0, 0, width, height));
+        map->addLayer(new ObjectGroup(QString(QLatin1String("%1_RoomDefs")).arg(z), 0, 0, width, height));
+    }
+
+    // Cells get ground everywhere, lots only get their building.
+    bool isCell = width == CELL_SIZE;
+    if (isCell) {
+        TileLayer *floor = map->layerAt(map->indexOfLayer(QLatin1String("0_Floor")))->asTileLayer();
+        TileLayer *vegetation = map->layerAt(map->indexOfLayer(QLatin1String("0_Vegetation")))->asTileLayer();
+        Tileset *nature = mTilesets[TilesetNature];
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                floor->setCell(x, y, Cell(nature->tileAt(random(0, FIRST_TREE_TILE - 1))));
+                if (random(0, 99) < 5)
+                    vegetation->setCell(x, y, Cell(nature->tileAt(random(FIRST_TREE_TILE, 2 * FIRST_TREE_TILE - 1))));
+            }
+        }
+    }
+
+    QRegion used;
+    int roomCount = 0;
+    for (int i = 0; i < buildingCount; i++) {
+        for (int attempt = 0; attempt < 10; attempt++) {
+            int bw = random(6, qMin(14, width - 2)), bh = random(6, qMin(14, height - 2));
+            QRect bounds(random(1, width - bw - 1), random(1, height - bh - 1), bw, bh);
+            if (used.intersects(bounds.adjusted(-2, -2, 2, 2)))
+                continue;
+            used += bounds;
+            addBuilding(map, bounds, roomCount);
+            if (isCell) {
+                TileLayer *vegetation = map->layerAt(map->indexOfLayer(QLatin1String("0_Vegetation")))->asTileLayer();
+                vegetation->erase(QRegion(bounds));
+            }
+            break;
+        }
+    }
+
+    if (isCell) {
+        MapBmp &bmp = map->rbmpMain();
+        MapBmp &veg = map->rbmpVeg();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                QRgb rgb = BMP_GRASS;
+                if (y >= height / 2 - 3 && y <= height / 2 + 3)
+                    rgb = BMP_ROAD;
+                else if (random(0, 99) < 10)
+                    rgb = BMP_DIRT;
+                bmp.setPixel(x, y, rgb);
+                veg.setPixel(x, y, (rgb == BMP_GRASS && random(0, 99) < 5) ? BMP_TREES : qRgb(0, 0, 0));
+            }
+        }
+        for (const QRect &r : used) {
+            for (int y = r.top(); y <= r.bottom(); y++)
+                for (int x = r.left(); x <= r.right(); x++)
+                    bmp.setPixel(x, y, BMP_DIRT);
+        }
+    }
+
+    return map;
+}
+
+void SyntheticWorld::addBuilding(Map *map, const QRect &bounds, int &roomCount)
+{
+    int levels = random(1, MAX_LEVEL - 1);
+    int split = bounds.left() + bounds.width() / 2;
+    QRect rooms[2] = {
+        QRect(bounds.topLeft(), QPoint(split - 1, bounds.bottom())),
+        QRect(QPoint(split, bounds.top()), bounds.bottomRight())
+    };
+
+    Tileset *floors = mTilesets[TilesetFloors];
+    Tileset *walls = mTilesets[TilesetWalls];
+    Tileset *furniture = mTilesets[TilesetFurniture];
+
+    for (int z = 0; z < levels; z++) {
+        TileLayer *floor = map->layerAt(map->indexOfLayer(QString(QLatin1String("%1_Floor")).arg(z)))->asTileLayer();
+        TileLayer *wallLayer = map->layerAt(map->indexOfLayer(QString(QLatin1String("%1_Walls")).arg(z)))->asTileLayer();
+        TileLayer *furnitureLayer = map->layerAt(map->indexOfLayer(QString(QLatin1String("%1_Furniture")).arg(z)))->asTileLayer();
+        ObjectGroup *roomDefs = map->layerAt(map->indexOfLayer(QString(QLatin1String("%1_RoomDefs")).arg(z)))->asObjectGroup();
+
+        for (const QRect &room : rooms) {
+            Tile *floorTile = floors->tileAt(random(0, floors->tileCount() - 1));
+            for (int y = room.top(); y <= room.bottom(); y++)
+                for (int x = room.left(); x <= room.right(); x++)
+                    floor->setCell(x, y, Cell(floorTile));
+
+            // West and north walls; the next room's west wall divides them.
+            int wallStyle = random(0, walls->tileCount() / 2 - 1) * 2;
+            for (int y = room.top(); y <= room.bottom(); y++)
+                wallLayer->setCell(room.left(), y, Cell(walls->tileAt(wallStyle + WALL_W)));
+            for (int x = room.left(); x <= room.right(); x++)
+                wallLayer->setCell(x, room.top(), Cell(walls->tileAt(wallStyle + WALL_N)));
+
+            int furnitureCount = random(1, 4);
+            for (int i = 0; i < furnitureCount; i++) {
+                furnitureLayer->setCell(random(room.left() + 1, qMax(room.left() + 1, room.right())),
+                                        random(room.top() + 1, qMax(room.top() + 1, room.bottom())),
+                                        Cell(furniture->tileAt(random(0, furniture->tileCount() - 1))));
+            }
+
+            QString name = QString(QLatin1String("%1#%2"))
+                    .arg(QLatin1String(ROOM_NAMES[random(0, 5)]))
+                    .arg(++roomCount);
+            roomDefs->addObject(new MapObject(name, QLatin1String("room"),
+                                              room.topLeft(), room.size()));
+        }
+    }
+}
+
+void SyntheticWorld::addBmpRules(Map *map)
+{
+    QList<BmpRule*> rules;
+    rules += new BmpRule(QLatin1String("grass"), 0, BMP_GRASS,
+                         QStringList() << tileName(TilesetNature, 0) << tileName(TilesetNature, 1)
+                                       << tileName(TilesetNature, 2) << tileName(TilesetNature, 3),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("dirt"), 0, BMP_DIRT,
+                         QStringList() << tileName(TilesetNature, 8) << tileName(TilesetNature, 9),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("road"), 0, BMP_ROAD,
+                         QStringList() << tileName(TilesetFloors, 0),
+                         QLatin1String("0_Floor"), qRgb(0, 0, 0));
+    rules += new BmpRule(QLatin1String("trees"), 1, BMP_TREES,
+                         QStringList() << tileName(TilesetNature, FIRST_TREE_TILE)
+                                       << tileName(TilesetNature, FIRST_TREE_TILE + 1),
+                         QLatin1String("0_Vegetation"), BMP_GRASS);
+    map->rbmpSettings()->setRules(rules);
+
+    QList<BmpBlend*> blends;
+    const BmpBlend::Direction dirs[] = { BmpBlend::N, BmpBlend::S, BmpBlend::E, BmpBlend::W };
+    for (int i = 0; i < 4; i++) {
+        blends += new BmpBlend(QLatin1String("0_FloorOverlay"),
+                               tileName(TilesetNature, 0), tileName(TilesetNature, 8 + i),
+                               dirs[i], QStringList(), QStringList());
+    }
+    map->rbmpSettings()->setBlends(blends);
+}
+
+QString SyntheticWorld::tileName(int tileset, int index) const
+{
+    return QString(QLatin1String("%1_%2")).arg(QLatin1String(TILESET_NAMES[tileset])).arg(index);
+}
+
+int SyntheticWorld::random(int lowest, int highest)
+{
+    return int(mRandom.bounded(quint32(highest - lowest + 1))) + lowest;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTHETICWORLD_H
+#define SYNTHETICWORLD_H
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QRandomGenerator>
+#include <QStringList>
+
+namespace Tiled {
+class Map;
+class Tileset;
+}
+
+class World;
+
+/**
+  * Writes a world made of random but plausible cells to a directory: the
+  * tileset images and a .tiles file describing them, one .tmx per cell with
+  * floors, walls, furniture, vegetation, room definitions and BMP images,
+  * some small .tmx lots, and a .pzw placing the cells and lots with objects
+  * and in-game map features.  The same seed always gives the same files, so
+  * timings taken on different builds can be compared.
+  */
+class SyntheticWorld
+{
+    Q_DECLARE_TR_FUNCTIONS(SyntheticWorld)
+
+public:
+    SyntheticWorld(quint32 seed = 1);
+    ~SyntheticWorld();
+
+    void setWorldSize(int width, int height)
+    {
+        mWorldWidth = width;
+        mWorldHeight = height;
+    }
+
+    void setLotsPerCell(int count)
+    { mLotsPerCell = count; }
+
+    bool generate(const QString &directory);
+
+    QString worldFileName() const
+    { return mWorldFileName; }
+
+    const QStringList &cellMapFiles() const
+    { return mCellMapFiles; }
+
+    const QStringList &lotMapFiles() const
+    { return mLotMapFiles; }
+
+    QString errorString() const
+    { return mError; }
+
+private:
+    bool writeTilesets(const QDir &dir);
+    bool writeTileDefFile(const QDir &dir);
+    bool writeLots(const QDir &dir);
+    bool writeCells(const QDir &dir);
+    bool writeWorld(const QDir &dir);
+
+    Tiled::Map *createMap(int width, int height, int buildingCount);
+    void addBuilding(Tiled::Map *map, const QRect &bounds, int &roomCount);
+    void addBmpRules(Tiled::Map *map);
+    QString tileName(int tileset, int index) const;
+    int random(int lowest, int highest);
+
+    QRandomGenerator mRandom;
+    int mWorldWidth;
+    int mWorldHeight;
+    int mLotsPerCell;
+    QList<Tiled::Tileset*> mTilesets;
+    QString mWorldFileName;
+    QStringList mCellMapFiles;
+    QStringList mLotMapFiles;
+    QString mError;
+};
+
+#endif // SYNTHETICWORLD_H
@@ -0,0 +1,383 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilechunkcache.h"
+
+#include "mapcomposite.h"
+
+#include "maprenderer.h"
+
+#include <QCoreApplication>
+#include <QPaintEngine>
+#include <QRunnable>
+#include <QThread>
+#include <QVector>
+
+#include <cmath>
+
+using namespace Tiled;
+
+namespace {
+
+struct DrawOp
+{
+    QImage mImage;
+    QRectF mTarget;
+    QRectF mSource;
+    QTransform mTransform;
+    qreal mOpacity;
+};
+
+/**
+  * Remembers the images a MapRenderer draws so they can be drawn again on a
+  * worker thread.  Tile images don't own their pixels (see Tile::setImage),
+  * so each distinct image is copied once per chunk.
+  */
+class DrawListEngine : public QPaintEngine
+{
+public:
+    DrawListEngine() :
+        QPaintEngine(QPaintEngine::AllFeatures),
+        mOpacity(1.0)
+    {
+    }
+
+    bool begin(QPaintDevice *) override { return true; }
+    bool end() override { return true; }
+
+    void updateState(const QPaintEngineState &state) override
+    {
+        if (state.state() & QPaintEngine::DirtyTransform)
+            mTransform = state.transform();
+        if (state.state() & QPaintEngine::DirtyOpacity)
+            mOpacity = state.opacity();
+    }
+
+    void drawPixmap(const QRectF &r, const QPixmap &pm, const QRectF &sr) override
+    {
+        drawImage(r, pm.toImage(), sr, Qt::AutoColor);
+    }
+
+    void drawImage(const QRectF &r, const QImage &image, const QRectF &sr,
+                   Qt::ImageConversionFlags flags) override
+    {
+        Q_UNUSED(flags)
+        QImage &copy = mCopies[image.constBits()];
+        if (copy.size() != image.size())
+            copy = image.copy();
+
+        DrawOp op;
+        op.mImage = copy;
+        op.mTarget = r;
+        op.mSource = sr;
+        op.mTransform = mTransform;
+        op.mOpacity = mOpacity;
+        mOps += op;
+    }
+
+    Type type() const override { return QPaintEngine::User; }
+
+    QVector<DrawOp> mOps;
+
+private:
+    QHash<const uchar*,QImage> mCopies;
+    QTransform mTransform;
+    qreal mOpacity;
+};
+
+class DrawListDevice : public QPaintDevice
+{
+public:
+    QPaintEngine *paintEngine() const override
+    { return &mEngine; }
+
+    const QVector<DrawOp> &ops() const
+    { return mEngine.mOps; }
+
+protected:
+    int metric(PaintDeviceMetric metric) const override
+    {
+        switch (metric) {
+        case PdmWidth:
+        case PdmHeight:
+            return TileChunkCache::ChunkSize;
+        case PdmWidthMM:
+        case PdmHeightMM:
+            return TileChunkCache::ChunkSize * 254 / 960;
+        case PdmNumColors:
+            return 0;
+        case PdmDepth:
+            return 32;
+        case PdmDpiX:
+        case PdmDpiY:
+        case PdmPhysicalDpiX:
+        case PdmPhysicalDpiY:
+            return 96;
+        default:
+            return QPaintDevice::metric(metric);
+        }
+    }
+
+private:
+    mutable DrawListEngine mEngine;
+};
+
+qint64 imageBytes(const QImage &image)
+{
+    return qint64(image.bytesPerLine()) * image.height();
+}
+
+} // namespace
+
+class TileChunkCache::RasterTask : public QRunnable
+{
+public:
+    RasterTask(TileChunkCache *cache, quint64 key, int generation,
+               const QTransform &transform, QPainter::RenderHints hints,
+               const QVector<DrawOp> &ops) :
+        mCache(cache),
+        mKey(key),
+        mGeneration(generation),
+        mTransform(transform),
+        mHints(hints),
+        mOps(ops)
+    {
+    }
+
+    void run() override
+    {
+        QImage image;
+        if (!mOps.isEmpty()) {
+            image = QImage(ChunkSize, ChunkSize, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+            QPainter painter(&image);
+            painter.setRenderHints(mHints);
+            foreach (const DrawOp &op, mOps) {
+                painter.setTransform(op.mTransform * mTransform);
+                painter.setOpacity(op.mOpacity);
+                painter.drawImage(op.mTarget, op.mImage, op.mSource);
+            }
+        }
+
+        TileChunkCache *cache = mCache;
+        quint64 key = mKey;
+        int generation = mGeneration;
+        QMetaObject::invokeMethod(cache, [cache, key, generation, image]() {
+            cache->chunkFinished(key, generation, image);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    TileChunkCache *mCache;
+    quint64 mKey;
+    int mGeneration;
+    QTransform mTransform;
+    QPainter::RenderHints mHints;
+    QVector<DrawOp> mOps;
+};
+
+///// ///// ///// ///// /////
+
+QList<TileChunkCache*> TileChunkCache::sCaches;
+qint64 TileChunkCache::sByteBudget = 256 * 1024 * 1024;
+qint64 TileChunkCache::sBytesUsed = 0;
+quint64 TileChunkCache::sFrame = 0;
+
+TileChunkCache::TileChunkCache(CompositeLayerGroup *layerGroup,
+                               MapRenderer *renderer, QObject *parent) :
+    QObject(parent),
+    mLayerGroup(layerGroup),
+    mRenderer(renderer),
+    mGeneration(0),
+    mTaskCount(0),
+    mLayerGroupChangeCount(layerGroup->changeCount()),
+    mMapChangeCount(layerGroup->owner()->changeCount())
+{
+    mThreadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    sCaches += this;
+}
+
+TileChunkCache::~TileChunkCache()
+{
+    mThreadPool.clear();
+    mThreadPool.waitForDone();
+    foreach (const Chunk &chunk, mChunks)
+        sBytesUsed -= imageBytes(chunk.mImage);
+    sCaches.removeAll(this);
+}
+
+bool TileChunkCache::paint(QPainter *painter, const QRectF &exposed)
+{
+    const QTransform &transform = painter->worldTransform();
+    if (transform.type() > QTransform::TxScale || transform.m11() <= 0 ||
+            !qFuzzyCompare(transform.m11(), transform.m22()))
+        return false;
+
+    if (mLayerGroup->changeCount() != mLayerGroupChangeCount ||
+            mLayerGroup->owner()->changeCount() != mMapChangeCount)
+        invalidate();
+
+    const QRectF rect = exposed & mLayerGroup->boundingRect(mRenderer);
+    if (rect.isEmpty())
+        return true;
+
+    mRenderHints = painter->renderHints();
+    ++sFrame;
+
+    const int zoom = zoomBucket(transform.m11());
+    const qreal size = ChunkSize / zoomScale(zoom);
+    const int x1 = int(std::floor(rect.left() / size));
+    const int y1 = int(std::floor(rect.top() / size));
+    const int x2 = int(std::floor(rect.right() / size));
+    const int y2 = int(std::floor(rect.bottom() / size));
+
+    for (int y = y1; y <= y2; y++) {
+        for (int x = x1; x <= x2; x++) {
+            const quint64 key = chunkKey(x, y, zoom);
+            Chunk &chunk = mChunks[key];
+            chunk.mX = x;
+            chunk.mY = y;
+            chunk.mZoom = zoom;
+            chunk.mLastUsed = sFrame;
+            if (!chunk.mImage.isNull())
+                painter->drawImage(chunkRect(chunk), chunk.mImage);
+            if (chunk.mGeneration != mGeneration && chunk.mPendingGeneration == -1)
+                queueChunk(key, chunk);
+        }
+    }
+
+    return true;
+}
+
+void TileChunkCache::invalidate()
+{
+    ++mGeneration;
+    mLayerGroupChangeCount = mLayerGroup->changeCount();
+    mMapChangeCount = mLayerGroup->owner()->changeCount();
+}
+
+void TileChunkCache::clear()
+{
+    foreach (const Chunk &chunk, mChunks)
+        sBytesUsed -= imageBytes(chunk.mImage);
+    mChunks.clear();
+}
+
+void TileChunkCache::waitForChunks()
+{
+    mThreadPool.waitForDone();
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void TileChunkCache::setByteBudget(qint64 bytes)
+{
+    sByteBudget = bytes;
+    trimToBudget();
+}
+
+int TileChunkCache::zoomBucket(qreal scale)
+{
+    // Half-octave steps, rounded up so chunks are never magnified by more
+    // than a small fraction.
+    return int(std::ceil(std::log2(scale) * 2 - 0.01));
+}
+
+qreal TileChunkCache::zoomScale(int zoom)
+{
+    return std::pow(2.0, zoom / 2.0);
+}
+
+quint64 TileChunkCache::chunkKey(int x, int y, int zoom)
+{
+    return (quint64(quint16(zoom)) << 32) | (quint64(quint16(y)) << 16) | quint16(x);
+}
+
+QRectF TileChunkCache::chunkRect(const Chunk &chunk)
+{
+    const qreal size = ChunkSize / zoomScale(chunk.mZoom);
+    return QRectF(chunk.mX * size, chunk.mY * size, size, size);
+}
+
+void TileChunkCache::queueChunk(quint64 key, Chunk &chunk)
+{
+    const QRectF rect = chunkRect(chunk);
+    const qreal scale = zoomScale(chunk.mZoom);
+
+    // Gathering the tiles reads the MapComposite, so it must happen here.
+    // Lots, sub-maps and BmpBlender tiles are only added by prepareDrawing().
+    mLayerGroup->prepareDrawing(mRenderer, rect.toAlignedRect());
+    DrawListDevice device;
+    QPainter painter(&device);
+    mRenderer->drawTileLayerGroup(&painter, mLayerGroup, rect);
+    painter.end();
+
+    QTransform transform = QTransform::fromScale(scale, scale);
+    transform.translate(-rect.x(), -rect.y());
+
+    chunk.mPendingGeneration = mGeneration;
+    ++mTaskCount;
+    mThreadPool.start(new RasterTask(this, key, mGeneration, transform,
+                                     mRenderHints, device.ops()));
+}
+
+void TileChunkCache::chunkFinished(quint64 key, int generation, const QImage &image)
+{
+    --mTaskCount;
+
+    QHash<quint64,Chunk>::iterator it = mChunks.find(key);
+    if (it == mChunks.end() || it->mPendingGeneration != generation)
+        return; // cleared while the task ran
+
+    Chunk &chunk = it.value();
+    sBytesUsed += imageBytes(image) - imageBytes(chunk.mImage);
+    chunk.mImage = image;
+    chunk.mGeneration = generation;
+    chunk.mPendingGeneration = -1;
+
+    emit chunkReady(chunkRect(chunk));
+
+    trimToBudget();
+}
+
+void TileChunkCache::removeChunk(quint64 key)
+{
+    sBytesUsed -= imageBytes(mChunks[key].mImage);
+    mChunks.remove(key);
+}
+
+void TileChunkCache::trimToBudget()
+{
+    while (sBytesUsed > sByteBudget) {
+        // Chunks drawn during the latest paint are kept.
+        TileChunkCache *oldestCache = nullptr;
+        quint64 oldestKey = 0;
+        quint64 oldestFrame = sFrame;
+        foreach (TileChunkCache *cache, sCaches) {
+            QHash<quint64,Chunk>::const_iterator it = cache->mChunks.constBegin();
+            for (; it != cache->mChunks.constEnd(); ++it) {
+                if (!it->mImage.isNull() && it->mLastUsed < oldestFrame) {
+                    oldestCache = cache;
+                    oldestKey = it.key();
+                    oldestFrame = it->mLastUsed;
+                }
+            }
+        }
+        if (!oldestCache)
+            break;
+        oldestCache->removeChunk(oldestKey);
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILECHUNKCACHE_H
+#define TILECHUNKCACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QPainter>
+#include <QRectF>
+#include <QThreadPool>
+
+class CompositeLayerGroup;
+
+namespace Tiled {
+class MapRenderer;
+}
+
+/**
+  * Caches the tiles of one CompositeLayerGroup (one level of a cell) as
+  * fixed-size images, so the non-OpenGL cell view doesn't gather and draw
+  * every tile again each time it is scrolled.
+  *
+  * A chunk is ChunkSize x ChunkSize pixels at one of several zoom buckets.
+  * Missing chunks are recorded on the GUI thread, where the layer group may
+  * be read safely, and rasterized on a worker thread.  Until a chunk arrives
+  * its area stays empty, or shows the chunk's previous contents if it was
+  * invalidated.
+  *
+  * All caches share a byte budget; the least recently drawn chunks are
+  * thrown away first.
+  */
+class TileChunkCache : public QObject
+{
+    Q_OBJECT
+public:
+    enum { ChunkSize = 512 };
+
+    TileChunkCache(CompositeLayerGroup *layerGroup, Tiled::MapRenderer *renderer,
+                   QObject *parent = nullptr);
+    ~TileChunkCache();
+
+    /**
+      * Draws the part of the layer group inside \a exposed, which is in
+      * scene coordinates.  Returns false if the painter's transformation
+      * can't be handled, in which case nothing was drawn.
+      */
+    bool paint(QPainter *painter, const QRectF &exposed);
+
+    /**
+      * Marks every chunk as out of date.  Old chunks are still drawn until
+      * they are replaced.  The cache also invalidates itself when the layer
+      * group or its MapComposite report a change.
+      */
+    void invalidate();
+
+    /**
+      * Throws away every chunk.
+      */
+    void clear();
+
+    /**
+      * Waits for the worker thread and stores every chunk it finished.
+      */
+    void waitForChunks();
+
+    /**
+      * Returns true while chunks are being drawn on the worker thread.
+      */
+    bool isBusy() const { return mTaskCount > 0; }
+
+    int chunkCount() const { return mChunks.size(); }
+
+    static void setByteBudget(qint64 bytes);
+    static qint64 byteBudget() { return sByteBudget; }
+    static qint64 bytesUsed() { return sBytesUsed; }
+
+signals:
+    void chunkReady(const QRectF &sceneRect);
+
+private:
+    struct Chunk
+    {
+        Chunk() : mX(0), mY(0), mZoom(0), mGeneration(-1), mPendingGeneration(-1), mLastUsed(0) {}
+        int mX;
+        int mY;
+        int mZoom;
+        QImage mImage;
+        int mGeneration;
+        int mPendingGeneration; // -1 if no task is drawing this chunk
+        quint64 mLastUsed;
+    };
+
+    class RasterTask;
+    friend class RasterTask;
+
+    static int zoomBucket(qreal scale);
+    static qreal zoomScale(int zoom);
+    static quint64 chunkKey(int x, int y, int zoom);
+    static QRectF chunkRect(const Chunk &chunk);
+    void queueChunk(quint64 key, Chunk &chunk);
+    void chunkFinished(quint64 key, int generation, const QImage &image);
+    void removeChunk(quint64 key);
+    static void trimToBudget();
+
+    CompositeLayerGroup *mLayerGroup;
+    Tiled::MapRenderer *mRenderer;
+    QHash<quint64,Chunk> mChunks;
+    QThreadPool mThreadPool;
+    int mGeneration;
+    int mTaskCount;
+    int mLayerGroupChangeCount;
+    int mMapChangeCount;
+    QPainter::RenderHints mRenderHints;
+
+    static QList<TileChunkCache*> sCaches;
+    static qint64 sByteBudget;
+    static qint64 sBytesUsed;
+    static quint64 sFrame;
+};
+
+#endif // TILECHUNKCACHE_H
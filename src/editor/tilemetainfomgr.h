@@ -102,6 +102,9 @@ public:
     QString errorString() const
     { return mError; }
 
+    int revision() const
+    { return mRevision; }
+
     bool addNewTilesets();
 
     Tileset *loadTileset(const QString &source);
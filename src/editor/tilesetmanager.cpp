@@ -29,6 +29,7 @@
 #include "preferences.h"
 #include "progress.h"
 #include "tile.h"
+#include "tilesetpixelcache.h"
 #include <QDebug>
 #include <QDir>
 #include <QImageReader>
@@ -302,7 +303,8 @@ void TilesetManager::fileChangedTimeout()
         QString fileName = tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x();
         if (mChangedFiles.contains(fileName)) {
             if (QImageReader(fileName).size().isValid()) {
-                tileset->loadFromImage(QImage(fileName), tileset->imageSource());
+                QImage image = TilesetPixelCache().readImage(fileName, !tileset->imageSource2x().isEmpty());
+                tileset->loadFromImage(image, tileset->imageSource());
                 tileset->setMissing(false);
             } else {
                 if (tileset->tileHeight() == mMissingTile->width() && tileset->tileWidth() == mMissingTile->height()) {
@@ -505,7 +507,9 @@ void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets, QWidget *
         if (ts->isMissing())
             continue;
         // There may be a thread already reading or about to read this image.
-        QImage *image = new QImage(ts->imageSource2x().isEmpty() ? ts->imageSource() : ts->imageSource2x());
+        QImage *image = new QImage(TilesetPixelCache().readImage(
+                    ts->imageSource2x().isEmpty() ? ts->imageSource() : ts->imageSource2x(),
+                    !ts->imageSource2x().isEmpty()));
         Tileset *cached = mTilesetImageCache->findMatch(ts, ts->imageSource(), ts->imageSource2x());
         Q_ASSERT(cached != 0 && !cached->isLoaded());
         if (cached) {
@@ -857,7 +861,11 @@ void TilesetImageReaderWorker::work()
 
         Job job = mJobs.takeAt(0);
 
-        QImage *image = new QImage(job.tileset->imageSource2x().isEmpty() ? job.tileset->imageSource() : job.tileset->imageSource2x());
+        // Decoded pixels come from the on-disk cache when the PNG hasn't
+        // changed since it was last decoded.
+        QImage *image = new QImage(TilesetPixelCache().readImage(
+                    job.tileset->imageSource2x().isEmpty() ? job.tileset->imageSource() : job.tileset->imageSource2x(),
+                    !job.tileset->imageSource2x().isEmpty()));
 #if 0
         Sleep::msleep(500);
         qDebug() << "TilesetImageReaderThread #" << mID << "loaded" << job.tileset->imageSource();
@@ -32,224 +32,390 @@
 
 #include <qmath.h>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QMap>
 #include <QMessageBox>
 #include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
 
 using namespace Tiled;
 
 SINGLETON_IMPL(TMXToBMP)
 
 TMXToBMP::TMXToBMP(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    mWorldDoc(0),
+    mBldgWriter(0),
+    mDoMain(false),
+    mDoVeg(false),
+    mDoBldg(false),
+    mPatchImages(true)
 {
 }
 
-#include "threads.h"
-bool TMXToBMP::generateWorld(WorldDocument *worldDoc, TMXToBMP::GenerateMode mode)
+/////
+
+// Receives the finished 300x300 images of cells and stores them in one
+// 'main', 'vegetation' or 'buildings' image file.
+class TMXToBMPWriter
 {
-    mWorldDoc = worldDoc;
-    World *world = mWorldDoc->world();
+public:
+    TMXToBMPWriter(const QString &path) :
+        mPath(path)
+    {
+    }
 
-    const TMXToBMPSettings &settings = world->getTMXToBMPSettings();
-    mDoMain = settings.doMain;
-    mDoVeg = settings.doVegetation;
-    mDoBldg = settings.doBuildings;
+    virtual ~TMXToBMPWriter()
+    {
+    }
 
-    MapManager::instance()->purgeUnreferencedMaps();
+    virtual bool open() = 0;
+    virtual bool writeTile(const QPoint &pos, const QImage &tile) = 0;
+    virtual bool close() = 0;
 
-    PROGRESS progress(QLatin1String("Setting up images"));
+    const QString &path() const { return mPath; }
+    const QSize &size() const { return mSize; }
+    QString errorString() const { return mError; }
 
-    QMap<QImage*,QImage::Format> originalFormat;
-    QMap<QImage*,QVector<QRgb>> originalColorTable;
+protected:
+    QString mPath;
+    QSize mSize;
+    QString mError;
+};
 
-    foreach (WorldBMP *bmp, world->bmps()) {
-        BMPToTMXImages *images = BMPToTMX::instance()->getImages(bmp->filePath(), bmp->pos());
-        if (!images) {
-            goto errorExit;
-        }
-#if 1
-        originalFormat[&images->mBmp] = images->mBmp.format();
-        originalFormat[&images->mBmpVeg] = images->mBmpVeg.format();
-        if (images->mBmp.colorCount() > 0) {
-            originalColorTable[&images->mBmp] = images->mBmp.colorTable();
-        }
-        if (images->mBmpVeg.colorCount() > 0) {
-            originalColorTable[&images->mBmpVeg] = images->mBmpVeg.colorTable();
-        }
+// Patches the rows of an existing uncompressed 8-bit or 24-bit .bmp file in
+// place.  Those are the kinds of BMP QImage writes.  Only the rows of the
+// cells being written are touched, so the image is never held in memory.
+class TMXToBMPFileWriter : public TMXToBMPWriter
+{
+public:
+    TMXToBMPFileWriter(const QString &path) :
+        TMXToBMPWriter(path),
+        mPixelOffset(0),
+        mBytesPerPixel(0),
+        mBytesPerLine(0),
+        mBottomUp(true)
+    {
+    }
 
-        // This is the fastest format for QImage::pixel() and QImage::setPixel().
-        if (images->mBmp.format() != QImage::Format_ARGB32) {
-            images->mBmp = images->mBmp.convertToFormat(QImage::Format_ARGB32);
-            if (images->mBmp.isNull()) {
-                mError = tr("The image%1 file couldn't be loaded.\n%2\n\nThere might not be enough memory.  Try closing any open Cells or restart the application.")
-                        .arg(QLatin1String("")).arg(QDir::toNativeSeparators(bmp->filePath()));
-                goto errorExit;
-            }
-        }
-        if (images->mBmpVeg.format() != QImage::Format_ARGB32) {
-            images->mBmpVeg = images->mBmpVeg.convertToFormat(QImage::Format_ARGB32);
-            if (images->mBmpVeg.isNull()) {
-                mError = tr("The image%1 file couldn't be loaded.\n%2\n\nThere might not be enough memory.  Try closing any open Cells or restart the application.")
-                        .arg(QLatin1String("_veg")).arg(QDir::toNativeSeparators(bmp->filePath()));
-                goto errorExit;
-            }
+    bool open()
+    {
+        if (QFileInfo(mPath).suffix().compare(QLatin1String("bmp"), Qt::CaseInsensitive))
+            return false;
+        mFile.setFileName(mPath);
+        if (!mFile.open(QIODevice::ReadWrite))
+            return false;
+
+        // BITMAPFILEHEADER followed by at least a BITMAPINFOHEADER.
+        QByteArray header = mFile.read(54);
+        if (header.size() < 54 || header.at(0) != 'B' || header.at(1) != 'M')
+            return false;
+        const uchar *d = reinterpret_cast<const uchar*>(header.constData());
+        mPixelOffset = qFromLittleEndian<quint32>(d + 10);
+        quint32 infoSize = qFromLittleEndian<quint32>(d + 14);
+        qint32 width = qFromLittleEndian<qint32>(d + 18);
+        qint32 height = qFromLittleEndian<qint32>(d + 22);
+        int bpp = qFromLittleEndian<quint16>(d + 28);
+        quint32 compression = qFromLittleEndian<quint32>(d + 30);
+        quint32 colorsUsed = qFromLittleEndian<quint32>(d + 46);
+        if (infoSize < 40 || compression != 0 /* BI_RGB */)
+            return false;
+        if ((bpp != 8 && bpp != 24) || width <= 0 || height == 0)
+            return false;
+
+        mSize = QSize(width, qAbs(height));
+        mBottomUp = height > 0;
+        mBytesPerPixel = bpp / 8;
+        mBytesPerLine = ((width * bpp + 31) / 32) * 4;
+
+        if (bpp == 8) {
+            int numColors = colorsUsed ? int(colorsUsed) : 256;
+            if (numColors > 256 || !mFile.seek(14 + infoSize))
+                return false;
+            QByteArray palette = mFile.read(numColors * 4);
+            if (palette.size() != numColors * 4)
+                return false;
+            const uchar *p = reinterpret_cast<const uchar*>(palette.constData());
+            for (int i = 0; i < numColors; i++)
+                mColorTable += qRgb(p[i * 4 + 2], p[i * 4 + 1], p[i * 4]);
         }
-#endif
-        mImages += images;
+
+        if (mFile.size() < mPixelOffset + qint64(mBytesPerLine) * mSize.height())
+            return false;
+
+        return true;
     }
 
-    if (mode == GenerateSelected) {
-#if 0
-        // Merge the selected map BMP data with existing images
-        if (mDoMain) {
-            if (QFileInfo(settings.mainFile).exists()) {
-                mImageMain = QImage(settings.mainFile);
-                if (mImageMain.isNull() || (mImageMain.size() != world->size() * 300)) {
-                    mError = tr("The existing 'main' image file could not be loaded or is the wrong size, can't merge.");
-                    goto errorExit;
-                }
+    bool writeTile(const QPoint &pos, const QImage &tile)
+    {
+        Q_ASSERT(QRect(QPoint(), mSize).contains(QRect(pos, tile.size())));
+
+        // Converting each tile separately gives the same pixels as converting
+        // the whole image, since AvoidDither picks the nearest color per pixel.
+        QImage image;
+        if (mBytesPerPixel == 1)
+            image = tile.convertToFormat(QImage::Format_Indexed8, mColorTable,
+                                         Qt::ThresholdDither | Qt::AvoidDither);
+        else
+            image = tile.convertToFormat(QImage::Format_RGB32);
+
+        QByteArray line(image.width() * mBytesPerPixel, 0);
+        for (int y = 0; y < image.height(); y++) {
+            if (mBytesPerPixel == 1) {
+                memcpy(line.data(), image.constScanLine(y), image.width());
             } else {
-                mImageMain = QImage(world->size() * 300, QImage::Format_ARGB32);
-            }
-        }
-        if (mDoVeg) {
-            if (QFileInfo(settings.vegetationFile).exists()) {
-                mImageVeg = QImage(settings.vegetationFile);
-                if (mImageVeg.isNull() || (mImageVeg.size() != world->size() * 300)) {
-                    mError = tr("The existing 'vegetation' image file could not be loaded or is the wrong size, can't merge.");
-                    goto errorExit;
+                const QRgb *src = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+                uchar *dst = reinterpret_cast<uchar*>(line.data());
+                for (int x = 0; x < image.width(); x++) {
+                    *dst++ = qBlue(src[x]);
+                    *dst++ = qGreen(src[x]);
+                    *dst++ = qRed(src[x]);
                 }
-            } else {
-                mImageVeg = QImage(world->size() * 300, QImage::Format_ARGB32);
             }
-        }
-#endif
-        if (mDoBldg) {
-            if (QFileInfo(settings.buildingsFile).exists()) {
-                mImageBldg = QImage(settings.buildingsFile);
-                if (mImageBldg.isNull() || (mImageBldg.size() != world->size() * 300)) {
-                    mError = tr("The existing 'buildings' image file could not be loaded or is the wrong size, can't merge.");
-                    goto errorExit;
-                }
-            } else {
-                mImageBldg = QImage(world->size() * 300, QImage::Format_ARGB32);
-                mImageBldg.fill(Qt::transparent);
+            int row = pos.y() + y;
+            if (mBottomUp)
+                row = mSize.height() - 1 - row;
+            qint64 offset = mPixelOffset + qint64(row) * mBytesPerLine
+                    + qint64(pos.x()) * mBytesPerPixel;
+            if (!mFile.seek(offset) || mFile.write(line) != line.size()) {
+                mError = TMXToBMP::tr("Error writing to the image file.\n%1\n%2")
+                        .arg(QDir::toNativeSeparators(mPath))
+                        .arg(mFile.errorString());
+                return false;
             }
         }
-    } else {
-        // Don't bother loading the existing image since it will be replaced.
-#if 0
-        if (mDoMain)
-            mImageMain = QImage(world->size() * 300, QImage::Format_ARGB32);
-        if (mDoVeg)
-            mImageVeg = QImage(world->size() * 300, QImage::Format_ARGB32);
-#endif
-        if (mDoBldg) {
-            mImageBldg = QImage(world->size() * 300, QImage::Format_ARGB32);
-            mImageBldg.fill(Qt::transparent);
-        }
+        return true;
     }
 
-    if (/*(mDoMain && mImageMain.isNull()) ||
-            (mDoVeg && mImageVeg.isNull()) ||*/
-            (mDoBldg && mImageBldg.isNull())) {
-        mError = tr("Failed to create images.  There might not be enough memory.\nTry closing any open cell documents or restart the application.");
-        goto errorExit;
+    bool close()
+    {
+        mFile.close();
+        return true;
     }
 
-    if (mDoBldg) {
-        if (!mBldgPainter.begin(&mImageBldg)) {
-            mError = tr("Can't paint to the buildings image for some reason.");
-            goto errorExit;
+    // Writes a black 24-bit .bmp file one row at a time.  These are the
+    // pixels QImage::save() writes for a transparent image of that size.
+    static bool createBlank(const QString &path, const QSize &size)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+
+        const int bytesPerLine = ((size.width() * 24 + 31) / 32) * 4;
+        const quint32 pixelOffset = 14 + 40;
+        uchar header[pixelOffset];
+        memset(header, 0, sizeof(header));
+        header[0] = 'B';
+        header[1] = 'M';
+        qToLittleEndian<quint32>(pixelOffset + quint32(bytesPerLine) * size.height(), header + 2);
+        qToLittleEndian<quint32>(pixelOffset, header + 10);
+        qToLittleEndian<quint32>(40, header + 14);
+        qToLittleEndian<qint32>(size.width(), header + 18);
+        qToLittleEndian<qint32>(size.height(), header + 22);
+        qToLittleEndian<quint16>(1, header + 26); // planes
+        qToLittleEndian<quint16>(24, header + 28); // bits per pixel
+        qToLittleEndian<quint32>(quint32(bytesPerLine) * size.height(), header + 34);
+        if (file.write(reinterpret_cast<const char*>(header), sizeof(header)) != qint64(sizeof(header)))
+            return false;
+
+        QByteArray line(bytesPerLine, 0);
+        for (int y = 0; y < size.height(); y++) {
+            if (file.write(line) != line.size())
+                return false;
         }
-        mBldgPainter.setCompositionMode(QPainter::CompositionMode_Source);
+        return true;
     }
 
-    progress.update(QLatin1String("Reading maps"));
+private:
+    QFile mFile;
+    qint64 mPixelOffset;
+    int mBytesPerPixel;
+    int mBytesPerLine;
+    bool mBottomUp;
+    QVector<QRgb> mColorTable;
+};
+
+// Used for any image file TMXToBMPFileWriter can't patch, such as .png files.
+// The whole image is loaded, updated, and saved again in its original format.
+class TMXToBMPImageWriter : public TMXToBMPWriter
+{
+public:
+    TMXToBMPImageWriter(const QString &path) :
+        TMXToBMPWriter(path),
+        mOriginalFormat(QImage::Format_Invalid),
+        mModified(false)
+    {
+    }
 
-    mModifiedImages.clear();
+    bool open()
+    {
+        if (!mImage.load(mPath)) {
+            mError = TMXToBMP::tr("The image file couldn't be loaded.\n%1\n\nThere might not be enough memory.  Try closing any open Cells or restart the application.")
+                    .arg(QDir::toNativeSeparators(mPath));
+            return false;
+        }
+        mOriginalFormat = mImage.format();
+        mOriginalColorTable = mImage.colorTable();
+        mSize = mImage.size();
 
-    if (mode == GenerateSelected) {
-        foreach (WorldCell *cell, worldDoc->selectedCells())
-            if (!generateCell(cell))
-                goto errorExit;
-    } else {
-        for (int y = 0; y < world->height(); y++) {
-            for (int x = 0; x < world->width(); x++) {
-                if (!generateCell(world->cellAt(x, y)))
-                    goto errorExit;
+        // This is the fastest format for QImage::pixel() and QImage::setPixel().
+        if (mImage.format() != QImage::Format_ARGB32) {
+            mImage = mImage.convertToFormat(QImage::Format_ARGB32);
+            if (mImage.isNull()) {
+                mError = TMXToBMP::tr("The image file couldn't be loaded.\n%1\n\nThere might not be enough memory.  Try closing any open Cells or restart the application.")
+                        .arg(QDir::toNativeSeparators(mPath));
+                return false;
             }
         }
+        return true;
     }
 
-    MapManager::instance()->purgeUnreferencedMaps();
+    // Starts with a transparent image instead of loading the file.
+    bool create(const QSize &size)
+    {
+        mImage = QImage(size, QImage::Format_ARGB32);
+        if (mImage.isNull()) {
+            mError = TMXToBMP::tr("Failed to create images.  There might not be enough memory.\nTry closing any open cell documents or restart the application.");
+            return false;
+        }
+        mImage.fill(Qt::transparent);
+        mOriginalFormat = mImage.format();
+        mSize = size;
+        mModified = true;
+        return true;
+    }
 
-#if 1
-    foreach (BMPToTMXImages *images, mImages) {
-        if (!mModifiedImages.contains(images))
-            continue;
-        QFileInfo info(images->mPath);
-        if (mDoMain) {
-            progress.update(QLatin1String("Saving ") + info.fileName());
-            if (originalFormat[&images->mBmp] == images->mBmp.format()) {
-                images->mBmp.save(images->mPath);
-            } else {
-                Qt::ImageConversionFlags conversionFlags = Qt::ThresholdDither | Qt::AvoidDither;
-                if (originalColorTable.contains(&images->mBmp)) {
-                    QImage image = images->mBmp.convertToFormat(originalFormat[&images->mBmp], originalColorTable[&images->mBmp], conversionFlags);
-                    image.save(images->mPath);
-                } else {
-                    QImage image = images->mBmp.convertToFormat(originalFormat[&images->mBmp], conversionFlags);
-                    image.save(images->mPath);
-                }
+    bool writeTile(const QPoint &pos, const QImage &tile)
+    {
+        QPainter painter(&mImage);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(pos, tile);
+        mModified = true;
+        return true;
+    }
+
+    bool close()
+    {
+        if (!mModified)
+            return true;
+        QImage image = mImage;
+        if (mOriginalFormat != image.format()) {
+            Qt::ImageConversionFlags conversionFlags = Qt::ThresholdDither | Qt::AvoidDither;
+            if (mOriginalColorTable.size())
+                image = mImage.convertToFormat(mOriginalFormat, mOriginalColorTable, conversionFlags);
+            else
+                image = mImage.convertToFormat(mOriginalFormat, conversionFlags);
+        }
+        if (!image.save(mPath)) {
+            mError = TMXToBMP::tr("The image file couldn't be saved.\n%1")
+                    .arg(QDir::toNativeSeparators(mPath));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    QImage mImage;
+    QImage::Format mOriginalFormat;
+    QVector<QRgb> mOriginalColorTable;
+    bool mModified;
+};
+
+/////
+
+// The 'main' and 'vegetation' images for one cell.  These are rendered on a
+// worker thread from the cell map's BMP images.
+class TMXToBMPTile
+{
+public:
+    TMXToBMPTile() :
+        mBmpIndex(-1)
+    {
+    }
+
+    void render(bool doMain, bool doVeg)
+    {
+        if (doMain) {
+            mMain = QImage(300, 300, QImage::Format_ARGB32);
+            mMain.fill(Qt::black);
+            if (!mMapMain.isNull()) {
+                QPainter painter(&mMain);
+                painter.drawImage(0, 0, mMapMain);
             }
-//            Sleep::sleep(2);
         }
-        if (mDoVeg) {
-            progress.update(QLatin1String("Saving ") + info.baseName() + QLatin1String("_veg.") + info.suffix());
-            QString path = info.absolutePath() + QLatin1String("/") + info.baseName() + QLatin1String("_veg.") + info.suffix();
-            if (originalFormat[&images->mBmpVeg] == images->mBmpVeg.format()) {
-                images->mBmpVeg.save(path);
-            } else {
-                if (originalColorTable.contains(&images->mBmpVeg)) {
-                    Qt::ImageConversionFlags conversionFlags = Qt::ThresholdDither | Qt::AvoidDither;
-                    QImage image = images->mBmpVeg.convertToFormat(originalFormat[&images->mBmpVeg], originalColorTable[&images->mBmpVeg], conversionFlags);
-                    image.save(path);
-                } else {
-                    Qt::ImageConversionFlags conversionFlags = Qt::ThresholdDither | Qt::AvoidDither;
-                    QImage image = images->mBmpVeg.convertToFormat(originalFormat[&images->mBmpVeg], conversionFlags);
-                    image.save(path);
+        if (doVeg) {
+            mVeg = QImage(300, 300, QImage::Format_ARGB32);
+            mVeg.fill(Qt::transparent);
+            if (!mMapVeg.isNull()) {
+                QPainter painter(&mVeg);
+                painter.drawImage(0, 0, mMapVeg);
+                painter.end();
+                const QRgb black = qRgba(0, 0, 0, 255);
+                const QRgb transparent = qRgba(0, 0, 0, 0);
+                for (int y = 0; y < 300; y++) {
+                    QRgb *line = reinterpret_cast<QRgb*>(mVeg.scanLine(y));
+                    for (int x = 0; x < 300; x++) {
+                        if (line[x] == black)
+                            line[x] = transparent;
+                    }
                 }
             }
-//            Sleep::sleep(2);
         }
+        mMapMain = QImage();
+        mMapVeg = QImage();
     }
 
-#else
-    if (mDoMain) {
-        progress.update(QLatin1String("Saving main image"));
-        mImageMain.save(settings.mainFile);
-    }
-    if (mDoVeg) {
-        progress.update(QLatin1String("Saving vegetation image"));
-        mImageVeg.save(settings.vegetationFile);
-    }
-#endif
-    if (mDoBldg) {
-        progress.update(QLatin1String("Saving buildings image"));
-        mImageBldg.save(settings.buildingsFile);
-//        Sleep::sleep(2);
+    int mBmpIndex;
+    QPoint mPos; // Relative to the BMP's top-left pixel
+    QImage mMapMain; // Null if the cell has no map
+    QImage mMapVeg;
+    QImage mMain;
+    QImage mVeg;
+};
+
+namespace {
+
+class TMXToBMPTileTask : public QRunnable
+{
+public:
+    TMXToBMPTileTask(TMXToBMPTile *tile, bool doMain, bool doVeg) :
+        mTile(tile),
+        mDoMain(doMain),
+        mDoVeg(doVeg)
+    {
     }
 
-    qDeleteAll(mImages);
-    mImages.clear();
-    if (mDoBldg) {
-        mBldgPainter.end();
-        mImageBldg = QImage();
+    void run()
+    {
+        mTile->render(mDoMain, mDoVeg);
     }
 
+private:
+    TMXToBMPTile *mTile;
+    bool mDoMain;
+    bool mDoVeg;
+};
+
+bool cellLessThan(WorldCell *a, WorldCell *b)
+{
+    return a->x() < b->x();
+}
+
+} // namespace
+
+/////
+
+bool TMXToBMP::generateWorld(WorldDocument *worldDoc, TMXToBMP::GenerateMode mode)
+{
+    if (!generateImages(worldDoc, mode))
+        return false;
+
     // While displaying this, the MapManager's FileSystemWatcher might see some
     // changed .tmx files, which results in the PROGRESS dialog being displayed.
     // It's a bit odd to see the PROGRESS dialog blocked behind this messagebox.
@@ -257,15 +423,97 @@ bool TMXToBMP::generateWorld(WorldDocument *worldDoc, TMXToBMP::GenerateMode mod
                              tr("TMP To BMP"), tr("Finished!"));
 
     return true;
+}
 
-errorExit:
-    qDeleteAll(mImages);
-    mImages.clear();
-    if (mDoBldg) {
+QString TMXToBMP::vegImagePath(const QString &path)
+{
+    QFileInfo info(path);
+    return info.absolutePath() + QLatin1Char('/') + info.completeBaseName()
+            + QLatin1String("_veg.") + info.suffix();
+}
+
+bool TMXToBMP::generateImages(WorldDocument *worldDoc, TMXToBMP::GenerateMode mode)
+{
+    mWorldDoc = worldDoc;
+    World *world = mWorldDoc->world();
+
+    const TMXToBMPSettings &settings = world->getTMXToBMPSettings();
+    mDoMain = settings.doMain;
+    mDoVeg = settings.doVegetation;
+    mDoBldg = settings.doBuildings;
+
+    MapManager::instance()->purgeUnreferencedMaps();
+
+    bool ok = generateImages(mode);
+
+    closeWriters();
+    if (mBldgPainter.isActive())
         mBldgPainter.end();
-        mImageBldg = QImage();
+
+    return ok;
+}
+
+bool TMXToBMP::generateImages(TMXToBMP::GenerateMode mode)
+{
+    World *world = mWorldDoc->world();
+
+    PROGRESS progress(QLatin1String("Setting up images"));
+
+    QList<WorldCell*> cells;
+    if (mode == GenerateSelected) {
+        cells = mWorldDoc->selectedCells();
+    } else {
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                cells += world->cellAt(x, y);
+            }
+        }
     }
-    return false;
+
+    // Cells are processed one row at a time.  Each row of cells is a band of
+    // 300 rows of pixels in the images.
+    QMap<int,QList<WorldCell*> > bands;
+    foreach (WorldCell *cell, cells) {
+        int bmpIndex;
+        if (!shouldGenerateCell(cell, bmpIndex))
+            continue;
+        if (mode == GenerateChanged && !isCellChanged(cell, bmpIndex))
+            continue;
+        if (!openWriters(bmpIndex))
+            return false;
+        bands[cell->y()] += cell;
+    }
+
+    if (mDoBldg && !openBuildingsWriter(mode))
+        return false;
+
+    QThreadPool threadPool;
+    foreach (int y, bands.keys()) {
+        progress.update(tr("Reading maps (row %1)").arg(y));
+        QList<WorldCell*> &band = bands[y];
+        std::sort(band.begin(), band.end(), cellLessThan);
+        if (!generateBand(band, &threadPool))
+            return false;
+        MapManager::instance()->purgeUnreferencedMaps();
+    }
+
+    foreach (TMXToBMPWriter *writer, mMainWriters.values() + mVegWriters.values()) {
+        progress.update(QLatin1String("Saving ") + QFileInfo(writer->path()).fileName());
+        if (!writer->close()) {
+            mError = writer->errorString();
+            return false;
+        }
+    }
+
+    if (mDoBldg) {
+        progress.update(QLatin1String("Saving buildings image"));
+        if (!mBldgWriter->close()) {
+            mError = mBldgWriter->errorString();
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool TMXToBMP::shouldGenerateCell(WorldCell *cell, int &bmpIndex)
@@ -284,72 +532,215 @@ bool TMXToBMP::shouldGenerateCell(WorldCell *cell, int &bmpIndex)
     return true;
 }
 
-bool TMXToBMP::generateCell(WorldCell *cell)
+bool TMXToBMP::isCellChanged(WorldCell *cell, int bmpIndex)
+{
+    QFileInfo mapInfo(cell->mapFilePath());
+    if (cell->mapFilePath().isEmpty() || !mapInfo.exists())
+        return false;
+    WorldBMP *bmp = cell->world()->bmps().at(bmpIndex);
+    if (mDoMain) {
+        QFileInfo info(bmp->filePath());
+        if (!info.exists() || mapInfo.lastModified() > info.lastModified())
+            return true;
+    }
+    if (mDoVeg) {
+        QFileInfo info(vegImagePath(bmp->filePath()));
+        if (!info.exists() || mapInfo.lastModified() > info.lastModified())
+            return true;
+    }
+    return false;
+}
+
+bool TMXToBMP::openWriters(int bmpIndex)
 {
-    int bmpIndex;
-    if (!shouldGenerateCell(cell, bmpIndex))
+    if ((!mDoMain || mMainWriters.contains(bmpIndex)) &&
+            (!mDoVeg || mVegWriters.contains(bmpIndex)))
         return true;
-    BMPToTMXImages *images = mImages[bmpIndex];
 
-    if (cell->mapFilePath().isEmpty()) {
-        if (mDoMain) {
-            QPainter painter(&images->mBmp);
-            painter.fillRect(cell->x() * 300, cell->y() * 300, 300, 300, Qt::black);
-            mModifiedImages.insert(images);
-        }
-        if (mDoVeg) {
-            QPainter painter(&images->mBmpVeg);
-            painter.setCompositionMode(QPainter::CompositionMode_Source);
-            painter.fillRect(cell->x() * 300, cell->y() * 300, 300, 300, Qt::transparent);
-            mModifiedImages.insert(images);
-        }
-        if (mDoBldg) {
-            mBldgPainter.fillRect(cell->x() * 300, cell->y() * 300, 300, 300, Qt::transparent);
+    WorldBMP *bmp = mWorldDoc->world()->bmps().at(bmpIndex);
+    QSize size = BMPToTMX::instance()->validateImages(bmp->filePath());
+    if (size.isEmpty()) {
+        mError = BMPToTMX::instance()->errorString();
+        if (mError.isEmpty())
+            mError = tr("The image file couldn't be read.\n%1")
+                    .arg(QDir::toNativeSeparators(bmp->filePath()));
+        return false;
+    }
+    if (size != bmp->bounds().size() * 300) {
+        mError = tr("The image size isn't divisible by 300.\n%1")
+                .arg(QDir::toNativeSeparators(bmp->filePath()));
+        return false;
+    }
+
+    if (mDoMain && !mMainWriters.contains(bmpIndex)) {
+        TMXToBMPWriter *writer = openWriter(bmp->filePath());
+        if (!writer)
+            return false;
+        mMainWriters[bmpIndex] = writer;
+    }
+    if (mDoVeg && !mVegWriters.contains(bmpIndex)) {
+        TMXToBMPWriter *writer = openWriter(vegImagePath(bmp->filePath()));
+        if (!writer)
+            return false;
+        mVegWriters[bmpIndex] = writer;
+    }
+    return true;
+}
+
+// The buildings image covers the whole world.  It is written one row of
+// cells at a time like the other images, so it is never held in memory
+// unless it isn't a .bmp file.
+bool TMXToBMP::openBuildingsWriter(TMXToBMP::GenerateMode mode)
+{
+    World *world = mWorldDoc->world();
+    const QString &path = world->getTMXToBMPSettings().buildingsFile;
+    const QSize size = world->size() * 300;
+
+    if (mode != GenerateAll && QFileInfo(path).exists()) {
+        // Merge the selected map BMP data with the existing image
+        mBldgWriter = openWriter(path);
+        if (!mBldgWriter)
+            return false;
+        if (mBldgWriter->size() != size) {
+            mError = tr("The existing 'buildings' image file could not be loaded or is the wrong size, can't merge.");
+            return false;
         }
         return true;
     }
 
-    MapInfo *mapInfo = MapManager::instance()->loadMap(cell->mapFilePath(),
-                                                       mWorldDoc->fileName());
-    if (!mapInfo) {
-        mError = MapManager::instance()->errorString();
+    // Don't bother loading the existing image since it will be replaced.
+    bool isBMP = !QFileInfo(path).suffix().compare(QLatin1String("bmp"), Qt::CaseInsensitive);
+    if (mPatchImages && isBMP) {
+        if (!TMXToBMPFileWriter::createBlank(path, size)) {
+            mError = tr("The image file couldn't be saved.\n%1")
+                    .arg(QDir::toNativeSeparators(path));
+            return false;
+        }
+        mBldgWriter = openWriter(path);
+        return mBldgWriter != 0;
+    }
+
+    TMXToBMPImageWriter *writer = new TMXToBMPImageWriter(path);
+    mBldgWriter = writer;
+    if (!writer->create(size)) {
+        mError = writer->errorString();
         return false;
     }
+    return true;
+}
 
+TMXToBMPWriter *TMXToBMP::openWriter(const QString &path)
+{
+    TMXToBMPWriter *writer;
+    if (mPatchImages) {
+        writer = new TMXToBMPFileWriter(path);
+        if (writer->open())
+            return writer;
+        delete writer;
+    }
+
+    writer = new TMXToBMPImageWriter(path);
+    if (writer->open())
+        return writer;
+    mError = writer->errorString();
+    delete writer;
+    return nullptr;
+}
+
+void TMXToBMP::closeWriters()
+{
+    qDeleteAll(mMainWriters);
+    mMainWriters.clear();
+    qDeleteAll(mVegWriters);
+    mVegWriters.clear();
+    delete mBldgWriter;
+    mBldgWriter = 0;
+}
+
+bool TMXToBMP::generateBand(const QList<WorldCell *> &cells, QThreadPool *threadPool)
+{
+    // Queue all the maps in this row so the MapManager's reader threads can
+    // load them at the same time.
     DelayedMapLoader mapLoader;
-    mapLoader.addMap(mapInfo);
+    QList<MapInfo*> mapInfos;
+    foreach (WorldCell *cell, cells) {
+        MapInfo *mapInfo = nullptr;
+        if (!cell->mapFilePath().isEmpty()) {
+            mapInfo = MapManager::instance()->loadMap(cell->mapFilePath(),
+                                                      mWorldDoc->fileName(), true);
+            if (!mapInfo) {
+                mError = MapManager::instance()->errorString();
+                return false;
+            }
+            mapLoader.addMap(mapInfo);
+        }
+        mapInfos += mapInfo;
+    }
 
-    while (mapLoader.isLoading()) {
+    while (mapLoader.isLoading())
         qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+    if (!mapLoader.errorString().isEmpty()) {
+        mError = mapLoader.errorString();
+        return false;
     }
 
-    QRgb black = qRgba(0, 0, 0, 255);
-    QRgb transparent = qRgba(0, 0, 0, 0);
-
-    if (mDoMain) {
-        QPainter painter(&images->mBmp);
-        painter.drawImage((cell->pos() - images->mBounds.topLeft()) * 300, mapInfo->map()->bmpMain().image());
-        mModifiedImages.insert(images);
+    QList<TMXToBMPTile*> tiles;
+    for (int i = 0; i < cells.size(); i++) {
+        WorldCell *cell = cells[i];
+        TMXToBMPTile *tile = new TMXToBMPTile;
+        shouldGenerateCell(cell, tile->mBmpIndex);
+        WorldBMP *bmp = mWorldDoc->world()->bmps().at(tile->mBmpIndex);
+        tile->mPos = (cell->pos() - bmp->pos()) * 300;
+        if (MapInfo *mapInfo = mapInfos[i]) {
+            tile->mMapMain = mapInfo->map()->rbmpMain().image();
+            tile->mMapVeg = mapInfo->map()->rbmpVeg().image();
+        }
+        tiles += tile;
+        threadPool->start(new TMXToBMPTileTask(tile, mDoMain, mDoVeg));
     }
 
-    if (mDoVeg) {
-        QPainter painter(&images->mBmpVeg);
-        QPoint p = (cell->pos() - images->mBounds.topLeft()) * 300;
-        painter.drawImage(p, mapInfo->map()->bmpVeg().image());
-        for (int y = 0; y < 300; y++) {
-            for (int x = 0; x < 300; x++) {
-                if (images->mBmpVeg.pixel(p + QPoint(x, y)) == black)
-                    images->mBmpVeg.setPixel(p + QPoint(x, y), transparent);
+    // The buildings image needs MapComposites, which must be created on this
+    // thread.  The tiles are rendered meanwhile.
+    bool ok = true;
+    if (mDoBldg) {
+        for (int i = 0; i < cells.size(); i++) {
+            WorldCell *cell = cells[i];
+            QImage image(300, 300, QImage::Format_ARGB32);
+            image.fill(Qt::transparent);
+            if (MapInfo *mapInfo = mapInfos[i]) {
+                mBldgPainter.begin(&image);
+                mBldgPainter.setCompositionMode(QPainter::CompositionMode_Source);
+                ok = doBuildings(cell, mapInfo);
+                mBldgPainter.end();
+                if (!ok)
+                    break;
+            }
+            if (!mBldgWriter->writeTile(cell->pos() * 300, image)) {
+                mError = mBldgWriter->errorString();
+                ok = false;
+                break;
             }
         }
-        mModifiedImages.insert(images);
     }
 
-    bool ok = true;
-    if (mDoBldg) {
-        ok = doBuildings(cell, mapInfo);
+    threadPool->waitForDone();
+
+    if (ok) {
+        foreach (TMXToBMPTile *tile, tiles) {
+            if (mDoMain && !mMainWriters[tile->mBmpIndex]->writeTile(tile->mPos, tile->mMain)) {
+                mError = mMainWriters[tile->mBmpIndex]->errorString();
+                ok = false;
+                break;
+            }
+            if (mDoVeg && !mVegWriters[tile->mBmpIndex]->writeTile(tile->mPos, tile->mVeg)) {
+                mError = mVegWriters[tile->mBmpIndex]->errorString();
+                ok = false;
+                break;
+            }
+        }
     }
 
+    qDeleteAll(tiles);
     return ok;
 }
 
@@ -389,8 +780,6 @@ bool TMXToBMP::doBuildings(WorldCell *cell, MapInfo *mapInfo)
         mapComposite->addMap(info, lot->pos(), lot->level());
     }
 
-    mBldgPainter.fillRect(cell->x() * 300, cell->y() * 300, 300, 300, Qt::transparent);
-
     return processObjectGroups(cell, mapComposite);
 }
 
@@ -454,9 +843,7 @@ bool TMXToBMP::processObjectGroup(WorldCell *cell, ObjectGroup *objectGroup,
                 return false;
             }
 
-            mBldgPainter.fillRect(cell->x() * 300 + x,
-                                  cell->y() * 300 + y,
-                                  w, h, mBldgColor);
+            mBldgPainter.fillRect(x, y, w, h, mBldgColor);
         }
     }
     return true;
@@ -21,17 +21,20 @@
 #include "singleton.h"
 
 #include <QImage>
+#include <QMap>
 #include <QObject>
 #include <QPainter>
-#include <QSet>
 
-class BMPToTMXImages;
 class MapComposite;
 class MapInfo;
+class TMXToBMPTile;
+class TMXToBMPWriter;
 class WorldBMP;
 class WorldCell;
 class WorldDocument;
 
+class QThreadPool;
+
 namespace Tiled {
 class ObjectGroup;
 }
@@ -42,30 +45,52 @@ class TMXToBMP : public QObject, public Singleton<TMXToBMP>
 public:
     enum GenerateMode {
         GenerateAll,
-        GenerateSelected
+        GenerateSelected,
+        GenerateChanged
     };
 
     explicit TMXToBMP(QObject *parent = 0);
 
     bool generateWorld(WorldDocument *worldDoc, GenerateMode mode);
 
+    /**
+      * Writes the images of \a worldDoc without showing anything when done.
+      * generateWorld() calls this.
+      */
+    bool generateImages(WorldDocument *worldDoc, GenerateMode mode);
+
+    /**
+      * Whether .bmp files are patched in place one row of cells at a time.
+      * When false, each image is loaded, updated and saved as a whole.
+      */
+    void setPatchImages(bool patch) { mPatchImages = patch; }
+
     QString errorString() const { return mError; }
 
+    static QString vegImagePath(const QString &path);
+
 private:
+    bool generateImages(GenerateMode mode);
     bool shouldGenerateCell(WorldCell *cell, int &bmpIndex);
-    bool generateCell(WorldCell *cell);
+    bool isCellChanged(WorldCell *cell, int bmpIndex);
+    bool openWriters(int bmpIndex);
+    bool openBuildingsWriter(GenerateMode mode);
+    TMXToBMPWriter *openWriter(const QString &path);
+    void closeWriters();
+    bool generateBand(const QList<WorldCell*> &cells, QThreadPool *threadPool);
     bool doBuildings(WorldCell *cell, MapInfo *mapInfo);
     bool processObjectGroups(WorldCell *cell, MapComposite *mapComposite);
     bool processObjectGroup(WorldCell *cell, Tiled::ObjectGroup *objectGroup, int levelOffset, const QPoint &offset);
 
 private:
     WorldDocument *mWorldDoc;
-    QList<BMPToTMXImages*> mImages;
-    QSet<BMPToTMXImages*> mModifiedImages;
-    QImage mImageBldg;
+    QMap<int,TMXToBMPWriter*> mMainWriters;
+    QMap<int,TMXToBMPWriter*> mVegWriters;
+    TMXToBMPWriter *mBldgWriter;
     bool mDoMain;
     bool mDoVeg;
     bool mDoBldg;
+    bool mPatchImages;
     QPainter mBldgPainter;
     QColor mBldgColor;
     QString mError;
@@ -17,7 +17,11 @@
 
 #include "undodock.h"
 
+#include "undomemory.h"
+
 #include <QEvent>
+#include <QLabel>
+#include <QUndoGroup>
 #include <QUndoView>
 #include <QVBoxLayout>
 
@@ -32,13 +36,19 @@ UndoDock::UndoDock(QUndoGroup *undoGroup, QWidget *parent) :
     mUndoView->setUniformItemSizes(true);
     mUndoView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 
+    mMemoryLabel = new QLabel(this);
+
     QWidget *widget = new QWidget(this);
     QVBoxLayout *layout = new QVBoxLayout(widget);
     layout->setContentsMargins(5, 5, 5, 5);
     layout->addWidget(mUndoView);
+    layout->addWidget(mMemoryLabel);
 
     setWidget(widget);
     retranslateUi();
+
+    connect(undoGroup, &QUndoGroup::activeStackChanged, this, &UndoDock::activeStackChanged);
+    activeStackChanged(undoGroup->activeStack());
 }
 
 void UndoDock::changeEvent(QEvent *e)
@@ -57,4 +67,26 @@ void UndoDock::retranslateUi()
 {
     setWindowTitle(tr("History"));
     mUndoView->setEmptyLabel(tr("<empty>"));
+    updateMemoryLabel();
+}
+
+void UndoDock::activeStackChanged(QUndoStack *undoStack)
+{
+    disconnect(mMemoryConnection);
+    if (UndoMemory *undoMemory = UndoMemory::forStack(undoStack))
+        mMemoryConnection = connect(undoMemory, &UndoMemory::memoryUsageChanged,
+                                    this, &UndoDock::updateMemoryLabel);
+    updateMemoryLabel();
+}
+
+void UndoDock::updateMemoryLabel()
+{
+    UndoMemory *undoMemory = UndoMemory::forStack(mUndoView->stack());
+    if (!undoMemory) {
+        mMemoryLabel->clear();
+        return;
+    }
+    mMemoryLabel->setText(tr("Memory: %1 of %2")
+                          .arg(UndoMemory::formatBytes(undoMemory->memoryUsage()))
+                          .arg(UndoMemory::formatBytes(undoMemory->limit())));
 }
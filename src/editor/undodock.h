@@ -20,7 +20,9 @@
 
 #include <QDockWidget>
 
+class QLabel;
 class QUndoGroup;
+class QUndoStack;
 class QUndoView;
 
 class UndoDock : public QDockWidget
@@ -33,7 +35,12 @@ protected:
 
 private:
     void retranslateUi();
+    void activeStackChanged(QUndoStack *undoStack);
+    void updateMemoryLabel();
+
     QUndoView *mUndoView;
+    QLabel *mMemoryLabel;
+    QMetaObject::Connection mMemoryConnection;
 };
 
 #endif // UNDODOCK_H
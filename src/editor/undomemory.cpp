@@ -0,0 +1,276 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "undomemory.h"
+
+#include "preferences.h"
+#include "worldcell.h"
+
+#include <QDataStream>
+#include <QUndoStack>
+
+// Rough per-allocation overhead of the heap plus a QList node pointer.
+static const qint64 ALLOC_OVERHEAD = 16 + sizeof(void*);
+
+// The newest commands are the ones most likely to be undone, so they are
+// never compressed.
+static const int KEEP_UNCOMPRESSED = 8;
+
+static qint64 stringUsage(const QString &s)
+{
+    return s.isEmpty() ? 0 : ALLOC_OVERHEAD + s.size() * sizeof(QChar);
+}
+
+/////
+
+CompressedCoordinates::CompressedCoordinates()
+    : mCount(0)
+{
+}
+
+CompressedCoordinates::CompressedCoordinates(const InGameMapCoordinates &coords)
+    : mCoordinates(coords)
+    , mCount(coords.size())
+{
+}
+
+void CompressedCoordinates::setCoordinates(const InGameMapCoordinates &coords)
+{
+    mCoordinates = coords;
+    mCompressed.clear();
+    mCount = coords.size();
+}
+
+InGameMapCoordinates CompressedCoordinates::coordinates() const
+{
+    if (!isCompressed())
+        return mCoordinates;
+
+    InGameMapCoordinates coords;
+    coords.reserve(mCount);
+    QByteArray data = qUncompress(mCompressed);
+    QDataStream in(data);
+    InGameMapPoint previous;
+    for (int i = 0; i < mCount; i++) {
+        qint32 dx, dy;
+        in >> dx >> dy;
+        previous = previous + InGameMapPoint(dx, dy);
+        coords += previous;
+    }
+    return coords;
+}
+
+void CompressedCoordinates::compress()
+{
+    if (isCompressed() || mCount == 0)
+        return;
+
+    // Points are stored as the distance from the previous point, which is
+    // usually a small whole number that zlib packs well.
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    InGameMapPoint previous;
+    for (const InGameMapPoint &point : mCoordinates) {
+        InGameMapPoint delta = point - previous;
+        out << delta.x << delta.y;
+        previous = point;
+    }
+    mCompressed = qCompress(data);
+    mCoordinates.clear();
+}
+
+qint64 CompressedCoordinates::memoryUsage() const
+{
+    if (isCompressed())
+        return sizeof(*this) + mCompressed.size();
+    return sizeof(*this) + UndoMemory::memoryUsage(mCoordinates);
+}
+
+/////
+
+UndoMemory::UndoMemory(QUndoStack *undoStack)
+    : QObject(undoStack)
+    , mUndoStack(undoStack)
+    , mIndex(undoStack->index())
+    , mMemoryUsage(0)
+{
+    connect(mUndoStack, &QUndoStack::indexChanged, this, &UndoMemory::indexChanged);
+    connect(Preferences::instance(), &Preferences::undoMemoryLimitChanged,
+            this, &UndoMemory::indexChanged);
+}
+
+UndoMemory *UndoMemory::forStack(QUndoStack *undoStack)
+{
+    return undoStack ? undoStack->findChild<UndoMemory*>(QString(), Qt::FindDirectChildrenOnly) : nullptr;
+}
+
+qint64 UndoMemory::limit() const
+{
+    return qint64(Preferences::instance()->undoMemoryLimit()) * 1024 * 1024;
+}
+
+qint64 UndoMemory::memoryUsage(const QUndoCommand *command)
+{
+    qint64 bytes = sizeof(QUndoCommand) + stringUsage(command->text());
+    if (const UndoCommandMemory *ucm = dynamic_cast<const UndoCommandMemory*>(command))
+        bytes += ucm->memoryUsage();
+    for (int i = 0; i < command->childCount(); i++)
+        bytes += memoryUsage(command->child(i));
+    return bytes;
+}
+
+qint64 UndoMemory::memoryUsage(const InGameMapCoordinates &coords)
+{
+    return coords.size() * (sizeof(InGameMapPoint) + ALLOC_OVERHEAD);
+}
+
+qint64 UndoMemory::memoryUsage(const InGameMapFeature *feature)
+{
+    qint64 bytes = sizeof(InGameMapFeature);
+    for (const InGameMapCoordinates &coords : feature->mGeometry.mCoordinates)
+        bytes += ALLOC_OVERHEAD + memoryUsage(coords);
+    for (const InGameMapProperty &property : feature->mProperties)
+        bytes += ALLOC_OVERHEAD + stringUsage(property.mKey) + stringUsage(property.mValue);
+    return bytes;
+}
+
+qint64 UndoMemory::memoryUsage(WorldCell *cell)
+{
+    qint64 bytes = sizeof(WorldCell) + stringUsage(cell->mapFilePath());
+
+    // The lots and objects of a cell that hasn't been loaded from a .pzwb
+    // file are still in the file, and measuring them mustn't load them.
+    if (!cell->isLoaded()) {
+        foreach (Property *property, cell->properties())
+            bytes += sizeof(Property) + ALLOC_OVERHEAD + stringUsage(property->mValue);
+        return bytes;
+    }
+
+    foreach (WorldCellLot *lot, cell->lots())
+        bytes += sizeof(WorldCellLot) + ALLOC_OVERHEAD + stringUsage(lot->mapName());
+    foreach (WorldCellObject *obj, cell->objects())
+        bytes += sizeof(WorldCellObject) + ALLOC_OVERHEAD + stringUsage(obj->name())
+                + obj->points().size() * sizeof(WorldCellObjectPoint);
+    foreach (Property *property, cell->properties())
+        bytes += sizeof(Property) + ALLOC_OVERHEAD + stringUsage(property->mValue);
+    for (InGameMapFeature *feature : cell->inGameMap().features())
+        bytes += memoryUsage(feature);
+    return bytes;
+}
+
+qint64 UndoMemory::memoryUsage(const WorldCellContents *contents)
+{
+    qint64 bytes = sizeof(WorldCellContents) + stringUsage(contents->mapFilePath());
+    foreach (WorldCellLot *lot, contents->lots())
+        bytes += sizeof(WorldCellLot) + ALLOC_OVERHEAD + stringUsage(lot->mapName());
+    foreach (WorldCellObject *obj, contents->objects())
+        bytes += sizeof(WorldCellObject) + ALLOC_OVERHEAD + stringUsage(obj->name())
+                + obj->points().size() * sizeof(WorldCellObjectPoint);
+    foreach (Property *property, contents->properties())
+        bytes += sizeof(Property) + ALLOC_OVERHEAD + stringUsage(property->mValue);
+    return bytes;
+}
+
+QString UndoMemory::formatBytes(qint64 bytes)
+{
+    if (bytes < 1024)
+        return tr("%1 bytes").arg(bytes);
+    if (bytes < 1024 * 1024)
+        return tr("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    return tr("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+void UndoMemory::compress(const QUndoCommand *command)
+{
+    // QUndoStack only hands out const commands.
+    QUndoCommand *cmd = const_cast<QUndoCommand*>(command);
+    if (UndoCommandMemory *ucm = dynamic_cast<UndoCommandMemory*>(cmd))
+        ucm->compress();
+    for (int i = 0; i < command->childCount(); i++)
+        compress(command->child(i));
+}
+
+void UndoMemory::remeasure(int index)
+{
+    if (index < 0 || index >= mEntries.size())
+        return;
+    Entry &entry = mEntries[index];
+    qint64 bytes = memoryUsage(entry.mCommand);
+    mMemoryUsage += bytes - entry.mBytes;
+    entry.mBytes = bytes;
+    entry.mCompressed = false;
+}
+
+void UndoMemory::indexChanged()
+{
+    const int count = mUndoStack->count();
+
+    // Commands deleted from the bottom of the stack by QUndoStack's undo
+    // limit.
+    if (!mEntries.isEmpty() && count > 0 && mEntries.first().mCommand != mUndoStack->command(0)) {
+        int first = 0;
+        while (first < mEntries.size() && mEntries[first].mCommand != mUndoStack->command(0))
+            first++;
+        for (int i = 0; i < first; i++)
+            mMemoryUsage -= mEntries[i].mBytes;
+        mEntries.erase(mEntries.begin(), mEntries.begin() + first);
+    }
+
+    // Commands deleted from the top of the stack by a push, or by clear().
+    int same = 0;
+    while (same < mEntries.size() && same < count && mEntries[same].mCommand == mUndoStack->command(same))
+        same++;
+    for (int i = same; i < mEntries.size(); i++)
+        mMemoryUsage -= mEntries[i].mBytes;
+    mEntries.erase(mEntries.begin() + same, mEntries.end());
+
+    // Newly pushed commands are measured once, here.
+    for (int i = same; i < count; i++) {
+        Entry entry;
+        entry.mCommand = mUndoStack->command(i);
+        entry.mBytes = memoryUsage(entry.mCommand);
+        entry.mCompressed = false;
+        mEntries += entry;
+        mMemoryUsage += entry.mBytes;
+    }
+
+    // Every command undone or redone since the last change of index may have
+    // expanded what it was holding; setIndex() can pass over many of them at
+    // once.  A push may also have merged into the command below the new
+    // index, or reused the address of a deleted command.
+    int index = mUndoStack->index();
+    int from = qMax(0, qMin(qMin(mIndex, index) - 1, count));
+    int to = qMin(qMax(mIndex, index), count - 1);
+    for (int i = from; i <= to; i++)
+        remeasure(i);
+    mIndex = index;
+
+    qint64 limit = this->limit();
+    int last = count - KEEP_UNCOMPRESSED;
+    for (int i = 0; i < last && mMemoryUsage > limit; i++) {
+        Entry &entry = mEntries[i];
+        if (entry.mCompressed)
+            continue;
+        compress(entry.mCommand);
+        qint64 bytes = memoryUsage(entry.mCommand);
+        mMemoryUsage += bytes - entry.mBytes;
+        entry.mBytes = bytes;
+        entry.mCompressed = true;
+    }
+
+    emit memoryUsageChanged(mMemoryUsage);
+}
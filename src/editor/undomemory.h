@@ -0,0 +1,139 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UNDOMEMORY_H
+#define UNDOMEMORY_H
+
+#include "InGameMap/ingamemapcell.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QVector>
+
+class WorldCell;
+class WorldCellContents;
+
+class QUndoCommand;
+class QUndoStack;
+
+/**
+  * Undo commands that hold on to a lot of data implement this alongside
+  * QUndoCommand.  Commands that don't are counted as a small fixed size.
+  */
+class UndoCommandMemory
+{
+public:
+    virtual ~UndoCommandMemory() {}
+
+    /**
+      * Approximate number of bytes this command keeps in memory.
+      */
+    virtual qint64 memoryUsage() const = 0;
+
+    /**
+      * Called on old commands when the undo stack is over its memory limit.
+      * The command should compress whatever it is holding and expand it again
+      * the next time it is undone or redone.
+      */
+    virtual void compress() {}
+};
+
+/**
+  * A list of in-game map points that can be zlib-compressed while an undo
+  * command is waiting on the stack.
+  */
+class CompressedCoordinates
+{
+public:
+    CompressedCoordinates();
+    CompressedCoordinates(const InGameMapCoordinates &coords);
+
+    void setCoordinates(const InGameMapCoordinates &coords);
+    InGameMapCoordinates coordinates() const;
+
+    int size() const
+    { return mCount; }
+
+    bool isCompressed() const
+    { return !mCompressed.isEmpty(); }
+
+    void compress();
+
+    qint64 memoryUsage() const;
+
+private:
+    InGameMapCoordinates mCoordinates;
+    QByteArray mCompressed;
+    int mCount;
+};
+
+/**
+  * Keeps track of how much memory the commands on a QUndoStack are using.
+  * One of these is created as a child of each document's undo stack.  When
+  * the total goes over the limit set in the preferences, the oldest
+  * commands are compressed until it is back under the limit.
+  */
+class UndoMemory : public QObject
+{
+    Q_OBJECT
+
+public:
+    UndoMemory(QUndoStack *undoStack);
+
+    static UndoMemory *forStack(QUndoStack *undoStack);
+
+    qint64 memoryUsage() const
+    { return mMemoryUsage; }
+
+    qint64 limit() const;
+
+    static qint64 memoryUsage(const QUndoCommand *command);
+    static qint64 memoryUsage(const InGameMapCoordinates &coords);
+    static qint64 memoryUsage(const InGameMapFeature *feature);
+    static qint64 memoryUsage(WorldCell *cell);
+    static qint64 memoryUsage(const WorldCellContents *contents);
+
+    static QString formatBytes(qint64 bytes);
+
+signals:
+    void memoryUsageChanged(qint64 bytes);
+
+private slots:
+    void indexChanged();
+
+private:
+    static void compress(const QUndoCommand *command);
+    void remeasure(int index);
+
+    /**
+      * The size of each command on the stack is remembered from when it was
+      * pushed, so a change of index only measures the commands that changed.
+      */
+    struct Entry
+    {
+        const QUndoCommand *mCommand;
+        qint64 mBytes;
+        bool mCompressed;
+    };
+
+    QUndoStack *mUndoStack;
+    QVector<Entry> mEntries;
+    int mIndex; // The stack's index at the last indexChanged()
+    qint64 mMemoryUsage;
+};
+
+#endif // UNDOMEMORY_H
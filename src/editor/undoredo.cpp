@@ -1046,6 +1046,22 @@ ResizeWorld::~ResizeWorld()
 #endif
 }
 
+qint64 ResizeWorld::memoryUsage() const
+{
+    // Only the cells outside the world's current bounds are held by this
+    // command, the others are shared with the world.
+    qint64 bytes = mCells.size() * sizeof(WorldCell*);
+    QRect bounds = mDocument->world()->bounds();
+    for (int y = 0; y < mSize.height(); y++) {
+        for (int x = 0; x < mSize.width(); x++) {
+            WorldCell *cell = mCells[x + y * mSize.width()];
+            if (cell && !bounds.contains(x, y))
+                bytes += UndoMemory::memoryUsage(cell);
+        }
+    }
+    return bytes;
+}
+
 void ResizeWorld::swap()
 {
     mWorldSize = mSize;
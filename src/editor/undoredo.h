@@ -18,6 +18,7 @@
 #ifndef UNDOREDO_H
 #define UNDOREDO_H
 
+#include "undomemory.h"
 #include "worldcell.h"
 
 #include <QColor>
@@ -81,7 +82,7 @@ private:
 
 /////
 
-class ReplaceCell : public QUndoCommand
+class ReplaceCell : public QUndoCommand, public UndoCommandMemory
 {
 public:
     ReplaceCell(WorldDocument *doc, WorldCell *cell, WorldCellContents *contents);
@@ -89,6 +90,9 @@ public:
     void undo() { swap(); }
     void redo() { swap(); }
 
+    qint64 memoryUsage() const
+    { return UndoMemory::memoryUsage(mContents); }
+
 private:
     void swap();
 
@@ -1164,7 +1168,7 @@ public:
 
 /////
 
-class ResizeWorld : public QUndoCommand
+class ResizeWorld : public QUndoCommand, public UndoCommandMemory
 {
 public:
     ResizeWorld(WorldDocument *doc, const QSize &newSize);
@@ -1173,6 +1177,8 @@ public:
     void undo() { swap(); }
     void redo() { swap(); }
 
+    qint64 memoryUsage() const;
+
 private:
     void swap();
 
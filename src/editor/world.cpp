@@ -18,6 +18,7 @@
 #include "world.h"
 
 #include "bmptotmx.h" // FIXME: remove from this file
+#include "worldbinary.h"
 #include "worldcell.h"
 
 #include <QStringList>
@@ -27,6 +28,7 @@ World::World(int width, int height)
     , mHeight(height)
     , mNullObjectType(new ObjectType())
     , mNullObjectGroup(new WorldObjectGroup(this))
+    , mCellSource(0)
 {
     mCells.resize(mWidth * mHeight);
 
@@ -51,6 +53,7 @@ World::~World()
     qDeleteAll(mPropertyEnums);
     qDeleteAll(mObjectTypes);
     qDeleteAll(mBMPs);
+    delete mCellSource;
 }
 
 void World::swapCells(QVector<WorldCell *> &cells)
@@ -64,6 +67,13 @@ void World::setSize(const QSize &newSize)
     mHeight = newSize.height();
 }
 
+void World::setCellSource(WorldCellSource *source)
+{
+    if (source != mCellSource)
+        delete mCellSource;
+    mCellSource = source;
+}
+
 PropertyDef *World::removePropertyDefinition(int index)
 {
     return mPropertyDefs.takeAt(index);
@@ -30,6 +30,7 @@ class BMPToTMXImages;
 class WorldObjectGroup;
 class ObjectType;
 class WorldCell;
+class WorldCellSource;
 
 #define MAX_WORLD_LEVELS 8
 
@@ -310,6 +311,13 @@ public:
     WorldObjectGroup *nullObjectGroup() const { return mNullObjectGroup; }
     ObjectType *nullObjectType() const { return mNullObjectType; }
 
+    /**
+      * The .pzwb file that cells not yet loaded read their lots and objects
+      * from.  The World owns it.
+      */
+    void setCellSource(WorldCellSource *source);
+    WorldCellSource *cellSource() const { return mCellSource; }
+
 private:
     int mWidth;
     int mHeight;
@@ -328,6 +336,7 @@ private:
     GenerateLotsSettings mGenerateLotsSettings;
     LuaSettings mLuaSettings;
     QStringList mOtherWorlds;
+    WorldCellSource *mCellSource;
 };
 
 #endif // WORLD_H
@@ -0,0 +1,514 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldbinary.h"
+
+#include "world.h"
+#include "worldcell.h"
+
+#include "InGameMap/ingamemapbinary.h"
+
+#include "compression.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <cstring>
+
+using namespace InGameMapBinary;
+
+namespace {
+
+// Same as WorldReader, so lots get the same paths from either format.
+QString resolveReference(const QString &fileName, const QString &relativeTo)
+{
+    if (fileName.isEmpty())
+        return fileName;
+    if (fileName == QLatin1String("."))
+        return relativeTo;
+    if (QDir::isRelativePath(fileName)) {
+        QString path = relativeTo + QLatin1Char('/') + fileName;
+        QFileInfo info(path);
+        if (info.exists())
+            return info.canonicalFilePath();
+        return QDir::cleanPath(path);
+    }
+    return fileName;
+}
+
+class BlockReader
+{
+public:
+    BlockReader(const QByteArray &data)
+        : mData(data)
+        , mPos(0)
+        , mOk(true)
+    {
+    }
+
+    quint32 varint()
+    {
+        quint32 v = 0;
+        if (mOk && !readVarint(mData, mPos, v))
+            mOk = false;
+        return v;
+    }
+
+    qint32 signedVarint()
+    {
+        return unzigzag(varint());
+    }
+
+    // A count of things that each take at least one byte.
+    int count()
+    {
+        quint32 v = varint();
+        if (v > quint32(mData.size() - mPos))
+            mOk = false;
+        return mOk ? int(v) : 0;
+    }
+
+    int index(int size)
+    {
+        quint32 v = varint();
+        if (v >= quint32(size))
+            mOk = false;
+        return mOk ? int(v) : -1;
+    }
+
+    QString string()
+    {
+        QString s;
+        if (mOk && !WorldBinary::readString(mData, mPos, s))
+            mOk = false;
+        return s;
+    }
+
+    double real()
+    {
+        double v = 0;
+        if (mOk && !WorldBinary::readDouble(mData, mPos, v))
+            mOk = false;
+        return v;
+    }
+
+    bool ok() const { return mOk; }
+
+private:
+    const QByteArray &mData;
+    int mPos;
+    bool mOk;
+};
+
+} // namespace
+
+WorldCellSource::WorldCellSource()
+    : mWidth(0)
+    , mHeight(0)
+    , mDataStart(0)
+{
+}
+
+WorldCellSource::~WorldCellSource()
+{
+}
+
+bool WorldCellSource::open(const QString &fileName, QByteArray *header)
+{
+    QMutexLocker locker(&mMutex);
+    return openLocked(fileName, header);
+}
+
+bool WorldCellSource::openLocked(const QString &fileName, QByteArray *header)
+{
+    mFile.close();
+    mFile.setFileName(fileName);
+    if (!mFile.open(QFile::ReadOnly)) {
+        mError = tr("Unable to read file: %1").arg(fileName);
+        return false;
+    }
+
+    QDataStream in(&mFile);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    quint8 sig[4];
+    in >> sig[0] >> sig[1] >> sig[2] >> sig[3];
+    if (sig[0] != 'P' || sig[1] != 'Z' || sig[2] != 'W' || sig[3] != 'B') {
+        mError = tr("Not a binary world file: %1").arg(fileName);
+        mFile.close();
+        return false;
+    }
+
+    qint32 version, width, height;
+    in >> version >> width >> height;
+    if (version != PZWB_VERSION1) {
+        mError = tr("Unsupported binary world version %1").arg(version);
+        mFile.close();
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width * height > 1000 * 1000) {
+        mError = tr("Invalid world size %1x%2").arg(width).arg(height);
+        mFile.close();
+        return false;
+    }
+
+    auto readCompressed = [&](QByteArray &data) {
+        qint32 size;
+        in >> size;
+        if (in.status() != QDataStream::Ok || size < 0)
+            return false;
+        data.resize(size);
+        if (in.readRawData(data.data(), size) != size)
+            return false;
+        data = Tiled::decompress(data, size * 8);
+        return !data.isNull();
+    };
+
+    QByteArray xml, tables;
+    if (!readCompressed(xml) || !readCompressed(tables)) {
+        mError = tr("Corrupt binary world file: %1").arg(fileName);
+        mFile.close();
+        return false;
+    }
+
+    const QString dir = QFileInfo(fileName).absolutePath();
+    mTables = WorldBinaryTables();
+    BlockReader r(tables);
+    int count = r.count();
+    for (int i = 0; i < count; i++)
+        mTables.mPaths += resolveReference(r.string(), dir);
+    count = r.count();
+    for (int i = 0; i < count; i++)
+        mTables.mGroupNames += r.string();
+    count = r.count();
+    for (int i = 0; i < count; i++)
+        mTables.mTypeNames += r.string();
+    count = r.count();
+    for (int i = 0; i < count; i++)
+        mTables.mPropertyDefNames += r.string();
+    count = r.count();
+    for (int i = 0; i < count; i++)
+        mTables.mTemplateNames += r.string();
+
+    mBlockOffsets.resize(width * height);
+    mBlockSizes.resize(width * height);
+    for (int i = 0; i < width * height; i++)
+        in >> mBlockOffsets[i] >> mBlockSizes[i];
+
+    if (!r.ok() || in.status() != QDataStream::Ok) {
+        mError = tr("Corrupt binary world file: %1").arg(fileName);
+        mFile.close();
+        return false;
+    }
+
+    mDataStart = mFile.pos();
+    for (int i = 0; i < width * height; i++) {
+        if (mDataStart + mBlockOffsets[i] + mBlockSizes[i] > mFile.size()) {
+            mError = tr("Corrupt binary world file: %1").arg(fileName);
+            mFile.close();
+            return false;
+        }
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mFileName = fileName;
+    if (header)
+        *header = xml;
+    return true;
+}
+
+void WorldCellSource::resolveTables(World *world)
+{
+    mTables.mGroups.clear();
+    foreach (const QString &name, mTables.mGroupNames) {
+        WorldObjectGroup *og = world->objectGroups().find(name);
+        mTables.mGroups += og ? og : world->nullObjectGroup();
+    }
+    mTables.mTypes.clear();
+    foreach (const QString &name, mTables.mTypeNames) {
+        ObjectType *ot = world->objectTypes().find(name);
+        mTables.mTypes += ot ? ot : world->nullObjectType();
+    }
+    mTables.mPropertyDefs.clear();
+    foreach (const QString &name, mTables.mPropertyDefNames)
+        mTables.mPropertyDefs += world->propertyDefinitions().findPropertyDef(name);
+    mTables.mTemplates.clear();
+    foreach (const QString &name, mTables.mTemplateNames)
+        mTables.mTemplates += world->propertyTemplates().find(name);
+}
+
+void WorldCellSource::attach(World *world)
+{
+    QMutexLocker locker(&mMutex);
+    resolveTables(world);
+    world->setCellSource(this);
+    for (int i = 0; i < mBlockSizes.size(); i++) {
+        if (mBlockSizes[i] == 0)
+            continue;
+        if (WorldCell *cell = world->cellAt(i % mWidth, i / mWidth))
+            cell->setPendingBlock(i);
+    }
+}
+
+void WorldCellSource::loadCell(WorldCell *cell)
+{
+    QMutexLocker locker(&mMutex);
+
+    // Another thread may have loaded it while this one waited.
+    const int index = cell->pendingBlock();
+    if (index == -1 || cell->isUnreadable())
+        return;
+
+    WorldCellLotList lots;
+    WorldCellObjectList objects;
+    if (!readBlock(index, cell, lots, objects)) {
+        // Leave the cell not loaded, so it is never saved as empty.
+        qWarning() << "Failed to load cell" << cell->x() << cell->y() << mError;
+        qDeleteAll(lots);
+        qDeleteAll(objects);
+        cell->setUnreadable(true);
+        mUnreadableError = mError;
+        return;
+    }
+
+    cell->mLots = lots;
+    cell->mObjects = objects;
+    cell->setPendingBlock(-1);
+}
+
+bool WorldCellSource::readBlock(int index, WorldCell *cell, WorldCellLotList &lots,
+                                WorldCellObjectList &objects)
+{
+    if (!mFile.isOpen() || !mFile.seek(mDataStart + mBlockOffsets[index])) {
+        mError = mFile.errorString();
+        return false;
+    }
+
+    QByteArray block = mFile.read(mBlockSizes[index]);
+    if (block.size() != int(mBlockSizes[index])) {
+        mError = tr("Unexpected end of file");
+        return false;
+    }
+    block = Tiled::decompress(block, block.size() * 4);
+
+    World *world = cell->world();
+    BlockReader r(block);
+
+    int count = r.count();
+    for (int i = 0; i < count && r.ok(); i++) {
+        const int path = r.index(mTables.mPaths.size());
+        const int x = r.signedVarint();
+        const int y = r.signedVarint();
+        const int level = r.signedVarint();
+        const int width = r.signedVarint();
+        const int height = r.signedVarint();
+        if (!r.ok())
+            break;
+        lots += new WorldCellLot(cell, mTables.mPaths[path], x, y, level, width, height);
+    }
+
+    count = r.count();
+    for (int i = 0; i < count && r.ok(); i++) {
+        const QString name = r.string();
+        const int group = r.index(mTables.mGroups.size());
+        const int type = r.index(mTables.mTypes.size());
+        const quint32 geometry = r.varint();
+        const int level = r.signedVarint();
+        const double x = r.real();
+        const double y = r.real();
+        const double width = r.real();
+        const double height = r.real();
+        const bool visible = r.varint() != 0;
+        if (!r.ok() || geometry > quint32(ObjectGeometryType::Polyline))
+            break;
+
+        // The group or type may have been removed since the file was opened.
+        WorldObjectGroup *og = mTables.mGroups[group];
+        if (world->objectGroups().indexOf(og) == -1) {
+            og = world->objectGroups().find(mTables.mGroupNames[group]);
+            if (!og)
+                og = world->nullObjectGroup();
+        }
+        ObjectType *ot = mTables.mTypes[type];
+        if (world->objectTypes().indexOf(ot) == -1) {
+            ot = world->objectTypes().find(mTables.mTypeNames[type]);
+            if (!ot)
+                ot = world->nullObjectType();
+        }
+
+        WorldCellObject *obj = new WorldCellObject(cell, name, ot, og, x, y, level, width, height);
+        obj->setVisible(visible);
+        objects += obj;
+
+        if (geometry != quint32(ObjectGeometryType::INVALID)) {
+            obj->setGeometryType(ObjectGeometryType(geometry));
+            WorldCellObjectPoints points;
+            int pointCount = r.count();
+            int prevX = 0, prevY = 0;
+            for (int j = 0; j < pointCount && r.ok(); j++) {
+                prevX += r.signedVarint();
+                prevY += r.signedVarint();
+                points += { prevX, prevY };
+            }
+            obj->setPoints(points);
+            obj->setPolylineWidth(r.signedVarint());
+        }
+
+        int templateCount = r.count();
+        for (int j = 0; j < templateCount && r.ok(); j++) {
+            const int index = r.index(mTables.mTemplates.size());
+            if (!r.ok())
+                break;
+            PropertyTemplate *pt = mTables.mTemplates[index];
+            if (pt && world->propertyTemplates().indexOf(pt) != -1)
+                obj->addTemplate(obj->templates().size(), pt);
+        }
+
+        int propertyCount = r.count();
+        for (int j = 0; j < propertyCount && r.ok(); j++) {
+            const int index = r.index(mTables.mPropertyDefs.size());
+            const QString value = r.string();
+            if (!r.ok())
+                break;
+            PropertyDef *pd = mTables.mPropertyDefs[index];
+            if (pd && world->propertyDefinitions().indexOf(pd) != -1)
+                obj->addProperty(obj->properties().size(), new Property(pd, value));
+        }
+    }
+
+    if (!r.ok()) {
+        mError = tr("Corrupt cell data");
+        return false;
+    }
+    return true;
+}
+
+bool WorldCellSource::isUnreadable(const WorldCell *cell)
+{
+    QMutexLocker locker(&mMutex);
+    const int index = cell->pendingBlock();
+    if (index == -1)
+        return false;
+    return !mFile.isOpen() || cell->isUnreadable();
+}
+
+bool WorldCellSource::checkReadable(World *world, QString &error)
+{
+    QMutexLocker locker(&mMutex);
+    int count = 0;
+    foreach (WorldCell *cell, world->cells()) {
+        const int index = cell->pendingBlock();
+        if (index != -1 && (!mFile.isOpen() || cell->isUnreadable()))
+            ++count;
+    }
+    if (count == 0)
+        return true;
+    if (!mFile.isOpen()) {
+        error = tr("%1 cells haven't been loaded yet, and %2 can't be read any more.
+
+%3")
+                .arg(count).arg(mFileName).arg(mError);
+    } else {
+        error = tr("%1 cells could not be read from %2.  Saving now would lose their lots and objects.
+
+%3")
+                .arg(count).arg(mFileName).arg(mUnreadableError);
+    }
+    return false;
+}
+
+QByteArray WorldCellSource::rawBlock(int index)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mFile.isOpen() || !mFile.seek(mDataStart + mBlockOffsets[index]))
+        return QByteArray();
+    return mFile.read(mBlockSizes[index]);
+}
+
+bool WorldCellSource::replaceFile(const QString &fileName, World *world,
+                                  const std::function<bool()> &replace)
+{
+    QMutexLocker locker(&mMutex);
+
+    // The old file can't be renamed while it is open on some systems.
+    const QString oldFileName = mFileName;
+    mFile.close();
+
+    const bool replaced = replace();
+    if (!openLocked(replaced ? fileName : oldFileName, nullptr)) {
+        // Cells not loaded yet stay that way and are unreadable, and
+        // checkReadable() stops the world being saved without them.
+        qWarning() << "Failed to reopen world file" << mError;
+        return replaced;
+    }
+    resolveTables(world);
+    foreach (WorldCell *cell, world->cells())
+        cell->setUnreadable(false);
+
+    // The writer copies the block of each cell that still isn't loaded.
+    if (replaced) {
+        foreach (WorldCell *cell, world->cells()) {
+            if (cell->pendingBlock() != -1)
+                cell->setPendingBlock(cell->x() + cell->y() * world->width());
+        }
+    }
+    return replaced;
+}
+
+/////
+
+void WorldBinary::writeString(QByteArray &out, const QString &str)
+{
+    const QByteArray utf8 = str.toUtf8();
+    writeVarint(out, utf8.size());
+    out += utf8;
+}
+
+bool WorldBinary::readString(const QByteArray &in, int &pos, QString &str)
+{
+    quint32 size;
+    if (!readVarint(in, pos, size) || size > quint32(in.size() - pos))
+        return false;
+    str = QString::fromUtf8(in.constData() + pos, int(size));
+    pos += int(size);
+    return true;
+}
+
+void WorldBinary::writeDouble(QByteArray &out, double v)
+{
+    quint64 bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    bits = qToLittleEndian(bits);
+    out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+}
+
+bool WorldBinary::readDouble(const QByteArray &in, int &pos, double &v)
+{
+    quint64 bits;
+    if (pos + int(sizeof(bits)) > in.size())
+        return false;
+    std::memcpy(&bits, in.constData() + pos, sizeof(bits));
+    bits = qFromLittleEndian(bits);
+    std::memcpy(&v, &bits, sizeof(v));
+    pos += sizeof(bits);
+    return true;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDBINARY_H
+#define WORLDBINARY_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+// Shared by WorldWriterBinary, WorldReaderBinary and WorldCell.
+//
+// A .pzwb file is:
+//   'PZWB' version width height
+//   the world as .pzw XML without any lots or objects, zlib-compressed
+//   tables of lot map paths, object groups, object types, property
+//   definitions and templates, which the cell blocks refer to by index
+//   an offset and size for every cell, 0 size for cells with no lots or
+//   objects
+//   the cell blocks, each zlib-compressed on its own
+
+#define PZWB_VERSION1 1
+#define PZWB_VERSION_LATEST PZWB_VERSION1
+
+class ObjectType;
+class PropertyDef;
+class PropertyTemplate;
+class World;
+class WorldCell;
+class WorldCellLotList;
+class WorldCellObjectList;
+class WorldObjectGroup;
+
+/**
+  * The tables of a .pzwb file.  Groups, types, definitions and templates are
+  * kept as pointers, so a renamed group is still found by the cells that
+  * haven't been loaded yet.
+  */
+class WorldBinaryTables
+{
+public:
+    QStringList mPaths; // absolute
+    QList<WorldObjectGroup*> mGroups;
+    QList<ObjectType*> mTypes;
+    QList<PropertyDef*> mPropertyDefs;
+    QList<PropertyTemplate*> mTemplates;
+
+    // The names in the file, for anything removed from the World since.
+    QStringList mGroupNames;
+    QStringList mTypeNames;
+    QStringList mPropertyDefNames;
+    QStringList mTemplateNames;
+};
+
+/**
+  * The open .pzwb file a World was read from.  WorldCell calls loadCell()
+  * the first time its lots or objects are used.  Cells may be loaded from
+  * any thread.
+  */
+class WorldCellSource
+{
+    Q_DECLARE_TR_FUNCTIONS(WorldCellSource)
+
+public:
+    WorldCellSource();
+    ~WorldCellSource();
+
+    /**
+      * Opens \a fileName and reads its tables and cell index.  The world
+      * XML is returned in \a header if it isn't null.
+      */
+    bool open(const QString &fileName, QByteArray *header);
+
+    /**
+      * Looks up the groups, types and property names of the tables in
+      * \a world, and marks every cell with a block in the file as not
+      * loaded.  The World takes ownership of the source.
+      */
+    void attach(World *world);
+
+    /**
+      * Reads the lots and objects of \a cell.  A cell whose block can't be
+      * read stays not loaded, with no lots or objects, and is remembered as
+      * unreadable so it isn't read again.
+      */
+    void loadCell(WorldCell *cell);
+
+    /**
+      * Returns true if \a cell is not loaded and its block couldn't be read,
+      * or the file isn't open any more.
+      */
+    bool isUnreadable(const WorldCell *cell);
+
+    /**
+      * Returns false, with the reason in \a error, if any cell of \a world
+      * that isn't loaded can't be read.  Saving the world then would lose
+      * the contents of those cells.
+      */
+    bool checkReadable(World *world, QString &error);
+
+    /**
+      * Returns the stored bytes of a block, so a writer can copy it as-is.
+      */
+    QByteArray rawBlock(int index);
+
+    /**
+      * The tables of the file.  Only valid until the source is reopened.
+      */
+    const WorldBinaryTables &tables() const { return mTables; }
+
+    /**
+      * Closes the file, calls \a replace, which should put a newly-written
+      * file at \a fileName, and opens the new file instead.  Cells still not
+      * loaded then refer to their block in the new file.  If \a replace
+      * returns false the old file is opened again.
+      */
+    bool replaceFile(const QString &fileName, World *world,
+                     const std::function<bool()> &replace);
+
+    QString fileName() const { return mFileName; }
+    QString errorString() const { return mError; }
+
+private:
+    bool openLocked(const QString &fileName, QByteArray *header);
+    void resolveTables(World *world);
+    bool readBlock(int index, WorldCell *cell, WorldCellLotList &lots,
+                   WorldCellObjectList &objects);
+
+    QMutex mMutex;
+    QFile mFile;
+    QString mFileName;
+    QString mError;
+    int mWidth;
+    int mHeight;
+    qint64 mDataStart;
+    QVector<quint32> mBlockOffsets;
+    QVector<quint32> mBlockSizes;
+    QString mUnreadableError;
+    WorldBinaryTables mTables;
+};
+
+namespace WorldBinary
+{
+
+void writeString(QByteArray &out, const QString &str);
+bool readString(const QByteArray &in, int &pos, QString &str);
+
+void writeDouble(QByteArray &out, double v);
+bool readDouble(const QByteArray &in, int &pos, double &v);
+
+} // namespace WorldBinary
+
+#endif // WORLDBINARY_H
@@ -18,6 +18,7 @@
 #include "worldcell.h"
 
 #include "world.h"
+#include "worldbinary.h"
 
 WorldCellLot::WorldCellLot(WorldCell *cell, const QString &name, int x, int y,
                            int z, int width, int height)
@@ -49,6 +50,8 @@ WorldCell::WorldCell(World *world, int x, int y)
     , mY(y)
     , mWorld(world)
     , mInGameMap(this)
+    , mPendingBlock(-1)
+    , mUnreadable(0)
 {
 }
 
@@ -70,26 +73,39 @@ void WorldCell::setMapFilePath(const QString &path)
 
 void WorldCell::insertLot(int index, WorldCellLot *lot)
 {
+    load();
     mLots.insert(index, lot);
 }
 
 WorldCellLot *WorldCell::removeLot(int index)
 {
+    load();
     return mLots.takeAt(index);
 }
 
 void WorldCell::insertObject(int index, WorldCellObject *obj)
 {
+    load();
     mObjects.insert(index, obj);
 }
 
 WorldCellObject *WorldCell::removeObject(int index)
 {
+    load();
     return mObjects.takeAt(index);
 }
 
+void WorldCell::loadContents() const
+{
+    mWorld->cellSource()->loadCell(const_cast<WorldCell*>(this));
+}
+
 bool WorldCell::isEmpty() const
 {
+    // Only cells with lots or objects have a block, even one that couldn't
+    // be read.
+    if (!isLoaded() || isUnreadable())
+        return false;
     if (!mMapFilePath.isEmpty()
             || !mLots.isEmpty()
             || !mObjects.isEmpty()
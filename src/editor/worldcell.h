@@ -21,6 +21,7 @@
 #include "worldproperties.h"
 #include "InGameMap/ingamemapcell.h"
 
+#include <QAtomicInt>
 #include <QColor>
 #include <QPoint>
 #include <QList>
@@ -414,32 +415,59 @@ public:
 
     void addLot(const QString &name, int x, int y, int z, int width, int height)
     {
+        load();
         mLots.append(new WorldCellLot(this, name, x, y, z, width, height));
     }
 
     void insertLot(int index, WorldCellLot *lot);
     WorldCellLot *removeLot(int index);
-    const WorldCellLotList &lots() const { return mLots; }
-    int indexOf(WorldCellLot *lot) { return mLots.indexOf(lot); }
+    const WorldCellLotList &lots() const { load(); return mLots; }
+    int indexOf(WorldCellLot *lot) { load(); return mLots.indexOf(lot); }
 
     void insertObject(int index, WorldCellObject *obj);
     WorldCellObject *removeObject(int index);
-    const WorldCellObjectList &objects() const { return mObjects; }
-    int indexOf(WorldCellObject *obj) { return mObjects.indexOf(obj); }
+    const WorldCellObjectList &objects() const { load(); return mObjects; }
+    int indexOf(WorldCellObject *obj) { load(); return mObjects.indexOf(obj); }
 
     InGameMapCell& inGameMap() { return mInGameMap; }
 
     bool isEmpty() const;
 
+    /**
+      * The lots and objects of a cell read from a .pzwb file stay in the file
+      * until they are first used.  This is the cell's block in
+      * World::cellSource(), or -1 once they are loaded.
+      */
+    void setPendingBlock(int block) { mPendingBlock.storeRelease(block); }
+    int pendingBlock() const { return mPendingBlock.loadAcquire(); }
+    bool isLoaded() const { return pendingBlock() == -1; }
+
+    /**
+      * A cell whose block couldn't be read stays not loaded, so it is never
+      * saved as empty, and isn't read again until the file is reopened.
+      */
+    void setUnreadable(bool unreadable) { mUnreadable.storeRelease(unreadable); }
+    bool isUnreadable() const { return mUnreadable.loadAcquire() != 0; }
+
 private:
+    void load() const
+    {
+        if (mPendingBlock.loadAcquire() != -1 && !isUnreadable())
+            loadContents();
+    }
+    void loadContents() const;
+
     int mX, mY;
     World *mWorld;
     QString mMapFilePath;
     WorldCellLotList mLots;
     WorldCellObjectList mObjects;
     InGameMapCell mInGameMap;
+    QAtomicInt mPendingBlock;
+    QAtomicInt mUnreadable;
 
     friend class WorldCellContents;
+    friend class WorldCellSource;
 };
 
 /**
@@ -555,5 +583,6 @@ private:
 #include <QMetaType>
 Q_DECLARE_METATYPE(ObjectType*)
 Q_DECLARE_METATYPE(WorldCell*)
+Q_DECLARE_METATYPE(WorldObjectGroup*)
 
 #endif // WORLDCELL_H
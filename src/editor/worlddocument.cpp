@@ -22,8 +22,10 @@
 #include "documentmanager.h"
 #include "luawriter.h"
 #include "mainwindow.h"
+#include "roadlayercache.h"
 #include "undoredo.h"
 #include "world.h"
+#include "worldbinary.h"
 #include "worldcell.h"
 #include "worldscene.h"
 #include "worldview.h"
@@ -44,6 +46,7 @@ WorldDocument::WorldDocument(World *world, const QString &fileName)
     , mUndoRedo(this)
 {
     mUndoStack = new QUndoStack(this);
+    new UndoMemory(mUndoStack);
 
     // Forward all the signals from mUndoRedo to this object's signals
 
@@ -188,6 +191,14 @@ WorldDocument::WorldDocument(World *world, const QString &fileName)
     connect(&mUndoRedo, SIGNAL(roadLinesChanged(int)),
             SIGNAL(roadLinesChanged(int)));
 
+    // Drop the cached road tiles of cells a road crosses when it changes.
+    connect(this, &WorldDocument::roadAdded, this, &WorldDocument::roadChanged);
+    connect(this, &WorldDocument::roadAboutToBeRemoved, this, &WorldDocument::roadChanged);
+    connect(this, &WorldDocument::roadCoordsChanged, this, &WorldDocument::roadChanged);
+    connect(this, &WorldDocument::roadWidthChanged, this, &WorldDocument::roadChanged);
+    connect(this, &WorldDocument::roadTileNameChanged, this, &WorldDocument::roadChanged);
+    connect(this, &WorldDocument::roadLinesChanged, this, &WorldDocument::roadChanged);
+
     connect(&mUndoRedo, &WorldDocumentUndoRedo::selectedCellsChanged,
             this, &WorldDocument::selectedCellsChanged);
 
@@ -211,6 +222,7 @@ WorldDocument::WorldDocument(World *world, const QString &fileName)
 WorldDocument::~WorldDocument()
 {
     delete mUndoStack; // before mWorld is deleted
+    RoadLayerCache::instance()->removeWorld(mWorld);
     delete mWorld;
 }
 
@@ -387,6 +399,15 @@ void WorldDocument::editCell(int x, int y)
         docman->setCurrentDocument(cellDoc);
         return;
     }
+    if (WorldCellSource *source = world()->cellSource()) {
+        cell->lots(); // load it
+        if (source->isUnreadable(cell)) {
+            QMessageBox::warning(MainWindow::instance(), tr("Error loading cell"),
+                                 tr("Cell %1,%2 could not be read from %3, so it can't be edited.\n\n%4")
+                                 .arg(x).arg(y).arg(source->fileName()).arg(source->errorString()));
+            return;
+        }
+    }
     CellDocument *cellDoc = new CellDocument(this, cell);
     docman->addDocument(cellDoc);
 }
@@ -1100,6 +1121,11 @@ void WorldDocument::syncPropertyEnumChoices(PropertyHolder *ph, PropertyDef *pd,
     }
 }
 
+void WorldDocument::roadChanged(int index)
+{
+    RoadLayerCache::instance()->invalidate(mWorld, mWorld->roads().at(index)->bounds());
+}
+
 /////
 
 WorldDocumentUndoRedo::WorldDocumentUndoRedo(WorldDocument *worldDoc)
@@ -1579,7 +1605,7 @@ InGameMapCoordinates WorldDocumentUndoRedo::removeInGameMapHole(WorldCell *cell,
 void WorldDocumentUndoRedo::convertToInGameMapPolygon(WorldCell *cell, int featureIndex)
 {
     InGameMapFeature* feature = cell->inGameMap().mFeatures[featureIndex];
-    feature->mGeometry.mType = QStringLiteral("Polygon");
+    feature->mGeometry.mType = InGameMapGeometry::Type::Polygon;
     emit inGameMapGeometryChanged(cell, featureIndex);
 }
 
@@ -555,6 +555,9 @@ signals:
     void propertyEnumChanged(PropertyEnum *pe);
     void propertyEnumChoicesChanged(PropertyEnum *pe);
 
+private slots:
+    void roadChanged(int index);
+
 private:
     World *mWorld;
     QList<WorldCell*> mSelectedCells;
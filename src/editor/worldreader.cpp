@@ -19,6 +19,7 @@
 
 #include "world.h"
 #include "worldcell.h"
+#include "worldreaderbinary.h"
 
 #include <QCoreApplication>
 #include <QDir>
@@ -51,6 +52,11 @@ public:
         return true;
     }
 
+    void setError(const QString &error)
+    {
+        mError = error;
+    }
+
     QString errorString() const
     {
         if (!mError.isEmpty()) {
@@ -759,6 +765,14 @@ World *WorldReader::readWorld(QIODevice *device, const QString &path)
 
 World *WorldReader::readWorld(const QString &fileName)
 {
+    if (WorldReaderBinary::isBinaryWorld(fileName)) {
+        WorldReaderBinary reader;
+        World *world = reader.readWorld(fileName);
+        if (!world)
+            d->setError(reader.errorString());
+        return world;
+    }
+
     QFile file(fileName);
     if (!d->openFile(&file))
         return 0;
@@ -33,6 +33,10 @@ public:
     ~WorldReader();
 
     World *readWorld(QIODevice *device, const QString &path = QString());
+
+    /**
+      * Reads .pzw XML, or a .pzwb file with WorldReaderBinary.
+      */
     World *readWorld(const QString &fileName);
 
     QString errorString() const;
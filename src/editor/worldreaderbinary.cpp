@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldreaderbinary.h"
+
+#include "world.h"
+#include "worldbinary.h"
+#include "worldreader.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+
+WorldReaderBinary::WorldReaderBinary()
+{
+}
+
+WorldReaderBinary::~WorldReaderBinary()
+{
+}
+
+bool WorldReaderBinary::isBinaryWorld(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    return file.read(4) == QByteArray("PZWB");
+}
+
+World *WorldReaderBinary::readWorld(const QString &fileName)
+{
+    mError.clear();
+
+    WorldCellSource *source = new WorldCellSource;
+    QByteArray header;
+    if (!source->open(fileName, &header)) {
+        mError = source->errorString();
+        delete source;
+        return 0;
+    }
+
+    QBuffer buffer(&header);
+    buffer.open(QIODevice::ReadOnly);
+    WorldReader reader;
+    World *world = reader.readWorld(&buffer, QFileInfo(fileName).absolutePath());
+    if (!world) {
+        mError = reader.errorString();
+        delete source;
+        return 0;
+    }
+
+    source->attach(world);
+    return world;
+}
+
+QString WorldReaderBinary::errorString() const
+{
+    return mError;
+}
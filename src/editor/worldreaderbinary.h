@@ -0,0 +1,49 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDREADERBINARY_H
+#define WORLDREADERBINARY_H
+
+#include <QString>
+
+class World;
+
+/**
+  * Reads files written by WorldWriterBinary.  Only the world settings and
+  * the cell index are read up front; the World keeps the file open and
+  * each cell reads its lots and objects the first time they are used.
+  */
+class WorldReaderBinary
+{
+public:
+    WorldReaderBinary();
+    ~WorldReaderBinary();
+
+    /**
+      * Returns true if \a fileName starts like a .pzwb file.
+      */
+    static bool isBinaryWorld(const QString &fileName);
+
+    World *readWorld(const QString &fileName);
+
+    QString errorString() const;
+
+private:
+    QString mError;
+};
+
+#endif // WORLDREADERBINARY_H
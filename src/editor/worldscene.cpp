@@ -61,6 +61,7 @@ WorldScene::WorldScene(WorldDocument *worldDoc, QObject *parent)
     , mGridItem(new WorldGridItem(this))
     , mCoordItem(new WorldCoordItem(this))
     , mSelectionItem(new WorldSelectionItem(this))
+    , mCellsItem(0)
     , mPasteCellsTool(0)
     , mActiveTool(0)
     , mDragMapImageItem(0)
@@ -85,8 +86,6 @@ WorldScene::WorldScene(WorldDocument *worldDoc, QObject *parent)
     connect(mWorldDoc, &WorldDocument::worldResized,
             this, &WorldScene::worldResized);
 
-    connect(mWorldDoc, &WorldDocument::selectedCellsChanged,
-            this, &WorldScene::selectedCellsChanged);
     connect(mWorldDoc, &WorldDocument::cellMapFileChanged,
             this, &WorldScene::cellMapFileChanged);
     connect(mWorldDoc, &WorldDocument::cellLotAdded,
@@ -137,7 +136,6 @@ WorldScene::WorldScene(WorldDocument *worldDoc, QObject *parent)
             Preferences *prefs = Preferences::instance();
             OtherWorld *_otherWorld = new OtherWorld();
             _otherWorld->mWorld = otherWorld;
-            _otherWorld->mCellItems.resize(otherWorld->width() * otherWorld->height());
             mOtherWorlds += _otherWorld;
 
             foreach (WorldBMP *bmp, otherWorld->bmps()) {
@@ -147,34 +145,22 @@ WorldScene::WorldScene(WorldDocument *worldDoc, QObject *parent)
                 _otherWorld->mBMPItems += item;
             }
 
-            for (int y = 0; y < otherWorld->height(); y++) {
-                for (int x = 0; x < otherWorld->width(); x++) {
-                    WorldCell *cell = otherWorld->cellAt(x, y);
-                    OtherWorldCellItem *item = new OtherWorldCellItem(cell, this);
-                    item->setVisible(prefs->showOtherWorlds());
-                    addItem(item);
-                    item->setZValue(ZVALUE_CELLITEM); // below mGridItem
-                    _otherWorld->mCellItems[y * otherWorld->width() + x] = item;
-                    _otherWorld->mPendingThumbnails += item;
-                }
-            }
+            WorldCellsItem *item = new WorldCellsItem(this, otherWorld);
+            item->setVisible(prefs->showOtherWorlds());
+            addItem(item);
+            item->setZValue(ZVALUE_CELLITEM); // below mGridItem
+            item->queueThumbnails();
+            _otherWorld->mCellsItem = item;
 
             if (prefs->showOtherWorlds())
                 setSceneRect(sceneRect().united(boundingRect(_otherWorld->adjustedBounds(world()))));
         }
     }
 
-    mCellItems.resize(world()->width() * world()->height());
-    for (int y = 0; y < world()->height(); y++) {
-        for (int x = 0; x < world()->width(); x++) {
-            WorldCell *cell = world()->cellAt(x, y);
-            WorldCellItem *item = new WorldCellItem(cell, this);
-            addItem(item);
-            item->setZValue(ZVALUE_CELLITEM); // below mGridItem
-            mCellItems[y * world()->width() + x] = item;
-            mPendingThumbnails += item;
-        }
-    }
+    mCellsItem = new WorldCellsItem(this, world());
+    addItem(mCellsItem);
+    mCellsItem->setZValue(ZVALUE_CELLITEM); // below mGridItem
+    mCellsItem->queueThumbnails();
 
     foreach (Road *road, world()->roads()) {
         WorldRoadItem *item = new WorldRoadItem(this, road);
@@ -226,13 +212,13 @@ WorldScene::WorldScene(WorldDocument *worldDoc, QObject *parent)
         LoadThumbnailsDialog dialog(this, MainWindow::instance());
         dialog.show();
 
-        int numThumbnails = mPendingThumbnails.size();
+        int numThumbnails = mCellsItem->pendingThumbnailCount();
         handlePendingThumbnails();
-        while (mPendingThumbnails.isEmpty() == false) {
+        while (mCellsItem->pendingThumbnailCount() != 0) {
             //TIM BAKER 07032023
             //PROGRESS progress(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mPendingThumbnails.size()).arg(numThumbnails));
             //qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-            dialog.setPrompt(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mPendingThumbnails.size()).arg(numThumbnails));
+            dialog.setPrompt(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mCellsItem->pendingThumbnailCount()).arg(numThumbnails));
             qApp->processEvents(QEventLoop::AllEvents);
         }
     }
@@ -268,21 +254,17 @@ void WorldScene::setTool(AbstractTool *tool)
     if (bmpToolActive != mBMPToolActive) {
         if (bmpToolActive) {
             worldDocument()->setSelectedCells(QList<WorldCell*>());
-            foreach (WorldCellItem *item, mCellItems)
-                item->setVisible(false); //item->setOpacity(0.2);
+            mCellsItem->setVisible(false); //mCellsItem->setOpacity(0.2);
             setShowBMPs(true);
         } else {
             worldDocument()->setSelectedBMPs(QList<WorldBMP*>());
-            foreach (WorldCellItem *item, mCellItems)
-                item->setVisible(true); //item->setOpacity(1.0);
+            mCellsItem->setVisible(true); //mCellsItem->setOpacity(1.0);
             setShowBMPs(Preferences::instance()->showBMPs());
         }
         mBMPToolActive = bmpToolActive;
 
-        foreach (OtherWorld *otherWorld, mOtherWorlds) {
-            foreach (OtherWorldCellItem *item, otherWorld->mCellItems)
-                item->setVisible(Preferences::instance()->showOtherWorlds() && !mBMPToolActive);
-        }
+        foreach (OtherWorld *otherWorld, mOtherWorlds)
+            otherWorld->mCellsItem->setVisible(Preferences::instance()->showOtherWorlds() && !mBMPToolActive);
     }
 }
 
@@ -291,16 +273,9 @@ World *WorldScene::world() const
     return mWorldDoc ? mWorldDoc->world() : 0;
 }
 
-WorldCellItem *WorldScene::itemForCell(WorldCell *cell)
+void WorldScene::setCellVisible(WorldCell *cell, bool visible)
 {
-    return itemForCell(cell->x(), cell->y());
-}
-
-WorldCellItem *WorldScene::itemForCell(int x, int y)
-{
-    if (!world()->contains(x, y))
-        return 0;
-    return mCellItems[y * world()->width() + x];
+    mCellsItem->setCellVisible(cell, visible);
 }
 
 QPoint WorldScene::pixelToRoadCoords(qreal x, qreal y) const
@@ -373,49 +348,19 @@ void WorldScene::pasteCellsFromClipboard()
 
 void WorldScene::cancelLoadingThumbnails()
 {
-    mPendingThumbnails.clear();
+    mCellsItem->cancelThumbnails();
 }
 
 void WorldScene::worldAboutToResize(const QSize &newSize)
 {
-    // Delete items for cells that are getting chopped off.
-    QRect newBounds = QRect(QPoint(0, 0), newSize);
-    for (int x = 0; x < world()->width(); x++)
-        for (int y = 0; y < world()->height(); y++) {
-            if (!newBounds.contains(x, y)) {
-                delete itemForCell(x, y);
-                mCellItems[x + y * world()->width()] = 0;
-            }
-        }
+    mCellsItem->worldAboutToResize(newSize);
 }
 
 void WorldScene::worldResized(const QSize &oldSize)
 {
-    QVector<WorldCellItem*> items(world()->width() * world()->height());
-
-    // Reuse items still in bounds.
-    for (int x = 0; x < qMin(oldSize.width(), world()->width()); x++) {
-        for (int y = 0; y < qMin(oldSize.height(), world()->height()); y++) {
-            WorldCellItem *item = mCellItems[x + y * oldSize.width()];
-            item->worldResized();
-            items[x + y * world()->width()] = item;
-        }
-    }
-
-    // Create new items for new cells.
-    QRect oldBounds = QRect(QPoint(0, 0), oldSize);
-    for (int x = 0; x < world()->width(); x++) {
-        for (int y = 0; y < world()->height(); y++) {
-            if (!oldBounds.contains(x, y)) {
-                WorldCellItem *item = new WorldCellItem(world()->cellAt(x, y), this);
-                item->setZValue(ZVALUE_CELLITEM);
-                items[x + y * world()->width()] = item;
-                addItem(item);
-            }
-        }
-    }
-
-    mCellItems = items;
+    mCellsItem->worldResized(oldSize);
+    foreach (OtherWorld *otherWorld, mOtherWorlds)
+        otherWorld->mCellsItem->worldResized(otherWorld->mWorld->size());
     mGridItem->updateBoundingRect();
     setSceneRect(mGridItem->boundingRect());
     mCoordItem->updateBoundingRect();
@@ -512,66 +457,50 @@ QPolygonF WorldScene::cellRectToPolygon(WorldCell *cell) const
     return cellRectToPolygon(QRect(cell->pos(), QSize(1,1)));
 }
 
-void WorldScene::selectedCellsChanged()
-{
-    foreach (WorldCellItem *item, mSelectedCellItems)
-        item->setSelected(false);
-
-    mSelectedCellItems.clear();
-    foreach (WorldCell *cell, mWorldDoc->selectedCells()) {
-        itemForCell(cell)->setSelected(true);
-        mSelectedCellItems += itemForCell(cell);
-    }
-}
-
 void WorldScene::cellMapFileChanged(WorldCell *cell)
 {
-    itemForCell(cell)->updateCellImage();
-    itemForCell(cell)->updateBoundingRect();
-    itemForCell(cell)->update();
+    mCellsItem->cellContentsChanged(cell);
 }
 
 void WorldScene::cellLotAdded(WorldCell *cell, int index)
 {
-    itemForCell(cell)->lotAdded(index);
-    itemForCell(cell)->update();
+    mCellsItem->lotAdded(cell, index);
 }
 
 void WorldScene::cellLotAboutToBeRemoved(WorldCell *cell, int index)
 {
-    itemForCell(cell)->lotRemoved(index);
-    itemForCell(cell)->update();
+    mCellsItem->lotRemoved(cell, index);
 }
 
 void WorldScene::cellLotMoved(WorldCellLot *lot)
 {
-    itemForCell(lot->cell())->lotMoved(lot);
+    mCellsItem->lotMoved(lot);
 }
 
 void WorldScene::cellContentsChanged(WorldCell *cell)
 {
-    itemForCell(cell)->cellContentsChanged();
+    mCellsItem->cellContentsChanged(cell);
 }
 
 void WorldScene::cellObjectAdded(WorldCell *cell, int objectIndex)
 {
-    itemForCell(cell)->objectPointsChanged(objectIndex);
+    mCellsItem->objectPointsChanged(cell, objectIndex);
 }
 
 void WorldScene::cellObjectAboutToBeRemoved(WorldCell *cell, int objectIndex)
 {
-    itemForCell(cell)->objectPointsChanged(objectIndex);
+    mCellsItem->objectPointsChanged(cell, objectIndex);
 }
 
 void WorldScene::cellObjectPointMoved(WorldCell *cell, int objectIndex, int pointIndex)
 {
     Q_UNUSED(pointIndex)
-    itemForCell(cell)->objectPointsChanged(objectIndex);
+    mCellsItem->objectPointsChanged(cell, objectIndex);
 }
 
 void WorldScene::cellObjectPointsChanged(WorldCell *cell, int objectIndex)
 {
-    itemForCell(cell)->objectPointsChanged(objectIndex);
+    mCellsItem->objectPointsChanged(cell, objectIndex);
 }
 
 void WorldScene::setShowGrid(bool show)
@@ -608,9 +537,7 @@ void WorldScene::setShowOtherWorlds(bool show)
         for (WorldBMPItem *item : otherWorld->mBMPItems) {
             item->setVisible(show && Preferences::instance()->showBMPs());
         }
-        for (OtherWorldCellItem *item : otherWorld->mCellItems) {
-            item->setVisible(show && !mBMPToolActive);
-        }
+        otherWorld->mCellsItem->setVisible(show && !mBMPToolActive);
         if (show) {
             bounds = bounds.united(boundingRect(otherWorld->adjustedBounds(world())));
         }
@@ -787,51 +714,47 @@ WorldBMPItem *WorldScene::itemForBMP(WorldBMP *bmp)
 
 void WorldScene::mapFileCreated(const QString &path)
 {
-    foreach (WorldCellItem *item, mCellItems)
-        item->mapFileCreated(path);
+    mCellsItem->mapFileCreated(path);
 }
 
 void WorldScene::mapImageChanged(MapImage *mapImage)
 {
-    foreach (WorldCellItem *item, mCellItems)
-        item->mapImageChanged(mapImage);
+    mCellsItem->mapImageChanged(mapImage);
+    foreach (OtherWorld *otherWorld, mOtherWorlds)
+        otherWorld->mCellsItem->mapImageChanged(mapImage);
     handlePendingThumbnails();
 }
 
 void WorldScene::worldThumbnailsChanged(bool thumbs)
 {
     foreach (OtherWorld *otherWorld, mOtherWorlds) {
-        otherWorld->mPendingThumbnails.clear();
-        foreach (OtherWorldCellItem *item, otherWorld->mCellItems) {
-            if (thumbs)
-                otherWorld->mPendingThumbnails += item;
-            else
-                item->thumbnailsAreFail();
-        }
+        otherWorld->mCellsItem->cancelThumbnails();
+        if (thumbs)
+            otherWorld->mCellsItem->queueThumbnails();
+        else
+            otherWorld->mCellsItem->thumbnailsAreFail();
     }
 
-    mPendingThumbnails.clear();
+    mCellsItem->cancelThumbnails();
     if (thumbs) {
-        foreach (WorldCellItem *item, mCellItems)
-            mPendingThumbnails += item;
+        mCellsItem->queueThumbnails();
         //TIM BAKER 07032023
         //PROGRESS progress(QStringLiteral("Loading thumbnails"));
         LoadThumbnailsDialog dialog(this, MainWindow::instance());
         dialog.show();
 
-        int numThumbnails = mPendingThumbnails.size();
+        int numThumbnails = mCellsItem->pendingThumbnailCount();
         handlePendingThumbnails();
-        while (mPendingThumbnails.isEmpty() == false) {
+        while (mCellsItem->pendingThumbnailCount() != 0) {
             //TIM BAKER 07032023
             //PROGRESS progress(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mPendingThumbnails.size()).arg(numThumbnails));
             //qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-            dialog.setPrompt(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mPendingThumbnails.size()).arg(numThumbnails));
+            dialog.setPrompt(QStringLiteral("Loading thumbnails %1 / %2").arg(numThumbnails - mCellsItem->pendingThumbnailCount()).arg(numThumbnails));
             qApp->processEvents(QEventLoop::AllEvents);
         }
 
     } else {
-        foreach (WorldCellItem *item, mCellItems)
-            item->thumbnailsAreFail();
+        mCellsItem->thumbnailsAreFail();
     }
 }
 
@@ -840,29 +763,15 @@ void WorldScene::handlePendingThumbnails()
     if (!Preferences::instance()->worldThumbnails())
         return;
 
-    if (mPendingThumbnails.size()) {
-        WorldCellItem *item = mPendingThumbnails.first();
-        WorldCellItem::ThumbnailStatus status = item->thumbnailsAreGo();
-        if (status != WorldCellItem::ThumbnailStatus::Loading) {
-            mPendingThumbnails.takeFirst();
-            if (mPendingThumbnails.size()) {
-                QMetaObject::invokeMethod(this, "handlePendingThumbnails",
-                                          Qt::QueuedConnection);
-            }
-        }
+    if (mCellsItem->loadPendingThumbnail()) {
+        QMetaObject::invokeMethod(this, "handlePendingThumbnails",
+                                  Qt::QueuedConnection);
     }
 
     foreach (OtherWorld *otherWorld, mOtherWorlds) {
-        if (otherWorld->mPendingThumbnails.size()) {
-            OtherWorldCellItem *item = otherWorld->mPendingThumbnails.first();
-            WorldCellItem::ThumbnailStatus status = item->thumbnailsAreGo();
-            if (status != WorldCellItem::ThumbnailStatus::Loading) {
-                otherWorld->mPendingThumbnails.takeFirst();
-                if (otherWorld->mPendingThumbnails.size()) {
-                    QMetaObject::invokeMethod(this, "handlePendingThumbnails",
-                                              Qt::QueuedConnection);
-                }
-            }
+        if (otherWorld->mCellsItem->loadPendingThumbnail()) {
+            QMetaObject::invokeMethod(this, "handlePendingThumbnails",
+                                      Qt::QueuedConnection);
         }
     }
 }
@@ -1034,65 +943,17 @@ static QSize mapSize(int mapWidth, int mapHeight, int tileWidth, int tileHeight)
                  side * tileHeight / 2);
 }
 
-BaseCellItem::BaseCellItem(WorldScene *scene, QGraphicsItem *parent)
-    : QGraphicsItem(parent)
-    , mScene(scene)
+CellImages::CellImages(WorldScene *scene)
+    : mScene(scene)
     , mMapImage(0)
     , mWantsImages(true)
 {
-    setAcceptedMouseButtons(Qt::MouseButton::NoButton);
 #ifndef QT_NO_DEBUG
     mUpdatingImage = false;
 #endif
 }
 
-void BaseCellItem::initialize()
-{
-    updateCellImage();
-
-    for (int i = 0; i < lots().size(); i++)
-        updateLotImage(i);
-
-    updateBoundingRect();
-}
-
-QRectF BaseCellItem::boundingRect() const
-{
-    return mBoundingRect;
-}
-
-QPainterPath BaseCellItem::shape() const
-{
-    QPainterPath path;
-    path.addPolygon(mScene->cellRectToPolygon(QRect(cellPos(), QSize(1, 1))).translated(mDrawOffset));
-    return path;
-}
-
-void BaseCellItem::paint(QPainter *painter,
-                         const QStyleOptionGraphicsItem *option,
-                         QWidget *)
-{
-    Q_UNUSED(option)
-
-    if (mMapImage && mMapImage->isLoaded()) {
-        QRectF target = mMapImageBounds.translated(mDrawOffset);
-        QRectF source = QRect(QPoint(0, 0), mMapImage->image().size());
-        painter->drawImage(target, mMapImage->image(), source);
-    }
-
-    foreach (const LotImage &lotImage, mLotImages) {
-        if (!lotImage.mMapImage || !lotImage.mMapImage->isLoaded()) continue;
-        QRectF target = lotImage.mBounds.translated(mDrawOffset);
-        QRectF source = QRect(QPoint(0, 0), lotImage.mMapImage->image().size());
-        painter->drawImage(target, lotImage.mMapImage->image(), source);
-    }
-
-#ifndef QT_NO_DEBUG
-    painter->drawRect(mBoundingRect);
-#endif
-}
-
-void BaseCellItem::updateCellImage()
+void CellImages::updateCellImage()
 {
     mMapImage = 0;
     mMapImageBounds = QRect();
@@ -1109,11 +970,9 @@ void BaseCellItem::updateCellImage()
             calcMapImageBounds();
         }
     }
-
-    setToolTip(QDir::toNativeSeparators(mapFilePath()));
 }
 
-void BaseCellItem::updateLotImage(int index)
+void CellImages::updateLotImage(int index)
 {
     WorldCellLot *lot = lots().at(index);
     MapImage *mapImage = mWantsImages
@@ -1127,45 +986,36 @@ void BaseCellItem::updateLotImage(int index)
     }
 }
 
-QPointF BaseCellItem::calcLotImagePosition(WorldCellLot *lot, int scaledImageWidth, MapImage *mapImage)
+void CellImages::updateLotImages()
 {
-    if (!mapImage)
-        return QPointF();
-
-    // Assume LevelIsometric
-    QPoint lotPos = lot->pos();
-    lotPos += QPoint(-3, -3) * lot->level();
+    mLotImages.clear();
 
-    const qreal cellX = cellPos().x() + (lotPos.x() / 300.0);
-    const qreal cellY = cellPos().y() + (lotPos.y() / 300.0);
-    QPointF pos = mScene->cellToPixelCoords(cellX, cellY);
+    // Without images there is nothing to keep for each lot, and the lots of
+    // a cell that isn't loaded yet aren't needed.
+    if (!mWantsImages)
+        return;
 
-    const qreal scaleImageToCell = qreal(scaledImageWidth) / mapImage->image().width();
-    pos -= mapImage->tileToImageCoords(0, 0) * scaleImageToCell;
-    return pos;
+    for (int i = 0; i < lots().size(); i++)
+        updateLotImage(i);
 }
 
-void BaseCellItem::updateBoundingRect()
+void CellImages::removeLotImage(int index)
 {
-    QRectF bounds = mScene->boundingRect(cellPos());
-
-    if (!mMapImageBounds.isEmpty())
-        bounds |= mMapImageBounds;
-
-    foreach (LotImage lotImage, mLotImages) {
-        if (!lotImage.mBounds.isEmpty())
-            bounds |= lotImage.mBounds;
-    }
-
-    bounds.adjust(mDrawOffset.x(), mDrawOffset.y(), mDrawOffset.x(), mDrawOffset.y());
+    if (index < mLotImages.size())
+        mLotImages.remove(index);
+}
 
-    if (mBoundingRect != bounds) {
-        prepareGeometryChange();
-        mBoundingRect = bounds;
-    }
+void CellImages::moveLotImage(WorldCellLot *lot)
+{
+    int index = lots().indexOf(lot);
+    if (index < 0 || index >= mLotImages.size())
+        return;
+    LotImage *lotImage = &mLotImages[index];
+    lotImage->mBounds.moveTopLeft(calcLotImagePosition(lot, lotImage->mBounds.width(),
+                                                       lotImage->mMapImage));
 }
 
-void BaseCellItem::mapImageChanged(MapImage *mapImage)
+bool CellImages::mapImageChanged(MapImage *mapImage)
 {
     bool changed = false;
     if (mapImage == mMapImage) {
@@ -1197,21 +1047,66 @@ void BaseCellItem::mapImageChanged(MapImage *mapImage)
         ++index;
     }
 
-    if (changed) {
-        updateBoundingRect();
-        update();
-    }
+    return changed;
 }
 
-void BaseCellItem::worldResized()
+void CellImages::updateImageBounds()
 {
     calcMapImageBounds();
     for (int i = 0; i < mLotImages.size(); i++)
         calcLotImageBounds(i);
-    updateBoundingRect();
 }
 
-void BaseCellItem::calcMapImageBounds()
+QRectF CellImages::imageBounds() const
+{
+    QRectF bounds = mScene->boundingRect(cellPos());
+
+    if (!mMapImageBounds.isEmpty())
+        bounds |= mMapImageBounds;
+
+    foreach (LotImage lotImage, mLotImages) {
+        if (!lotImage.mBounds.isEmpty())
+            bounds |= lotImage.mBounds;
+    }
+
+    return bounds.translated(mDrawOffset);
+}
+
+void CellImages::paintImages(QPainter *painter) const
+{
+    if (mMapImage && mMapImage->isLoaded()) {
+        QRectF target = mMapImageBounds.translated(mDrawOffset);
+        QRectF source = QRect(QPoint(0, 0), mMapImage->image().size());
+        painter->drawImage(target, mMapImage->image(), source);
+    }
+
+    foreach (const LotImage &lotImage, mLotImages) {
+        if (!lotImage.mMapImage || !lotImage.mMapImage->isLoaded()) continue;
+        QRectF target = lotImage.mBounds.translated(mDrawOffset);
+        QRectF source = QRect(QPoint(0, 0), lotImage.mMapImage->image().size());
+        painter->drawImage(target, lotImage.mMapImage->image(), source);
+    }
+}
+
+QPointF CellImages::calcLotImagePosition(WorldCellLot *lot, int scaledImageWidth, MapImage *mapImage)
+{
+    if (!mapImage)
+        return QPointF();
+
+    // Assume LevelIsometric
+    QPoint lotPos = lot->pos();
+    lotPos += QPoint(-3, -3) * lot->level();
+
+    const qreal cellX = cellPos().x() + (lotPos.x() / 300.0);
+    const qreal cellY = cellPos().y() + (lotPos.y() / 300.0);
+    QPointF pos = mScene->cellToPixelCoords(cellX, cellY);
+
+    const qreal scaleImageToCell = qreal(scaledImageWidth) / mapImage->image().width();
+    pos -= mapImage->tileToImageCoords(0, 0) * scaleImageToCell;
+    return pos;
+}
+
+void CellImages::calcMapImageBounds()
 {
     if (mMapImage) {
         int SCL = 2;
@@ -1228,7 +1123,7 @@ void BaseCellItem::calcMapImageBounds()
     }
 }
 
-void BaseCellItem::calcLotImageBounds(int index)
+void CellImages::calcLotImageBounds(int index)
 {
     WorldCellLot *lot = lots().at(index);
     LotImage &lotImage = mLotImages[index];
@@ -1255,16 +1150,76 @@ void BaseCellItem::calcLotImageBounds(int index)
 
 /////
 
-WorldCellItem::WorldCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent)
-    : BaseCellItem(scene, parent)
-    , mCell(cell)
+BaseCellItem::BaseCellItem(WorldScene *scene, QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , CellImages(scene)
 {
-    setAcceptHoverEvents(true);
-    setFlag(ItemIsSelectable);
-    mWantsImages = false;
-    initialize();
+    setAcceptedMouseButtons(Qt::MouseButton::NoButton);
 }
 
+void BaseCellItem::initialize()
+{
+    updateCellImage();
+    updateLotImages();
+    updateBoundingRect();
+}
+
+QRectF BaseCellItem::boundingRect() const
+{
+    return mBoundingRect;
+}
+
+QPainterPath BaseCellItem::shape() const
+{
+    QPainterPath path;
+    path.addPolygon(mScene->cellRectToPolygon(QRect(cellPos(), QSize(1, 1))).translated(mDrawOffset));
+    return path;
+}
+
+void BaseCellItem::paint(QPainter *painter,
+                         const QStyleOptionGraphicsItem *option,
+                         QWidget *)
+{
+    Q_UNUSED(option)
+
+    paintImages(painter);
+
+#ifndef QT_NO_DEBUG
+    painter->drawRect(mBoundingRect);
+#endif
+}
+
+void BaseCellItem::updateCellImage()
+{
+    CellImages::updateCellImage();
+    setToolTip(QDir::toNativeSeparators(mapFilePath()));
+}
+
+void BaseCellItem::updateBoundingRect()
+{
+    QRectF bounds = imageBounds();
+    if (mBoundingRect != bounds) {
+        prepareGeometryChange();
+        mBoundingRect = bounds;
+    }
+}
+
+void BaseCellItem::mapImageChanged(MapImage *mapImage)
+{
+    if (CellImages::mapImageChanged(mapImage)) {
+        updateBoundingRect();
+        update();
+    }
+}
+
+void BaseCellItem::worldResized()
+{
+    updateImageBounds();
+    updateBoundingRect();
+}
+
+/////
+
 #include "worldview.h"
 #include "InGameMap/clipper.hpp"
 
@@ -1297,159 +1252,446 @@ static QPolygonF createPolylineOutline(WorldScene *scene, WorldCellObject *objec
     return result;
 }
 
-void WorldCellItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+static bool showZones()
 {
-    if (Preferences::instance()->showZonesInWorldView() || Preferences::instance()->showZonesWorldInWorldView()) {
-        QPen pen(Qt::black);
-        pen.setCosmetic(((WorldView*) mScene->views().at(0))->zoomable()->scale() >= 1.0);
-        painter->setPen(pen);
+    return Preferences::instance()->showZonesInWorldView() || Preferences::instance()->showZonesWorldInWorldView();
+}
 
-        for (WorldCellObject *object : cell()->objects()) {
-            if (object->group() != nullptr) {
-                QColor color = object->group()->color();
-                color.setAlpha(50);
-                painter->setBrush(QBrush(color));
-                if (object->isRectangle()) {
-                    QPointF p1(cell()->x() + object->x() / 300.0, cell()->y() + object->y() / 300.0);
-                    QPointF p2(cell()->x() + (object->x() + object->width()) / 300.0, cell()->y() + (object->y() + object->height()) / 300.0);
-                    QPolygonF poly = mScene->cellRectToPolygon(QRectF(p1, p2));
-                    painter->drawPolygon(poly);
-                }
-                if (object->isPolygon()) {
-                    QPolygonF poly;
-                    for (WorldCellObjectPoint pt : object->points()) {
-                        poly << mScene->cellToPixelCoords(cell()->x() + pt.x / 300.0, cell()->y() + pt.y / 300.0);
-                    }
-                    painter->drawPolygon(poly);
+static void paintZones(QPainter *painter, WorldScene *scene, WorldCell *cell,
+                       QMap<WorldCellObject*,QPolygonF> &polylineOutlines)
+{
+    for (WorldCellObject *object : cell->objects()) {
+        if (object->group() != nullptr) {
+            QColor color = object->group()->color();
+            color.setAlpha(50);
+            painter->setBrush(QBrush(color));
+            if (object->isRectangle()) {
+                QPointF p1(cell->x() + object->x() / 300.0, cell->y() + object->y() / 300.0);
+                QPointF p2(cell->x() + (object->x() + object->width()) / 300.0, cell->y() + (object->y() + object->height()) / 300.0);
+                QPolygonF poly = scene->cellRectToPolygon(QRectF(p1, p2));
+                painter->drawPolygon(poly);
+            }
+            if (object->isPolygon()) {
+                QPolygonF poly;
+                for (WorldCellObjectPoint pt : object->points()) {
+                    poly << scene->cellToPixelCoords(cell->x() + pt.x / 300.0, cell->y() + pt.y / 300.0);
                 }
-                if (object->isPolyline() && (object->polylineWidth() > 0)) {
-                    if (mPolylineOutlines.contains(object) == false) {
-                        mPolylineOutlines[object] = createPolylineOutline(mScene, object);
-                    }
-                    QPolygonF poly = mPolylineOutlines[object];
-                    painter->drawPolygon(poly);
+                painter->drawPolygon(poly);
+            }
+            if (object->isPolyline() && (object->polylineWidth() > 0)) {
+                if (polylineOutlines.contains(object) == false) {
+                    polylineOutlines[object] = createPolylineOutline(scene, object);
                 }
+                QPolygonF poly = polylineOutlines[object];
+                painter->drawPolygon(poly);
             }
         }
-    } else {
-        BaseCellItem::paint(painter, option, widget);
     }
+}
 
-    if (mHoverRefCount > 0)
+static QPen zonesPen(WorldScene *scene)
+{
+    QPen pen(Qt::black);
+    if (!scene->views().isEmpty())
+        pen.setCosmetic(((WorldView*) scene->views().at(0))->zoomable()->scale() >= 1.0);
+    return pen;
+}
+
+/////
+
+class WorldCellsItem::CellEntry : public CellImages
+{
+public:
+    CellEntry(WorldCellsItem *item, WorldCell *cell)
+        : CellImages(item->mScene)
+        , mItem(item)
+        , mCell(cell)
+        , mVisible(true)
     {
-//        QPen pen(Qt::darkGray);
-//        pen.setWidth(2);
-//        pen.setCosmetic(true);
+        mWantsImages = false;
+        updateCellImage();
+        updateLotImages();
+    }
+
+    QPoint cellPos() const { return mItem->cellOffset() + mCell->pos(); }
+    QString mapFilePath() const { return mCell->mapFilePath(); }
+    const QList<WorldCellLot*> &lots() const { return mCell->lots(); }
+
+    bool wantsImages() const { return mWantsImages; }
+    void setWantsImages(bool wants) { mWantsImages = wants; }
+
+    WorldCellsItem *mItem;
+    WorldCell *mCell;
+    bool mVisible;
+    QMap<WorldCellObject*,QPolygonF> mPolylineOutlines;
+};
+
+WorldCellsItem::WorldCellsItem(WorldScene *scene, World *world)
+    : QGraphicsItem()
+    , mScene(scene)
+    , mWorld(world)
+    , mHoverCell(-1, -1)
+{
+    setFlag(ItemUsesExtendedStyleOption);
+    setAcceptedMouseButtons(Qt::MouseButton::NoButton);
+    setAcceptHoverEvents(true);
+
+    mCells.resize(mWorld->width() * mWorld->height());
+    for (int y = 0; y < mWorld->height(); y++) {
+        for (int x = 0; x < mWorld->width(); x++) {
+            CellEntry *entry = new CellEntry(this, mWorld->cellAt(x, y));
+            mCells[x + y * mWorld->width()] = entry;
+            addDrawMargins(entry);
+        }
+    }
+    updateBoundingRect();
+}
+
+WorldCellsItem::~WorldCellsItem()
+{
+    qDeleteAll(mCells);
+}
+
+QRectF WorldCellsItem::boundingRect() const
+{
+    return mBoundingRect;
+}
+
+void WorldCellsItem::paint(QPainter *painter,
+                           const QStyleOptionGraphicsItem *option,
+                           QWidget *)
+{
+    const QRectF exposed = option->exposedRect;
+    const QRect cells = cellsInRect(exposed.marginsAdded(mDrawMargins));
+
+    // Other worlds only show their thumbnails.
+    const bool zones = showZones() && (mWorld == mScene->world());
+    if (zones)
+        painter->setPen(zonesPen(mScene));
+
+    // Same order the cell items were added to the scene in.
+    for (int y = cells.top(); y <= cells.bottom(); y++) {
+        for (int x = cells.left(); x <= cells.right(); x++) {
+            CellEntry *entry = mCells[x + y * mWorld->width()];
+            if (!entry->mVisible)
+                continue;
+            if (zones) {
+                if (mScene->boundingRect(entry->cellPos()).intersects(exposed))
+                    paintZones(painter, mScene, entry->mCell, entry->mPolylineOutlines);
+            } else if (entry->imageBounds().intersects(exposed)) {
+                entry->paintImages(painter);
+            }
+        }
+    }
+
+    if (mWorld->contains(mHoverCell)) {
         // Use no pen to avoid clipping by adjacent cells to the south/east.
         painter->setPen(Qt::NoPen);
         QColor color = QColor(Qt::darkGray).lighter();
         color.setAlpha(50);
         painter->setBrush(QBrush(color));
-        QPolygonF poly = mScene->cellRectToPolygon(cell());
+        QPolygonF poly = mScene->cellRectToPolygon(QRect(cellOffset() + mHoverCell, QSize(1, 1)));
         painter->drawPolygon(poly);
     }
 }
 
-void WorldCellItem::lotAdded(int index)
+QPoint WorldCellsItem::cellOffset() const
 {
-    updateLotImage(index);
-    updateBoundingRect();
+    if (mWorld == mScene->world())
+        return QPoint();
+    return mWorld->getGenerateLotsSettings().worldOrigin
+            - mScene->world()->getGenerateLotsSettings().worldOrigin;
 }
 
-void WorldCellItem::lotRemoved(int index)
+void WorldCellsItem::setCellVisible(WorldCell *cell, bool visible)
 {
-    mLotImages.remove(index);
-    updateBoundingRect();
+    if (CellEntry *entry = this->entry(cell)) {
+        if (entry->mVisible != visible) {
+            entry->mVisible = visible;
+            update(entry->imageBounds());
+        }
+    }
 }
 
-void WorldCellItem::lotMoved(WorldCellLot *lot)
+void WorldCellsItem::cellContentsChanged(WorldCell *cell)
 {
-    int index = mCell->lots().indexOf(lot);
-    LotImage *lotImage = &mLotImages[index];
-    lotImage->mBounds.moveTopLeft(calcLotImagePosition(lot, lotImage->mBounds.width(),
-                                                       lotImage->mMapImage));
-    updateBoundingRect();
-    update();
+    if (CellEntry *entry = this->entry(cell))
+        updateContents(entry);
 }
 
-void WorldCellItem::cellContentsChanged()
+void WorldCellsItem::lotAdded(WorldCell *cell, int index)
 {
-    updateCellImage();
-    mLotImages.clear();
-    for (int i = 0; i < mCell->lots().size(); i++)
-        updateLotImage(i);
-    updateBoundingRect();
+    CellEntry *entry = this->entry(cell);
+    if (!entry || !entry->wantsImages())
+        return;
+    const QRectF oldBounds = entry->imageBounds();
+    entry->updateLotImage(index);
+    cellChanged(entry, oldBounds);
 }
 
-void WorldCellItem::objectPointsChanged(int index)
+void WorldCellsItem::lotRemoved(WorldCell *cell, int index)
 {
-    WorldCellObject *object = cell()->objects().value(index);
-    mPolylineOutlines.remove(object);
-    if (Preferences::instance()->showZonesInWorldView() || Preferences::instance()->showZonesWorldInWorldView()) {
-        update();
-    }
+    CellEntry *entry = this->entry(cell);
+    if (!entry)
+        return;
+    const QRectF oldBounds = entry->imageBounds();
+    entry->removeLotImage(index);
+    cellChanged(entry, oldBounds);
 }
 
-void WorldCellItem::mapFileCreated(const QString &path)
+void WorldCellsItem::lotMoved(WorldCellLot *lot)
 {
-    // If BMPtoTMX creates our cell's .tmx file and that .tmx file didn't exist
-    // before, we need to create the cell/lot images.
-    if (mapFilePath().isEmpty() || mMapImage)
+    CellEntry *entry = this->entry(lot->cell());
+    if (!entry)
         return;
-    if (QFileInfo(path) == QFileInfo(mapFilePath()))
-        cellContentsChanged();
+    const QRectF oldBounds = entry->imageBounds();
+    entry->moveLotImage(lot);
+    cellChanged(entry, oldBounds);
 }
 
-WorldCellItem::ThumbnailStatus WorldCellItem::thumbnailsAreGo()
+void WorldCellsItem::objectPointsChanged(WorldCell *cell, int index)
 {
-    if (mMapImage && mMapImage->isLoaded())
-        return ThumbnailStatus::Loaded;
-    mWantsImages = true;
-    cellContentsChanged();
-    if (mMapImage && mMapImage->isLoaded())
-        return ThumbnailStatus::Loaded;
-    return (mMapImage != nullptr) ? ThumbnailStatus::Loading : ThumbnailStatus::Missing;
+    CellEntry *entry = this->entry(cell);
+    if (!entry)
+        return;
+    WorldCellObject *object = cell->objects().value(index);
+    entry->mPolylineOutlines.remove(object);
+    if (showZones())
+        update(mScene->boundingRect(entry->cellPos()));
 }
 
-void WorldCellItem::thumbnailsAreFail()
+void WorldCellsItem::mapFileCreated(const QString &path)
 {
-    if (mWantsImages) {
-        mWantsImages = false;
-        cellContentsChanged();
+    // If BMPtoTMX creates a cell's .tmx file and that .tmx file didn't exist
+    // before, we need to create the cell/lot images.
+    const QFileInfo info(path);
+    foreach (CellEntry *entry, mCells) {
+        if (entry->mapFilePath().isEmpty() || entry->mapImage())
+            continue;
+        if (info == QFileInfo(entry->mapFilePath()))
+            updateContents(entry);
     }
 }
 
-void WorldCellItem::hoverEnterEvent(QGraphicsSceneHoverEvent *event)
+void WorldCellsItem::mapImageChanged(MapImage *mapImage)
 {
-    Q_UNUSED(event)
-    if (++mHoverRefCount == 1)
-    {
-        update();
+    foreach (CellEntry *entry, mCells) {
+        const QRectF oldBounds = entry->imageBounds();
+        if (entry->mapImageChanged(mapImage))
+            cellChanged(entry, oldBounds);
+    }
+}
+
+void WorldCellsItem::worldAboutToResize(const QSize &newSize)
+{
+    // Forget cells that are getting chopped off.
+    QRect newBounds = QRect(QPoint(0, 0), newSize);
+    for (int x = 0; x < mWorld->width(); x++) {
+        for (int y = 0; y < mWorld->height(); y++) {
+            if (!newBounds.contains(x, y)) {
+                CellEntry *&entry = mCells[x + y * mWorld->width()];
+                mPendingThumbnails.removeAll(entry);
+                delete entry;
+                entry = 0;
+            }
+        }
+    }
+    mHoverCell = QPoint(-1, -1);
+}
+
+void WorldCellsItem::worldResized(const QSize &oldSize)
+{
+    QVector<CellEntry*> cells(mWorld->width() * mWorld->height());
+
+    // Reuse entries still in bounds.  Every cell moves in the scene.
+    mDrawMargins = QMarginsF();
+    for (int x = 0; x < qMin(oldSize.width(), mWorld->width()); x++) {
+        for (int y = 0; y < qMin(oldSize.height(), mWorld->height()); y++) {
+            CellEntry *entry = mCells[x + y * oldSize.width()];
+            entry->updateImageBounds();
+            cells[x + y * mWorld->width()] = entry;
+            addDrawMargins(entry);
+        }
+    }
+
+    // Create entries for new cells.
+    QRect oldBounds = QRect(QPoint(0, 0), oldSize);
+    for (int x = 0; x < mWorld->width(); x++) {
+        for (int y = 0; y < mWorld->height(); y++) {
+            if (!oldBounds.contains(x, y)) {
+                CellEntry *entry = new CellEntry(this, mWorld->cellAt(x, y));
+                cells[x + y * mWorld->width()] = entry;
+                addDrawMargins(entry);
+            }
+        }
+    }
+
+    mCells = cells;
+    updateBoundingRect();
+    update();
+}
+
+void WorldCellsItem::queueThumbnails()
+{
+    mPendingThumbnails.clear();
+    foreach (CellEntry *entry, mCells)
+        mPendingThumbnails += entry;
+}
+
+void WorldCellsItem::cancelThumbnails()
+{
+    mPendingThumbnails.clear();
+}
+
+bool WorldCellsItem::loadPendingThumbnail()
+{
+    if (mPendingThumbnails.isEmpty())
+        return false;
+
+    CellEntry *entry = mPendingThumbnails.first();
+    ThumbnailStatus status;
+    if (entry->mapImage() && entry->mapImage()->isLoaded()) {
+        status = ThumbnailStatus::Loaded;
+    } else {
+        entry->setWantsImages(true);
+        updateContents(entry);
+        if (entry->mapImage() && entry->mapImage()->isLoaded())
+            status = ThumbnailStatus::Loaded;
+        else
+            status = entry->mapImage() ? ThumbnailStatus::Loading : ThumbnailStatus::Missing;
     }
+
+    // A loading image calls WorldScene::handlePendingThumbnails() when done.
+    if (status == ThumbnailStatus::Loading)
+        return false;
+    mPendingThumbnails.takeFirst();
+    return !mPendingThumbnails.isEmpty();
 }
 
-void WorldCellItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event)
+void WorldCellsItem::thumbnailsAreFail()
+{
+    foreach (CellEntry *entry, mCells) {
+        if (entry->wantsImages()) {
+            entry->setWantsImages(false);
+            updateContents(entry);
+        }
+    }
+}
+
+void WorldCellsItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event)
+{
+    QPoint pos = mScene->pixelToCellCoordsInt(event->scenePos()) - cellOffset();
+    CellEntry *entry = mWorld->contains(pos) ? mCells[pos.x() + pos.y() * mWorld->width()] : 0;
+    if (!entry || !entry->mVisible) {
+        entry = 0;
+        pos = QPoint(-1, -1);
+    }
+
+    setToolTip(entry ? QDir::toNativeSeparators(entry->mapFilePath()) : QString());
+
+    // Only the scene's own cells are highlighted.
+    if (mWorld == mScene->world())
+        setHoverCell(pos);
+}
+
+void WorldCellsItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event)
 {
     Q_UNUSED(event)
-    Q_ASSERT(mHoverRefCount > 0);
-    if (--mHoverRefCount == 0)
-    {
-        update();
+    setHoverCell(QPoint(-1, -1));
+}
+
+WorldCellsItem::CellEntry *WorldCellsItem::entry(WorldCell *cell) const
+{
+    if (!cell || cell->world() != mWorld || !mWorld->contains(cell->pos()))
+        return 0;
+    return mCells[cell->x() + cell->y() * mWorld->width()];
+}
+
+QRect WorldCellsItem::cellsInRect(const QRectF &rect) const
+{
+    // The corners of the rectangle give the furthest cells in each direction.
+    const QPoint offset = cellOffset();
+    const int startX = qMax(0, qFloor(mScene->pixelToCellCoords(rect.topLeft()).x()) - offset.x());
+    const int startY = qMax(0, qFloor(mScene->pixelToCellCoords(rect.topRight()).y()) - offset.y());
+    const int endX = qMin(mWorld->width() - 1,
+                          qFloor(mScene->pixelToCellCoords(rect.bottomRight()).x()) - offset.x());
+    const int endY = qMin(mWorld->height() - 1,
+                          qFloor(mScene->pixelToCellCoords(rect.bottomLeft()).y()) - offset.y());
+    return QRect(QPoint(startX, startY), QPoint(endX, endY));
+}
+
+void WorldCellsItem::updateContents(CellEntry *entry)
+{
+    const QRectF oldBounds = entry->imageBounds();
+    entry->updateCellImage();
+    entry->updateLotImages();
+    entry->mPolylineOutlines.clear();
+    cellChanged(entry, oldBounds);
+}
+
+void WorldCellsItem::cellChanged(CellEntry *entry, const QRectF &oldBounds)
+{
+    const QMarginsF oldMargins = mDrawMargins;
+    addDrawMargins(entry);
+    if (mDrawMargins != oldMargins)
+        updateBoundingRect();
+    update(oldBounds);
+    update(entry->imageBounds());
+}
+
+void WorldCellsItem::addDrawMargins(CellEntry *entry)
+{
+    // The margins only grow, until the World is resized.
+    const QRectF cell = mScene->boundingRect(entry->cellPos());
+    const QRectF bounds = entry->imageBounds();
+    mDrawMargins = QMarginsF(qMax(mDrawMargins.left(), cell.left() - bounds.left()),
+                             qMax(mDrawMargins.top(), cell.top() - bounds.top()),
+                             qMax(mDrawMargins.right(), bounds.right() - cell.right()),
+                             qMax(mDrawMargins.bottom(), bounds.bottom() - cell.bottom()));
+}
+
+void WorldCellsItem::updateBoundingRect()
+{
+    QRectF bounds = mScene->boundingRect(QRect(cellOffset(), mWorld->size()));
+    bounds = bounds.marginsAdded(mDrawMargins);
+    if (bounds != mBoundingRect) {
+        prepareGeometryChange();
+        mBoundingRect = bounds;
     }
 }
 
+void WorldCellsItem::setHoverCell(const QPoint &pos)
+{
+    if (pos == mHoverCell)
+        return;
+    if (mWorld->contains(mHoverCell))
+        update(mScene->boundingRect(cellOffset() + mHoverCell));
+    mHoverCell = pos;
+    if (mWorld->contains(mHoverCell))
+        update(mScene->boundingRect(cellOffset() + mHoverCell));
+}
+
 /////
 
 DragCellItem::DragCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent)
-    : WorldCellItem(cell, scene, parent)
+    : BaseCellItem(scene, parent)
+    , mCell(cell)
 {
     mWantsImages = Preferences::instance()->worldThumbnails();
-    initialize(); // again?!?!?!?!
+    initialize();
 }
 
 void DragCellItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    WorldCellItem::paint(painter, option, widget);
+    if (showZones()) {
+        painter->save();
+        painter->translate(mDrawOffset);
+        painter->setPen(zonesPen(mScene));
+        paintZones(painter, mScene, mCell, mPolylineOutlines);
+        painter->restore();
+    } else {
+        BaseCellItem::paint(painter, option, widget);
+    }
 
     QPen pen(Qt::blue);
 //    pen.setWidth(2);
@@ -1542,48 +1784,6 @@ QPoint DragMapImageItem::dropPos() const
 
 /////
 
-OtherWorldCellItem::OtherWorldCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent)
-    : BaseCellItem(scene, parent)
-    , mCell(cell)
-{
-//    setFlag(ItemIsSelectable);
-    mWantsImages = false;
-    initialize();
-}
-
-QPoint OtherWorldCellItem::cellPos() const
-{
-     return mCell->world()->getGenerateLotsSettings().worldOrigin - mScene->world()->getGenerateLotsSettings().worldOrigin + mCell->pos();
-}
-
-void OtherWorldCellItem::cellContentsChanged()
-{
-    updateCellImage();
-    mLotImages.clear();
-    for (int i = 0; i < mCell->lots().size(); i++)
-        updateLotImage(i);
-    updateBoundingRect();
-}
-
-WorldCellItem::ThumbnailStatus OtherWorldCellItem::thumbnailsAreGo()
-{
-    if (mMapImage && mMapImage->isLoaded())
-        return WorldCellItem::ThumbnailStatus::Loaded;
-    mWantsImages = true;
-    cellContentsChanged();
-    if (mMapImage && mMapImage->isLoaded())
-        return WorldCellItem::ThumbnailStatus::Loaded;
-    return (mMapImage != nullptr) ? WorldCellItem::ThumbnailStatus::Loading : WorldCellItem::ThumbnailStatus::Missing;
-}
-
-void OtherWorldCellItem::thumbnailsAreFail()
-{
-    if (mWantsImages) {
-        mWantsImages = false;
-        cellContentsChanged();
-    }
-}
-
 ///// ///// ///// ///// /////
 
 WorldGridItem::WorldGridItem(WorldScene *scene)
@@ -1663,7 +1863,7 @@ void WorldCoordItem::paint(QPainter *painter,
                      const QStyleOptionGraphicsItem *option,
                      QWidget *)
 {
-    if (!mScene->world())
+    if (!mScene->world() || !mScene->worldDocument()->view())
         return;
 
     if (mScene->worldDocument()->view()->zoomable()->scale() < 0.25) return;
@@ -23,6 +23,8 @@
 #include "worldcell.h"
 
 #include <QGraphicsItem>
+#include <QMap>
+#include <QMargins>
 #include <QPair>
 #include <QPolygonF>
 
@@ -112,24 +114,14 @@ private:
 };
 
 /**
-  * Base item for drawing a single cell's map and Lots.
+  * The map image and Lot images of a single cell, positioned in the scene.
+  * The images are only looked up when mWantsImages is true.
   */
-class BaseCellItem : public QGraphicsItem
+class CellImages
 {
 public:
-    BaseCellItem(WorldScene *scene, QGraphicsItem *parent = 0);
-
-    // Ugliness to work around not being allowed to call pure-virtual methods
-    // from the constructor.
-    void initialize();
-
-    QRectF boundingRect() const;
-
-    QPainterPath shape() const;
-
-    void paint(QPainter *painter,
-               const QStyleOptionGraphicsItem *option,
-               QWidget *widget = 0);
+    CellImages(WorldScene *scene);
+    virtual ~CellImages() {}
 
     virtual QPoint cellPos() const = 0;
     virtual QString mapFilePath() const = 0;
@@ -137,11 +129,29 @@ public:
 
     void updateCellImage();
     void updateLotImage(int index);
-    void updateBoundingRect();
+    void updateLotImages();
+    void removeLotImage(int index);
+    void moveLotImage(WorldCellLot *lot);
 
-    void mapImageChanged(MapImage *mapImage);
+    /**
+      * Recalculates the bounds of any image using \a mapImage.  Returns true
+      * if there were any.
+      */
+    bool mapImageChanged(MapImage *mapImage);
 
-    void worldResized();
+    /**
+      * Recalculates the bounds of every image after the World was resized.
+      */
+    void updateImageBounds();
+
+    /**
+      * The cell's bounds joined with the bounds of its images.
+      */
+    QRectF imageBounds() const;
+
+    void paintImages(QPainter *painter) const;
+
+    MapImage *mapImage() const { return mMapImage; }
 
 protected:
     void calcMapImageBounds();
@@ -165,7 +175,6 @@ protected:
     };
 
     WorldScene *mScene;
-    QRectF mBoundingRect;
     MapImage *mMapImage;
     QRectF mMapImageBounds;
     QVector<LotImage> mLotImages;
@@ -177,28 +186,49 @@ protected:
 };
 
 /**
-  * There is one of these for each cell in the world.
+  * Base item for drawing a single cell's map and Lots.
   */
-class WorldCellItem : public BaseCellItem
+class BaseCellItem : public QGraphicsItem, public CellImages
 {
 public:
-    WorldCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent = nullptr);
+    BaseCellItem(WorldScene *scene, QGraphicsItem *parent = 0);
+
+    // Ugliness to work around not being allowed to call pure-virtual methods
+    // from the constructor.
+    void initialize();
 
-    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+    QRectF boundingRect() const;
 
-    QPoint cellPos() const override { return mCell->pos(); }
-    QString mapFilePath() const override { return mCell->mapFilePath(); }
-    const QList<WorldCellLot*> &lots() const override { return mCell->lots(); }
+    QPainterPath shape() const;
 
-    WorldCell *cell() const { return mCell; }
+    void paint(QPainter *painter,
+               const QStyleOptionGraphicsItem *option,
+               QWidget *widget = 0);
 
-    void lotAdded(int index);
-    void lotRemoved(int index);
-    void lotMoved(WorldCellLot *lot);
-    void cellContentsChanged();
-    void objectPointsChanged(int index);
-    void mapFileCreated(const QString &path);
+    void updateCellImage();
+    void updateBoundingRect();
+
+    void mapImageChanged(MapImage *mapImage);
+
+    void worldResized();
 
+protected:
+    QRectF mBoundingRect;
+};
+
+/**
+  * Draws every cell of a World: the map and Lot thumbnails, or the zones when
+  * those are shown, and the cell under the mouse.  The scene has one of these
+  * for its World and one for each OtherWorld instead of an item for every
+  * cell, so the scene's index doesn't grow with the size of the world.
+  *
+  * The isometric grid gives the cells under any rectangle directly.  Images
+  * may reach outside their cell, so the draw margins are the furthest any
+  * cell's images reach, and painting looks that much further for cells.
+  */
+class WorldCellsItem : public QGraphicsItem
+{
+public:
     enum struct ThumbnailStatus
     {
         Missing,
@@ -206,22 +236,78 @@ public:
         Loaded
     };
 
-    ThumbnailStatus thumbnailsAreGo();
-    void thumbnailsAreFail();
+    WorldCellsItem(WorldScene *scene, World *world);
+    ~WorldCellsItem();
 
-    void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
-    void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
+    QRectF boundingRect() const;
+
+    void paint(QPainter *painter,
+               const QStyleOptionGraphicsItem *option,
+               QWidget *widget = 0);
+
+    World *world() const { return mWorld; }
+
+    /**
+      * Where this item's World is relative to the scene's World, in cells.
+      */
+    QPoint cellOffset() const;
+
+    /**
+      * Hides a cell while it is being dragged.
+      */
+    void setCellVisible(WorldCell *cell, bool visible);
+
+    void cellContentsChanged(WorldCell *cell);
+    void lotAdded(WorldCell *cell, int index);
+    void lotRemoved(WorldCell *cell, int index);
+    void lotMoved(WorldCellLot *lot);
+    void objectPointsChanged(WorldCell *cell, int index);
+    void mapFileCreated(const QString &path);
+    void mapImageChanged(MapImage *mapImage);
+
+    void worldAboutToResize(const QSize &newSize);
+    void worldResized(const QSize &oldSize);
+
+    void queueThumbnails();
+    void cancelThumbnails();
+    int pendingThumbnailCount() const { return mPendingThumbnails.size(); }
+
+    /**
+      * Starts loading the thumbnails of the first queued cell.  Returns true
+      * if that cell is done and there are more cells queued.
+      */
+    bool loadPendingThumbnail();
+
+    void thumbnailsAreFail();
 
 protected:
-    WorldCell *mCell;
-    int mHoverRefCount = 0;
-    QMap<WorldCellObject*,QPolygonF> mPolylineOutlines;
+    void hoverMoveEvent(QGraphicsSceneHoverEvent *event);
+    void hoverLeaveEvent(QGraphicsSceneHoverEvent *event);
+
+private:
+    class CellEntry;
+
+    CellEntry *entry(WorldCell *cell) const;
+    QRect cellsInRect(const QRectF &rect) const;
+    void updateContents(CellEntry *entry);
+    void cellChanged(CellEntry *entry, const QRectF &oldBounds);
+    void addDrawMargins(CellEntry *entry);
+    void updateBoundingRect();
+    void setHoverCell(const QPoint &pos);
+
+    WorldScene *mScene;
+    World *mWorld;
+    QVector<CellEntry*> mCells;
+    QList<CellEntry*> mPendingThumbnails;
+    QRectF mBoundingRect;
+    QMarginsF mDrawMargins;
+    QPoint mHoverCell;
 };
 
 /**
   * This item is used when dragging cells to a new location.
   */
-class DragCellItem : public WorldCellItem
+class DragCellItem : public BaseCellItem
 {
 public:
     DragCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent = 0);
@@ -230,7 +316,17 @@ public:
                const QStyleOptionGraphicsItem *option,
                QWidget *widget = 0);
 
+    QPoint cellPos() const { return mCell->pos(); }
+    QString mapFilePath() const { return mCell->mapFilePath(); }
+    const QList<WorldCellLot*> &lots() const { return mCell->lots(); }
+
+    WorldCell *cell() const { return mCell; }
+
     void setDragOffset(const QPointF &offset);
+
+private:
+    WorldCell *mCell;
+    QMap<WorldCellObject*,QPolygonF> mPolylineOutlines;
 };
 
 /**
@@ -387,28 +483,6 @@ private:
     QRectF mMapImageBounds;
 };
 
-/**
- * This item displays a cell from an external World (a different PZW file).
- */
-class OtherWorldCellItem : public BaseCellItem
-{
-public:
-    OtherWorldCellItem(WorldCell *cell, WorldScene *scene, QGraphicsItem *parent = 0);
-
-    QPoint cellPos() const;
-    QString mapFilePath() const { return mCell->mapFilePath(); }
-    const QList<WorldCellLot*> &lots() const { return mCell->lots(); }
-
-    WorldCell *cell() const { return mCell; }
-
-    void cellContentsChanged();
-    WorldCellItem::ThumbnailStatus thumbnailsAreGo();
-    void thumbnailsAreFail();
-
-protected:
-    WorldCell *mCell;
-};
-
 class OtherWorld
 {
 public:
@@ -418,8 +492,7 @@ public:
 
     World *mWorld;
     QList<WorldBMPItem*> mBMPItems;
-    QVector<OtherWorldCellItem*> mCellItems;
-    QList<OtherWorldCellItem*> mPendingThumbnails;
+    WorldCellsItem *mCellsItem;
 };
 
 class WorldScene : public BaseGraphicsScene
@@ -464,8 +537,8 @@ public:
     WorldDocument *worldDocument() const { return mWorldDoc; }
 
     World *world() const;
-    WorldCellItem *itemForCell(WorldCell *cell);
-    WorldCellItem *itemForCell(int x, int y);
+    WorldCellsItem *cellsItem() const { return mCellsItem; }
+    void setCellVisible(WorldCell *cell, bool visible);
 
     QPoint pixelToRoadCoords(qreal x, qreal y) const;
 
@@ -496,7 +569,6 @@ public slots:
 
     void generateLotsSettingsChanged();
 
-    void selectedCellsChanged();
     void cellMapFileChanged(WorldCell *cell);
     void cellLotAdded(WorldCell *cell, int index);
     void cellLotAboutToBeRemoved(WorldCell *cell, int index);
@@ -552,9 +624,7 @@ private:
     WorldGridItem *mGridItem;
     WorldCoordItem *mCoordItem;
     WorldSelectionItem *mSelectionItem;
-    QVector<WorldCellItem*> mSelectedCellItems;
-    QVector<WorldCellItem*> mCellItems;
-    QList<WorldCellItem*> mPendingThumbnails;
+    WorldCellsItem *mCellsItem;
     PasteCellsTool *mPasteCellsTool;
     BaseWorldSceneTool *mActiveTool;
     DragMapImageItem *mDragMapImageItem;
@@ -0,0 +1,881 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldscript.h"
+
+#include "mapmanager.h"
+#include "road.h"
+#include "world.h"
+#include "worldcell.h"
+#include "worlddocument.h"
+#include "worldreader.h"
+#include "worldwriter.h"
+
+#include "BuildingEditor/buildingtiles.h"
+
+#include "map.h"
+#include "tilelayer.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QUndoStack>
+
+extern "C" {
+#include "lualib.h"
+#include "lauxlib.h"
+}
+
+using namespace Tiled;
+
+static const char *WORLD = "World";
+static const char *CELL = "WorldCell";
+static const char *LOT = "WorldCellLot";
+static const char *OBJECT = "WorldCellObject";
+static const char *ROAD = "Road";
+
+// The address of this is the registry key for the WorldScript.
+static char REGISTRY_KEY;
+
+// Lua errors longjmp out of these functions, so anything with a destructor
+// must be out of scope before luaL_error() or a luaL_check*() is called.
+
+// The userdata of every object the script sees.  Lots and objects remember
+// their cell, so a handle to one that was removed can be recognized without
+// touching the object, which may have been deleted.
+struct Handle
+{
+    void *mObject;
+    void *mOwner;
+};
+
+template <class T>
+static void pushObject(lua_State *L, T *object, const char *type, void *owner = nullptr)
+{
+    if (!object) {
+        lua_pushnil(L);
+        return;
+    }
+    Handle *ud = static_cast<Handle*>(lua_newuserdata(L, sizeof(Handle)));
+    ud->mObject = object;
+    ud->mOwner = owner;
+    luaL_setmetatable(L, type);
+}
+
+static Handle *checkHandle(lua_State *L, int index, const char *type)
+{
+    return static_cast<Handle*>(luaL_checkudata(L, index, type));
+}
+
+template <class T>
+static T *checkObject(lua_State *L, int index, const char *type)
+{
+    return static_cast<T*>(checkHandle(L, index, type)->mObject);
+}
+
+template <class T>
+static void pushList(lua_State *L, const QList<T*> &objects, const char *type,
+                     void *owner = nullptr)
+{
+    lua_createtable(L, objects.size(), 0);
+    for (int i = 0; i < objects.size(); i++) {
+        pushObject(L, objects[i], type, owner);
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+static void pushString(lua_State *L, const QString &s)
+{
+    QByteArray utf8 = s.toUtf8();
+    lua_pushlstring(L, utf8.constData(), utf8.size());
+}
+
+static QString checkString(lua_State *L, int index)
+{
+    return QString::fromUtf8(luaL_checkstring(L, index));
+}
+
+static WorldDocument *document(lua_State *L)
+{
+    return WorldScript::fromState(L)->document();
+}
+
+static World *world(lua_State *L)
+{
+    return document(L)->world();
+}
+
+// Pointers are compared so the same object fetched twice is equal.
+static int objectEquals(lua_State *L)
+{
+    Handle *a = static_cast<Handle*>(lua_touserdata(L, 1));
+    Handle *b = static_cast<Handle*>(lua_touserdata(L, 2));
+    lua_pushboolean(L, a && b && a->mObject == b->mObject);
+    return 1;
+}
+
+/**
+  * Changes to the lots and objects of a cell don't reach the scenes and
+  * docks one at a time.  The cell gets cellContentsAboutToChange() before
+  * its first change and cellContentsChanged() once the script ends.
+  */
+class CellEdit
+{
+public:
+    CellEdit(lua_State *L, WorldCell *cell)
+        : mUndoRedo(document(L)->undoRedo())
+    {
+        WorldScript::fromState(L)->cellAboutToChange(cell);
+        mWasBlocked = mUndoRedo.blockSignals(true);
+    }
+
+    ~CellEdit()
+    {
+        mUndoRedo.blockSignals(mWasBlocked);
+    }
+
+private:
+    WorldDocumentUndoRedo &mUndoRedo;
+    bool mWasBlocked;
+};
+
+/////
+
+static int printToOutput(lua_State *L)
+{
+    WorldScript *script = WorldScript::fromState(L);
+    int count = lua_gettop(L);
+    for (int i = 1; i <= count; i++) {
+        if (i > 1)
+            script->print(QLatin1String("\t"));
+        script->print(QString::fromUtf8(luaL_tolstring(L, i, nullptr)));
+        lua_pop(L, 1);
+    }
+    script->print(QLatin1String("\n"));
+    return 0;
+}
+
+/////
+
+static int world_width(lua_State *L)
+{
+    lua_pushinteger(L, world(L)->width());
+    return 1;
+}
+
+static int world_height(lua_State *L)
+{
+    lua_pushinteger(L, world(L)->height());
+    return 1;
+}
+
+static int world_cell(lua_State *L)
+{
+    int x = luaL_checkint(L, 2);
+    int y = luaL_checkint(L, 3);
+    pushObject(L, world(L)->cellAt(x, y), CELL);
+    return 1;
+}
+
+static int world_cells(lua_State *L)
+{
+    pushList(L, world(L)->cells().toList(), CELL);
+    return 1;
+}
+
+static int world_roads(lua_State *L)
+{
+    pushList<Road>(L, world(L)->roads(), ROAD);
+    return 1;
+}
+
+static int world_objectGroups(lua_State *L)
+{
+    QStringList names = world(L)->objectGroups().names();
+    lua_createtable(L, names.size(), 0);
+    for (int i = 0; i < names.size(); i++) {
+        pushString(L, names[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static int world_objectTypes(lua_State *L)
+{
+    QStringList names = world(L)->objectTypes().names();
+    lua_createtable(L, names.size(), 0);
+    for (int i = 0; i < names.size(); i++) {
+        pushString(L, names[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static const luaL_Reg worldMethods[] = {
+    { "width", world_width },
+    { "height", world_height },
+    { "cell", world_cell },
+    { "cells", world_cells },
+    { "roads", world_roads },
+    { "objectGroups", world_objectGroups },
+    { "objectTypes", world_objectTypes },
+    { nullptr, nullptr }
+};
+
+/////
+
+static WorldCell *checkCell(lua_State *L, int index = 1)
+{
+    return checkObject<WorldCell>(L, index, CELL);
+}
+
+static int cell_x(lua_State *L)
+{
+    lua_pushinteger(L, checkCell(L)->x());
+    return 1;
+}
+
+static int cell_y(lua_State *L)
+{
+    lua_pushinteger(L, checkCell(L)->y());
+    return 1;
+}
+
+static int cell_map(lua_State *L)
+{
+    pushString(L, checkCell(L)->mapFilePath());
+    return 1;
+}
+
+static int cell_setMap(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    document(L)->setCellMapName(cell, checkString(L, 2));
+    return 0;
+}
+
+static int cell_lots(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    pushList<WorldCellLot>(L, cell->lots(), LOT, cell);
+    return 1;
+}
+
+static int cell_objects(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    pushList<WorldCellObject>(L, cell->objects(), OBJECT, cell);
+    return 1;
+}
+
+// cell:addLot(mapFile, x, y, level)
+static int cell_addLot(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    const char *mapName = luaL_checkstring(L, 2);
+    int x = luaL_checkint(L, 3);
+    int y = luaL_checkint(L, 4);
+    int level = luaL_optint(L, 5, 0);
+    MapInfo *mapInfo = MapManager::instance()->mapInfo(QString::fromUtf8(mapName));
+    if (!mapInfo)
+        return luaL_error(L, "can't read map \"%s\"", mapName);
+    WorldCellLot *lot = new WorldCellLot(cell, mapInfo->path(), x, y, level,
+                                         mapInfo->width(), mapInfo->height());
+    {
+        CellEdit edit(L, cell);
+        document(L)->addCellLot(cell, cell->lots().size(), lot);
+    }
+    pushObject(L, lot, LOT, cell);
+    return 1;
+}
+
+static int cell_removeLot(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    WorldCellLot *lot = checkObject<WorldCellLot>(L, 2, LOT);
+    int index = cell->lots().indexOf(lot);
+    if (index == -1)
+        return luaL_error(L, "lot isn't in this cell");
+    CellEdit edit(L, cell);
+    document(L)->removeCellLot(cell, index);
+    return 0;
+}
+
+// cell:addObject{group=, type=, name=, x=, y=, level=, width=, height=}
+static int cell_addObject(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    lua_getfield(L, 2, "group");
+    const char *groupName = luaL_optstring(L, -1, "");
+    lua_getfield(L, 2, "type");
+    const char *typeName = luaL_optstring(L, -1, nullptr);
+    lua_getfield(L, 2, "name");
+    const char *name = luaL_optstring(L, -1, "");
+    lua_getfield(L, 2, "x");
+    lua_Number x = luaL_checknumber(L, -1);
+    lua_getfield(L, 2, "y");
+    lua_Number y = luaL_checknumber(L, -1);
+    lua_getfield(L, 2, "level");
+    int level = luaL_optint(L, -1, 0);
+    lua_getfield(L, 2, "width");
+    lua_Number width = luaL_optnumber(L, -1, 1);
+    lua_getfield(L, 2, "height");
+    lua_Number height = luaL_optnumber(L, -1, 1);
+
+    WorldObjectGroup *og = world(L)->objectGroups().find(QString::fromUtf8(groupName));
+    if (!og)
+        return luaL_error(L, "unknown object group \"%s\"", groupName);
+    ObjectType *type = og->type();
+    if (typeName) {
+        type = world(L)->objectType(QString::fromUtf8(typeName));
+        if (!type)
+            return luaL_error(L, "unknown object type \"%s\"", typeName);
+    }
+
+    WorldCellObject *obj = new WorldCellObject(cell, QString::fromUtf8(name), type, og,
+                                               x, y, level, width, height);
+    {
+        CellEdit edit(L, cell);
+        document(L)->addCellObject(cell, cell->objects().size(), obj);
+    }
+    pushObject(L, obj, OBJECT, cell);
+    return 1;
+}
+
+static int cell_removeObject(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    WorldCellObject *obj = checkObject<WorldCellObject>(L, 2, OBJECT);
+    int index = cell->objects().indexOf(obj);
+    if (index == -1)
+        return luaL_error(L, "object isn't in this cell");
+    CellEdit edit(L, cell);
+    document(L)->removeCellObject(cell, index);
+    return 0;
+}
+
+// cell:tileAt(layerName, x, y) returns the name of the tile in the cell's
+// map, or nil.  Lots aren't looked at.
+static int cell_tileAt(lua_State *L)
+{
+    WorldCell *cell = checkCell(L);
+    const char *layerName = luaL_checkstring(L, 2);
+    int x = luaL_checkint(L, 3);
+    int y = luaL_checkint(L, 4);
+    if (cell->mapFilePath().isEmpty())
+        return 0;
+    Map *map = WorldScript::fromState(L)->map(cell->mapFilePath());
+    if (!map)
+        return luaL_error(L, "can't read the map for cell %d,%d", cell->x(), cell->y());
+    int index = map->indexOfLayer(QString::fromUtf8(layerName));
+    TileLayer *tl = (index == -1) ? nullptr : map->layerAt(index)->asTileLayer();
+    if (!tl || !tl->contains(x, y))
+        return 0;
+    Tile *tile = tl->cellAt(x, y).tile();
+    if (!tile)
+        return 0;
+    pushString(L, BuildingEditor::BuildingTilesMgr::nameForTile(tile));
+    return 1;
+}
+
+static const luaL_Reg cellMethods[] = {
+    { "x", cell_x },
+    { "y", cell_y },
+    { "map", cell_map },
+    { "setMap", cell_setMap },
+    { "lots", cell_lots },
+    { "objects", cell_objects },
+    { "addLot", cell_addLot },
+    { "removeLot", cell_removeLot },
+    { "addObject", cell_addObject },
+    { "removeObject", cell_removeObject },
+    { "tileAt", cell_tileAt },
+    { nullptr, nullptr }
+};
+
+/////
+
+static WorldCellLot *checkLot(lua_State *L)
+{
+    Handle *handle = checkHandle(L, 1, LOT);
+    WorldCellLot *lot = static_cast<WorldCellLot*>(handle->mObject);
+    if (static_cast<WorldCell*>(handle->mOwner)->lots().indexOf(lot) == -1)
+        luaL_error(L, "the lot was removed from its cell");
+    return lot;
+}
+
+static int lot_map(lua_State *L)
+{
+    pushString(L, checkLot(L)->mapName());
+    return 1;
+}
+
+static int lot_cell(lua_State *L)
+{
+    pushObject(L, checkLot(L)->cell(), CELL);
+    return 1;
+}
+
+static int lot_x(lua_State *L)
+{
+    lua_pushinteger(L, checkLot(L)->x());
+    return 1;
+}
+
+static int lot_y(lua_State *L)
+{
+    lua_pushinteger(L, checkLot(L)->y());
+    return 1;
+}
+
+static int lot_level(lua_State *L)
+{
+    lua_pushinteger(L, checkLot(L)->level());
+    return 1;
+}
+
+static int lot_width(lua_State *L)
+{
+    lua_pushinteger(L, checkLot(L)->width());
+    return 1;
+}
+
+static int lot_height(lua_State *L)
+{
+    lua_pushinteger(L, checkLot(L)->height());
+    return 1;
+}
+
+static int lot_setPos(lua_State *L)
+{
+    WorldCellLot *lot = checkLot(L);
+    int x = luaL_checkint(L, 2);
+    int y = luaL_checkint(L, 3);
+    CellEdit edit(L, lot->cell());
+    document(L)->moveCellLot(lot, QPoint(x, y));
+    return 0;
+}
+
+static int lot_setLevel(lua_State *L)
+{
+    WorldCellLot *lot = checkLot(L);
+    int level = luaL_checkint(L, 2);
+    CellEdit edit(L, lot->cell());
+    document(L)->setLotLevel(lot, level);
+    return 0;
+}
+
+static const luaL_Reg lotMethods[] = {
+    { "map", lot_map },
+    { "cell", lot_cell },
+    { "x", lot_x },
+    { "y", lot_y },
+    { "level", lot_level },
+    { "width", lot_width },
+    { "height", lot_height },
+    { "setPos", lot_setPos },
+    { "setLevel", lot_setLevel },
+    { nullptr, nullptr }
+};
+
+/////
+
+static WorldCellObject *checkCellObject(lua_State *L)
+{
+    Handle *handle = checkHandle(L, 1, OBJECT);
+    WorldCellObject *obj = static_cast<WorldCellObject*>(handle->mObject);
+    if (static_cast<WorldCell*>(handle->mOwner)->objects().indexOf(obj) == -1)
+        luaL_error(L, "the object was removed from its cell");
+    return obj;
+}
+
+static int object_name(lua_State *L)
+{
+    pushString(L, checkCellObject(L)->name());
+    return 1;
+}
+
+static int object_type(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    pushString(L, obj->type() ? obj->type()->name() : QString());
+    return 1;
+}
+
+static int object_group(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    pushString(L, obj->group() ? obj->group()->name() : QString());
+    return 1;
+}
+
+static int object_cell(lua_State *L)
+{
+    pushObject(L, checkCellObject(L)->cell(), CELL);
+    return 1;
+}
+
+static int object_x(lua_State *L)
+{
+    lua_pushnumber(L, checkCellObject(L)->x());
+    return 1;
+}
+
+static int object_y(lua_State *L)
+{
+    lua_pushnumber(L, checkCellObject(L)->y());
+    return 1;
+}
+
+static int object_level(lua_State *L)
+{
+    lua_pushinteger(L, checkCellObject(L)->level());
+    return 1;
+}
+
+static int object_width(lua_State *L)
+{
+    lua_pushnumber(L, checkCellObject(L)->width());
+    return 1;
+}
+
+static int object_height(lua_State *L)
+{
+    lua_pushnumber(L, checkCellObject(L)->height());
+    return 1;
+}
+
+static int object_setName(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    QString name = checkString(L, 2);
+    if (name != obj->name()) {
+        CellEdit edit(L, obj->cell());
+        document(L)->setCellObjectName(obj, name);
+    }
+    return 0;
+}
+
+static int object_setType(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    const char *typeName = luaL_checkstring(L, 2);
+    ObjectType *type = world(L)->objectType(QString::fromUtf8(typeName));
+    if (!type)
+        return luaL_error(L, "unknown object type \"%s\"", typeName);
+    if (type != obj->type()) {
+        CellEdit edit(L, obj->cell());
+        document(L)->setCellObjectType(obj, type->name());
+    }
+    return 0;
+}
+
+static int object_setGroup(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    const char *groupName = luaL_checkstring(L, 2);
+    WorldObjectGroup *og = world(L)->objectGroups().find(QString::fromUtf8(groupName));
+    if (!og)
+        return luaL_error(L, "unknown object group \"%s\"", groupName);
+    if (og != obj->group()) {
+        CellEdit edit(L, obj->cell());
+        document(L)->setCellObjectGroup(obj, og);
+    }
+    return 0;
+}
+
+static int object_setPos(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    QPointF pos(luaL_checknumber(L, 2), luaL_checknumber(L, 3));
+    CellEdit edit(L, obj->cell());
+    document(L)->moveCellObject(obj, pos);
+    return 0;
+}
+
+static int object_setSize(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    QSizeF size(luaL_checknumber(L, 2), luaL_checknumber(L, 3));
+    CellEdit edit(L, obj->cell());
+    document(L)->resizeCellObject(obj, size);
+    return 0;
+}
+
+static int object_setLevel(lua_State *L)
+{
+    WorldCellObject *obj = checkCellObject(L);
+    int level = luaL_checkint(L, 2);
+    CellEdit edit(L, obj->cell());
+    document(L)->setObjectLevel(obj, level);
+    return 0;
+}
+
+static const luaL_Reg objectMethods[] = {
+    { "name", object_name },
+    { "type", object_type },
+    { "group", object_group },
+    { "cell", object_cell },
+    { "x", object_x },
+    { "y", object_y },
+    { "level", object_level },
+    { "width", object_width },
+    { "height", object_height },
+    { "setName", object_setName },
+    { "setType", object_setType },
+    { "setGroup", object_setGroup },
+    { "setPos", object_setPos },
+    { "setSize", object_setSize },
+    { "setLevel", object_setLevel },
+    { nullptr, nullptr }
+};
+
+/////
+
+static Road *checkRoad(lua_State *L)
+{
+    Road *road = checkObject<Road>(L, 1, ROAD);
+    if (world(L)->roads().indexOf(road) == -1)
+        luaL_error(L, "the road was removed from the world");
+    return road;
+}
+
+static int road_coords(lua_State *L)
+{
+    Road *road = checkRoad(L);
+    lua_pushinteger(L, road->x1());
+    lua_pushinteger(L, road->y1());
+    lua_pushinteger(L, road->x2());
+    lua_pushinteger(L, road->y2());
+    return 4;
+}
+
+static int road_width(lua_State *L)
+{
+    lua_pushinteger(L, checkRoad(L)->width());
+    return 1;
+}
+
+static int road_tileName(lua_State *L)
+{
+    pushString(L, checkRoad(L)->tileName());
+    return 1;
+}
+
+static int road_setCoords(lua_State *L)
+{
+    Road *road = checkRoad(L);
+    QPoint start(luaL_checkint(L, 2), luaL_checkint(L, 3));
+    QPoint end(luaL_checkint(L, 4), luaL_checkint(L, 5));
+    document(L)->changeRoadCoords(road, start, end);
+    return 0;
+}
+
+static int road_setWidth(lua_State *L)
+{
+    Road *road = checkRoad(L);
+    document(L)->changeRoadWidth(road, luaL_checkint(L, 2));
+    return 0;
+}
+
+static int road_setTileName(lua_State *L)
+{
+    Road *road = checkRoad(L);
+    document(L)->changeRoadTileName(road, checkString(L, 2));
+    return 0;
+}
+
+static const luaL_Reg roadMethods[] = {
+    { "coords", road_coords },
+    { "width", road_width },
+    { "tileName", road_tileName },
+    { "setCoords", road_setCoords },
+    { "setWidth", road_setWidth },
+    { "setTileName", road_setTileName },
+    { nullptr, nullptr }
+};
+
+/////
+
+static void registerType(lua_State *L, const char *type, const luaL_Reg *methods)
+{
+    luaL_newmetatable(L, type);
+    lua_newtable(L);
+    luaL_setfuncs(L, methods, 0);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, objectEquals);
+    lua_setfield(L, -2, "__eq");
+    lua_pop(L, 1);
+}
+
+WorldScript::WorldScript(WorldDocument *worldDoc)
+    : mState(luaL_newstate())
+    , mDocument(worldDoc)
+{
+    lua_State *L = mState;
+    luaL_openlibs(L);
+
+    lua_pushlightuserdata(L, &REGISTRY_KEY);
+    lua_pushlightuserdata(L, this);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    lua_register(L, "print", printToOutput);
+
+    registerType(L, WORLD, worldMethods);
+    registerType(L, CELL, cellMethods);
+    registerType(L, LOT, lotMethods);
+    registerType(L, OBJECT, objectMethods);
+    registerType(L, ROAD, roadMethods);
+
+    pushObject(L, mDocument->world(), WORLD);
+    lua_setglobal(L, "world");
+}
+
+WorldScript::~WorldScript()
+{
+    lua_close(mState);
+    foreach (MapInfo *mapInfo, mMaps)
+        MapManager::instance()->removeReferenceToMap(mapInfo);
+}
+
+WorldScript *WorldScript::fromState(lua_State *L)
+{
+    lua_pushlightuserdata(L, &REGISTRY_KEY);
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    WorldScript *script = static_cast<WorldScript*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+    return script;
+}
+
+bool WorldScript::runFile(const QString &fileName)
+{
+    if (luaL_loadfile(mState, QFile::encodeName(fileName).constData()) != LUA_OK) {
+        mError = QString::fromUtf8(lua_tostring(mState, -1));
+        lua_pop(mState, 1);
+        return false;
+    }
+    return run(QFileInfo(fileName).fileName());
+}
+
+bool WorldScript::runString(const QString &source, const QString &name)
+{
+    QByteArray utf8 = source.toUtf8();
+    if (luaL_loadbuffer(mState, utf8.constData(), utf8.size(), name.toUtf8().constData()) != LUA_OK) {
+        mError = QString::fromUtf8(lua_tostring(mState, -1));
+        lua_pop(mState, 1);
+        return false;
+    }
+    return run(name);
+}
+
+namespace {
+
+// Pushed after undoing a failed script, so the script's macro is dropped
+// from the redo end of the stack.  Being obsolete, it is deleted at once.
+class DiscardRedoCommand : public QUndoCommand
+{
+public:
+    void redo() override { setObsolete(true); }
+};
+
+} // namespace
+
+bool WorldScript::run(const QString &name)
+{
+    QUndoStack *undoStack = mDocument->undoStack();
+    undoStack->beginMacro(tr("Run Script %1").arg(name));
+    int status = lua_pcall(mState, 0, 0, 0);
+    undoStack->endMacro();
+
+    // One refresh for each cell the script changed.
+    foreach (WorldCell *cell, mChangedCells)
+        emit mDocument->cellContentsChanged(cell);
+    mChangedCells.clear();
+
+    if (status != LUA_OK) {
+        mError = QString::fromUtf8(lua_tostring(mState, -1));
+        lua_pop(mState, 1);
+        // Put the world back the way it was before the script started,
+        // leaving nothing to redo.
+        undoStack->undo();
+        undoStack->push(new DiscardRedoCommand);
+        return false;
+    }
+    return true;
+}
+
+void WorldScript::cellAboutToChange(WorldCell *cell)
+{
+    if (mChangedCells.contains(cell))
+        return;
+    mChangedCells += cell;
+    emit mDocument->cellContentsAboutToChange(cell);
+}
+
+Map *WorldScript::map(const QString &fileName)
+{
+    if (!mMaps.contains(fileName)) {
+        MapInfo *mapInfo = MapManager::instance()->loadMap(fileName);
+        if (mapInfo)
+            MapManager::instance()->addReferenceToMap(mapInfo);
+        mMaps[fileName] = mapInfo;
+    }
+    MapInfo *mapInfo = mMaps[fileName];
+    return mapInfo ? mapInfo->map() : nullptr;
+}
+
+int WorldScript::runHeadless(const QStringList &args)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (args.size() < 2) {
+        err << "Usage: PZWorldEd --script <file.lua> <world.pzw> [--save]\n";
+        return 1;
+    }
+    QString scriptFile = args[0];
+    QString worldFile = args[1];
+
+    WorldReader reader;
+    World *world = reader.readWorld(worldFile);
+    if (!world) {
+        err << reader.errorString() << "\n";
+        return 1;
+    }
+
+    WorldDocument worldDoc(world, worldFile);
+    bool ok;
+    {
+        WorldScript script(&worldDoc);
+        ok = script.runFile(scriptFile);
+        out << script.output();
+        if (!ok)
+            err << script.errorString() << "\n";
+    }
+    if (!ok)
+        return 1;
+
+    if (args.contains(QLatin1String("--save"))) {
+        WorldWriter writer;
+        if (!writer.writeWorld(world, worldFile)) {
+            err << writer.errorString() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDSCRIPT_H
+#define WORLDSCRIPT_H
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QStringList>
+
+struct lua_State;
+
+class MapInfo;
+class WorldCell;
+class WorldDocument;
+
+namespace Tiled {
+class Map;
+}
+
+/**
+  * Runs a Lua script that edits a world.  The script sees a global "world"
+  * object with cells, lots, objects and roads, and can read the tiles of
+  * each cell's map.  Every change the script makes goes through the
+  * WorldDocument so it is undoable; the whole script is one undo macro, and
+  * if the script fails the changes it made are undone and dropped from the
+  * undo stack.  Using a lot, object or road the script removed is an error.
+  *
+  *   for _,cell in ipairs(world:cells()) do
+  *     for _,obj in ipairs(cell:objects()) do
+  *       if obj:type() == "TownZone" then obj:setType("Forest") end
+  *     end
+  *   end
+  *
+  * The same scripts can be run without the main window with
+  * "PZWorldEd --script <file.lua> <world.pzw> [--save]".
+  */
+class WorldScript
+{
+    Q_DECLARE_TR_FUNCTIONS(WorldScript)
+
+public:
+    WorldScript(WorldDocument *worldDoc);
+    ~WorldScript();
+
+    bool runFile(const QString &fileName);
+    bool runString(const QString &source, const QString &name);
+
+    QString output() const
+    { return mOutput; }
+
+    QString errorString() const
+    { return mError; }
+
+    /**
+      * Handles "--script <file.lua> <world.pzw> [--save]".  Returns the
+      * process exit code.
+      */
+    static int runHeadless(const QStringList &args);
+
+    // These are used by the functions the script calls.
+    static WorldScript *fromState(lua_State *L);
+
+    WorldDocument *document() const
+    { return mDocument; }
+
+    Tiled::Map *map(const QString &fileName);
+
+    void print(const QString &text)
+    { mOutput += text; }
+
+    /**
+      * Called before the script first changes the lots or objects of
+      * \a cell.  The scenes and docks are told about the changes to every
+      * such cell at once when the script ends.
+      */
+    void cellAboutToChange(WorldCell *cell);
+
+private:
+    bool run(const QString &name);
+
+    lua_State *mState;
+    WorldDocument *mDocument;
+    QMap<QString,MapInfo*> mMaps;
+    QList<WorldCell*> mChangedCells;
+    QString mOutput;
+    QString mError;
+};
+
+#endif // WORLDSCRIPT_H
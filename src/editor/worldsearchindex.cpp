@@ -0,0 +1,550 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldsearchindex.h"
+
+#include "world.h"
+#include "worldcell.h"
+#include "worlddocument.h"
+
+#include "BuildingEditor/buildingtiles.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+
+#define SEARCH_CACHE_MAGIC 0x505A5349 // PZSI
+#define SEARCH_CACHE_VERSION 1
+
+bool MapContents::read(const QString &fileName)
+{
+    mFileName = fileName;
+
+    QFileInfo info(fileName);
+    mSize = info.size();
+    mModified = info.lastModified().toMSecsSinceEpoch();
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    if (fileName.endsWith(QLatin1String(".tbx"), Qt::CaseInsensitive))
+        return readTBX(&file);
+    return readTMX(&file);
+}
+
+bool MapContents::isOutOfDate() const
+{
+    QFileInfo info(mFileName);
+    return (info.size() != mSize) ||
+            (info.lastModified().toMSecsSinceEpoch() != mModified);
+}
+
+bool MapContents::readTMX(QIODevice *device)
+{
+    QXmlStreamReader xml(device);
+    if (!xml.readNextStartElement() || xml.name() != QLatin1String("map"))
+        return false;
+
+    QSet<QString> tilesets, rooms;
+
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("properties")) {
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("property")) {
+                    const QXmlStreamAttributes atts = xml.attributes();
+                    mProperties += atts.value(QLatin1String("name")).toString()
+                            + QLatin1Char('=')
+                            + atts.value(QLatin1String("value")).toString();
+                }
+                xml.skipCurrentElement();
+            }
+        } else if (xml.name() == QLatin1String("tileset")) {
+            const QXmlStreamAttributes atts = xml.attributes();
+            QString name = atts.value(QLatin1String("name")).toString();
+            if (name.isEmpty())
+                name = QFileInfo(atts.value(QLatin1String("source")).toString()).completeBaseName();
+            if (!name.isEmpty())
+                tilesets += name;
+            xml.skipCurrentElement();
+        } else if (xml.name() == QLatin1String("objectgroup")) {
+            // Room definitions are named "internalName#N".
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("object")) {
+                    const QXmlStreamAttributes atts = xml.attributes();
+                    if (atts.value(QLatin1String("type")) == QLatin1String("room")) {
+                        QString name = atts.value(QLatin1String("name")).toString();
+                        name = name.section(QLatin1Char('#'), 0, 0);
+                        if (!name.isEmpty())
+                            rooms += name;
+                    }
+                }
+                xml.skipCurrentElement();
+            }
+        } else {
+            // Skip the tile layers without looking at their data.
+            xml.skipCurrentElement();
+        }
+    }
+
+    mTilesets = tilesets.toList();
+    mTilesets.sort();
+    mRooms = rooms.toList();
+    mRooms.sort();
+
+    return !xml.hasError();
+}
+
+bool MapContents::readTBX(QIODevice *device)
+{
+    QXmlStreamReader xml(device);
+    if (!xml.readNextStartElement() || xml.name() != QLatin1String("building"))
+        return false;
+
+    QSet<QString> tilesets, rooms;
+
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (!xml.isStartElement())
+            continue;
+        const QXmlStreamAttributes atts = xml.attributes();
+        if (xml.name() == QLatin1String("room")) {
+            QString name = atts.value(QLatin1String("InternalName")).toString();
+            if (name.isEmpty())
+                name = atts.value(QLatin1String("Name")).toString();
+            if (!name.isEmpty())
+                rooms += name;
+        } else if (xml.name() == QLatin1String("tile")) {
+            QString tilesetName;
+            int index;
+            if (BuildingEditor::BuildingTilesMgr::parseTileName(
+                        atts.value(QLatin1String("tile")).toString(), tilesetName, index))
+                tilesets += tilesetName;
+        }
+    }
+
+    mTilesets = tilesets.toList();
+    mTilesets.sort();
+    mRooms = rooms.toList();
+    mRooms.sort();
+
+    return !xml.hasError();
+}
+
+/////
+
+MapContentsWorker::MapContentsWorker(InterruptibleThread *thread) :
+    BaseWorker(thread)
+{
+}
+
+void MapContentsWorker::work()
+{
+    IN_WORKER_THREAD
+
+    while (mJobs.size()) {
+        if (aborted()) {
+            mJobs.clear();
+            return;
+        }
+
+        // A file that can't be read is still reported so it isn't read again
+        // until it changes.
+        MapContents *contents = new MapContents;
+        contents->read(mJobs.takeFirst());
+        emit mapContentsRead(contents);
+    }
+}
+
+void MapContentsWorker::addJob(const QString &fileName)
+{
+    IN_WORKER_THREAD
+
+    mJobs += fileName;
+    scheduleWork();
+}
+
+/////
+
+WorldSearchIndex::WorldSearchIndex(WorldDocument *worldDoc) :
+    QObject(),
+    mWorldDoc(worldDoc),
+    mRebuild(true),
+    mIndexMapContents(false),
+    mCacheChanged(false),
+    mNextThreadForJob(0)
+{
+    qRegisterMetaType<MapContents*>("MapContents*");
+
+    connect(mWorldDoc, &WorldDocument::worldAboutToResize,
+            this, &WorldSearchIndex::rebuildLater);
+    connect(mWorldDoc, &WorldDocument::worldResized,
+            this, &WorldSearchIndex::rebuildLater);
+    connect(mWorldDoc, &WorldDocument::objectGroupAboutToBeRemoved,
+            this, &WorldSearchIndex::rebuildLater);
+    connect(mWorldDoc, &WorldDocument::objectTypeAboutToBeRemoved,
+            this, &WorldSearchIndex::rebuildLater);
+
+    connect(mWorldDoc, &WorldDocument::cellMapFileChanged,
+            this, &WorldSearchIndex::cellChanged);
+    connect(mWorldDoc, &WorldDocument::cellContentsChanged,
+            this, &WorldSearchIndex::cellChanged);
+
+    connect(mWorldDoc, &WorldDocument::cellLotAdded,
+            this, [this](WorldCell *cell, int) { cellChanged(cell); });
+    connect(mWorldDoc, &WorldDocument::cellLotAboutToBeRemoved,
+            this, [this](WorldCell *cell, int) { cellChanged(cell); });
+    connect(mWorldDoc, &WorldDocument::cellLotMoved,
+            this, &WorldSearchIndex::lotChanged);
+
+    connect(mWorldDoc, &WorldDocument::cellObjectAdded,
+            this, [this](WorldCell *cell, int) { cellChanged(cell); });
+    connect(mWorldDoc, &WorldDocument::cellObjectAboutToBeRemoved,
+            this, [this](WorldCell *cell, int) { cellChanged(cell); });
+    connect(mWorldDoc, &WorldDocument::cellObjectGroupChanged,
+            this, &WorldSearchIndex::objectChanged);
+    connect(mWorldDoc, &WorldDocument::cellObjectTypeChanged,
+            this, &WorldSearchIndex::objectChanged);
+
+    readCache();
+}
+
+WorldSearchIndex::~WorldSearchIndex()
+{
+    for (int i = 0; i < mThreads.size(); i++) {
+        mThreads[i]->interrupt();
+        mThreads[i]->quit();
+        mThreads[i]->wait();
+        delete mWorkers[i];
+        delete mThreads[i];
+    }
+
+    if (mCacheChanged)
+        writeCache();
+
+    qDeleteAll(mMapContents);
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithObjectType(ObjectType *type)
+{
+    update();
+    return sorted(mObjectTypes.cells(type));
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithObjectGroup(WorldObjectGroup *og)
+{
+    update();
+    return sorted(mObjectGroups.cells(og));
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithLotFileName(const QString &text)
+{
+    update();
+    QSet<WorldCell*> cells;
+    foreach (const QString &fileName, mLotFileNames.keys()) {
+        if (fileName.contains(text, Qt::CaseInsensitive))
+            cells |= mLotFileNames.cells(fileName);
+    }
+    return sorted(cells);
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithTileset(const QString &text)
+{
+    return cellsWithMapContents(mMapsWithTileset, text);
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithRoomName(const QString &text)
+{
+    return cellsWithMapContents(mMapsWithRoom, text);
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithMapProperty(const QString &text)
+{
+    return cellsWithMapContents(mMapsWithProperty, text);
+}
+
+void WorldSearchIndex::indexMapContents()
+{
+    update();
+
+    mIndexMapContents = true;
+
+    foreach (const QString &fileName, mMapFiles.keys()) {
+        MapContents *contents = mMapContents.value(fileName);
+        if (!contents || contents->isOutOfDate())
+            requestMapContents(fileName);
+    }
+}
+
+void WorldSearchIndex::cellChanged(WorldCell *cell)
+{
+    mDirtyCells += cell;
+}
+
+void WorldSearchIndex::lotChanged(WorldCellLot *lot)
+{
+    // A lot may have moved to a different cell.
+    mRebuild = true;
+    Q_UNUSED(lot)
+}
+
+void WorldSearchIndex::objectChanged(WorldCellObject *object)
+{
+    mDirtyCells += object->cell();
+}
+
+void WorldSearchIndex::rebuildLater()
+{
+    mRebuild = true;
+}
+
+void WorldSearchIndex::update()
+{
+    if (mRebuild) {
+        mObjectTypes.clear();
+        mObjectGroups.clear();
+        mLotFileNames.clear();
+        mMapFiles.clear();
+        mDirtyCells.clear();
+
+        World *world = mWorldDoc->world();
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                if (WorldCell *cell = world->cellAt(x, y))
+                    indexCell(cell);
+            }
+        }
+        mRebuild = false;
+        return;
+    }
+
+    foreach (WorldCell *cell, mDirtyCells) {
+        removeCell(cell);
+        indexCell(cell);
+    }
+    mDirtyCells.clear();
+}
+
+void WorldSearchIndex::indexCell(WorldCell *cell)
+{
+    foreach (WorldCellObject *obj, cell->objects()) {
+        if (obj->type())
+            mObjectTypes.insert(cell, obj->type());
+        if (obj->group())
+            mObjectGroups.insert(cell, obj->group());
+    }
+
+    QStringList mapFiles;
+    if (!cell->mapFilePath().isEmpty())
+        mapFiles += cell->mapFilePath();
+    foreach (WorldCellLot *lot, cell->lots()) {
+        mLotFileNames.insert(cell, lot->mapName());
+        mapFiles += lot->mapName();
+    }
+
+    foreach (const QString &fileName, mapFiles) {
+        mMapFiles.insert(cell, fileName);
+        if (mIndexMapContents && !mMapContents.contains(fileName))
+            requestMapContents(fileName);
+    }
+}
+
+void WorldSearchIndex::removeCell(WorldCell *cell)
+{
+    mObjectTypes.remove(cell);
+    mObjectGroups.remove(cell);
+    mLotFileNames.remove(cell);
+    mMapFiles.remove(cell);
+}
+
+void WorldSearchIndex::requestMapContents(const QString &fileName)
+{
+    if (mPendingMaps.contains(fileName))
+        return;
+
+    if (mThreads.isEmpty()) {
+        mThreads.resize(qBound(2, QThread::idealThreadCount(), 4));
+        mWorkers.resize(mThreads.size());
+        for (int i = 0; i < mThreads.size(); i++) {
+            mThreads[i] = new InterruptibleThread;
+            mWorkers[i] = new MapContentsWorker(mThreads[i]);
+            mWorkers[i]->moveToThread(mThreads[i]);
+            connect(mWorkers[i], &MapContentsWorker::mapContentsRead,
+                    this, &WorldSearchIndex::mapContentsRead);
+            mThreads[i]->start();
+        }
+    }
+
+    mPendingMaps += fileName;
+    QMetaObject::invokeMethod(mWorkers[mNextThreadForJob],
+                              "addJob", Qt::QueuedConnection,
+                              Q_ARG(QString,fileName));
+    mNextThreadForJob = (mNextThreadForJob + 1) % mWorkers.size();
+}
+
+void WorldSearchIndex::mapContentsRead(MapContents *contents)
+{
+    mPendingMaps.remove(contents->mFileName);
+    removeMapContents(contents->mFileName);
+    addMapContents(contents);
+    mCacheChanged = true;
+
+    if (mPendingMaps.isEmpty())
+        emit mapContentsIndexed();
+}
+
+void WorldSearchIndex::addMapContents(MapContents *contents)
+{
+    const QString &fileName = contents->mFileName;
+    mMapContents[fileName] = contents;
+    foreach (const QString &tilesetName, contents->mTilesets)
+        mMapsWithTileset[tilesetName] += fileName;
+    foreach (const QString &roomName, contents->mRooms)
+        mMapsWithRoom[roomName] += fileName;
+    foreach (const QString &property, contents->mProperties)
+        mMapsWithProperty[property] += fileName;
+}
+
+static void removeFromIndex(QHash<QString,QSet<QString> > &index,
+                            const QStringList &keys, const QString &fileName)
+{
+    foreach (const QString &key, keys) {
+        QSet<QString> &fileNames = index[key];
+        fileNames.remove(fileName);
+        if (fileNames.isEmpty())
+            index.remove(key);
+    }
+}
+
+void WorldSearchIndex::removeMapContents(const QString &fileName)
+{
+    MapContents *contents = mMapContents.take(fileName);
+    if (!contents)
+        return;
+    removeFromIndex(mMapsWithTileset, contents->mTilesets, fileName);
+    removeFromIndex(mMapsWithRoom, contents->mRooms, fileName);
+    removeFromIndex(mMapsWithProperty, contents->mProperties, fileName);
+    delete contents;
+}
+
+QList<WorldCell *> WorldSearchIndex::cellsWithMapContents(const QHash<QString,QSet<QString> > &index,
+                                                          const QString &text)
+{
+    update();
+    QSet<WorldCell*> cells;
+    QHash<QString,QSet<QString> >::const_iterator it;
+    for (it = index.constBegin(); it != index.constEnd(); it++) {
+        if (!it.key().contains(text, Qt::CaseInsensitive))
+            continue;
+        foreach (const QString &fileName, it.value())
+            cells |= mMapFiles.cells(fileName);
+    }
+    return sorted(cells);
+}
+
+QList<WorldCell *> WorldSearchIndex::sorted(const QSet<WorldCell *> &cells) const
+{
+    QList<WorldCell*> result = cells.toList();
+    std::sort(result.begin(), result.end(), [](WorldCell *a, WorldCell *b) {
+        if (a->y() != b->y())
+            return a->y() < b->y();
+        return a->x() < b->x();
+    });
+    return result;
+}
+
+QString WorldSearchIndex::cacheFileName() const
+{
+    if (mWorldDoc->fileName().isEmpty())
+        return QString();
+    QFileInfo worldInfo(mWorldDoc->fileName());
+    QDir dir(worldInfo.absoluteDir().filePath(QLatin1String(".pzeditor")));
+    return dir.filePath(worldInfo.fileName() + QLatin1String(".search"));
+}
+
+void WorldSearchIndex::readCache()
+{
+    QString fileName = cacheFileName();
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version, count;
+    in >> magic >> version;
+    if (magic != SEARCH_CACHE_MAGIC || version != SEARCH_CACHE_VERSION)
+        return;
+
+    in >> count;
+    for (quint32 i = 0; i < count; i++) {
+        MapContents *contents = new MapContents;
+        in >> contents->mFileName >> contents->mSize >> contents->mModified
+           >> contents->mTilesets >> contents->mRooms >> contents->mProperties;
+        if (in.status() != QDataStream::Ok) {
+            delete contents;
+            break;
+        }
+        removeMapContents(contents->mFileName);
+        addMapContents(contents);
+    }
+}
+
+void WorldSearchIndex::writeCache()
+{
+    QString fileName = cacheFileName();
+    if (fileName.isEmpty())
+        return;
+
+    QFileInfo info(fileName);
+    QDir dir = info.absoluteDir();
+    if (!dir.exists() && !dir.mkpath(QLatin1String(".")))
+        return;
+
+    // Forget maps no longer used by the world.
+    QList<MapContents*> contentsList;
+    foreach (MapContents *contents, mMapContents) {
+        if (mRebuild || !mMapFiles.cells(contents->mFileName).isEmpty())
+            contentsList += contents;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << quint32(SEARCH_CACHE_MAGIC) << quint32(SEARCH_CACHE_VERSION);
+    out << quint32(contentsList.size());
+    foreach (MapContents *contents, contentsList) {
+        out << contents->mFileName << contents->mSize << contents->mModified
+            << contents->mTilesets << contents->mRooms << contents->mProperties;
+    }
+
+    file.commit();
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDSEARCHINDEX_H
+#define WORLDSEARCHINDEX_H
+
+#include "threads.h"
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class QIODevice;
+
+class ObjectType;
+class WorldCell;
+class WorldCellLot;
+class WorldCellObject;
+class WorldDocument;
+class WorldObjectGroup;
+
+/**
+  * The tilesets, room names and map properties of one .tmx or .tbx file.
+  */
+class MapContents
+{
+public:
+    MapContents() :
+        mSize(0),
+        mModified(0)
+    {
+    }
+
+    bool read(const QString &fileName);
+
+    bool isOutOfDate() const;
+
+    QString mFileName;
+    qint64 mSize;
+    qint64 mModified;
+    QStringList mTilesets;
+    QStringList mRooms;
+    QStringList mProperties; // name=value
+
+private:
+    bool readTMX(QIODevice *device);
+    bool readTBX(QIODevice *device);
+};
+
+class MapContentsWorker : public BaseWorker
+{
+    Q_OBJECT
+public:
+    MapContentsWorker(InterruptibleThread *thread);
+
+signals:
+    void mapContentsRead(MapContents *contents);
+
+public slots:
+    void work();
+    void addJob(const QString &fileName);
+
+private:
+    QStringList mJobs;
+};
+
+/**
+  * Maps keys to the cells that have them, and each cell to its keys so the
+  * cell can be removed again.
+  */
+template<class Key>
+class WorldCellIndex
+{
+public:
+    void insert(WorldCell *cell, const Key &key)
+    {
+        mCells[key].insert(cell);
+        mKeys[cell].insert(key);
+    }
+
+    void remove(WorldCell *cell)
+    {
+        foreach (const Key &key, mKeys.take(cell)) {
+            QSet<WorldCell*> &cells = mCells[key];
+            cells.remove(cell);
+            if (cells.isEmpty())
+                mCells.remove(key);
+        }
+    }
+
+    QSet<WorldCell*> cells(const Key &key) const
+    { return mCells.value(key); }
+
+    QList<Key> keys() const
+    { return mCells.keys(); }
+
+    void clear()
+    {
+        mCells.clear();
+        mKeys.clear();
+    }
+
+private:
+    QHash<Key,QSet<WorldCell*> > mCells;
+    QHash<WorldCell*,QSet<Key> > mKeys;
+};
+
+/**
+  * Inverted indexes used by the Search dock.  Object types, object groups and
+  * lot file names are indexed per cell and kept up-to-date from WorldDocument
+  * signals; cells are reindexed the next time a query is made.
+  *
+  * The tilesets, room names and map properties of each cell's map and lots
+  * are read by worker threads once indexMapContents() is called, and saved in
+  * the .pzeditor directory next to the world file so they only need to be read
+  * again when a map file changes.
+  */
+class WorldSearchIndex : public QObject
+{
+    Q_OBJECT
+public:
+    WorldSearchIndex(WorldDocument *worldDoc);
+    ~WorldSearchIndex();
+
+    QList<WorldCell*> cellsWithObjectType(ObjectType *type);
+    QList<WorldCell*> cellsWithObjectGroup(WorldObjectGroup *og);
+
+    // These match case-insensitive substrings.
+    QList<WorldCell*> cellsWithLotFileName(const QString &text);
+    QList<WorldCell*> cellsWithTileset(const QString &text);
+    QList<WorldCell*> cellsWithRoomName(const QString &text);
+    QList<WorldCell*> cellsWithMapProperty(const QString &text);
+
+    /**
+      * Reads any map used by the world that hasn't been read yet or has
+      * changed since it was read.  mapContentsIndexed() is emitted whenever
+      * more map contents are available.
+      */
+    void indexMapContents();
+
+    bool isIndexingMapContents() const
+    { return !mPendingMaps.isEmpty(); }
+
+signals:
+    void mapContentsIndexed();
+
+private:
+    void cellChanged(WorldCell *cell);
+    void lotChanged(WorldCellLot *lot);
+    void objectChanged(WorldCellObject *object);
+    void rebuildLater();
+
+    void update();
+    void indexCell(WorldCell *cell);
+    void removeCell(WorldCell *cell);
+
+    void requestMapContents(const QString &fileName);
+    void mapContentsRead(MapContents *contents);
+    void addMapContents(MapContents *contents);
+    void removeMapContents(const QString &fileName);
+
+    QList<WorldCell*> cellsWithMapContents(const QHash<QString,QSet<QString> > &index,
+                                           const QString &text);
+    QList<WorldCell*> sorted(const QSet<WorldCell*> &cells) const;
+
+    QString cacheFileName() const;
+    void readCache();
+    void writeCache();
+
+    WorldDocument *mWorldDoc;
+
+    bool mRebuild;
+    QSet<WorldCell*> mDirtyCells;
+
+    WorldCellIndex<ObjectType*> mObjectTypes;
+    WorldCellIndex<WorldObjectGroup*> mObjectGroups;
+    WorldCellIndex<QString> mLotFileNames;
+    WorldCellIndex<QString> mMapFiles; // cell maps and lots
+
+    bool mIndexMapContents;
+    QHash<QString,MapContents*> mMapContents;
+    QHash<QString,QSet<QString> > mMapsWithTileset;
+    QHash<QString,QSet<QString> > mMapsWithRoom;
+    QHash<QString,QSet<QString> > mMapsWithProperty;
+    QSet<QString> mPendingMaps;
+    bool mCacheChanged;
+
+    QVector<InterruptibleThread*> mThreads;
+    QVector<MapContentsWorker*> mWorkers;
+    int mNextThreadForJob;
+};
+
+#endif // WORLDSEARCHINDEX_H
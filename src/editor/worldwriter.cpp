@@ -19,7 +19,9 @@
 
 #include "bmptotmx.h"
 #include "world.h"
+#include "worldbinary.h"
 #include "worldcell.h"
+#include "worldwriterbinary.h"
 
 #include <QCoreApplication>
 #include <QDir>
@@ -35,6 +37,7 @@ class WorldWriterPrivate
 public:
     WorldWriterPrivate()
         : mWorld(0)
+        , mCellContents(true)
     {
     }
 
@@ -230,11 +233,13 @@ public:
         foreach (Property *p, cell->properties())
             writeProperty(w, p);
 
-        foreach (WorldCellLot *lot, cell->lots())
-            writeLot(w, lot);
+        if (mCellContents) {
+            foreach (WorldCellLot *lot, cell->lots())
+                writeLot(w, lot);
 
-        foreach (WorldCellObject *obj, cell->objects())
-            writeObject(w, obj);
+            foreach (WorldCellObject *obj, cell->objects())
+                writeObject(w, obj);
+        }
 
         w.writeEndElement();
     }
@@ -495,6 +500,7 @@ public:
     World *mWorld;
     QString mError;
     QDir mMapDir;
+    bool mCellContents;
 };
 
 /////
@@ -509,8 +515,32 @@ WorldWriter::~WorldWriter()
     delete d;
 }
 
+void WorldWriter::setCellContentsEnabled(bool enabled)
+{
+    d->mCellContents = enabled;
+}
+
 bool WorldWriter::writeWorld(World *world, const QString &filePath)
 {
+    if (filePath.endsWith(QLatin1String(".pzwb"), Qt::CaseInsensitive)) {
+        WorldWriterBinary writer;
+        if (!writer.writeWorld(world, filePath)) {
+            d->mError = writer.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    // Cells of a .pzwb file are written as they are loaded, and one that
+    // can't be read would be written as empty.
+    WorldCellSource *source = world->cellSource();
+    if (source && d->mCellContents) {
+        foreach (WorldCell *cell, world->cells())
+            cell->lots();
+        if (!source->checkReadable(world, d->mError))
+            return false;
+    }
+
     QTemporaryFile tempFile;
     if (!d->openFile(&tempFile))
         return false;
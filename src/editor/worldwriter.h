@@ -31,9 +31,19 @@ public:
     WorldWriter();
     ~WorldWriter();
 
+    /**
+      * Writes a .pzwb file with WorldWriterBinary if \a filePath ends with
+      * ".pzwb", otherwise .pzw XML.
+      */
     bool writeWorld(World *world, const QString &filePath);
     void writeWorld(World *world, QIODevice *device, const QString &absDirPath);
 
+    /**
+      * Whether cell lots and objects are written.  WorldWriterBinary stores
+      * them separately.
+      */
+    void setCellContentsEnabled(bool enabled);
+
     QString errorString() const;
 
 private:
@@ -0,0 +1,390 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldwriterbinary.h"
+
+#include "world.h"
+#include "worldbinary.h"
+#include "worldcell.h"
+#include "worldwriter.h"
+
+#include "InGameMap/ingamemapbinary.h"
+
+#include "compression.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTemporaryFile>
+
+using namespace InGameMapBinary;
+using namespace WorldBinary;
+
+class WorldWriterBinaryPrivate
+{
+    Q_DECLARE_TR_FUNCTIONS(WorldWriterBinary)
+
+public:
+    WorldWriterBinaryPrivate()
+    {
+    }
+
+    bool openFile(QFile *file)
+    {
+        if (!file->open(QIODevice::WriteOnly)) {
+            mError = tr("Could not open file for writing.");
+            return false;
+        }
+
+        return true;
+    }
+
+    void writeWorld(World *world, QIODevice *device, const QString &absDirPath)
+    {
+        mMapDir = QDir(absDirPath);
+        mMissingBlocks = 0;
+        initTables(world);
+
+        WorldCellSource *source = world->cellSource();
+        QVector<QByteArray> blocks(world->width() * world->height());
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                WorldCell *cell = world->cellAt(x, y);
+                QByteArray &block = blocks[x + y * world->width()];
+                const int pending = cell->pendingBlock();
+                if (source && pending != -1) {
+                    block = source->rawBlock(pending);
+                    if (!block.isEmpty())
+                        continue;
+                    mMissingBlocks++;
+                }
+                if (cell->lots().isEmpty() && cell->objects().isEmpty())
+                    continue;
+                writeCell(block, cell);
+                block = Tiled::compress(block, Tiled::Zlib);
+            }
+        }
+
+        QBuffer xml;
+        xml.open(QIODevice::WriteOnly);
+        WorldWriter writer;
+        writer.setCellContentsEnabled(false);
+        writer.writeWorld(world, &xml, absDirPath);
+
+        // The tables come after the blocks because encoding cells adds to them.
+        QByteArray tables;
+        writeVarint(tables, mPaths.size());
+        foreach (const QString &path, mPaths)
+            writeString(tables, relativeFileName(path));
+        writeVarint(tables, mGroupNames.size());
+        foreach (const QString &name, mGroupNames)
+            writeString(tables, name);
+        writeVarint(tables, mTypeNames.size());
+        foreach (const QString &name, mTypeNames)
+            writeString(tables, name);
+        writeVarint(tables, mPropertyDefNames.size());
+        foreach (const QString &name, mPropertyDefNames)
+            writeString(tables, name);
+        writeVarint(tables, mTemplateNames.size());
+        foreach (const QString &name, mTemplateNames)
+            writeString(tables, name);
+
+        QDataStream w(device);
+        w.setByteOrder(QDataStream::LittleEndian);
+
+        w << quint8('P') << quint8('Z') << quint8('W') << quint8('B');
+        w << qint32(PZWB_VERSION1);
+        w << qint32(world->width());
+        w << qint32(world->height());
+
+        const QByteArray header = Tiled::compress(xml.data(), Tiled::Zlib);
+        w << qint32(header.size());
+        w.writeRawData(header.constData(), header.size());
+        tables = Tiled::compress(tables, Tiled::Zlib);
+        w << qint32(tables.size());
+        w.writeRawData(tables.constData(), tables.size());
+
+        quint32 offset = 0;
+        for (const QByteArray &block : qAsConst(blocks)) {
+            w << offset << quint32(block.size());
+            offset += block.size();
+        }
+        for (const QByteArray &block : qAsConst(blocks)) {
+            w.writeRawData(block.constData(), block.size());
+        }
+    }
+
+    // Copied blocks refer to the tables of the file they came from, so those
+    // are kept in the same order.  Renamed groups and types get their new
+    // names.
+    void initTables(World *world)
+    {
+        mPaths.clear();
+        mPathIndex.clear();
+        mGroupNames.clear();
+        mGroupIndex.clear();
+        mTypeNames.clear();
+        mTypeIndex.clear();
+        mPropertyDefNames.clear();
+        mPropertyDefIndex.clear();
+        mTemplateNames.clear();
+        mTemplateIndex.clear();
+
+        WorldCellSource *source = world->cellSource();
+        if (!source)
+            return;
+        const WorldBinaryTables &t = source->tables();
+
+        foreach (const QString &path, t.mPaths) {
+            if (!mPathIndex.contains(path))
+                mPathIndex[path] = mPaths.size();
+            mPaths += path;
+        }
+        for (int i = 0; i < t.mGroups.size(); i++) {
+            WorldObjectGroup *og = t.mGroups[i];
+            const bool exists = world->objectGroups().indexOf(og) != -1;
+            if (exists && !mGroupIndex.contains(og))
+                mGroupIndex[og] = i;
+            mGroupNames += exists ? og->name() : t.mGroupNames[i];
+        }
+        for (int i = 0; i < t.mTypes.size(); i++) {
+            ObjectType *ot = t.mTypes[i];
+            const bool exists = world->objectTypes().indexOf(ot) != -1;
+            if (exists && !mTypeIndex.contains(ot))
+                mTypeIndex[ot] = i;
+            mTypeNames += exists ? ot->name() : t.mTypeNames[i];
+        }
+        for (int i = 0; i < t.mPropertyDefs.size(); i++) {
+            PropertyDef *pd = t.mPropertyDefs[i];
+            const bool exists = pd && world->propertyDefinitions().indexOf(pd) != -1;
+            if (exists && !mPropertyDefIndex.contains(pd))
+                mPropertyDefIndex[pd] = i;
+            mPropertyDefNames += exists ? pd->mName : t.mPropertyDefNames[i];
+        }
+        for (int i = 0; i < t.mTemplates.size(); i++) {
+            PropertyTemplate *pt = t.mTemplates[i];
+            const bool exists = pt && world->propertyTemplates().indexOf(pt) != -1;
+            if (exists && !mTemplateIndex.contains(pt))
+                mTemplateIndex[pt] = i;
+            mTemplateNames += exists ? pt->mName : t.mTemplateNames[i];
+        }
+    }
+
+    template<class T>
+    int tableIndex(QHash<T*,int> &index, QStringList &names, T *item, const QString &name)
+    {
+        typename QHash<T*,int>::const_iterator it = index.constFind(item);
+        if (it != index.constEnd())
+            return it.value();
+        index[item] = names.size();
+        names += name;
+        return names.size() - 1;
+    }
+
+    int pathIndex(const QString &path)
+    {
+        QHash<QString,int>::const_iterator it = mPathIndex.constFind(path);
+        if (it != mPathIndex.constEnd())
+            return it.value();
+        mPathIndex[path] = mPaths.size();
+        mPaths += path;
+        return mPaths.size() - 1;
+    }
+
+    void writeCell(QByteArray &out, WorldCell *cell)
+    {
+        writeVarint(out, cell->lots().size());
+        foreach (WorldCellLot *lot, cell->lots()) {
+            writeVarint(out, pathIndex(lot->mapName()));
+            writeVarint(out, zigzag(lot->x()));
+            writeVarint(out, zigzag(lot->y()));
+            writeVarint(out, zigzag(lot->level()));
+            writeVarint(out, zigzag(lot->width()));
+            writeVarint(out, zigzag(lot->height()));
+        }
+
+        writeVarint(out, cell->objects().size());
+        foreach (WorldCellObject *obj, cell->objects()) {
+            writeString(out, obj->name());
+            writeVarint(out, tableIndex(mGroupIndex, mGroupNames, obj->group(), obj->group()->name()));
+            writeVarint(out, tableIndex(mTypeIndex, mTypeNames, obj->type(), obj->type()->name()));
+            writeVarint(out, quint32(obj->geometryType()));
+            writeVarint(out, zigzag(obj->level()));
+            writeDouble(out, obj->x());
+            writeDouble(out, obj->y());
+            writeDouble(out, obj->width());
+            writeDouble(out, obj->height());
+            writeVarint(out, obj->isVisible() ? 1 : 0);
+
+            if (!obj->isRectangle()) {
+                // Each point is stored relative to the previous one.
+                int prevX = 0, prevY = 0;
+                writeVarint(out, obj->points().size());
+                for (const auto &point : obj->points()) {
+                    writeVarint(out, zigzag(point.x - prevX));
+                    writeVarint(out, zigzag(point.y - prevY));
+                    prevX = point.x;
+                    prevY = point.y;
+                }
+                writeVarint(out, zigzag(obj->polylineWidth()));
+            }
+
+            writeVarint(out, obj->templates().size());
+            foreach (PropertyTemplate *pt, obj->templates())
+                writeVarint(out, tableIndex(mTemplateIndex, mTemplateNames, pt, pt->mName));
+
+            writeVarint(out, obj->properties().size());
+            foreach (Property *p, obj->properties()) {
+                writeVarint(out, tableIndex(mPropertyDefIndex, mPropertyDefNames,
+                                            p->mDefinition, p->mDefinition->mName));
+                writeString(out, p->mValue);
+            }
+        }
+    }
+
+    QString relativeFileName(const QString &path)
+    {
+        if (!path.isEmpty()) {
+            QFileInfo fi(path);
+            if (fi.isAbsolute())
+                return mMapDir.relativeFilePath(path);
+        }
+        return path;
+    }
+
+    QString mError;
+    int mMissingBlocks = 0; // cells not loaded whose block couldn't be copied
+    QDir mMapDir;
+    QStringList mPaths;
+    QHash<QString,int> mPathIndex;
+    QStringList mGroupNames;
+    QHash<WorldObjectGroup*,int> mGroupIndex;
+    QStringList mTypeNames;
+    QHash<ObjectType*,int> mTypeIndex;
+    QStringList mPropertyDefNames;
+    QHash<PropertyDef*,int> mPropertyDefIndex;
+    QStringList mTemplateNames;
+    QHash<PropertyTemplate*,int> mTemplateIndex;
+};
+
+/////
+
+WorldWriterBinary::WorldWriterBinary()
+    : d(new WorldWriterBinaryPrivate)
+{
+}
+
+WorldWriterBinary::~WorldWriterBinary()
+{
+    delete d;
+}
+
+bool WorldWriterBinary::writeWorld(World *world, const QString &filePath)
+{
+    WorldCellSource *source = world->cellSource();
+    if (source && !source->checkReadable(world, d->mError))
+        return false;
+
+    QTemporaryFile tempFile;
+    if (!d->openFile(&tempFile))
+        return false;
+
+    writeWorld(world, &tempFile, QFileInfo(filePath).absolutePath());
+
+    if (tempFile.error() != QFile::NoError) {
+        d->mError = tempFile.errorString();
+        return false;
+    }
+    if (d->mMissingBlocks) {
+        d->mError = WorldWriterBinaryPrivate::tr("%1 cells that haven't been loaded yet could not be copied from %2.")
+                .arg(d->mMissingBlocks).arg(source->fileName());
+        return false;
+    }
+
+    auto replace = [&]() {
+        // foo.pzwb -> foo.pzwb.bak
+        QFileInfo destInfo(filePath);
+        QString backupPath = filePath + QLatin1String(".bak");
+        QFile backupFile(backupPath);
+        if (destInfo.exists()) {
+            if (backupFile.exists()) {
+                if (!backupFile.remove()) {
+                    d->mError = QString(QLatin1String("Error deleting file!\n%1\n\n%2"))
+                            .arg(backupPath)
+                            .arg(backupFile.errorString());
+                    return false;
+                }
+            }
+            QFile destFile(filePath);
+            if (!destFile.rename(backupPath)) {
+                d->mError = QString(QLatin1String("Error renaming file!\nFrom: %1\nTo: %2\n\n%3"))
+                        .arg(filePath)
+                        .arg(backupPath)
+                        .arg(destFile.errorString());
+                return false;
+            }
+        }
+
+        // /tmp/tempXYZ -> foo.pzwb
+        tempFile.close();
+        if (!tempFile.rename(filePath)) {
+            d->mError = QString(QLatin1String("Error renaming file!\nFrom: %1\nTo: %2\n\n%3"))
+                    .arg(tempFile.fileName())
+                    .arg(filePath)
+                    .arg(tempFile.errorString());
+            // Try to un-rename the backup file
+            if (backupFile.exists())
+                backupFile.rename(filePath); // might fail
+            return false;
+        }
+
+        // If anything above failed, the temp file should auto-remove, but not after
+        // a successful save.
+        tempFile.setAutoRemove(false);
+        return true;
+    };
+
+    // The World's own file is closed while it is replaced, and cells not yet
+    // loaded are pointed at the new file.
+    if (source) {
+        if (!source->replaceFile(filePath, world, replace))
+            return false;
+        // Saved, but cells not loaded yet are lost if the file can't be read.
+        QString error;
+        if (!source->checkReadable(world, error)) {
+            d->mError = WorldWriterBinaryPrivate::tr("The world was saved, but could not be opened again.  "
+                           "Reopen the world before saving it again.\n\n%1").arg(error);
+            return false;
+        }
+        return true;
+    }
+    return replace();
+}
+
+void WorldWriterBinary::writeWorld(World *world, QIODevice *device, const QString &absDirPath)
+{
+    d->writeWorld(world, device, absDirPath);
+}
+
+QString WorldWriterBinary::errorString() const
+{
+    return d->mError;
+}
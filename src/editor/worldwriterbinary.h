@@ -0,0 +1,49 @@
+/*
+ * Copyright 2018, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDWRITERBINARY_H
+#define WORLDWRITERBINARY_H
+
+#include <QString>
+
+class World;
+class WorldWriterBinaryPrivate;
+
+class QIODevice;
+
+/**
+  * Writes a World as a .pzwb file; see worldbinary.h for the layout.
+  * The blocks of cells that were never loaded from the World's own .pzwb
+  * file are copied from it without being decoded, so saving costs little
+  * more than the cells that were looked at.
+  */
+class WorldWriterBinary
+{
+public:
+    WorldWriterBinary();
+    ~WorldWriterBinary();
+
+    bool writeWorld(World *world, const QString &filePath);
+    void writeWorld(World *world, QIODevice *device, const QString &absDirPath);
+
+    QString errorString() const;
+
+private:
+    WorldWriterBinaryPrivate *d;
+};
+
+#endif // WORLDWRITERBINARY_H
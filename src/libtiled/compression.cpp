@@ -111,10 +111,10 @@ QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
     return out;
 }
 
-QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
+QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method,
+                           int level)
 {
     QByteArray out;
-    out.resize(1024);
     int err;
     z_stream strm;
     strm.zalloc = Z_NULL;
@@ -122,18 +122,22 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
     strm.opaque = Z_NULL;
     strm.next_in = (Bytef *) data.data();
     strm.avail_in = data.length();
-    strm.next_out = (Bytef *) out.data();
-    strm.avail_out = out.size();
 
     const int windowBits = (method == Gzip) ? 15 + 16 : 15;
 
-    err = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
+    err = deflateInit2(&strm, qBound(-1, level, 9), Z_DEFLATED, windowBits,
                        8, Z_DEFAULT_STRATEGY);
     if (err != Z_OK) {
         logZlibError(err);
         return QByteArray();
     }
 
+    // deflateBound() includes the gzip or zlib header, so the whole stream
+    // fits and the loop below only runs once.
+    out.resize(int(deflateBound(&strm, data.length())));
+    strm.next_out = (Bytef *) out.data();
+    strm.avail_out = out.size();
+
     do {
         err = deflate(&strm, Z_FINISH);
         Q_ASSERT(err != Z_STREAM_ERROR);
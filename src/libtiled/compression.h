@@ -61,11 +61,14 @@ QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
  *
  * Needed because qCompress does not support gzip compression.
  *
- * @param data the uncompressed data
+ * @param data  the uncompressed data
+ * @param level the zlib compression level, from 1 (fastest) to 9
+ *              (smallest), or -1 for zlib's default
  * @return the compressed data, or a null QByteArray if compression failed
  */
 QByteArray TILEDSHARED_EXPORT compress(const QByteArray &data,
-                                       CompressionMethod method = Zlib);
+                                       CompressionMethod method = Zlib,
+                                       int level = -1);
 
 } // namespace Tiled
 
@@ -49,9 +49,9 @@ Cell GidMapper::gidToCell(uint gid, bool &ok) const
     Cell result;
 
     // Read out the flags
-    result.flippedHorizontally = (gid & FlippedHorizontallyFlag);
-    result.flippedVertically = (gid & FlippedVerticallyFlag);
-    result.flippedAntiDiagonally = (gid & FlippedAntiDiagonallyFlag);
+    result.setFlippedHorizontally(gid & FlippedHorizontallyFlag);
+    result.setFlippedVertically(gid & FlippedVerticallyFlag);
+    result.setFlippedAntiDiagonally(gid & FlippedAntiDiagonallyFlag);
 
     // Clear the flags
     gid &= ~(FlippedHorizontallyFlag |
@@ -78,9 +78,9 @@ Cell GidMapper::gidToCell(uint gid, bool &ok) const
                 tileId = row * tileset->columnCount() + column;
             }
 
-            result.tile = tileset->tileAt(tileId);
+            result.setTile(tileset->tileAt(tileId));
         } else {
-            result.tile = 0;
+            result.setTile(0);
         }
 
         ok = true;
@@ -94,7 +94,7 @@ uint GidMapper::cellToGid(const Cell &cell) const
     if (cell.isEmpty())
         return 0;
 
-    const Tileset *tileset = cell.tile->tileset();
+    const Tileset *tileset = cell.tile()->tileset();
 
     // Find the first GID for the tileset
     QMap<uint, Tileset*>::const_iterator i = mFirstGidToTileset.begin();
@@ -105,12 +105,12 @@ uint GidMapper::cellToGid(const Cell &cell) const
     if (i == i_end) // tileset not found
         return 0;
 
-    uint gid = i.key() + cell.tile->id();
-    if (cell.flippedHorizontally)
+    uint gid = i.key() + cell.tile()->id();
+    if (cell.flippedHorizontally())
         gid |= FlippedHorizontallyFlag;
-    if (cell.flippedVertically)
+    if (cell.flippedVertically())
         gid |= FlippedVerticallyFlag;
-    if (cell.flippedAntiDiagonally)
+    if (cell.flippedAntiDiagonally())
         gid |= FlippedAntiDiagonallyFlag;
 
     return gid;
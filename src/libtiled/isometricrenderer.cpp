@@ -261,11 +261,11 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                 const Cell &cell = layer->cellAt(columnItr);
                 if (!cell.isEmpty()) {
 #ifdef ZOMBOID
-                    const QImage &img = cell.tile->image();
+                    const QImage &img = cell.tile()->image();
 #else
-                    const QPixmap &img = cell.tile->image();
+                    const QPixmap &img = cell.tile()->image();
 #endif
-                    const QPoint offset = cell.tile->tileset()->tileOffset();
+                    const QPoint offset = cell.tile()->tileset()->tileOffset();
 
                     qreal m11 = 1;      // Horizontal scaling factor
                     qreal m12 = 0;      // Vertical shearing factor
@@ -274,7 +274,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                     qreal dx = offset.x() + x;
                     qreal dy = offset.y() + y - img.height();
 
-                    if (cell.flippedAntiDiagonally) {
+                    if (cell.flippedAntiDiagonally()) {
                         // Use shearing to swap the X/Y axis
                         m11 = 0;
                         m12 = 1;
@@ -284,16 +284,16 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                         // Compensate for the swap of image dimensions
                         dy += img.height() - img.width();
                     }
-                    if (cell.flippedHorizontally) {
+                    if (cell.flippedHorizontally()) {
                         m11 = -m11;
                         m21 = -m21;
-                        dx += cell.flippedAntiDiagonally ? img.height()
+                        dx += cell.flippedAntiDiagonally() ? img.height()
                                                          : img.width();
                     }
-                    if (cell.flippedVertically) {
+                    if (cell.flippedVertically()) {
                         m12 = -m12;
                         m22 = -m22;
-                        dy += cell.flippedAntiDiagonally ? img.width()
+                        dy += cell.flippedAntiDiagonally() ? img.width()
                                                          : img.height();
                     }
 
@@ -411,8 +411,8 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
                     }
                     const Cell *cell = cells[i];
                     if (!cell->isEmpty()) {
-                        const QImage &img = cell->tile->image();
-                        const QPoint offset = cell->tile->tileset()->tileOffset();
+                        const QImage &img = cell->tile()->image();
+                        const QPoint offset = cell->tile()->tileset()->tileOffset();
 
                         qreal m11 = 1;      // Horizontal scaling factor
                         qreal m12 = 0;      // Vertical shearing factor
@@ -421,7 +421,7 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
                         qreal dx = offset.x() + x;
                         qreal dy = offset.y() + y - img.height();
 
-                        if (cell->flippedAntiDiagonally) {
+                        if (cell->flippedAntiDiagonally()) {
                             // Use shearing to swap the X/Y axis
                             m11 = 0;
                             m12 = 1;
@@ -431,16 +431,16 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
                             // Compensate for the swap of image dimensions
                             dy += img.height() - img.width();
                         }
-                        if (cell->flippedHorizontally) {
+                        if (cell->flippedHorizontally()) {
                             m11 = -m11;
                             m21 = -m21;
-                            dx += cell->flippedAntiDiagonally ? img.height()
+                            dx += cell->flippedAntiDiagonally() ? img.height()
                                                              : img.width();
                         }
-                        if (cell->flippedVertically) {
+                        if (cell->flippedVertically()) {
                             m12 = -m12;
                             m22 = -m22;
-                            dy += cell->flippedAntiDiagonally ? img.width()
+                            dy += cell->flippedAntiDiagonally() ? img.width()
                                                              : img.height();
                         }
 
@@ -25,6 +25,8 @@ SOURCES += compression.cpp \
     isometricrenderer.cpp \
     layer.cpp \
     map.cpp \
+    mapcache.cpp \
+    tilesetpixelcache.cpp \
     mapobject.cpp \
     mapreader.cpp \
     maprenderer.cpp \
@@ -36,6 +38,7 @@ SOURCES += compression.cpp \
     texture_atlas.c \
     tilelayer.cpp \
     tileset.cpp \
+    tileregistry.cpp \
     gidmapper.cpp \
     zlevelrenderer.cpp \
     ztilelayergroup.cpp \
@@ -45,6 +48,8 @@ HEADERS += compression.h \
     isometricrenderer.h \
     layer.h \
     map.h \
+    mapcache.h \
+    tilesetpixelcache.h \
     mapobject.h \
     mapreader.h \
     maprenderer.h \
@@ -59,6 +64,7 @@ HEADERS += compression.h \
     tiled_global.h \
     tilelayer.h \
     tileset.h \
+    tileregistry.h \
     gidmapper.h \
     zlevelrenderer.h \
     ztilelayergroup.h
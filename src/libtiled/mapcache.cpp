@@ -0,0 +1,630 @@
+/*
+ * mapcache.cpp
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mapcache.h"
+
+#include "gidmapper.h"
+#include "map.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <zlib.h>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSysInfo>
+
+using namespace Tiled;
+
+#define CACHE_MAGIC 0x504A4D43 // PZMC
+#define CACHE_VERSION 2
+
+QString MapCache::cacheFileName(const QString &mapFileName)
+{
+    QFileInfo mapFileInfo(mapFileName);
+    return mapFileInfo.absolutePath() + QLatin1String("/.pzeditor/") +
+            mapFileInfo.fileName() + QLatin1String(".bin");
+}
+
+Map *MapCache::readMap(const QString &mapFileName)
+{
+    mError.clear();
+
+    QFileInfo mapFileInfo(mapFileName);
+    QString fileName = cacheFileName(mapFileName);
+    if (!QFileInfo::exists(fileName)) {
+        mError = tr("No cache file for %1").arg(mapFileName);
+        return 0;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        mError = tr("Couldn't open %1").arg(fileName);
+        return 0;
+    }
+    const QByteArray data = file.readAll();
+    file.close();
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version, payloadSize, checksum;
+    quint8 byteOrder;
+    qint64 mapSize, mapModified;
+    in >> magic >> version >> byteOrder >> mapSize >> mapModified
+       >> payloadSize >> checksum;
+
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC) {
+        mError = tr("%1 isn't a map cache file").arg(fileName);
+        return 0;
+    }
+    if (version != CACHE_VERSION || byteOrder != QSysInfo::ByteOrder) {
+        mError = tr("%1 is from a different version").arg(fileName);
+        return 0;
+    }
+    if (mapSize != mapFileInfo.size() ||
+            mapModified != mapFileInfo.lastModified().toMSecsSinceEpoch()) {
+        mError = tr("%1 is out of date").arg(fileName);
+        return 0;
+    }
+
+    const qint64 headerSize = in.device()->pos();
+    if (data.size() - headerSize != qint64(payloadSize) ||
+            crc32(0, reinterpret_cast<const Bytef*>(data.constData() + headerSize),
+                  payloadSize) != checksum) {
+        mError = tr("%1 is corrupt").arg(fileName);
+        return 0;
+    }
+
+    Map *map = readPayload(in, mapFileInfo.absolutePath());
+    if (!map && mError.isEmpty())
+        mError = tr("%1 is corrupt").arg(fileName);
+    return map;
+}
+
+bool MapCache::writeMap(const Map *map, const QString &mapFileName)
+{
+    mError.clear();
+
+    QFileInfo mapFileInfo(mapFileName);
+
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        if (!writePayload(map, mapFileInfo.absolutePath(), out))
+            return false;
+    }
+
+    QString fileName = cacheFileName(mapFileName);
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+        mError = tr("Couldn't create the cache directory for %1").arg(mapFileName);
+        return false;
+    }
+
+    // QSaveFile so a reader in another thread never sees a partial file.
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        mError = file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION)
+        << quint8(QSysInfo::ByteOrder)
+        << qint64(mapFileInfo.size())
+        << qint64(mapFileInfo.lastModified().toMSecsSinceEpoch())
+        << quint32(payload.size())
+        << quint32(crc32(0, reinterpret_cast<const Bytef*>(payload.constData()),
+                         payload.size()));
+    out.writeRawData(payload.constData(), payload.size());
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        mError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+/////
+
+// Arrays of quint32 are written as one block in native byte order; the header
+// records the byte order so a cache file is never read on the wrong machine.
+static void writeArray(QDataStream &out, const QVector<quint32> &v)
+{
+    out << quint32(v.size());
+    out.writeRawData(reinterpret_cast<const char*>(v.constData()),
+                     v.size() * sizeof(quint32));
+}
+
+static bool readArray(QDataStream &in, QVector<quint32> &v)
+{
+    quint32 size;
+    in >> size;
+    if (in.status() != QDataStream::Ok || size > (1 << 28))
+        return false;
+    v.resize(size);
+    const int bytes = size * sizeof(quint32);
+    return in.readRawData(reinterpret_cast<char*>(v.data()), bytes) == bytes;
+}
+
+static void writeProperties(QDataStream &out, const Properties &properties)
+{
+    out << static_cast<const QMap<QString,QString>&>(properties);
+}
+
+static Properties readProperties(QDataStream &in)
+{
+    Properties properties;
+    in >> static_cast<QMap<QString,QString>&>(properties);
+    return properties;
+}
+
+static void writeLayerAttributes(QDataStream &out, const Layer *layer)
+{
+    out << layer->name() << qint32(layer->x()) << qint32(layer->y())
+        << qint32(layer->width()) << qint32(layer->height())
+        << layer->opacity() << layer->isVisible();
+    writeProperties(out, layer->properties());
+}
+
+static void readLayerBounds(QDataStream &in, QString &name, QRect &bounds)
+{
+    qint32 x, y, width, height;
+    in >> name >> x >> y >> width >> height;
+    bounds = QRect(x, y, width, height);
+}
+
+static void readLayerAttributes(QDataStream &in, Layer *layer)
+{
+    float opacity;
+    bool visible;
+    in >> opacity >> visible;
+    layer->setOpacity(opacity);
+    layer->setVisible(visible);
+    layer->mergeProperties(readProperties(in));
+}
+
+/**
+  * Tile layers are stored as runs of non-empty cells: the number of empty
+  * cells to skip, the number of gids that follow, then the gids.  Most layers
+  * in a Project Zomboid map are nearly empty.
+  */
+static QVector<quint32> encodeTileLayer(const TileLayer *tl, const GidMapper &gidMapper)
+{
+    QVector<quint32> encoded;
+    const int size = tl->width() * tl->height();
+    int skip = 0;
+    int runStart = -1;
+    for (int i = 0; i < size; i++) {
+        const Cell &cell = tl->cellAt(i % tl->width(), i / tl->width());
+        const uint gid = gidMapper.cellToGid(cell);
+        if (gid == 0) {
+            if (runStart != -1) {
+                encoded[runStart] = encoded.size() - runStart - 1;
+                runStart = -1;
+            }
+            ++skip;
+            continue;
+        }
+        if (runStart == -1) {
+            encoded += skip;
+            runStart = encoded.size();
+            encoded += 0;
+            skip = 0;
+        }
+        encoded += gid;
+    }
+    if (runStart != -1)
+        encoded[runStart] = encoded.size() - runStart - 1;
+    return encoded;
+}
+
+static bool decodeTileLayer(TileLayer *tl, const QVector<quint32> &encoded,
+                            const GidMapper &gidMapper)
+{
+    const int size = tl->width() * tl->height();
+    int pos = 0;
+    int i = 0;
+    while (i + 1 < encoded.size()) {
+        pos += encoded[i++];
+        const int count = encoded[i++];
+        if (count < 0 || pos + count > size || i + count > encoded.size())
+            return false;
+        for (int n = 0; n < count; n++, pos++) {
+            bool ok;
+            const Cell cell = gidMapper.gidToCell(encoded[i++], ok);
+            if (!ok)
+                return false;
+            tl->setCell(pos % tl->width(), pos / tl->width(), cell);
+        }
+    }
+    return i == encoded.size();
+}
+
+// BMP images are mostly large areas of a single color, stored as (count, rgb)
+// pairs.
+static QVector<quint32> encodeBmp(const MapBmp &bmp)
+{
+    QVector<quint32> encoded;
+    const QImage image = bmp.image();
+    for (int y = 0; y < image.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); x++) {
+            if (!encoded.isEmpty() && encoded.last() == line[x])
+                ++encoded[encoded.size() - 2];
+            else
+                encoded << 1 << line[x];
+        }
+    }
+    return encoded;
+}
+
+static bool decodeBmp(MapBmp &bmp, const QVector<quint32> &encoded)
+{
+    QImage &image = bmp.rimage();
+    const int width = image.width();
+    const int size = width * image.height();
+    if (encoded.size() % 2)
+        return false;
+    int pos = 0;
+    for (int i = 0; i < encoded.size(); i += 2) {
+        const int count = encoded[i];
+        if (count < 0 || pos + count > size)
+            return false;
+        for (int n = 0; n < count; n++, pos++)
+            reinterpret_cast<QRgb*>(image.scanLine(pos / width))[pos % width] = encoded[i + 1];
+    }
+    return pos == size;
+}
+
+// The reverse of MapReader::resolveReference(), as MapWriter does it.
+static QString relativePath(const QDir &mapDir, const QString &path)
+{
+    return QDir::isAbsolutePath(path) ? mapDir.relativeFilePath(path) : path;
+}
+
+// The same as MapReaderWorker_MapReader::resolveReference() in the editor,
+// which makes the path canonical when the file exists, so a map read from the
+// cache has the same paths as one read from the TMX file.
+static QString absolutePath(const QString &mapPath, const QString &path)
+{
+    if (path.isEmpty())
+        return path;
+    QString resolved = QDir::isRelativePath(path) ? mapPath + QLatin1Char('/') + path : path;
+    QString canonical = QFileInfo(resolved).canonicalFilePath();
+    return canonical.isEmpty() ? resolved : canonical;
+}
+
+static bool isLot(const QString &name)
+{
+    return name == QLatin1String("lot");
+}
+
+enum {
+    CachedTileLayer,
+    CachedObjectGroup
+};
+
+bool MapCache::writePayload(const Map *map, const QString &mapPath, QDataStream &out)
+{
+    const QDir mapDir(mapPath);
+
+    foreach (Tileset *ts, map->tilesets()) {
+        if (!ts->fileName().isEmpty()) {
+            mError = tr("External tilesets aren't cached");
+            return false;
+        }
+    }
+    foreach (Layer *layer, map->layers()) {
+        if (layer->isImageLayer()) {
+            mError = tr("Image layers aren't cached");
+            return false;
+        }
+    }
+
+    out << qint32(map->orientation())
+        << qint32(map->width()) << qint32(map->height())
+        << qint32(map->tileWidth()) << qint32(map->tileHeight());
+    writeProperties(out, map->properties());
+
+    out << quint32(map->tilesets().size());
+    foreach (Tileset *ts, map->tilesets()) {
+        out << ts->name() << qint32(ts->tileWidth()) << qint32(ts->tileHeight())
+            << qint32(ts->tileSpacing()) << qint32(ts->margin())
+            << ts->tileOffset() << ts->transparentColor()
+            << relativePath(mapDir, ts->imageSource())
+            << qint32(ts->imageWidth()) << qint32(ts->imageHeight())
+            << qint32(ts->tileCount());
+        writeProperties(out, ts->properties());
+        QList<Tile*> tiles;
+        for (int i = 0; i < ts->tileCount(); i++) {
+            if (!ts->tileAt(i)->properties().isEmpty())
+                tiles += ts->tileAt(i);
+        }
+        out << quint32(tiles.size());
+        foreach (Tile *tile, tiles) {
+            out << qint32(tile->id());
+            writeProperties(out, tile->properties());
+        }
+    }
+
+    GidMapper gidMapper(map->tilesets());
+
+    out << quint32(map->layerCount());
+    foreach (Layer *layer, map->layers()) {
+        if (TileLayer *tl = layer->asTileLayer()) {
+            out << quint8(CachedTileLayer);
+            writeLayerAttributes(out, tl);
+            writeArray(out, encodeTileLayer(tl, gidMapper));
+        } else if (ObjectGroup *og = layer->asObjectGroup()) {
+            out << quint8(CachedObjectGroup);
+            writeLayerAttributes(out, og);
+            out << og->color();
+            out << quint32(og->objectCount());
+            foreach (MapObject *mo, og->objects()) {
+                const QString type = isLot(mo->name()) ? relativePath(mapDir, mo->type())
+                                                       : mo->type();
+                out << mo->name() << type << mo->position() << mo->size()
+                    << quint32(gidMapper.cellToGid(Cell(mo->tile())))
+                    << mo->isVisible() << qint32(mo->shape()) << mo->polygon();
+                writeProperties(out, mo->properties());
+            }
+        }
+    }
+
+    const BmpSettings *settings = map->bmpSettings();
+    out << relativePath(mapDir, settings->rulesFile())
+        << relativePath(mapDir, settings->blendsFile())
+        << settings->isBlendEdgesEverywhere();
+    out << quint32(settings->aliases().size());
+    foreach (BmpAlias *alias, settings->aliases())
+        out << alias->name << alias->tiles;
+    out << quint32(settings->rules().size());
+    foreach (BmpRule *rule, settings->rules())
+        out << rule->label << qint32(rule->bitmapIndex) << quint32(rule->color)
+            << rule->tileChoices << rule->targetLayer << quint32(rule->condition);
+    out << quint32(settings->blends().size());
+    foreach (BmpBlend *blend, settings->blends())
+        out << blend->targetLayer << blend->mainTile << blend->blendTile
+            << qint32(blend->dir) << blend->ExclusionList << blend->exclude2;
+
+    for (int i = 0; i < 2; i++) {
+        const MapBmp bmp = map->bmp(i);
+        out << quint32(bmp.rands().seed());
+        writeArray(out, encodeBmp(bmp));
+    }
+
+    QList<MapNoBlend*> noBlends = map->noBlends();
+    out << quint32(noBlends.size());
+    foreach (MapNoBlend *noBlend, noBlends) {
+        QByteArray bits((noBlend->width() * noBlend->height() + 7) / 8, 0);
+        char *data = bits.data();
+        for (int y = 0; y < noBlend->height(); y++) {
+            for (int x = 0; x < noBlend->width(); x++) {
+                if (noBlend->get(x, y)) {
+                    const int i = x + y * noBlend->width();
+                    data[i / 8] |= 1 << (i % 8);
+                }
+            }
+        }
+        out << noBlend->layerName() << bits;
+    }
+
+    return out.status() == QDataStream::Ok;
+}
+
+Map *MapCache::readPayload(QDataStream &in, const QString &mapPath)
+{
+    qint32 orientation, width, height, tileWidth, tileHeight;
+    in >> orientation >> width >> height >> tileWidth >> tileHeight;
+    if (in.status() != QDataStream::Ok || width <= 0 || height <= 0)
+        return 0;
+
+    Map *map = new Map(Map::Orientation(orientation), width, height,
+                       tileWidth, tileHeight);
+    map->mergeProperties(readProperties(in));
+
+    quint32 tilesetCount;
+    in >> tilesetCount;
+    for (quint32 i = 0; i < tilesetCount && in.status() == QDataStream::Ok; i++) {
+        QString name, imageSource;
+        qint32 tileWidth, tileHeight, spacing, margin;
+        qint32 imageWidth, imageHeight, tileCount;
+        QPoint tileOffset;
+        QColor transparentColor;
+        in >> name >> tileWidth >> tileHeight >> spacing >> margin
+           >> tileOffset >> transparentColor >> imageSource
+           >> imageWidth >> imageHeight >> tileCount;
+        if (tileWidth <= 0 || tileHeight <= 0 || spacing < 0 || margin < 0)
+            goto corrupt;
+
+        Tileset *ts = new Tileset(name, tileWidth, tileHeight, spacing, margin);
+        map->addTileset(ts);
+        ts->setTileOffset(tileOffset);
+        ts->setTransparentColor(transparentColor);
+        ts->mergeProperties(readProperties(in));
+        if (!imageSource.isEmpty())
+            ts->loadFromNothing(QSize(imageWidth, imageHeight),
+                                absolutePath(mapPath, imageSource));
+        if (ts->tileCount() != tileCount)
+            goto corrupt;
+
+        quint32 tileCountWithProperties;
+        in >> tileCountWithProperties;
+        for (quint32 j = 0; j < tileCountWithProperties; j++) {
+            qint32 id;
+            in >> id;
+            if (id < 0 || id >= ts->tileCount())
+                goto corrupt;
+            ts->tileAt(id)->mergeProperties(readProperties(in));
+        }
+    }
+
+    {
+        GidMapper gidMapper(map->tilesets());
+
+        quint32 layerCount;
+        in >> layerCount;
+        for (quint32 i = 0; i < layerCount && in.status() == QDataStream::Ok; i++) {
+            quint8 type;
+            QString name;
+            QRect r;
+            in >> type;
+            readLayerBounds(in, name, r);
+            if (type == CachedTileLayer) {
+                TileLayer *tl = new TileLayer(name, r.x(), r.y(), r.width(), r.height());
+                map->addLayer(tl);
+                readLayerAttributes(in, tl);
+                QVector<quint32> encoded;
+                if (!readArray(in, encoded) || !decodeTileLayer(tl, encoded, gidMapper))
+                    goto corrupt;
+            } else if (type == CachedObjectGroup) {
+                ObjectGroup *og = new ObjectGroup(name, r.x(), r.y(), r.width(), r.height());
+                map->addLayer(og);
+                readLayerAttributes(in, og);
+                QColor color;
+                quint32 objectCount;
+                in >> color >> objectCount;
+                og->setColor(color);
+                for (quint32 j = 0; j < objectCount && in.status() == QDataStream::Ok; j++) {
+                    QString name, type;
+                    QPointF pos;
+                    QSizeF size;
+                    quint32 gid;
+                    bool visible;
+                    qint32 shape;
+                    QPolygonF polygon;
+                    in >> name >> type >> pos >> size >> gid >> visible
+                       >> shape >> polygon;
+                    if (isLot(name))
+                        type = absolutePath(mapPath, type);
+                    MapObject *mo = new MapObject(name, type, pos, size);
+                    og->addObject(mo);
+                    if (gid) {
+                        bool ok;
+                        mo->setTile(gidMapper.gidToCell(gid, ok).tile());
+                    }
+                    mo->setVisible(visible);
+                    mo->setShape(MapObject::Shape(shape));
+                    mo->setPolygon(polygon);
+                    mo->mergeProperties(readProperties(in));
+                }
+            } else {
+                goto corrupt;
+            }
+        }
+
+        BmpSettings *settings = map->rbmpSettings();
+        QString rulesFile, blendsFile;
+        bool edgesEverywhere;
+        in >> rulesFile >> blendsFile >> edgesEverywhere;
+        settings->setRulesFile(absolutePath(mapPath, rulesFile));
+        settings->setBlendsFile(absolutePath(mapPath, blendsFile));
+        settings->setBlendEdgesEverywhere(edgesEverywhere);
+
+        quint32 count;
+        in >> count;
+        QList<BmpAlias*> aliases;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QString name;
+            QStringList tiles;
+            in >> name >> tiles;
+            aliases += new BmpAlias(name, tiles);
+        }
+        settings->setAliases(aliases);
+
+        in >> count;
+        QList<BmpRule*> rules;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QString label, targetLayer;
+            qint32 bitmapIndex;
+            quint32 color, condition;
+            QStringList tileChoices;
+            in >> label >> bitmapIndex >> color >> tileChoices >> targetLayer
+               >> condition;
+            rules += new BmpRule(label, bitmapIndex, color, tileChoices,
+                                 targetLayer, condition);
+        }
+        settings->setRules(rules);
+
+        in >> count;
+        QList<BmpBlend*> blends;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QString targetLayer, mainTile, blendTile;
+            qint32 dir;
+            QStringList exclusions, exclude2;
+            in >> targetLayer >> mainTile >> blendTile >> dir >> exclusions
+               >> exclude2;
+            blends += new BmpBlend(targetLayer, mainTile, blendTile,
+                                   BmpBlend::Direction(dir), exclusions, exclude2);
+        }
+        settings->setBlends(blends);
+
+        for (int i = 0; i < 2; i++) {
+            MapBmp &bmp = map->rbmp(i);
+            quint32 seed;
+            in >> seed;
+            if (seed != bmp.rands().seed())
+                bmp.rrands().setSeed(seed);
+            QVector<quint32> encoded;
+            if (!readArray(in, encoded) || !decodeBmp(bmp, encoded))
+                goto corrupt;
+        }
+
+        in >> count;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            QString layerName;
+            QByteArray bits;
+            in >> layerName >> bits;
+            MapNoBlend *noBlend = map->noBlend(layerName);
+            if (bits.size() != (noBlend->width() * noBlend->height() + 7) / 8)
+                goto corrupt;
+            for (int y = 0; y < noBlend->height(); y++) {
+                for (int x = 0; x < noBlend->width(); x++) {
+                    const int n = x + y * noBlend->width();
+                    if (bits[n / 8] & (1 << (n % 8)))
+                        noBlend->set(x, y, true);
+                }
+            }
+        }
+    }
+
+    if (in.status() == QDataStream::Ok && in.atEnd())
+        return map;
+
+corrupt:
+    // The tilesets are not owned by the map
+    qDeleteAll(map->tilesets());
+    delete map;
+    return 0;
+}
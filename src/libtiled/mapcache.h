@@ -0,0 +1,89 @@
+/*
+ * mapcache.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include "tiled_global.h"
+
+#include <QCoreApplication>
+#include <QString>
+
+class QDataStream;
+
+namespace Tiled {
+
+class Map;
+
+/**
+  * Reads and writes a binary snapshot of a Map so that TMX files don't have
+  * to be parsed with MapReader every time they are loaded.
+  *
+  * The cache file holds the size and modification time of the TMX file it
+  * was created from.  readMap() fails if the TMX file has changed since then,
+  * or if the cache file is from a different version or fails its checksum.
+  * Tileset images are not loaded, as with MapReader under ZOMBOID.
+  *
+  * Tileset images, lots and the BMP rules and blends files are stored
+  * relative to the TMX file, as MapWriter does, so a cache file still works
+  * after the directory holding the maps is moved.
+  */
+class TILEDSHARED_EXPORT MapCache
+{
+    Q_DECLARE_TR_FUNCTIONS(MapCache)
+
+public:
+    /**
+      * Returns the name of the cache file for the given TMX file.  It lives
+      * in the same .pzeditor directory used for map thumbnails.  The
+      * directory isn't created until a cache file is written.
+      */
+    static QString cacheFileName(const QString &mapFileName);
+
+    /**
+      * Reads the map cached for \a mapFileName.  Returns 0 if there is no
+      * cache file or it is out of date, in which case errorString() says why.
+      */
+    Map *readMap(const QString &mapFileName);
+
+    /**
+      * Writes the cache file for \a map, which was read from \a mapFileName.
+      * Maps with image layers or external tilesets are not cached.
+      */
+    bool writeMap(const Map *map, const QString &mapFileName);
+
+    QString errorString() const
+    { return mError; }
+
+private:
+    Map *readPayload(QDataStream &in, const QString &mapPath);
+    bool writePayload(const Map *map, const QString &mapPath, QDataStream &out);
+
+    QString mError;
+};
+
+} // namespace Tiled
+
+#endif // MAPCACHE_H
@@ -830,7 +830,7 @@ MapObject *MapReaderPrivate::readObject()
                                                               size.y()));
     if (gid) {
         const Cell cell = cellForGid(gid);
-        object->setTile(cell.tile);
+        object->setTile(cell.tile());
     }
 
     bool ok;
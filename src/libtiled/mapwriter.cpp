@@ -42,6 +42,9 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 #include <QXmlStreamWriter>
 #ifdef ZOMBOID
 #include "qtlockedfile.h"
@@ -73,15 +76,21 @@ public:
     bool openFile(QFile *file);
 #endif
 
+    QByteArray encodeTileData(const TileLayer *tileLayer) const;
+
     QString mError;
     MapWriter::LayerDataFormat mLayerDataFormat;
+    int mCompressionLevel;
+    int mThreadCount;
     bool mDtdEnabled;
 
 private:
     void writeMap(QXmlStreamWriter &w, const Map *map);
     void writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                       uint firstGid);
-    void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer);
+    void encodeTileLayers(const Map *map);
+    void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer,
+                        const QByteArray &encoded);
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer *layer);
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup *objectGroup);
     void writeObject(QXmlStreamWriter &w, const MapObject *mapObject);
@@ -93,11 +102,13 @@ private:
     void writeBmpSettings(QXmlStreamWriter &w, const BmpSettings *settings);
     void writeBmpImage(QXmlStreamWriter &w, int index, const MapBmp &bmp);
     void writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend);
+    QVector<uint> layerGids(const TileLayer *tileLayer) const;
 #endif
 
     QDir mMapDir;     // The directory in which the map is being saved
     GidMapper mGidMapper;
     bool mUseAbsolutePaths;
+    QVector<QByteArray> mEncodedLayers; // Base64 tile data by layer index
 };
 
 } // namespace Internal
@@ -106,6 +117,8 @@ private:
 
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(MapWriter::Base64Gzip)
+    , mCompressionLevel(-1)
+    , mThreadCount(0)
     , mDtdEnabled(false)
     , mUseAbsolutePaths(false)
 {
@@ -204,10 +217,14 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         firstGid += tileset->tileCount();
     }
 
-    foreach (const Layer *layer, map->layers()) {
+    encodeTileLayers(map);
+
+    for (int i = 0; i < map->layerCount(); i++) {
+        const Layer *layer = map->layerAt(i);
         const Layer::Type type = layer->type();
         if (type == Layer::TileLayerType)
-            writeTileLayer(w, static_cast<const TileLayer*>(layer));
+            writeTileLayer(w, static_cast<const TileLayer*>(layer),
+                           mEncodedLayers.value(i));
         else if (type == Layer::ObjectGroupType)
             writeObjectGroup(w, static_cast<const ObjectGroup*>(layer));
         else if (type == Layer::ImageLayerType)
@@ -222,6 +239,8 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         writeNoBlend(w, noBlend);
 #endif
 
+    mEncodedLayers.clear();
+
     w.writeEndElement();
 }
 
@@ -318,8 +337,103 @@ void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
     w.writeEndElement();
 }
 
+namespace {
+
+class EncodeTileLayerTask : public QRunnable
+{
+public:
+    EncodeTileLayerTask(const MapWriterPrivate *writer,
+                        const TileLayer *tileLayer, QByteArray *encoded) :
+        mWriter(writer),
+        mTileLayer(tileLayer),
+        mEncoded(encoded)
+    {
+    }
+
+    void run() override
+    {
+        *mEncoded = mWriter->encodeTileData(mTileLayer);
+    }
+
+private:
+    const MapWriterPrivate *mWriter;
+    const TileLayer *mTileLayer;
+    QByteArray *mEncoded;
+};
+
+} // namespace
+
+/**
+ * Builds, compresses and base64-encodes the data of every tile layer ahead
+ * of writing, spread over several threads.  Only the binary formats are
+ * done this way; XML and CSV are written straight to the stream.
+ */
+void MapWriterPrivate::encodeTileLayers(const Map *map)
+{
+    mEncodedLayers.clear();
+    if (mLayerDataFormat != MapWriter::Base64
+            && mLayerDataFormat != MapWriter::Base64Gzip
+            && mLayerDataFormat != MapWriter::Base64Zlib)
+        return;
+
+    mEncodedLayers.resize(map->layerCount());
+
+    QList<int> tileLayers;
+    for (int i = 0; i < map->layerCount(); i++) {
+        if (map->layerAt(i)->isTileLayer())
+            tileLayers += i;
+    }
+
+    const int threadCount = (mThreadCount > 0) ? mThreadCount : QThread::idealThreadCount();
+    if (tileLayers.size() < 2 || threadCount < 2) {
+        foreach (int i, tileLayers)
+            mEncodedLayers[i] = encodeTileData(map->layerAt(i)->asTileLayer());
+        return;
+    }
+
+    // Each task writes to its own element, which was allocated above.
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(threadCount);
+    foreach (int i, tileLayers)
+        threadPool.start(new EncodeTileLayerTask(this, map->layerAt(i)->asTileLayer(),
+                                                 &mEncodedLayers[i]));
+    threadPool.waitForDone();
+}
+
+QByteArray MapWriterPrivate::encodeTileData(const TileLayer *tileLayer) const
+{
+#ifdef ZOMBOID
+    const QVector<uint> gids = layerGids(tileLayer);
+#endif
+
+    QByteArray tileData;
+    tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
+
+    for (int y = 0; y < tileLayer->height(); ++y) {
+        for (int x = 0; x < tileLayer->width(); ++x) {
+#ifdef ZOMBOID
+            const uint gid = gids[x + y * tileLayer->width()];
+#else
+            const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+#endif
+            tileData.append((char) (gid));
+            tileData.append((char) (gid >> 8));
+            tileData.append((char) (gid >> 16));
+            tileData.append((char) (gid >> 24));
+        }
+    }
+
+    if (mLayerDataFormat == MapWriter::Base64Gzip)
+        tileData = compress(tileData, Gzip, mCompressionLevel);
+    else if (mLayerDataFormat == MapWriter::Base64Zlib)
+        tileData = compress(tileData, Zlib, mCompressionLevel);
+
+    return tileData.toBase64();
+}
+
 void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
-                                      const TileLayer *tileLayer)
+                                      const TileLayer *tileLayer,
+                                      const QByteArray &encoded)
 {
     w.writeStartElement(QLatin1String("layer"));
     writeLayerAttributes(w, tileLayer);
@@ -348,10 +462,20 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
     if (!compression.isEmpty())
         w.writeAttribute(QLatin1String("compression"), compression);
 
+#ifdef ZOMBOID
+    QVector<uint> gids;
+    if (mLayerDataFormat == MapWriter::XML || mLayerDataFormat == MapWriter::CSV)
+        gids = layerGids(tileLayer);
+#endif
+
     if (mLayerDataFormat == MapWriter::XML) {
         for (int y = 0; y < tileLayer->height(); ++y) {
             for (int x = 0; x < tileLayer->width(); ++x) {
+#ifdef ZOMBOID
+                const uint gid = gids[x + y * tileLayer->width()];
+#else
                 const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+#endif
                 w.writeStartElement(QLatin1String("tile"));
                 w.writeAttribute(QLatin1String("gid"), QString::number(gid));
                 w.writeEndElement();
@@ -362,7 +486,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
 
         for (int y = 0; y < tileLayer->height(); ++y) {
             for (int x = 0; x < tileLayer->width(); ++x) {
+#ifdef ZOMBOID
+                const uint gid = gids[x + y * tileLayer->width()];
+#else
                 const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+#endif
                 tileData.append(QString::number(gid));
                 if (x != tileLayer->width() - 1
                     || y != tileLayer->height() - 1)
@@ -374,26 +502,8 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
         w.writeCharacters(QLatin1String("\n"));
         w.writeCharacters(tileData);
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
-
-        if (mLayerDataFormat == MapWriter::Base64Gzip)
-            tileData = compress(tileData, Gzip);
-        else if (mLayerDataFormat == MapWriter::Base64Zlib)
-            tileData = compress(tileData, Zlib);
-
         w.writeCharacters(QLatin1String("\n   "));
-        w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
+        w.writeCharacters(QString::fromLatin1(encoded));
         w.writeCharacters(QLatin1String("\n  "));
     }
 
@@ -752,6 +862,18 @@ void MapWriterPrivate::writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend)
 
     w.writeEndElement(); // bmp-noblend
 }
+
+// Returns the gid of every cell of the layer in row order.  Empty cells are
+// gid 0, so only the non-empty cells need to be looked at.
+QVector<uint> MapWriterPrivate::layerGids(const TileLayer *tileLayer) const
+{
+    const int width = tileLayer->width();
+    QVector<uint> gids(width * tileLayer->height(), 0);
+    SparseTileGrid::Iterator it = tileLayer->cells(QRect(0, 0, width, tileLayer->height()));
+    while (it.next())
+        gids[it.x() + it.y() * width] = mGidMapper.cellToGid(it.cell());
+    return gids;
+}
 #endif // ZOMBOID
 
 MapWriter::MapWriter()
@@ -831,6 +953,26 @@ MapWriter::LayerDataFormat MapWriter::layerDataFormat() const
     return d->mLayerDataFormat;
 }
 
+void MapWriter::setCompressionLevel(int level)
+{
+    d->mCompressionLevel = level;
+}
+
+int MapWriter::compressionLevel() const
+{
+    return d->mCompressionLevel;
+}
+
+void MapWriter::setThreadCount(int count)
+{
+    d->mThreadCount = count;
+}
+
+int MapWriter::threadCount() const
+{
+    return d->mThreadCount;
+}
+
 void MapWriter::setDtdEnabled(bool enabled)
 {
     d->mDtdEnabled = enabled;
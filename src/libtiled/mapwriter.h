@@ -114,6 +114,22 @@ public:
     void setLayerDataFormat(LayerDataFormat format);
     LayerDataFormat layerDataFormat() const;
 
+    /**
+     * Sets the zlib level used by the Base64Gzip and Base64Zlib formats,
+     * from 1 (fastest) to 9 (smallest).  The default, -1, is zlib's own
+     * default level.
+     */
+    void setCompressionLevel(int level);
+    int compressionLevel() const;
+
+    /**
+     * Sets how many threads encode the tile layers of a map.  Layers are
+     * still written in order.  The default, 0, uses
+     * QThread::idealThreadCount().
+     */
+    void setThreadCount(int count);
+    int threadCount() const;
+
     /**
      * Sets whether the DTD reference is written when saving the map.
      */
@@ -254,11 +254,11 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
                 continue;
 
 #ifdef ZOMBOID
-            const QImage &img = cell.tile->image();
+            const QImage &img = cell.tile()->image();
 #else
-            const QPixmap &img = cell.tile->image();
+            const QPixmap &img = cell.tile()->image();
 #endif
-            const QPoint offset = cell.tile->tileset()->tileOffset();
+            const QPoint offset = cell.tile()->tileset()->tileOffset();
 
             qreal m11 = 1;      // Horizontal scaling factor
             qreal m12 = 0;      // Vertical shearing factor
@@ -267,7 +267,7 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
             qreal dx = offset.x() + x * tileWidth;
             qreal dy = offset.y() + (y + 1) * tileHeight - img.height();
 
-            if (cell.flippedAntiDiagonally) {
+            if (cell.flippedAntiDiagonally()) {
                 // Use shearing to swap the X/Y axis
                 m11 = 0;
                 m12 = 1;
@@ -277,15 +277,15 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
                 // Compensate for the swap of image dimensions
                 dy += img.height() - img.width();
             }
-            if (cell.flippedHorizontally) {
+            if (cell.flippedHorizontally()) {
                 m11 = -m11;
                 m21 = -m21;    
-                dx += cell.flippedAntiDiagonally ? img.height() : img.width();
+                dx += cell.flippedAntiDiagonally() ? img.height() : img.width();
             }
-            if (cell.flippedVertically) {
+            if (cell.flippedVertically()) {
                 m12 = -m12;
                 m22 = -m22;
-                dy += cell.flippedAntiDiagonally ? img.width() : img.height();
+                dy += cell.flippedAntiDiagonally() ? img.width() : img.height();
             }
 
             const QTransform transform(m11, m12, m21, m22, dx, dy);
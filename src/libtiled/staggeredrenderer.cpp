@@ -208,11 +208,11 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
             }
 
 #ifdef ZOMBOID
-            const QImage &img = cell.tile->image();
+            const QImage &img = cell.tile()->image();
 #else
-            const QPixmap &img = cell.tile->image();
+            const QPixmap &img = cell.tile()->image();
 #endif
-            const QPoint offset = cell.tile->tileset()->tileOffset();
+            const QPoint offset = cell.tile()->tileset()->tileOffset();
 
             qreal m11 = 1;      // Horizontal scaling factor
             qreal m12 = 0;      // Vertical shearing factor
@@ -221,7 +221,7 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
             qreal dx = offset.x() + rowPos.x();
             qreal dy = offset.y() + rowPos.y() - img.height();
 
-            if (cell.flippedAntiDiagonally) {
+            if (cell.flippedAntiDiagonally()) {
                 // Use shearing to swap the X/Y axis
                 m11 = 0;
                 m12 = 1;
@@ -231,16 +231,16 @@ void StaggeredRenderer::drawTileLayer(QPainter *painter,
                 // Compensate for the swap of image dimensions
                 dy += img.height() - img.width();
             }
-            if (cell.flippedHorizontally) {
+            if (cell.flippedHorizontally()) {
                 m11 = -m11;
                 m21 = -m21;
-                dx += cell.flippedAntiDiagonally ? img.height()
+                dx += cell.flippedAntiDiagonally() ? img.height()
                                                  : img.width();
             }
-            if (cell.flippedVertically) {
+            if (cell.flippedVertically()) {
                 m12 = -m12;
                 m22 = -m22;
-                dy += cell.flippedAntiDiagonally ? img.width()
+                dy += cell.flippedAntiDiagonally() ? img.width()
                                                  : img.height();
             }
 
@@ -38,36 +38,38 @@ using namespace Tiled;
 
 void Tile::setImage(const QImage &image)
 {
+    QRect r = opaqueRect(image, image.rect());
+    setImage(image, r, r.topLeft(), image.size());
+}
+
+void Tile::setImage(const QImage &sheet, const QRect &rect,
+                    const QPoint &offset, const QSize &size)
+{
+    mSheet = QImage();
     mImage = QImage();
     mImageOffset = QPoint(0, 0);
-    mImageSize = image.size();
+    mImageSize = size;
+    if (rect.isEmpty())
+        return;
+    mImageOffset = offset;
 
-    int top = 0;
-    while (top < image.height() && isRowTransparent(image, top))
-        top++;
-    if (top == image.height()) {
+    if (sheet.depth() != 32) {
+        mImage = sheet.copy(rect);
         return;
     }
-    mImageOffset.setY(top);
-
-    int bottom = image.height() - 1;
-    while (bottom > top && isRowTransparent(image, bottom))
-        bottom--;
-
-    int left = 0;
-    while (left < image.width() && isColumnTransparent(image, left))
-        left++;
-    mImageOffset.setX(left);
 
-    int right = image.width() - 1;
-    while (right > left && isColumnTransparent(image, right))
-        right--;
-
-    mImage = image.copy(left, top, right - left + 1, bottom - top + 1);
+    // A read-only QImage over the sheet's pixels.  mSheet holds a reference
+    // so the pixels stay valid even if the tileset replaces its image.
+    mSheet = sheet;
+    const uchar *bits = mSheet.constBits() + rect.y() * mSheet.bytesPerLine()
+            + rect.x() * 4;
+    mImage = QImage(bits, rect.width(), rect.height(), mSheet.bytesPerLine(),
+                    mSheet.format());
 }
 
 void Tile::setEmptyImage(int width, int height)
 {
+    mSheet = QImage();
     mImage = QImage();
     mImageOffset = QPoint(0, 0);
     mImageSize = QSize(width, height);
@@ -95,14 +97,47 @@ QImage Tile::finalImage(int width, int height)
 
 void Tile::setImage(const Tile *tile)
 {
+    mSheet = tile->mSheet;
     mImage = tile->mImage;
     mImageOffset = tile->mImageOffset;
     mImageSize = tile->mImageSize;
 }
 
-bool Tile::isRowTransparent(const QImage &image, int row)
+QRect Tile::opaqueRect(const QImage &image, const QRect &rect)
+{
+    int top = rect.top();
+    while (top <= rect.bottom() && isRowTransparent(image, top, rect.left(), rect.right()))
+        top++;
+    if (top > rect.bottom())
+        return QRect();
+
+    int bottom = rect.bottom();
+    while (bottom > top && isRowTransparent(image, bottom, rect.left(), rect.right()))
+        bottom--;
+
+    int left = rect.left();
+    while (left <= rect.right() && isColumnTransparent(image, left, top, bottom))
+        left++;
+
+    int right = rect.right();
+    while (right > left && isColumnTransparent(image, right, top, bottom))
+        right--;
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+bool Tile::isRowTransparent(const QImage &image, int row, int left, int right)
 {
-    for (int x = 0; x < image.width(); x++) {
+    if (image.format() == QImage::Format_ARGB32_Premultiplied ||
+            image.format() == QImage::Format_ARGB32) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(row));
+        for (int x = left; x <= right; x++) {
+            if (qAlpha(line[x]) > 0)
+                return false;
+        }
+        return true;
+    }
+    for (int x = left; x <= right; x++) {
         QRgb rgb = image.pixel(x, row);
         if (qAlpha(rgb) > 0)
             return false;
@@ -110,9 +145,18 @@ bool Tile::isRowTransparent(const QImage &image, int row)
     return true;
 }
 
-bool Tile::isColumnTransparent(const QImage &image, int col)
+bool Tile::isColumnTransparent(const QImage &image, int col, int top, int bottom)
 {
-    for (int y = 0; y < image.height(); y++) {
+    if (image.format() == QImage::Format_ARGB32_Premultiplied ||
+            image.format() == QImage::Format_ARGB32) {
+        for (int y = top; y <= bottom; y++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            if (qAlpha(line[col]) > 0)
+                return false;
+        }
+        return true;
+    }
+    for (int y = top; y <= bottom; y++) {
         QRgb rgb = image.pixel(col, y);
         if (qAlpha(rgb) > 0)
             return false;
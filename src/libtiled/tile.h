@@ -31,6 +31,7 @@
 #define TILE_H
 
 #include "object.h"
+#include "tileregistry.h"
 
 #include <QPixmap>
 
@@ -44,6 +45,7 @@ public:
 #ifdef ZOMBOID
     Tile(const QImage &image, int id, Tileset *tileset):
         mId(id),
+        mGlobalId(TileRegistry::add(this)),
         mTileset(tileset)
     {
         setImage(image);
@@ -51,6 +53,7 @@ public:
 
     Tile(const Tile *tile, int id, Tileset *tileset):
         mId(id),
+        mGlobalId(TileRegistry::add(this)),
         mTileset(tileset)
     {
         setImage(tile);
@@ -58,6 +61,7 @@ public:
 
     Tile(int width, int height, int id, Tileset *tileset):
         mId(id),
+        mGlobalId(TileRegistry::add(this)),
         mTileset(tileset)
     {
         setEmptyImage(width, height);
@@ -65,16 +69,26 @@ public:
 #else
     Tile(const QPixmap &image, int id, Tileset *tileset):
         mId(id),
+        mGlobalId(TileRegistry::add(this)),
         mTileset(tileset),
         mImage(image)
     {}
 #endif
 
+    ~Tile()
+    { TileRegistry::remove(mGlobalId); }
+
     /**
      * Returns ID of this tile within its tileset.
      */
     int id() const { return mId; }
 
+    /**
+     * Returns the id of this tile in the TileRegistry, which no other live
+     * tile has.
+     */
+    quint32 globalId() const { return mGlobalId; }
+
     /**
      * Returns the tileset that this tile is part of.
      */
@@ -82,7 +96,8 @@ public:
 
 #ifdef ZOMBOID
     /**
-     * Returns the image of this tile.
+     * Returns the image of this tile.  This is usually a view onto part of
+     * the tileset's shared image and doesn't own any pixels.
      */
     const QImage &image() const { return mImage; }
 
@@ -91,6 +106,14 @@ public:
      */
     void setImage(const QImage &image);
     void setImage(const Tile *tile);
+
+    /**
+     * Makes \a rect of \a sheet the image of this tile without copying any
+     * pixels.  \a offset and \a size are the position of \a rect within the
+     * untrimmed tile and the untrimmed size.
+     */
+    void setImage(const QImage &sheet, const QRect &rect,
+                  const QPoint &offset, const QSize &size);
     void setEmptyImage(int width, int height);
 
     void setEmptyImage()
@@ -135,9 +158,15 @@ public:
     void setAtlasSize(const QSize& size)
     { mAtlasSize = size; }
 
+    /**
+     * Returns the smallest part of \a rect in \a image that contains every
+     * pixel that isn't fully transparent.
+     */
+    static QRect opaqueRect(const QImage &image, const QRect &rect);
+
 private:
-    bool isRowTransparent(const QImage &image, int row);
-    bool isColumnTransparent(const QImage &image, int col);
+    static bool isRowTransparent(const QImage &image, int row, int left, int right);
+    static bool isColumnTransparent(const QImage &image, int col, int top, int bottom);
 #else
     /**
      * Returns the image of this tile.
@@ -166,9 +195,13 @@ private:
 #endif
 
 private:
+    Q_DISABLE_COPY(Tile)
+
     int mId;
+    quint32 mGlobalId;
     Tileset *mTileset;
 #ifdef ZOMBOID
+    QImage mSheet; // Keeps the pixels mImage points into alive
     QImage mImage;
     QPoint mImageOffset;
     QSize mImageSize;
@@ -36,6 +36,153 @@
 
 using namespace Tiled;
 
+#ifdef ZOMBOID
+SparseTileGrid::SparseTileGrid(int width, int height)
+    : mWidth(width)
+    , mHeight(height)
+    , mBlocksWide((width + BlockMask) >> BlockShift)
+    , mBlocksHigh((height + BlockMask) >> BlockShift)
+    , mWordsPerRow((mBlocksWide + 31) / 32)
+    , mBlocks(mBlocksWide * mBlocksHigh)
+    , mPresent(mWordsPerRow * mBlocksHigh, 0)
+    , mBlockCount(0)
+{
+}
+
+void SparseTileGrid::replace(int x, int y, const Cell &cell)
+{
+    // A cell with flip flags but no tile is stored as a plain empty cell.
+    // Blocks count cells by tile id, not isEmpty(), so the count stays right
+    // when a tile is deleted while a cell still refers to it.
+    if (!cell.tileId() && cell != mEmptyCell) {
+        replace(x, y, mEmptyCell);
+        return;
+    }
+
+    const int bx = x >> BlockShift, by = y >> BlockShift;
+    QSharedDataPointer<Block> &block = mBlocks[blockIndex(bx, by)];
+    if (!block) {
+        if (!cell.tileId())
+            return;
+        block = new Block;
+        mPresent[by * mWordsPerRow + (bx >> 5)] |= 1u << (bx & 31);
+        ++mBlockCount;
+    }
+
+    // Check before writing so unchanged cells don't detach a shared block.
+    const Cell &current = block.constData()->mCells[cellIndex(x, y)];
+    if (current == cell)
+        return;
+    const bool wasEmpty = !current.tileId();
+
+    block->mCells[cellIndex(x, y)] = cell;
+    if (wasEmpty)
+        ++block->mCount;
+    else if (!cell.tileId() && --block->mCount == 0) {
+        block = nullptr;
+        mPresent[by * mWordsPerRow + (bx >> 5)] &= ~(1u << (bx & 31));
+        --mBlockCount;
+    }
+}
+
+void SparseTileGrid::clear()
+{
+    mBlocks.fill(QSharedDataPointer<Block>());
+    mPresent.fill(0);
+    mBlockCount = 0;
+}
+
+QRect SparseTileGrid::blockBounds() const
+{
+    if (!mBlockCount)
+        return QRect();
+    int left = mBlocksWide, right = -1, top = -1, bottom = -1;
+    for (int by = 0; by < mBlocksHigh; by++) {
+        int bx = nextBlock(0, mBlocksWide - 1, by);
+        if (bx == -1)
+            continue;
+        if (top == -1)
+            top = by;
+        bottom = by;
+        left = qMin(left, bx);
+        for (; bx != -1; bx = nextBlock(bx + 1, mBlocksWide - 1, by))
+            right = qMax(right, bx);
+    }
+    QRect r(QPoint(left << BlockShift, top << BlockShift),
+            QPoint(((right + 1) << BlockShift) - 1, ((bottom + 1) << BlockShift) - 1));
+    return r & QRect(0, 0, mWidth, mHeight);
+}
+
+// Returns the first block between bx1 and bx2 in block row by, or -1.
+int SparseTileGrid::nextBlock(int bx1, int bx2, int by) const
+{
+    const quint32 *row = mPresent.constData() + by * mWordsPerRow;
+    int bx = bx1;
+    while (bx <= bx2) {
+        quint32 word = row[bx >> 5] >> (bx & 31);
+        if (!word) {
+            bx = (bx | 31) + 1;
+            continue;
+        }
+        while (!(word & 1)) {
+            word >>= 1;
+            ++bx;
+        }
+        return (bx <= bx2) ? bx : -1;
+    }
+    return -1;
+}
+
+SparseTileGrid::Iterator::Iterator(const SparseTileGrid &grid, const QRect &rect)
+    : mGrid(&grid)
+    , mCell(0)
+{
+    const QRect r = rect & QRect(0, 0, grid.width(), grid.height());
+    mLeft = r.left();
+    mTop = r.top();
+    mRight = r.right();
+    mBottom = r.bottom();
+    mX = mLeft - 1;
+    mY = r.isEmpty() ? mBottom + 1 : mTop;
+}
+
+bool SparseTileGrid::Iterator::next()
+{
+    int x = mX + 1, y = mY;
+    while (y <= mBottom) {
+        const int by = y >> BlockShift;
+        const int bx = (x <= mRight)
+                ? mGrid->nextBlock(x >> BlockShift, mRight >> BlockShift, by)
+                : -1;
+        if (bx == -1) {
+            // Nothing else in this row.  If nothing was in the whole row,
+            // then nothing is in the rest of this row of blocks either.
+            if (x == mLeft)
+                y |= BlockMask;
+            ++y;
+            x = mLeft;
+            continue;
+        }
+        x = qMax(x, bx << BlockShift);
+        const int end = qMin(mRight, (bx << BlockShift) + BlockMask);
+        const Block *block = mGrid->mBlocks[mGrid->blockIndex(bx, by)].constData();
+        const Cell *cells = block->mCells + ((y & BlockMask) << BlockShift);
+        for (; x <= end; ++x) {
+            const Cell *cell = cells + (x & BlockMask);
+            if (!cell->isEmpty()) {
+                mX = x;
+                mY = y;
+                mCell = cell;
+                return true;
+            }
+        }
+    }
+    mX = mRight;
+    mY = y;
+    return false;
+}
+#endif // ZOMBOID
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height):
     Layer(TileLayerType, name, x, y, width, height),
     mMaxTileSize(0, 0),
@@ -56,6 +203,23 @@ QRegion TileLayer::region() const
 {
     QRegion region;
 
+#if SPARSE_TILELAYER
+    // Cells come in row order, so runs of cells are found by checking
+    // whether each cell continues the previous one.
+    SparseTileGrid::Iterator it(mGrid, QRect(0, 0, mWidth, mHeight));
+    QRect run;
+    while (it.next()) {
+        if (run.isValid() && it.y() == run.top() && it.x() == run.right() + 1) {
+            run.setRight(it.x());
+            continue;
+        }
+        if (run.isValid())
+            region += run.translated(mX, mY);
+        run = QRect(it.x(), it.y(), 1, 1);
+    }
+    if (run.isValid())
+        region += run.translated(mX, mY);
+#else
     for (int y = 0; y < mHeight; ++y) {
         for (int x = 0; x < mWidth; ++x) {
             if (!cellAt(x, y).isEmpty()) {
@@ -71,6 +235,7 @@ QRegion TileLayer::region() const
             }
         }
     }
+#endif
 
     return region;
 }
@@ -95,14 +260,15 @@ void TileLayer::setCell(int x, int y, const Cell &cell)
 {
     Q_ASSERT(contains(x, y));
 
-    if (cell.tile) {
-        int width = cell.tile->width();
-        int height = cell.tile->height();
+    Tile *tile = cell.tile();
+    if (tile) {
+        int width = tile->width();
+        int height = tile->height();
 
-        if (cell.flippedAntiDiagonally)
+        if (cell.flippedAntiDiagonally())
             std::swap(width, height);
 
-        const QPoint offset = cell.tile->tileset()->tileOffset();
+        const QPoint offset = tile->tileset()->tileOffset();
 
         mMaxTileSize = maxSize(QSize(width, height), mMaxTileSize);
         mOffsetMargins = maxMargins(QMargins(-offset.x(),
@@ -116,10 +282,10 @@ void TileLayer::setCell(int x, int y, const Cell &cell)
     }
 
 #ifdef ZOMBOID
-    if (Tile *tile = cellAt(x, y).tile)
-        removeReference(tile->tileset());
-    if (cell.tile)
-        addReference(cell.tile->tileset());
+    if (Tile *oldTile = cellAt(x, y).tile())
+        removeReference(oldTile->tileset());
+    if (tile)
+        addReference(tile->tileset());
 #endif
 
 #if SPARSE_TILELAYER
@@ -216,11 +382,11 @@ void TileLayer::flip(FlipDirection direction)
         for (int x = 0; x < mWidth; ++x) {
             if (direction == FlipHorizontally) {
                 Cell source = cellAt(mWidth - x - 1, y);
-                source.flippedHorizontally = !source.flippedHorizontally;
+                source.setFlippedHorizontally(!source.flippedHorizontally());
                 newGrid.replace(x, y, source);
             } else if (direction == FlipVertically) {
                 Cell source = cellAt(x, mHeight - y - 1);
-                source.flippedVertically = !source.flippedVertically;
+                source.setFlippedVertically(!source.flippedVertically());
                 newGrid.replace(x, y, source);
             }
         }
@@ -236,11 +402,11 @@ void TileLayer::flip(FlipDirection direction)
             if (direction == FlipHorizontally) {
                 const Cell &source = cellAt(mWidth - x - 1, y);
                 dest = source;
-                dest.flippedHorizontally = !source.flippedHorizontally;
+                dest.setFlippedHorizontally(!source.flippedHorizontally());
             } else if (direction == FlipVertically) {
                 const Cell &source = cellAt(x, mHeight - y - 1);
                 dest = source;
-                dest.flippedVertically = !source.flippedVertically;
+                dest.setFlippedVertically(!source.flippedVertically());
             }
         }
     }
@@ -271,15 +437,15 @@ void TileLayer::rotate(RotateDirection direction)
             Cell dest = source;
 
             unsigned char mask =
-                    (dest.flippedHorizontally << 2) |
-                    (dest.flippedVertically << 1) |
-                    (dest.flippedAntiDiagonally << 0);
+                    (dest.flippedHorizontally() << 2) |
+                    (dest.flippedVertically() << 1) |
+                    (dest.flippedAntiDiagonally() << 0);
 
             mask = rotateMask[mask];
 
-            dest.flippedHorizontally = (mask & 4) != 0;
-            dest.flippedVertically = (mask & 2) != 0;
-            dest.flippedAntiDiagonally = (mask & 1) != 0;
+            dest.setFlippedHorizontally((mask & 4) != 0);
+            dest.setFlippedVertically((mask & 2) != 0);
+            dest.setFlippedAntiDiagonally((mask & 1) != 0);
 
 #if SPARSE_TILELAYER
             if (direction == RotateRight)
@@ -314,7 +480,7 @@ QSet<Tileset*> TileLayer::usedTilesets() const
     QSet<Tileset*> tilesets;
 
     for (int i = 0, i_end = mGrid.size(); i < i_end; ++i)
-        if (const Tile *tile = mGrid.at(i).tile)
+        if (const Tile *tile = mGrid.at(i).tile())
             tilesets.insert(tile->tileset());
 
     return tilesets;
@@ -328,7 +494,7 @@ bool TileLayer::referencesTileset(const Tileset *tileset) const
     return mUsedTilesets.contains(key);
 #else
     for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
+        const Tile *tile = mGrid.at(i).tile();
         if (tile && tile->tileset() == tileset)
             return true;
     }
@@ -340,49 +506,62 @@ QRegion TileLayer::tilesetReferences(Tileset *tileset) const
 {
     QRegion region;
 
+#if SPARSE_TILELAYER
+    SparseTileGrid::Iterator it(mGrid, QRect(0, 0, mWidth, mHeight));
+    while (it.next())
+        if (it.cell().tile()->tileset() == tileset)
+            region += QRegion(it.x() + mX, it.y() + mY, 1, 1);
+#else
     for (int y = 0; y < mHeight; ++y)
         for (int x = 0; x < mWidth; ++x)
-            if (const Tile *tile = cellAt(x, y).tile)
+            if (const Tile *tile = cellAt(x, y).tile())
                 if (tile->tileset() == tileset)
                     region += QRegion(x + mX, y + mY, 1, 1);
+#endif
 
     return region;
 }
 
 void TileLayer::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
-#ifdef ZOMBOID
-        if (tile && tile->tileset() == tileset) {
+#if SPARSE_TILELAYER
+    SparseTileGrid::Iterator it(mGrid, QRect(0, 0, mWidth, mHeight));
+    while (it.next()) {
+        if (it.cell().tile()->tileset() == tileset) {
             removeReference(tileset);
-            mGrid.replace(i, Cell());
+            mGrid.replace(it.x(), it.y(), Cell());
         }
+    }
 #else
+    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
+        const Tile *tile = mGrid.at(i).tile();
         if (tile && tile->tileset() == tileset)
             mGrid.replace(i, Cell());
-#endif
     }
+#endif
 }
 
 void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
                                            Tileset *newTileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
-#ifdef ZOMBOID
-        if (tile && tile->tileset() == oldTileset) {
+#if SPARSE_TILELAYER
+    SparseTileGrid::Iterator it(mGrid, QRect(0, 0, mWidth, mHeight));
+    while (it.next()) {
+        if (it.cell().tile()->tileset() == oldTileset) {
             removeReference(oldTileset);
             addReference(newTileset);
+            Cell cell = it.cell();
+            cell.setTile(newTileset->tileAt(cell.tile()->id()));
+            mGrid.replace(it.x(), it.y(), cell);
         }
-#endif
-        if (tile && tile->tileset() == oldTileset)
-#if SPARSE_TILELAYER
-            mGrid.setTile(i, newTileset->tileAt(tile->id()));
+    }
 #else
-            mGrid[i].tile = newTileset->tileAt(tile->id());
-#endif
+    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
+        const Tile *tile = mGrid.at(i).tile();
+        if (tile && tile->tileset() == oldTileset)
+            mGrid[i].setTile(newTileset->tileAt(tile->id()));
     }
+#endif
 }
 
 void TileLayer::resize(const QSize &size, const QPoint &offset)
@@ -403,20 +582,20 @@ void TileLayer::resize(const QSize &size, const QPoint &offset)
     mUsedTilesets.clear();
 #endif
 
+#if SPARSE_TILELAYER
+    SparseTileGrid::Iterator it(mGrid, QRect(startX, startY, endX - startX, endY - startY));
+    while (it.next()) {
+        newGrid.replace(it.x() + offset.x(), it.y() + offset.y(), it.cell());
+        addReference(it.cell().tile()->tileset());
+    }
+#else
     for (int y = startY; y < endY; ++y) {
         for (int x = startX; x < endX; ++x) {
             const int index = x + offset.x() + (y + offset.y()) * size.width();
-#if SPARSE_TILELAYER
-            newGrid.replace(index, cellAt(x, y));
-#else
             newGrid[index] = cellAt(x, y);
-#endif
-#ifdef ZOMBOID
-            if (Tile *tile = cellAt(x, y).tile)
-                addReference(tile->tileset());
-#endif
         }
     }
+#endif
 
     mGrid = newGrid;
     Layer::resize(size, offset);
@@ -446,7 +625,7 @@ void TileLayer::offset(const QPoint &offset,
                 newGrid[x + y * mWidth] = cellAt(x, y);
 #endif
 #ifdef ZOMBOID
-                if (Tile *tile = cellAt(x, y).tile)
+                if (Tile *tile = cellAt(x, y).tile())
                     addReference(tile->tileset());
 #endif
                 continue;
@@ -486,7 +665,7 @@ void TileLayer::offset(const QPoint &offset,
 #endif
 #ifdef ZOMBOID
             if (contains(oldX, oldY) && bounds.contains(oldX, oldY)) {
-                if (Tile *tile = cellAt(oldX, oldY).tile)
+                if (Tile *tile = cellAt(oldX, oldY).tile())
                     addReference(tile->tileset());
             }
 #endif
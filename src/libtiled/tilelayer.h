@@ -33,160 +33,239 @@
 #include "tiled_global.h"
 
 #include "layer.h"
+#include "tile.h"
 #ifdef ZOMBOID
 #include "ztilelayergroup.h"
 #endif
 
 #include <QMargins>
+#include <QRect>
+#include <QSharedData>
 #include <QString>
 #include <QVector>
 
 namespace Tiled {
 
-class Tile;
 class Tileset;
 
 /**
  * A cell on a tile layer grid.
+ *
+ * A cell is 32 bits: the tile's id in the TileRegistry in the low 29 bits
+ * and the flip flags in the top 3, so tile layers and lists of cells take a
+ * quarter of the memory a Tile pointer and three bools would.
  */
 class Cell
 {
 public:
+    enum {
+        FlippedHorizontallyFlag   = 0x80000000,
+        FlippedVerticallyFlag     = 0x40000000,
+        FlippedAntiDiagonallyFlag = 0x20000000,
+        TileIdMask                = 0x1FFFFFFF
+    };
+
     Cell() :
-        tile(0),
-        flippedHorizontally(false),
-        flippedVertically(false),
-        flippedAntiDiagonally(false)
+        mData(0)
     {}
 
     explicit Cell(Tile *tile) :
-        tile(tile),
-        flippedHorizontally(false),
-        flippedVertically(false),
-        flippedAntiDiagonally(false)
+        mData(tile ? tile->globalId() : 0)
     {}
 
-    bool isEmpty() const { return tile == 0; }
+    /**
+     * Returns true if the cell has no tile, or if its tile was deleted since
+     * the cell was set.
+     */
+    bool isEmpty() const { return tile() == 0; }
 
-    bool operator == (const Cell &other) const
+    /**
+     * Returns the tile in this cell, or 0 if the cell is empty or its tile
+     * was deleted.
+     */
+    Tile *tile() const
     {
-        return tile == other.tile
-                && flippedHorizontally == other.flippedHorizontally
-                && flippedVertically == other.flippedVertically
-                && flippedAntiDiagonally == other.flippedAntiDiagonally;
+        const quint32 id = mData & TileIdMask;
+        return id ? TileRegistry::tile(id) : 0;
     }
 
+    void setTile(Tile *tile)
+    { mData = (mData & ~quint32(TileIdMask)) | (tile ? tile->globalId() : 0); }
+
+    /**
+     * Returns the TileRegistry id of the tile in this cell, 0 if no tile was
+     * ever set.  Unlike isEmpty() this doesn't change when the tile is
+     * deleted.
+     */
+    quint32 tileId() const { return mData & TileIdMask; }
+
+    bool flippedHorizontally() const
+    { return mData & FlippedHorizontallyFlag; }
+
+    bool flippedVertically() const
+    { return mData & FlippedVerticallyFlag; }
+
+    bool flippedAntiDiagonally() const
+    { return mData & FlippedAntiDiagonallyFlag; }
+
+    void setFlippedHorizontally(bool flipped)
+    { setFlag(FlippedHorizontallyFlag, flipped); }
+
+    void setFlippedVertically(bool flipped)
+    { setFlag(FlippedVerticallyFlag, flipped); }
+
+    void setFlippedAntiDiagonally(bool flipped)
+    { setFlag(FlippedAntiDiagonallyFlag, flipped); }
+
+    bool operator == (const Cell &other) const
+    { return mData == other.mData; }
+
     bool operator != (const Cell &other) const
+    { return mData != other.mData; }
+
+private:
+    void setFlag(quint32 flag, bool on)
     {
-        return tile != other.tile
-                || flippedHorizontally != other.flippedHorizontally
-                || flippedVertically != other.flippedVertically
-                || flippedAntiDiagonally != other.flippedAntiDiagonally;
+        if (on)
+            mData |= flag;
+        else
+            mData &= ~flag;
     }
 
-    Tile *tile;
-    bool flippedHorizontally;
-    bool flippedVertically;
-    bool flippedAntiDiagonally;
+    quint32 mData;
 };
 
 #ifdef ZOMBOID
 #define SPARSE_TILELAYER 1
 
 /**
-  * This is a QHash-based tile grid.  Project Zomboid maps can be 300x300 with over
-  * 100 tile layers, most of which are mostly empty.  Using a sparse array results in
-  * massive memory savings.
+  * This is a block-sparse tile grid.  Project Zomboid maps can be 300x300 with
+  * over 100 tile layers, most of which are mostly empty.  Cells are stored in
+  * 16x16 blocks that are only allocated once something is put in them, and a
+  * bitmap records which blocks exist so empty parts of a layer can be skipped
+  * without touching the blocks at all.
+  *
+  * Blocks are implicitly shared, so copying a grid (when cloning a layer for
+  * undo, for example) only copies the blocks that are later changed.
   */
-class SparseTileGrid
+class TILEDSHARED_EXPORT SparseTileGrid
 {
 public:
-    SparseTileGrid(int width, int height)
-        : mWidth(width)
-        , mHeight(height)
-        , mUseVector(false)
-    {
-    }
+    enum {
+        BlockShift = 4,
+        BlockSize = 1 << BlockShift,
+        BlockMask = BlockSize - 1
+    };
+
+    SparseTileGrid(int width, int height);
+
+    int width() const
+    { return mWidth; }
+
+    int height() const
+    { return mHeight; }
 
     int size() const
     { return mWidth * mHeight; }
 
     const Cell &at(int index) const
     {
-        if (mUseVector)
-            return mCellsVector[index];
-        QHash<int,Cell>::const_iterator it = mCells.find(index);
-        if (it != mCells.end())
-            return *it;
-        return mEmptyCell;
+        return at(index % mWidth, index / mWidth);
     }
 
     const Cell &at(int x, int y) const
     {
-        return at(y * mWidth + x);
+        const Block *block = mBlocks[blockIndex(x >> BlockShift, y >> BlockShift)].constData();
+        if (block)
+            return block->mCells[cellIndex(x, y)];
+        return mEmptyCell;
     }
 
     void replace(int index, const Cell &cell)
     {
-        if (mUseVector) {
-            mCellsVector[index] = cell;
-            return;
-        }
-        QHash<int,Cell>::iterator it = mCells.find(index);
-        if (it == mCells.end()) {
-            if (cell.isEmpty())
-                return;
-            mCells.insert(index, cell);
-        } else if (!cell.isEmpty())
-            (*it) = cell;
-        else
-            mCells.erase(it);
-        if (mCells.size() > 300 * 300 / 3)
-            swapToVector();
+        replace(index % mWidth, index / mWidth, cell);
     }
 
-    void replace(int x, int y, const Cell &cell)
-    {
-        int index = y * mWidth + x;
-        replace(index, cell);
-    }
+    void replace(int x, int y, const Cell &cell);
 
     void setTile(int index, Tile *tile)
     {
         Cell cell = at(index);
-        cell.tile = tile;
+        cell.setTile(tile);
         replace(index, cell);
     }
 
     bool isEmpty() const
-    { return !mUseVector && mCells.isEmpty(); }
+    { return mBlockCount == 0; }
+
+    void clear();
+
+    /**
+      * Returns the smallest rectangle of whole blocks containing every
+      * non-empty cell, clipped to the grid.
+      */
+    QRect blockBounds() const;
 
-    void clear()
+    /**
+      * Visits the non-empty cells inside a rectangle one row at a time, from
+      * left to right, skipping blocks that have nothing in them.
+      *
+      *     SparseTileGrid::Iterator it(grid, rect);
+      *     while (it.next())
+      *         use(it.x(), it.y(), it.cell());
+      *
+      * Cells already visited may be changed while iterating.
+      */
+    class TILEDSHARED_EXPORT Iterator
     {
-        if (mUseVector)
-            mCellsVector.fill(mEmptyCell);
-        else
-            mCells.clear();
-    }
+    public:
+        Iterator(const SparseTileGrid &grid, const QRect &rect);
+
+        bool next();
+
+        int x() const
+        { return mX; }
+
+        int y() const
+        { return mY; }
+
+        QPoint pos() const
+        { return QPoint(mX, mY); }
+
+        const Cell &cell() const
+        { return *mCell; }
+
+    private:
+        const SparseTileGrid *mGrid;
+        int mLeft, mTop, mRight, mBottom;
+        int mX, mY;
+        const Cell *mCell;
+    };
 
 private:
-    void swapToVector()
+    class Block : public QSharedData
     {
-        Q_ASSERT(!mUseVector);
-        mCellsVector.resize(size());
-        QHash<int,Cell>::const_iterator it = mCells.begin();
-        while (it != mCells.end()) {
-            mCellsVector[it.key()] = (*it);
-            ++it;
-        }
-        mCells.clear();
-        mUseVector = true;
-    }
+    public:
+        Block() : mCount(0) {}
+
+        Cell mCells[BlockSize * BlockSize];
+        int mCount;
+    };
+
+    int blockIndex(int bx, int by) const
+    { return bx + by * mBlocksWide; }
+
+    static int cellIndex(int x, int y)
+    { return ((y & BlockMask) << BlockShift) + (x & BlockMask); }
+
+    int nextBlock(int bx1, int bx2, int by) const;
 
     int mWidth, mHeight;
-    QHash<int,Cell> mCells;
-    QVector<Cell> mCellsVector;
-    bool mUseVector;
+    int mBlocksWide, mBlocksHigh;
+    int mWordsPerRow;
+    QVector<QSharedDataPointer<Block> > mBlocks;
+    QVector<quint32> mPresent;
+    int mBlockCount;
     Cell mEmptyCell;
 };
 #endif
@@ -256,11 +335,33 @@ public:
      * coordinates have to be within this layer.
      */
     const Cell &cellAt(int x, int y) const
+#if SPARSE_TILELAYER
+    { return mGrid.at(x, y); }
+#else
     { return mGrid.at(x + y * mWidth); }
+#endif
 
     const Cell &cellAt(const QPoint &point) const
     { return cellAt(point.x(), point.y()); }
 
+#if SPARSE_TILELAYER
+    /**
+     * Returns an iterator over the non-empty cells inside \a rect, in row
+     * order. The rectangle is in local coordinates and is clipped to this
+     * layer.
+     */
+    SparseTileGrid::Iterator cells(const QRect &rect) const
+    { return SparseTileGrid::Iterator(mGrid, rect); }
+
+    /**
+     * Returns a rectangle in local coordinates that contains every non-empty
+     * cell. It is rounded out to the grid's blocks, so it is cheap to compute
+     * but not exact.
+     */
+    QRect cellBounds() const
+    { return mGrid.blockBounds(); }
+#endif
+
     /**
      * Sets the cell at the given coordinates.
      */
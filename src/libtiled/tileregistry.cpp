@@ -0,0 +1,83 @@
+/*
+ * tileregistry.cpp
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tileregistry.h"
+
+#include <QMutex>
+#include <QQueue>
+
+using namespace Tiled;
+
+TileRegistry::Slot *TileRegistry::sPages[TileRegistry::MaxPages];
+
+namespace {
+
+QMutex sMutex;
+quint32 sNextIndex = 1;
+QQueue<quint32> sFreeIds; // The last id each free slot had, oldest first.
+int sCount = 0;
+
+} // namespace
+
+quint32 TileRegistry::add(Tile *tile)
+{
+    QMutexLocker locker(&sMutex);
+    quint32 id;
+    if (!sFreeIds.isEmpty()) {
+        // Reusing the slot freed longest ago makes it least likely that a
+        // stale Cell still holds an id that wraps around to the new one.
+        const quint32 old = sFreeIds.dequeue();
+        id = (old + (1u << IndexBits)) & ((1u << IdBits) - 1);
+    } else {
+        if (sNextIndex > quint32(IndexMask))
+            qFatal("TileRegistry::add: more than %d tiles at once", int(IndexMask));
+        id = sNextIndex++;
+        if (!sPages[id >> PageShift])
+            sPages[id >> PageShift] = new Slot[PageSize]();
+    }
+    Slot &slot = sPages[(id & IndexMask) >> PageShift][id & (PageSize - 1)];
+    slot.tile = tile;
+    slot.id = id;
+    ++sCount;
+    return id;
+}
+
+void TileRegistry::remove(quint32 id)
+{
+    if (!id)
+        return;
+    QMutexLocker locker(&sMutex);
+    Slot &slot = sPages[(id & IndexMask) >> PageShift][id & (PageSize - 1)];
+    slot.tile = 0;
+    slot.id = 0;
+    sFreeIds.enqueue(id);
+    --sCount;
+}
+
+int TileRegistry::count()
+{
+    QMutexLocker locker(&sMutex);
+    return sCount;
+}
@@ -0,0 +1,95 @@
+/*
+ * tileregistry.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TILEREGISTRY_H
+#define TILEREGISTRY_H
+
+#include "tiled_global.h"
+
+namespace Tiled {
+
+class Tile;
+
+/**
+ * Gives every Tile in the process a small id so that a Cell can refer to
+ * its tile with 29 bits instead of a pointer.  Id 0 is never used, it means
+ * "no tile".
+ *
+ * An id is a slot index in the low bits and a generation in the high bits.
+ * When a tile is deleted its slot goes to the back of a free list, and the
+ * next tile to use that slot gets the next generation.  A Cell that outlives
+ * its tile (in an undo command, the clipboard, or a layer still using a
+ * reloaded tileset) then finds no tile instead of an unrelated one, and the
+ * table only grows with the number of tiles alive at once, not with every
+ * tile ever created.  A stale id only matches again once its slot has been
+ * reused GenerationCount times.
+ *
+ * Looking up a tile doesn't lock.  The table is made of pages that are never
+ * moved or freed, so a page exists before any id pointing into it is handed
+ * out.
+ */
+class TILEDSHARED_EXPORT TileRegistry
+{
+public:
+    enum {
+        IdBits = 29,
+        IndexBits = 21,
+        IndexMask = (1 << IndexBits) - 1,
+        GenerationCount = 1 << (IdBits - IndexBits),
+        PageShift = 14,
+        PageSize = 1 << PageShift,
+        MaxPages = (1 << IndexBits) >> PageShift
+    };
+
+    static quint32 add(Tile *tile);
+    static void remove(quint32 id);
+
+    /**
+     * Returns the tile with the given id, or 0 if that tile was deleted.
+     */
+    static Tile *tile(quint32 id)
+    {
+        const Slot &slot = sPages[(id & IndexMask) >> PageShift][id & (PageSize - 1)];
+        return (slot.id == id) ? slot.tile : 0;
+    }
+
+    /**
+     * Returns the number of tiles that currently have an id.
+     */
+    static int count();
+
+private:
+    struct Slot
+    {
+        Tile *tile;
+        quint32 id;
+    };
+
+    static Slot *sPages[MaxPages];
+};
+
+} // namespace Tiled
+
+#endif // TILEREGISTRY_H
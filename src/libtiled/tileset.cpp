@@ -92,7 +92,7 @@ static bool tryCreateAtlas(Tileset *tileset, const QImage &image, int size)
         int width = extents[2] - extents[0];
         int height = extents[3] - extents[1];
 //        qDebug() << fileName << image.width() << image.height() << "->" << width << height;
-        QImage image4(width, height, image.format());
+        QImage image4(width, height, QImage::Format_ARGB32_Premultiplied);
         image4.fill(Qt::transparent);
         QPainter painter(&image4);
         for (auto it = ids.cbegin(); it != ids.cend(); it++) {
@@ -111,13 +111,21 @@ static bool tryCreateAtlas(Tileset *tileset, const QImage &image, int size)
             tile->setAtlasSize(tile->image().size());
 
             painter.drawImage(QRect(xywh[0], xywh[1], xywh[2], xywh[3]), tile->image());
-
-            /////
-//            tile->setEmptyImage();
-            /////
         }
         painter.end();
         tileset->setImage(image4);
+
+        // Point the tiles at the atlas so the sheet they were cut from can
+        // be freed.
+        for (auto it = ids.cbegin(); it != ids.cend(); it++) {
+            uint16_t xywh[4];
+            atlas_get_vtex_xywh_coords(atlas, it.value(), 0, xywh);
+            QRect r(xywh[0], xywh[1], xywh[2], xywh[3]);
+            if (!image4.rect().contains(r))
+                continue;
+            Tile *tile = tileset->tileAt(it.key());
+            tile->setImage(image4, r, tile->offset(), tile->size());
+        }
     }
 
     if (atlas != nullptr) {
@@ -168,12 +176,18 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
     for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
         for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
 #ifdef ZOMBOID
-            QImage tileImage = image2.copy(x, y, mTileWidth, mTileHeight);
+            // Tiles are views onto image2 until the atlas is built, no pixels
+            // are copied per tile.
+            const QRect tileRect(x, y, mTileWidth, mTileHeight);
+            const QRect r = Tile::opaqueRect(image2, tileRect);
+            const QPoint offset = r.topLeft() - tileRect.topLeft();
 
             if (tileNum < oldTilesetSize) {
-                mTiles.at(tileNum)->setImage(tileImage);
+                mTiles.at(tileNum)->setImage(image2, r, offset, tileRect.size());
             } else {
-                mTiles.append(new Tile(tileImage, tileNum, this));
+                Tile *tile = new Tile(mTileWidth, mTileHeight, tileNum, this);
+                tile->setImage(image2, r, offset, tileRect.size());
+                mTiles.append(tile);
             }
 #else
             const QImage tileImage = image.copy(x, y, mTileWidth, mTileHeight);
@@ -392,7 +406,10 @@ Tileset *TilesetImageCache::addTileset(Tileset *ts)
 
     for (int tileNum = 0; tileNum < ts->tileCount(); ++tileNum) {
         Tile *tile = ts->tileAt(tileNum);
-        cached->mTiles.append(new Tile(tile, tileNum, cached));
+        Tile *copy = new Tile(tile, tileNum, cached);
+        copy->setAtlasUVST(tile->atlasUVST());
+        copy->setAtlasSize(tile->atlasSize());
+        cached->mTiles.append(copy);
     }
 
     mTilesets.append(cached);
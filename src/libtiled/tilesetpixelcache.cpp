@@ -0,0 +1,216 @@
+/*
+ * tilesetpixelcache.cpp
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tilesetpixelcache.h"
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QStandardPaths>
+#include <QSysInfo>
+
+using namespace Tiled;
+
+#define CACHE_MAGIC 0x50545043 // PTPC
+#define CACHE_VERSION 2
+
+// The pixels start at this offset so they are aligned in the mapped file.
+static const int HEADER_SIZE = 64;
+
+static QAtomicInt sEnabled(0);
+static QString sCacheDirectory;
+
+void TilesetPixelCache::setEnabled(bool enabled)
+{
+    sEnabled.storeRelease(enabled ? 1 : 0);
+}
+
+bool TilesetPixelCache::isEnabled()
+{
+    return sEnabled.loadAcquire() != 0;
+}
+
+void TilesetPixelCache::setCacheDirectory(const QString &path)
+{
+    sCacheDirectory = path;
+}
+
+QString TilesetPixelCache::cacheDirectory()
+{
+    if (sCacheDirectory.isEmpty()) {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                QLatin1String("/tilesets");
+    }
+    return sCacheDirectory;
+}
+
+// Images from different directories may have the same name, so the name of
+// the cache file includes a hash of the image's path.
+QString TilesetPixelCache::cacheFileName(const QString &imageFileName, bool is2x)
+{
+    QFileInfo imageFileInfo(imageFileName);
+    const QByteArray hash = QCryptographicHash::hash(
+                imageFileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return cacheDirectory() + QLatin1Char('/') + imageFileInfo.completeBaseName() +
+            QLatin1Char('-') + QString::fromLatin1(hash.left(16)) +
+            (is2x ? QLatin1String(".2x.pixels") : QLatin1String(".1x.pixels"));
+}
+
+QImage TilesetPixelCache::readImage(const QString &imageFileName, bool is2x)
+{
+    if (!isEnabled())
+        return QImage(imageFileName).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QImage image = readCache(imageFileName, is2x);
+    if (!image.isNull())
+        return image;
+
+    image = QImage(imageFileName);
+    if (image.isNull())
+        return image;
+    image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    // If this fails the PNG is simply decoded again next time.
+    writeCache(image, imageFileName, is2x);
+    return image;
+}
+
+// Deleting the QFile unmaps the file.
+static void unmapCacheFile(void *info)
+{
+    delete static_cast<QFile*>(info);
+}
+
+QImage TilesetPixelCache::readCache(const QString &imageFileName, bool is2x)
+{
+    mError.clear();
+
+    QFileInfo imageFileInfo(imageFileName);
+    QString fileName = cacheFileName(imageFileName, is2x);
+    if (!QFileInfo::exists(fileName)) {
+        mError = tr("No cache file for %1").arg(imageFileName);
+        return QImage();
+    }
+
+    QScopedPointer<QFile> file(new QFile(fileName));
+    if (!file->open(QFile::ReadOnly)) {
+        mError = tr("Couldn't open %1").arg(fileName);
+        return QImage();
+    }
+    const qint64 fileSize = file->size();
+    const uchar *data = fileSize >= HEADER_SIZE ? file->map(0, fileSize) : 0;
+    if (!data) {
+        mError = tr("%1 isn't a tileset cache file").arg(fileName);
+        return QImage();
+    }
+
+    QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char*>(data), HEADER_SIZE));
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    quint8 byteOrder, scale;
+    qint64 imageSize, imageModified;
+    qint32 width, height, bytesPerLine;
+    in >> magic >> version >> byteOrder >> scale >> imageSize >> imageModified
+       >> width >> height >> bytesPerLine;
+
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC) {
+        mError = tr("%1 isn't a tileset cache file").arg(fileName);
+        return QImage();
+    }
+    if (version != CACHE_VERSION || byteOrder != QSysInfo::ByteOrder) {
+        mError = tr("%1 is from a different version").arg(fileName);
+        return QImage();
+    }
+    if (scale != (is2x ? 2 : 1) || imageSize != imageFileInfo.size() ||
+            imageModified != imageFileInfo.lastModified().toMSecsSinceEpoch()) {
+        mError = tr("%1 is out of date").arg(fileName);
+        return QImage();
+    }
+
+    const qint64 payloadSize = qint64(bytesPerLine) * height;
+    if (width <= 0 || height <= 0 || bytesPerLine < width * 4 ||
+            fileSize != HEADER_SIZE + payloadSize) {
+        mError = tr("%1 is corrupt").arg(fileName);
+        return QImage();
+    }
+
+    // The image reads straight from the mapped file and unmaps it when the
+    // last copy of the image is gone.  It is read-only, anything that
+    // modifies it gets its own copy.
+    QFile *mapped = file.take();
+    return QImage(data + HEADER_SIZE, width, height, bytesPerLine,
+                  QImage::Format_ARGB32_Premultiplied, unmapCacheFile, mapped);
+}
+
+bool TilesetPixelCache::writeCache(const QImage &image_, const QString &imageFileName,
+                                   bool is2x)
+{
+    mError.clear();
+
+    const QImage image = image_.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const qint64 payloadSize = qint64(image.bytesPerLine()) * image.height();
+
+    QFileInfo imageFileInfo(imageFileName);
+    QString fileName = cacheFileName(imageFileName, is2x);
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) {
+        mError = tr("Couldn't create the cache directory for %1").arg(imageFileName);
+        return false;
+    }
+
+    QByteArray header;
+    {
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION)
+            << quint8(QSysInfo::ByteOrder) << quint8(is2x ? 2 : 1)
+            << qint64(imageFileInfo.size())
+            << qint64(imageFileInfo.lastModified().toMSecsSinceEpoch())
+            << qint32(image.width()) << qint32(image.height())
+            << qint32(image.bytesPerLine());
+    }
+    Q_ASSERT(header.size() <= HEADER_SIZE);
+    header.resize(HEADER_SIZE);
+
+    // QSaveFile so a reader in another thread never sees a partial file.
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        mError = file.errorString();
+        return false;
+    }
+    if (file.write(header) != HEADER_SIZE ||
+            file.write(reinterpret_cast<const char*>(image.constBits()), payloadSize) != payloadSize ||
+            !file.commit()) {
+        mError = file.errorString();
+        return false;
+    }
+    return true;
+}
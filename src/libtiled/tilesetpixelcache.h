@@ -0,0 +1,99 @@
+/*
+ * tilesetpixelcache.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TILESETPIXELCACHE_H
+#define TILESETPIXELCACHE_H
+
+#include "tiled_global.h"
+
+#include <QCoreApplication>
+#include <QImage>
+#include <QString>
+
+namespace Tiled {
+
+/**
+  * Keeps decoded tileset images on disk so the PNG files don't have to be
+  * decoded every time the tilesets are loaded.
+  *
+  * Each cache file holds the premultiplied pixels of one tileset image,
+  * along with the size and modification time of the PNG and whether it is
+  * the 1x or 2x image.  A cache file whose header doesn't match the PNG and
+  * this version is ignored and written again; the pixels themselves aren't
+  * checked, so loading only touches the pages of the mapped file that are
+  * used.  Cache files are mapped into memory with QFile::map rather than
+  * read into a buffer.
+  *
+  * The cache is off until setEnabled(true) is called.  The files live in
+  * the user's cache directory, never beside the tileset images, which may be
+  * read-only or shared.
+  */
+class TILEDSHARED_EXPORT TilesetPixelCache
+{
+    Q_DECLARE_TR_FUNCTIONS(TilesetPixelCache)
+
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    /**
+      * Sets the directory the cache files are kept in.  The default is a
+      * "tilesets" directory in QStandardPaths::CacheLocation.  Call this
+      * before any tilesets are loaded.
+      */
+    static void setCacheDirectory(const QString &path);
+    static QString cacheDirectory();
+
+    /**
+      * Returns the name of the cache file for the given tileset image.  The
+      * directory isn't created until a cache file is written.
+      */
+    static QString cacheFileName(const QString &imageFileName, bool is2x);
+
+    /**
+      * Returns the premultiplied image for \a imageFileName.  If the cache
+      * is enabled it comes from the cache file when that is up to date,
+      * otherwise the PNG is decoded and the cache file is written again.
+      */
+    QImage readImage(const QString &imageFileName, bool is2x);
+
+    /**
+      * Returns the cached image, or a null image if there is no cache file or
+      * it can't be used, in which case errorString() says why.
+      */
+    QImage readCache(const QString &imageFileName, bool is2x);
+
+    bool writeCache(const QImage &image, const QString &imageFileName, bool is2x);
+
+    QString errorString() const
+    { return mError; }
+
+private:
+    QString mError;
+};
+
+} // namespace Tiled
+
+#endif // TILESETPIXELCACHE_H
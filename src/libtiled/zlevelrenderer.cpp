@@ -189,7 +189,18 @@ void ZLevelRenderer::drawGrid(QPainter *painter, const QRectF &rect, QColor grid
     }
 }
 
-static Tile *g_missing_tile = 0;
+// Drawn in place of tiles whose image failed to load.  Created once, even
+// when several threads draw at the same time.
+static Tile *missingTile()
+{
+    static Tile *tile = []() -> Tile* {
+        Tileset *ts = new Tileset(QLatin1String("MISSING"), 64, 128);
+        if (ts->loadFromImage(QImage(QLatin1String(":/images/missing-tile.png")), QLatin1String(":/images/missing-tile.png")))
+            return ts->tileAt(0);
+        return 0;
+    }();
+    return tile;
+}
 
 void ZLevelRenderer::drawTileLayer(QPainter *painter,
                                       const TileLayer *layer,
@@ -266,17 +277,18 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
             if (layer->contains(columnItr)) {
                 const Cell &cell = layer->cellAt(columnItr);
                 if (!cell.isEmpty()) {
-                    QImage img = cell.tile->image();
-                    const QPoint offset = cell.tile->tileset()->tileOffset() + cell.tile->offset();
+                    const Tile *tile = cell.tile();
+                    QImage img = tile->image();
+                    const QPoint offset = tile->tileset()->tileOffset() + tile->offset();
 
                     qreal m11 = 1;      // Horizontal scaling factor
                     qreal m12 = 0;      // Vertical shearing factor
                     qreal m21 = 0;      // Horizontal shearing factor
                     qreal m22 = 1;      // Vertical scaling factor
                     qreal dx = offset.x() + x;
-                    qreal dy = offset.y() + y - cell.tile->height();
+                    qreal dy = offset.y() + y - tile->height();
 
-                    if (cell.flippedAntiDiagonally) {
+                    if (cell.flippedAntiDiagonally()) {
                         // Use shearing to swap the X/Y axis
                         m11 = 0;
                         m12 = 1;
@@ -286,29 +298,29 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
                         // Compensate for the swap of image dimensions
                         dy += img.height() - img.width();
                     }
-                    if (cell.flippedHorizontally) {
+                    if (cell.flippedHorizontally()) {
                         m11 = -m11;
                         m21 = -m21;
-                        dx += cell.flippedAntiDiagonally ? img.height()
+                        dx += cell.flippedAntiDiagonally() ? img.height()
                                                          : img.width();
                     }
-                    if (cell.flippedVertically) {
+                    if (cell.flippedVertically()) {
                         m12 = -m12;
                         m22 = -m22;
-                        dy += cell.flippedAntiDiagonally ? img.width()
+                        dy += cell.flippedAntiDiagonally() ? img.width()
                                                          : img.height();
                     }
 
-                    if (tileWidth == cell.tile->width() * 2) {
+                    if (tileWidth == tile->width() * 2) {
                         m11 *= 2.0f;
                         m22 *= 2.0f;
-                        dx += cell.tile->offset().x();
-                        dy -= cell.tile->height() - cell.tile->offset().y();
-                    } else if (tileWidth == cell.tile->width() / 2) {
+                        dx += tile->offset().x();
+                        dy -= tile->height() - tile->offset().y();
+                    } else if (tileWidth == tile->width() / 2) {
                         float scale = 0.5f;
                         m11 *= scale;
                         m22 *= scale;
-                        dy += cell.tile->height() / 2;
+                        dy += tile->height() / 2;
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
@@ -426,16 +438,10 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                     }
                     const Cell *cell = cells[i];
                     if (!cell->isEmpty()) {
-                        Tile *tile = cell->tile;
+                        Tile *tile = cell->tile();
                         if (tile->image().isNull()) {
-                            if (g_missing_tile == 0) {
-                                Tileset *ts = new Tileset(QLatin1String("MISSING"), 64, 128);
-                                if (ts->loadFromImage(QImage(QLatin1String(":/images/missing-tile.png")), QLatin1String(":/images/missing-tile.png"))) {
-                                    g_missing_tile = ts->tileAt(0);
-                                }
-                            }
-                            if (g_missing_tile)
-                                tile = g_missing_tile;
+                            if (Tile *missing = missingTile())
+                                tile = missing;
                         }
                         QImage img = tile->image();
                         const QPoint offset = tile->tileset()->tileOffset() + tile->offset();
@@ -447,7 +453,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                         qreal dx = offset.x() + x;
                         qreal dy = offset.y() + y - tile->height();
 
-                        if (cell->flippedAntiDiagonally) {
+                        if (cell->flippedAntiDiagonally()) {
                             // Use shearing to swap the X/Y axis
                             m11 = 0;
                             m12 = 1;
@@ -457,16 +463,16 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                             // Compensate for the swap of image dimensions
                             dy += img.height() - img.width();
                         }
-                        if (cell->flippedHorizontally) {
+                        if (cell->flippedHorizontally()) {
                             m11 = -m11;
                             m21 = -m21;
-                            dx += cell->flippedAntiDiagonally ? img.height()
+                            dx += cell->flippedAntiDiagonally() ? img.height()
                                                              : img.width();
                         }
-                        if (cell->flippedVertically) {
+                        if (cell->flippedVertically()) {
                             m12 = -m12;
                             m22 = -m22;
-                            dy += cell->flippedAntiDiagonally ? img.width()
+                            dy += cell->flippedAntiDiagonally() ? img.width()
                                                              : img.height();
                         }
 